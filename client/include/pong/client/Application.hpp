@@ -25,6 +25,8 @@ public:
     bool is_connected() const;
     bool is_connecting() const;
 
+    std::string const& username_of(pong::packet::server::name_id_t id) const;
+
     sf::Font const& get_font() const;
 
     unsigned width() const;
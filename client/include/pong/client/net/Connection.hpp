@@ -2,8 +2,12 @@
 
 #include <SFML/Network.hpp>
 
+#include <pong/packet/Server.hpp>
+
 #include <memory>
 #include <future>
+#include <string>
+#include <unordered_map>
 
 namespace pong::client::net {
 
@@ -13,6 +17,10 @@ private:
     std::unique_ptr<sf::TcpSocket> socket;
     std::future<std::unique_ptr<sf::TcpSocket>> future_socket;
 
+    // Usernames declared by the server with `UserName`, by name id
+    // A map: the ids come from the wire, a large one must not size a vector
+    std::unordered_map<pong::packet::server::name_id_t, std::string> usernames;
+
 public:
 
     enum class Status {
@@ -31,6 +39,9 @@ public:
 
     sf::TcpSocket* get_socket();
 
+    void learn_username(pong::packet::server::UserName const& user_name);
+    std::string const& username_of(pong::packet::server::name_id_t id) const;
+
 };
 
 }
\ No newline at end of file
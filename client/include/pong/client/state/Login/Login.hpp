@@ -10,6 +10,8 @@ class Login : public State {
 public:
 
     Login(Application app);
+    // Log in again with the same name on the server of the federation the user is redirected to
+    Login(Application app, std::string username, pong::packet::server::Redirect redirect);
 
     action::Actions on_window_event(Application application, WindowEvent const& window_event) override;
     action::Actions on_send(Application application, pong::packet::client::Any const& game_packet) override;
@@ -42,6 +44,9 @@ private:
 
     std::optional<std::string> username;
 
+    // Request sent again once in the lobby of the new server
+    std::optional<pong::packet::server::Redirect> redirect;
+
     ClientState client_state;
 
 };
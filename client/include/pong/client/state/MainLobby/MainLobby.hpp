@@ -9,7 +9,7 @@ class MainLobby : public State {
 
 public:
 
-    MainLobby(Application app, std::string username);
+    MainLobby(Application app, std::string username, std::optional<pong::packet::server::Redirect> redirect = std::nullopt);
 
     action::Actions on_window_event(Application application, WindowEvent const& window_event) override;
     action::Actions on_send(Application application, pong::packet::client::Any const& game_packet) override;
@@ -28,7 +28,7 @@ public:
 
 private:
 
-    void add_to_people_count(int additional_people);
+    void set_people_count(unsigned people);
 
     action::Actions new_on_send(Application application, pong::packet::client::Any const& game_packet);
     action::Actions new_on_receive(Application application, pong::packet::server::Any const& game_packet);
@@ -43,11 +43,10 @@ private:
     action::Actions creating_room_on_receive(Application application, pong::packet::server::Any const& game_packet);
 
     using Events = std::variant<
-        pong::packet::server::NewUser,
-        pong::packet::server::OldUser,
+        pong::packet::server::UserCount,
         pong::packet::server::NewRoom,
         pong::packet::server::OldRoom,
-        pong::packet::server::RoomInfo
+        pong::packet::server::RoomUpdate
     >;
 
     action::Actions events_on_receive(Application application, Events const& events);
@@ -60,6 +59,9 @@ private:
 
     std::string username;
 
+    // The request that redirected the user to this server, sent again after `LobbyInfo`
+    std::optional<pong::packet::server::Redirect> redirect;
+
     ClientState client_state;
 
     unsigned int people_count;
@@ -32,6 +32,12 @@ bool Application::is_connecting() const {
 
 
 
+std::string const& Application::username_of(pong::packet::server::name_id_t id) const {
+    return connection.username_of(id);
+}
+
+
+
 sf::Font const& Application::get_font() const {
     return font;
 }
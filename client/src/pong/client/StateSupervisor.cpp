@@ -225,6 +225,11 @@ void StateSupervisor::process_events(float dt) {
     }
 
     for(auto& network_event : receive_packets()) {
+        // Names are valid for the whole connection, whatever the state receiving them
+        if (auto* user_name = std::get_if<pong::packet::server::UserName>(&network_event)) {
+            connection.learn_username(*user_name);
+        }
+
         process_actions(state->on_receive(app, network_event));
     }
 
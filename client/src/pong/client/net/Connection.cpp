@@ -25,6 +25,7 @@ void Connection::stop_connection() {
     NOTICE("Stop connection");
     socket = nullptr;
     future_socket = {};
+    usernames.clear();
     assert(!is_connecting());
 }
 
@@ -63,4 +64,27 @@ sf::TcpSocket* Connection::get_socket() {
     return socket.get();
 }
 
+void Connection::learn_username(pong::packet::server::UserName const& user_name) {
+    if (user_name.id == pong::packet::server::no_name) {
+        WARN("Received a username for the id #0");
+        return;
+    }
+
+    usernames[user_name.id] = user_name.username;
+}
+
+std::string const& Connection::username_of(pong::packet::server::name_id_t id) const {
+    static std::string const unknown;
+
+    auto it = usernames.find(id);
+    if (it == std::end(usernames)) {
+        if (id != pong::packet::server::no_name) {
+            WARN("Unknown username id #", id);
+        }
+        return unknown;
+    }
+
+    return it->second;
+}
+
 }
\ No newline at end of file
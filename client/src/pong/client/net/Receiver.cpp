@@ -9,7 +9,14 @@ std::pair<Status, std::optional<pong::packet::server::Any>> receive(sf::TcpSocke
     switch(socket.receive(packet)) {
         case sf::Socket::Status::Done: {
             pong::packet::server::Any game_packet;
-            packet >> game_packet;
+            if (auto error = pong::packet::server::decode(packet.getData(), packet.getDataSize(), game_packet); error != pong::packet::DecodeError::None) {
+                ERROR("Received a malformed packet: ", pong::packet::to_string(error));
+                return std::make_pair(
+                    Status::Error,
+                    std::nullopt
+                );
+            }
+
             return std::make_pair(
                 Status::Available,
                 std::move(game_packet)
@@ -16,6 +16,13 @@ Login::Login(Application app)
 ,   client_state{ Login::ClientState::Invalid }
 {}
 
+Login::Login(Application app, std::string _username, pong::packet::server::Redirect _redirect) 
+:   graphics(app)
+,   username{ std::move(_username) }
+,   redirect{ std::move(_redirect) }
+,   client_state{ Login::ClientState::Invalid }
+{}
+
 action::Actions Login::on_window_event(Application app, WindowEvent const& window_event) {
     return std::visit(Visitor{
         [this] (MouseButtonReleased const& event) {
@@ -152,19 +159,24 @@ action::Actions Login::on_update(Application app, float dt) {
 action::Actions Login::on_connection(Application) {
     assert(username.has_value());
 
-    auto actions = action::seq(action::send(pong::packet::client::ChangeUsername{ *username }));
+    auto actions = action::seq(
+        action::send(pong::packet::client::Capabilities{ pong::packet::Capability::CompressedFrames }),
+        action::send(pong::packet::client::ChangeUsername{ *username })
+    );
     return actions;
 }
 
 action::Actions Login::on_connection_failure(Application) {
     ERROR("Connection Failure");
     username = std::nullopt;
+    redirect = std::nullopt;
     return action::idle();
 }
 
 action::Actions Login::on_disconnection(Application) {
     ERROR("Unexpected disconnection");
     username = std::nullopt;
+    redirect = std::nullopt;
     return action::idle();
 }
 
@@ -215,7 +227,7 @@ action::Actions Login::connecting_on_send(Application, pong::packet::client::Any
 action::Actions Login::connecting_on_receive(Application application, pong::packet::server::Any const& game_packet) {
     if (auto* response = std::get_if<packet::server::ChangeUsernameResponse>(&game_packet)) {
         if (response->valid) {
-            return action::seq(action::change_state<MainLobby>(application, std::move(*username)));
+            return action::seq(action::change_state<MainLobby>(application, std::move(*username), std::move(redirect)));
         } else {
             client_state = Login::ClientState::Invalid;
             return action::idle();
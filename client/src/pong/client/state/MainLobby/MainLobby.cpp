@@ -1,5 +1,6 @@
 #include <pong/client/state/MainLobby/MainLobby.hpp>
 #include <pong/client/state/Room/Room.hpp>
+#include <pong/client/state/Login/Login.hpp>
 
 #include <pong/client/Logger.hpp>
 #include <pong/client/Visitor.hpp>
@@ -10,9 +11,10 @@
 
 namespace pong::client::state {
 
-MainLobby::MainLobby(Application app, std::string _username) 
+MainLobby::MainLobby(Application app, std::string _username, std::optional<pong::packet::server::Redirect> _redirect) 
 :   graphics(app)
 ,   username{ std::move(_username) }
+,   redirect{ std::move(_redirect) }
 ,   client_state{ MainLobby::ClientState::New }
 ,   people_count{ 0 }
 {}
@@ -180,8 +182,8 @@ void MainLobby::draw(Application app, sf::RenderTarget& target, sf::RenderStates
 
 
 
-void MainLobby::add_to_people_count(int additional_people) {
-    people_count += additional_people;
+void MainLobby::set_people_count(unsigned people) {
+    people_count = people;
     graphics.set_people_count(people_count);
 }
 
@@ -197,13 +199,8 @@ using require_not_event_t = std::enable_if_t<!std::is_constructible_v<MainLobby:
 
 action::Actions MainLobby::events_on_receive(Application app, MainLobby::Events const& events) {
     return std::visit(Visitor{
-        [this, &app] (packet::server::NewUser const& new_user) {
-            add_to_people_count(1);
-            return action::idle();
-        },
-
-        [this, &app] (packet::server::OldUser const& old_user) {
-            add_to_people_count(-1);
+        [this, &app] (packet::server::UserCount const& user_count) {
+            set_people_count(user_count.count);
             return action::idle();
         },
 
@@ -215,7 +212,7 @@ action::Actions MainLobby::events_on_receive(Application app, MainLobby::Events
             return action::idle();
         },
 
-        [this, &app] (packet::server::RoomInfo const& room_info) {
+        [this, &app] (packet::server::RoomUpdate const& room_update) {
             return action::idle();
         }
     }, events);
@@ -234,7 +231,18 @@ action::Actions MainLobby::new_on_receive(Application application, pong::packet:
 
     if (auto* lobby_info = std::get_if<packet::server::LobbyInfo>(&game_packet)) {
         client_state = MainLobby::ClientState::Regular;
-        add_to_people_count(lobby_info->users.size() + 1 /* me */);
+        set_people_count(lobby_info->user_count);
+
+        if (redirect) {
+            auto request = *redirect;
+            redirect = std::nullopt;
+
+            if (request.request == packet::server::Redirect::Request::EnterRoom) {
+                return action::seq(action::send(pong::packet::client::EnterRoom{ request.room_id }));
+            } else {
+                return action::seq(action::send(pong::packet::client::CreateRoom{}));
+            }
+        }
     }
 
     return action::idle();
@@ -284,6 +292,15 @@ action::Actions MainLobby::entering_room_on_send(Application app, pong::packet::
 
 action::Actions MainLobby::entering_room_on_receive(Application app, pong::packet::server::Any const& game_packet) {
     return std::visit(Visitor {
+        [this, &app] (packet::server::Redirect const& redirect_to) {
+            NOTICE("Redirected to ", redirect_to.address, ":", redirect_to.port);
+            return action::seq(
+                action::disconnect(),
+                action::change_state<Login>(app, std::move(username), redirect_to),
+                action::connect(redirect_to.address, redirect_to.port)
+            );
+        },
+
         [this, &app] (packet::server::EnterRoomResponse const& response) {
             if (response.result == packet::server::EnterRoomResponse::Result::Okay) {
                 return action::seq(action::change_state<Room>(app, std::move(username)));
@@ -315,6 +332,15 @@ action::Actions MainLobby::creating_room_on_send(Application app, pong::packet::
 
 action::Actions MainLobby::creating_room_on_receive(Application app, pong::packet::server::Any const& game_packet) {
     return std::visit(Visitor {
+        [this, &app] (packet::server::Redirect const& redirect_to) {
+            NOTICE("Redirected to ", redirect_to.address, ":", redirect_to.port);
+            return action::seq(
+                action::disconnect(),
+                action::change_state<Login>(app, std::move(username), redirect_to),
+                action::connect(redirect_to.address, redirect_to.port)
+            );
+        },
+
         [this, &app] (packet::server::CreateRoomResponse const& response) {
             if (response.reason == packet::server::CreateRoomResponse::Reason::Okay) {
                 return action::seq(action::change_state<Room>(app, std::move(username)));
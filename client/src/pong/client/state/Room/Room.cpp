@@ -510,7 +510,7 @@ using require_not_event_t = std::enable_if_t<!std::is_constructible_v<Room::Even
 action::Actions Room::events_on_receive(Application app, Room::Events const& events) {
     return std::visit(Visitor {
         [this, &app] (packet::server::NewUser const& new_user) {
-            NOTICE("New user in the room: ", new_user.username);
+            NOTICE("New user in the room: ", app.username_of(new_user.user));
 
             add_to_spectator_count(1);
 
@@ -518,7 +518,7 @@ action::Actions Room::events_on_receive(Application app, Room::Events const& eve
         },
 
         [this, &app] (packet::server::OldUser const& old_user) {
-            NOTICE("Old user in the room: ", old_user.username);
+            NOTICE("Old user in the room: ", app.username_of(old_user.user));
 
             add_to_spectator_count(-1);
 
@@ -526,14 +526,14 @@ action::Actions Room::events_on_receive(Application app, Room::Events const& eve
         },
 
         [this, &app] (packet::server::NewPlayer const& new_player) {
-            NOTICE("New player in the room: ", new_player.username);
+            NOTICE("New player in the room: ", app.username_of(new_player.user));
 
             add_to_spectator_count(-1);
 
             if (new_player.side == pong::Side::Left) {
-                update_left_player(new_player.username);
+                update_left_player(app.username_of(new_player.user));
             } else {
-                update_right_player(new_player.username);
+                update_right_player(app.username_of(new_player.user));
             }
 
             game = room::Game{};
@@ -542,7 +542,7 @@ action::Actions Room::events_on_receive(Application app, Room::Events const& eve
         },
 
         [this, &app] (packet::server::OldPlayer const& old_player) {
-            NOTICE("Old player in the room: ", old_player.username);
+            NOTICE("Old player in the room: ", app.username_of(old_player.user));
 
             add_to_spectator_count(1);
 
@@ -606,8 +606,8 @@ action::Actions Room::new_on_receive(Application app, pong::packet::server::Any
             
             game = room::Game{};
 
-            update_left_player(std::move(room_info.left_player));
-            update_right_player(std::move(room_info.right_player));
+            update_left_player(app.username_of(room_info.left_player));
+            update_right_player(app.username_of(room_info.right_player));
 
             set_state(Room::ClientState::Spectator);
             
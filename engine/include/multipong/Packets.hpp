@@ -66,8 +66,9 @@ sf::Packet& operator >> (sf::Packet& p, std::vector<T>& v) {
     int size{ 0 };
     p >> size;
 
-    v.reserve(size);
-    for(; size > 0; --size) {
+    // The size comes from the wire, it isn't trusted to reserve: the loop stops at the end of the packet
+    v.clear();
+    for(; size > 0 && p; --size) {
         p >> v.emplace_back();
     }
 
@@ -6,12 +6,38 @@
 #include <multipong/Game.hpp>
 #include <pong/packet/MakePacket.hpp>
 #include <pong/packet/Utility.hpp>
+#include <pong/packet/Fields.hpp>
+#include <pong/packet/Compression.hpp>
+#include <string_view>
+#include <tuple>
 
 namespace pong::packet::client {
 
 MAKE_PACKET(ChangeUsername) {
     static constexpr char const* name = "ChangeUsername";
     std::string username;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field(&ChangeUsername::username, max_username_size)
+        );
+    }
+};
+
+/*
+    `ChangeUsername` decoded in place by the server
+    `username` refers to the bytes of the received frame, it's only valid while the packet is handled
+*/
+struct ChangeUsernameView {
+    using packet_t = ChangeUsername;
+
+    std::string_view username;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<std::string>(&ChangeUsernameView::username, max_username_size)
+        );
+    }
 };
 
 MAKE_PACKET(CreateRoom) {
@@ -37,23 +63,80 @@ MAKE_PACKET(Abandon) {
 MAKE_PACKET(EnterRoom) {
     static constexpr char const* name = "EnterRoom";
     unsigned id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&EnterRoom::id)
+        );
+    }
 };
 
 MAKE_PACKET(Input) {
     static constexpr char const* name = "Input";
     ::pong::Input input;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&Input::input)
+        );
+    }
 };
 
 MAKE_PACKET(SubscribeRoomInfo) {
     static constexpr char const* name = "SubscribeRoomInfo";
     unsigned range_min;
     unsigned range_max_excluded;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&SubscribeRoomInfo::range_min),
+            details::field_as<sf::Uint32>(&SubscribeRoomInfo::range_max_excluded)
+        );
+    }
 };
 
 MAKE_PACKET(AcceptBePlayer) {
     static constexpr char const* name = "AcceptBePlayer";
 };
 
+/*
+    Features supported by the client, sent before `ChangeUsername`
+    `flags` is a combination of `pong::packet::Capability`, the server doesn't use the others
+    Always sent in `Encoding::Sfml`, the frames after it use `Encoding::Compact` if its flag is set
+*/
+MAKE_PACKET(Capabilities) {
+    static constexpr char const* name = "Capabilities";
+    sf::Uint32 flags;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field(&Capabilities::flags)
+        );
+    }
+};
+
+// `FindMatch` without rating: any opponent
+constexpr unsigned no_rating = 0;
+
+/*
+    Wait in the lobby to be paired with another user, in a room created for both (see the matchmaking of the server)
+    The users are paired with the ones of a similar `rating` first, the gap accepted grows as they wait
+*/
+MAKE_PACKET(FindMatch) {
+    static constexpr char const* name = "FindMatch";
+    unsigned rating;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&FindMatch::rating)
+        );
+    }
+};
+
+MAKE_PACKET(LeaveMatchmaking) {
+    static constexpr char const* name = "LeaveMatchmaking";
+};
+
 using Any = std::variant<
     ChangeUsername,
     CreateRoom,
@@ -64,11 +147,22 @@ using Any = std::variant<
     EnterQueue, 
     LeaveQueue,
     SubscribeRoomInfo,
-    AcceptBePlayer
+    AcceptBePlayer,
+    Capabilities,
+    FindMatch,
+    LeaveMatchmaking
 >;
 
+/*
+    Decode a whole packet from [data, data + size), without trusting any length read from it
+    `encoding` is the one of the connection, see Encoding.hpp
+*/
+DecodeError decode(void const* data, std::size_t size, Any& packet, Encoding encoding = Encoding::Sfml);
+
+// Throws std::runtime_error if the packet is malformed
 sf::Packet& operator >> (sf::Packet& p, Any& packet);
 sf::Packet& operator << (sf::Packet& p, Any const& packet);
+std::size_t serialized_size(Any const& packet);
 std::ostream& operator <<(std::ostream& os, Any const& packet);
 std::string to_string(Any const& packet);
 
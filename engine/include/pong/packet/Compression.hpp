@@ -0,0 +1,87 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include <pong/packet/MakePacket.hpp>
+
+namespace pong::packet {
+
+/*
+    Compression of large frames (the rosters of `LobbyInfo` and `RoomInfo`), negotiated with `client::Capabilities`
+
+    A compressed frame carries `compressed_id` instead of the id of the packet, then the size of the packet
+    once decompressed (sf::Uint32), then the packet (its id and its fields) compressed with `compress`:
+
+        [frame size][compressed_id][packet size][compressed packet]
+
+    The header is always in `Encoding::Sfml`, the packet in the encoding of the connection.
+    A packet in `Encoding::Compact` starts with an id below 0x80, so it's never taken for `compressed_id`
+
+    The codec is a byte oriented LZ77, the format of an LZ4 block: sequences of literals followed by a match
+    - token: literal count (high nibble) and match length - 4 (low nibble), 15 meaning that bytes of 255 follow,
+      ended by a byte below 255
+    - the literals
+    - the offset of the match (2 bytes, little endian, 1 to 65535) and the rest of its length
+    The last sequence has no match, it ends at the end of the block
+*/
+
+// Out of the ids of client::Any and server::Any
+constexpr id_t compressed_id{ 0xFFFFFFFF };
+
+// Largest packet a compressed frame can announce, the decoder doesn't allocate more
+constexpr std::size_t max_decompressed_size{ 1 << 20 };
+
+
+/*
+    Flags of `client::Capabilities`
+*/
+enum Capability : sf::Uint32 {
+    CompressedFrames = 1 << 0,
+    // See Encoding.hpp
+    CompactEncoding = 1 << 1
+};
+
+
+/*
+    Bytes `compress` can write for `size` bytes, when nothing matches
+*/
+constexpr std::size_t max_compressed_size(std::size_t size) {
+    return size + size / 255 + 16;
+}
+
+
+/*
+    Compress [data, data + size) into `out`, returns the number of bytes written (at most `max_compressed_size(size)`)
+*/
+std::size_t compress(std::byte const* data, std::size_t size, std::byte* out);
+
+
+/*
+    Decompress [data, data + size) into [out, out + out_size)
+    false if the block is malformed or doesn't decompress to exactly `out_size` bytes, nothing is read or written out of bounds
+*/
+bool decompress(std::byte const* data, std::size_t size, std::byte* out, std::size_t out_size);
+
+
+/*
+    Write the compressed frame of a packet (id and fields) into `frame`, resized to the frame
+*/
+void write_compressed_frame(std::byte const* packet, std::size_t size, std::vector<std::byte>& frame);
+
+
+/*
+    The packet (id and fields) of a frame starts with `compressed_id`
+*/
+bool is_compressed(void const* packet, std::size_t size);
+
+
+/*
+    Decompress the packet of a compressed frame into `packet`
+    false if the frame is malformed or announces more than `max_decompressed_size`
+*/
+bool decompress_packet(void const* data, std::size_t size, std::vector<std::byte>& packet);
+
+}
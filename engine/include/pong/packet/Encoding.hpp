@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace pong::packet {
+
+/*
+    Wire encodings of the packets, selected per connection
+
+    - Sfml: the encoding of sf::Packet, integers in network byte order on their full size,
+      sizes of the vectors as sf::Uint64 and of the strings as sf::Uint32
+    - Compact: every integer (packet ids, sizes, room and name ids, enums) is a LEB128 varint,
+      7 bits per byte starting with the lowest ones, the high bit set when another byte follows.
+      Signed integers are zigzag encoded first, so small negative values stay small.
+      Floats and bools are written as in Sfml
+
+    In both, a frame starts with its size as a fixed sf::Uint32 (the framing of sf::TcpSocket),
+    and a connection starts in Sfml: the client switches to Compact once it sent `client::Capabilities`
+    with `Capability::CompactEncoding`, both ways
+*/
+enum class Encoding : std::uint8_t {
+    Sfml,
+    Compact
+};
+
+constexpr std::size_t number_of_encoding{ 2 };
+
+
+constexpr std::size_t index_of(Encoding encoding) {
+    return static_cast<std::size_t>(encoding);
+}
+
+}
+
+namespace pong::packet::details {
+
+// Longest varint of an integer of `size` bytes
+constexpr std::size_t max_varint_size(std::size_t size) {
+    return (8 * size + 6) / 7;
+}
+
+
+constexpr std::size_t varint_size(std::uint64_t value) {
+    std::size_t size{ 1 };
+    for(; value >= 0x80; value >>= 7) {
+        ++size;
+    }
+    return size;
+}
+
+
+/*
+    The unsigned value written as a varint for the integer `value`
+*/
+template<typename T>
+constexpr std::uint64_t varint_bits(T value) {
+    static_assert(std::is_integral_v<T>);
+
+    if constexpr (std::is_signed_v<T>) {
+        auto wide = static_cast<std::int64_t>(value);
+        return (static_cast<std::uint64_t>(wide) << 1) ^ static_cast<std::uint64_t>(wide >> 63);
+    } else {
+        return static_cast<std::uint64_t>(value);
+    }
+}
+
+
+/*
+    Inverse of `varint_bits`, `bits` must fit in T
+*/
+template<typename T>
+constexpr T from_varint_bits(std::uint64_t bits) {
+    static_assert(std::is_integral_v<T>);
+
+    if constexpr (std::is_same_v<T, bool>) {
+        return bits != 0;
+    }
+    else if constexpr (std::is_signed_v<T>) {
+        return static_cast<T>(static_cast<std::int64_t>(bits >> 1) ^ -static_cast<std::int64_t>(bits & 1));
+    }
+    else {
+        return static_cast<T>(bits);
+    }
+}
+
+
+/*
+    Largest `varint_bits` of a T
+*/
+template<typename T>
+constexpr std::uint64_t max_varint_bits() {
+    if constexpr (std::is_same_v<T, bool>) {
+        return 1;
+    } else {
+        return std::uint64_t{ 0xFFFFFFFFFFFFFFFF } >> (64 - 8 * sizeof(T));
+    }
+}
+
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+#include <iostream>
+#include <variant>
+#include <pong/packet/MakePacket.hpp>
+#include <pong/packet/Utility.hpp>
+#include <pong/packet/Fields.hpp>
+#include <pong/packet/Server.hpp>
+#include <tuple>
+
+/*
+    Protocol between the servers of a federation and their coordinator
+
+    A server joins the coordinator with the address its clients are redirected to, and gets its node id
+    and the range of room slots it owns: the room ids are unique across the federation, the server owning a room
+    is found from its slot. Then both ways the same packets are used:
+    - a server reports its rooms (`RoomUpdate`, `OldRoom`) and its load (`Load`),
+    - the coordinator forwards them to the other servers, with the nodes (`NodeInfo`, `OldNode`)
+      and the server where the new rooms are created (`Placement`).
+    The frames are the ones of the clients, always in `Encoding::Compact`
+*/
+
+namespace pong::packet::federation {
+
+using node_id_t = unsigned;
+
+// A node id that is never given
+constexpr node_id_t no_node = 0;
+
+MAKE_PACKET(Join) {
+    static constexpr char const* name = "Join";
+    std::string address;
+    sf::Uint16 port;
+    // The range owned before a reconnection, `slot_count` is 0 for a new server
+    unsigned first_slot;
+    unsigned slot_count;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field(&Join::address, server::max_address_size),
+            details::field(&Join::port),
+            details::field_as<sf::Uint32>(&Join::first_slot),
+            details::field_as<sf::Uint32>(&Join::slot_count)
+        );
+    }
+};
+
+MAKE_PACKET(Welcome) {
+    static constexpr char const* name = "Welcome";
+    node_id_t node;
+    unsigned first_slot;
+    unsigned slot_count;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&Welcome::node),
+            details::field_as<sf::Uint32>(&Welcome::first_slot),
+            details::field_as<sf::Uint32>(&Welcome::slot_count)
+        );
+    }
+};
+
+MAKE_PACKET(NodeInfo) {
+    static constexpr char const* name = "NodeInfo";
+    node_id_t node;
+    std::string address;
+    sf::Uint16 port;
+    unsigned first_slot;
+    unsigned slot_count;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&NodeInfo::node),
+            details::field(&NodeInfo::address, server::max_address_size),
+            details::field(&NodeInfo::port),
+            details::field_as<sf::Uint32>(&NodeInfo::first_slot),
+            details::field_as<sf::Uint32>(&NodeInfo::slot_count)
+        );
+    }
+};
+
+MAKE_PACKET(OldNode) {
+    static constexpr char const* name = "OldNode";
+    node_id_t node;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&OldNode::node)
+        );
+    }
+};
+
+MAKE_PACKET(Load) {
+    static constexpr char const* name = "Load";
+    // Ignored by the coordinator, set by it when forwarded
+    node_id_t node;
+    unsigned users;
+    unsigned lobby_users;
+    unsigned rooms;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&Load::node),
+            details::field_as<sf::Uint32>(&Load::users),
+            details::field_as<sf::Uint32>(&Load::lobby_users),
+            details::field_as<sf::Uint32>(&Load::rooms)
+        );
+    }
+};
+
+MAKE_PACKET(Placement) {
+    static constexpr char const* name = "Placement";
+    node_id_t node;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&Placement::node)
+        );
+    }
+};
+
+MAKE_PACKET(RoomUpdate) {
+    static constexpr char const* name = "RoomUpdate";
+    server::RoomSummary summary;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field(&RoomUpdate::summary)
+        );
+    }
+};
+
+MAKE_PACKET(OldRoom) {
+    static constexpr char const* name = "OldRoom";
+    unsigned id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&OldRoom::id)
+        );
+    }
+};
+
+using Any = std::variant<
+    Join,
+    Welcome,
+    NodeInfo,
+    OldNode,
+    Load,
+    Placement,
+    RoomUpdate,
+    OldRoom
+>;
+
+/*
+    Decode a whole packet from [data, data + size), without trusting any length read from it
+*/
+DecodeError decode(void const* data, std::size_t size, Any& packet, Encoding encoding = Encoding::Compact);
+
+sf::Packet& operator << (sf::Packet& p, Any const& packet);
+std::size_t serialized_size(Any const& packet);
+std::ostream& operator <<(std::ostream& os, Any const& packet);
+std::string to_string(Any const& packet);
+
+template<typename T>
+constexpr id_t id_of() {
+    return details::index_of_v<Any, T>;
+}
+
+template<typename T>
+constexpr id_t id_of(T const&) {
+    return id_of<T>();
+}
+
+}
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <SFML/Network.hpp>
+
+#include <multipong/Game.hpp>
+#include <pong/packet/Encoding.hpp>
+#include <pong/packet/MakePacket.hpp>
+#include <pong/packet/Utility.hpp>
+#include <pong/packet/Reader.hpp>
+#include <pong/packet/Writer.hpp>
+
+/*
+    Field lists of the packets
+
+    A packet (or any struct embedded in one) describes its fields in a static `fields` function:
+
+        static constexpr auto fields() {
+            return std::make_tuple(
+                field_as<sf::Uint8>(&NewPlayer::side),
+                field(&NewPlayer::user)
+            );
+        }
+
+    `field_as<E>` serializes an arithmetic or enum member as `E`, `field` serializes the member as itself.
+    A `std::string_view` member serialized as `std::string` is decoded in place, it refers to the bytes of the frame.
+    A struct without `fields` has no field.
+
+    Strings and vectors can be given the maximum size accepted when decoding, `field(&UserName::name, max_username_size)`.
+
+    `PACKET_CODEC(P)` then defines `<<`, `==`, `serialized_size` and the `std::ostream` operator of the packet P
+    from its field list, so every packet shares the same (de)serialization code.
+    The same field list writes a packet in place with a `Writer`, see `write_frame`,
+    and reads it from a frame with a bounded `Reader`, see `decode_any`.
+    Both take the `Encoding` of the connection, sf::Packet is always `Encoding::Sfml`.
+*/
+
+namespace pong::packet::details {
+
+static constexpr std::size_t no_size_limit{ std::numeric_limits<std::size_t>::max() };
+
+template<typename E, typename P, typename T>
+struct Field {
+    using encoded_t = E;
+    T P::* member;
+
+    // Maximum number of characters of a string, or of elements of a vector, accepted when decoding
+    std::size_t max_size;
+};
+
+
+template<typename E, typename P, typename T>
+constexpr Field<E, P, T> field_as(T P::* member, std::size_t max_size = no_size_limit) {
+    static_assert(
+        std::is_arithmetic_v<E> || (std::is_same_v<E, std::string> && std::is_same_v<T, std::string_view>), 
+        "A field can only be encoded as an arithmetic type, or a string view as a string"
+    );
+    return { member, max_size };
+}
+
+template<typename P, typename T>
+constexpr Field<T, P, T> field(T P::* member, std::size_t max_size = no_size_limit) {
+    return { member, max_size };
+}
+
+
+
+template<typename T, typename = void>
+struct HasFields : std::false_type {};
+
+template<typename T>
+struct HasFields<T, std::void_t<decltype(T::fields())>> : std::true_type {};
+
+template<typename T>
+constexpr auto fields_of() {
+    if constexpr (HasFields<T>::value) {
+        return T::fields();
+    } else {
+        return std::tuple<>{};
+    }
+}
+
+
+template<typename T>
+struct IsVector : std::false_type {};
+
+template<typename T>
+struct IsVector<std::vector<T>> : std::true_type {};
+
+
+
+
+
+/*
+    Size of an integer once serialized as `E`
+*/
+template<typename E, typename T>
+std::size_t integer_size(T value, Encoding encoding) {
+    if constexpr (std::is_integral_v<E> && !std::is_same_v<E, bool>) {
+        if (encoding == Encoding::Compact) {
+            return varint_size(varint_bits(static_cast<E>(value)));
+        }
+    }
+    return sizeof(E);
+}
+
+
+/*
+    Size of a value once serialized as `E`
+*/
+template<typename E, typename T>
+std::size_t encoded_size(T const& value, Encoding encoding = Encoding::Sfml);
+
+template<typename T>
+std::size_t fields_size(T const& value, Encoding encoding = Encoding::Sfml) {
+    return std::apply([&value, encoding] (auto const&...fields) {
+        return (std::size_t{ 0 } + ... + encoded_size<typename std::decay_t<decltype(fields)>::encoded_t>(value.*fields.member, encoding));
+    }, fields_of<T>());
+}
+
+template<typename E, typename T>
+std::size_t encoded_size(T const& value, Encoding encoding) {
+    if constexpr (std::is_arithmetic_v<E>) {
+        return integer_size<E>(value, encoding);
+    }
+    else if constexpr (std::is_same_v<E, std::string>) {
+        return integer_size<sf::Uint32>(value.size(), encoding) + value.size();
+    }
+    else if constexpr (IsVector<E>::value) {
+        std::size_t size{ integer_size<sf::Uint64>(value.size(), encoding) };
+        for(auto const& element : value) {
+            size += encoded_size<typename E::value_type>(element, encoding);
+        }
+        return size;
+    }
+    else if constexpr (std::is_same_v<E, pong::Ball>) {
+        return 4 * sizeof(float);
+    }
+    else if constexpr (std::is_same_v<E, pong::Pad>) {
+        return 2 * sizeof(float);
+    }
+    else {
+        return fields_size(value, encoding);
+    }
+}
+
+
+
+
+
+/*
+    Write a value as `E` into a sink, a sf::Packet or a Writer
+    Both sinks produce the same bytes, `encoded_size<E>` of them
+*/
+template<typename E, typename S, typename T>
+void encode(S& sink, T const& value);
+
+template<typename S, typename T>
+S& encode_fields(S& sink, T const& value) {
+    std::apply([&sink, &value] (auto const&...fields) {
+        (encode<typename std::decay_t<decltype(fields)>::encoded_t>(sink, value.*fields.member), ...);
+    }, fields_of<T>());
+    return sink;
+}
+
+template<typename E, typename S, typename T>
+void encode(S& sink, T const& value) {
+    if constexpr (std::is_arithmetic_v<E>) {
+        sink << static_cast<E>(value);
+    }
+    else if constexpr (std::is_same_v<E, std::string> && std::is_same_v<T, std::string_view>) {
+        sink << static_cast<sf::Uint32>(value.size());
+        sink.append(value.data(), value.size());
+    }
+    else if constexpr (std::is_same_v<E, std::string> || std::is_same_v<E, pong::Ball> || std::is_same_v<E, pong::Pad>) {
+        sink << value;
+    }
+    else if constexpr (IsVector<E>::value) {
+        sink << static_cast<sf::Uint64>(value.size());
+        for(auto const& element : value) {
+            encode<typename E::value_type>(sink, element);
+        }
+    }
+    else {
+        encode_fields(sink, value);
+    }
+}
+
+/*
+    Smallest size of a value serialized as `E`, a vector can't have more elements than the remaining bytes allow
+*/
+template<typename E>
+constexpr std::size_t min_encoded_size(Encoding encoding);
+
+template<typename Tuple, std::size_t...Is>
+constexpr std::size_t min_fields_size(Encoding encoding, std::index_sequence<Is...>) {
+    return (std::size_t{ 0 } + ... + min_encoded_size<typename std::tuple_element_t<Is, Tuple>::encoded_t>(encoding));
+}
+
+template<typename E>
+constexpr std::size_t min_encoded_size(Encoding encoding) {
+    if constexpr (std::is_integral_v<E> && !std::is_same_v<E, bool>) {
+        return encoding == Encoding::Compact ? 1 : sizeof(E);
+    }
+    else if constexpr (std::is_arithmetic_v<E>) {
+        return sizeof(E);
+    }
+    else if constexpr (std::is_same_v<E, std::string>) {
+        return min_encoded_size<sf::Uint32>(encoding);
+    }
+    else if constexpr (IsVector<E>::value) {
+        return min_encoded_size<sf::Uint64>(encoding);
+    }
+    else if constexpr (std::is_same_v<E, pong::Ball>) {
+        return 4 * sizeof(float);
+    }
+    else if constexpr (std::is_same_v<E, pong::Pad>) {
+        return 2 * sizeof(float);
+    }
+    else {
+        using fields_t = decltype(fields_of<E>());
+        return min_fields_size<fields_t>(encoding, std::make_index_sequence<std::tuple_size_v<fields_t>>{});
+    }
+}
+
+
+
+
+
+/*
+    Read a value serialized as `E`
+    The lengths are validated against `max_size` and the remaining bytes before allocating
+*/
+template<typename E, typename T>
+void decode(Reader& reader, T& value, std::size_t max_size = no_size_limit);
+
+template<typename T>
+Reader& decode_fields(Reader& reader, T& value) {
+    std::apply([&reader, &value] (auto const&...fields) {
+        (decode<typename std::decay_t<decltype(fields)>::encoded_t>(reader, value.*fields.member, fields.max_size), ...);
+    }, fields_of<T>());
+    return reader;
+}
+
+template<typename E, typename T>
+void decode(Reader& reader, T& value, std::size_t max_size) {
+    if constexpr (std::is_arithmetic_v<E>) {
+        E encoded;
+        reader >> encoded;
+        value = static_cast<T>(encoded);
+    }
+    else if constexpr (std::is_same_v<E, std::string>) {
+        reader.read_string(value, max_size);
+    }
+    else if constexpr (std::is_same_v<E, pong::Ball> || std::is_same_v<E, pong::Pad>) {
+        reader >> value;
+    }
+    else if constexpr (IsVector<E>::value) {
+        sf::Uint64 size;
+        reader >> size;
+
+        static constexpr std::array<std::size_t, number_of_encoding> min_element_sizes{
+            std::max<std::size_t>(min_encoded_size<typename E::value_type>(Encoding::Sfml), 1),
+            std::max<std::size_t>(min_encoded_size<typename E::value_type>(Encoding::Compact), 1)
+        };
+        auto min_element_size = min_element_sizes[index_of(reader.encoding)];
+        if (size > max_size) {
+            return reader.fail(DecodeError::TooLong);
+        }
+        if (size > reader.remaining() / min_element_size) {
+            return reader.fail(DecodeError::Truncated);
+        }
+
+
+        value.clear();
+        value.reserve(static_cast<std::size_t>(size));
+        for(; size > 0 && !reader.failed(); --size) {
+            decode<typename E::value_type>(reader, value.emplace_back());
+        }
+    }
+    else {
+        decode_fields(reader, value);
+    }
+}
+
+
+template<typename T>
+bool equal_fields(T const& lhs, T const& rhs) {
+    return std::apply([&lhs, &rhs] (auto const&...fields) {
+        return (true && ... && (lhs.*fields.member == rhs.*fields.member));
+    }, fields_of<T>());
+}
+
+
+
+
+
+/*
+    A frame is a packet as sent by sf::TcpSocket: the size of the packet (sf::Uint32) followed by the packet
+    It can be written directly into the output buffer of a connection, without any sf::Packet
+    The size is fixed whatever the encoding, the packet is written with the encoding of the writer
+*/
+// The ids of client::Any and server::Any are below it, a single byte in `Encoding::Compact`
+static constexpr std::size_t max_number_of_packet{ 0x80 };
+
+constexpr std::size_t id_size(Encoding encoding) {
+    return encoding == Encoding::Compact ? 1 : sizeof(id_t);
+}
+
+
+template<typename P>
+std::size_t frame_size(P const& packet, Encoding encoding = Encoding::Sfml) {
+    return sizeof(sf::Uint32) + id_size(encoding) + fields_size(packet, encoding);
+}
+
+template<typename P>
+void write_frame(Writer& writer, id_t id, P const& packet) {
+    assert(id < max_number_of_packet);
+    writer.write_fixed(static_cast<sf::Uint32>(id_size(writer.encoding) + fields_size(packet, writer.encoding)));
+    writer << id;
+    encode_fields(writer, packet);
+}
+
+
+
+
+
+template<typename Any, std::size_t I>
+void decode_alternative(Reader& reader, Any& any_packet) {
+    auto& packet = any_packet.template emplace<I>();
+    decode_fields(reader, packet);
+}
+
+/*
+    Decoders of the alternatives of a packet variant, indexed by packet id
+*/
+template<typename Any, std::size_t...Is>
+constexpr auto make_decode_table(std::index_sequence<Is...>) {
+    using decoder_t = void (*)(Reader&, Any&);
+    return std::array<decoder_t, sizeof...(Is)>{ &decode_alternative<Any, Is>... };
+}
+
+/*
+    Decode a whole packet, its id followed by its fields
+*/
+template<typename Any>
+DecodeError decode_any(Reader& reader, Any& any_packet) {
+    static_assert(std::variant_size_v<Any> <= max_number_of_packet, "The ids must stay a single byte in Encoding::Compact");
+    static constexpr auto table = make_decode_table<Any>(std::make_index_sequence<std::variant_size_v<Any>>{});
+
+    id_t id;
+    reader >> id;
+    if (reader.failed()) {
+        return reader.error;
+    }
+
+    if (id >= table.size()) {
+        reader.fail(DecodeError::BadId);
+        return reader.error;
+    }
+
+    table[id](reader, any_packet);
+    return reader.finish();
+}
+
+}
+
+
+
+
+
+/*
+    Define the serialization of the packet P_ from its field list
+    The packet id is written first
+*/
+#define PACKET_CODEC(P_)                                                        \
+sf::Packet& operator << (sf::Packet& p, P_ const& packet) {                     \
+    return ::pong::packet::details::encode_fields(p << id_of(packet), packet);  \
+}                                                                               \
+                                                                                \
+bool operator == (P_ const& lhs, P_ const& rhs) {                               \
+    return ::pong::packet::details::equal_fields(lhs, rhs);                     \
+}                                                                               \
+                                                                                \
+std::size_t serialized_size(P_ const& packet) {                                 \
+    return sizeof(::pong::packet::id_t)                                         \
+        +  ::pong::packet::details::fields_size(packet);                        \
+}                                                                               \
+                                                                                \
+std::ostream& operator <<(std::ostream& os, P_ const& packet) {                 \
+    return os << to_string(packet);                                             \
+}
@@ -2,21 +2,30 @@
 
 #include <SFML/Network.hpp>
 
+#include <cstddef>
+#include <ostream>
+#include <string>
+
 namespace pong::packet {
     using id_t = sf::Uint32;
+
+    // Longest username accepted on the wire, the server may be stricter
+    constexpr std::size_t max_username_size{ 32 };
 }
 /*
     Create a packet with the name P_ and the id N
     It supports `==`, `to_string` and `<<` with std::ostream
-    And obviously can be (de)serialized into sf::Packet
+    And obviously can be serialized into sf::Packet, `serialized_size` being its exact size once serialized
+    Packets are decoded as a whole with a bounded Reader, see `decode` of client::Any and server::Any
+    The serialization is generated from the field list of the packet, see Fields.hpp
 */
 
 #define MAKE_PACKET(P_)                                             \
 struct P_;                                                          \
                                                                     \
-sf::Packet& operator >> (sf::Packet& p, P_& packet);                \
 sf::Packet& operator << (sf::Packet& p, P_ const& packet);          \
 bool operator == (P_ const& lhs, P_ const& rhs);                    \
+std::size_t serialized_size(P_ const& packet);                      \
 std::ostream& operator <<(std::ostream& os, P_ const& packet);      \
 std::string to_string(P_ const& packet);                            \
                                                                     \
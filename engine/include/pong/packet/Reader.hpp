@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <SFML/Network.hpp>
+
+#include <multipong/Game.hpp>
+#include <pong/packet/Encoding.hpp>
+
+namespace pong::packet {
+
+/*
+    Why a frame couldn't be decoded
+*/
+enum class DecodeError : std::uint8_t {
+    None,
+    // A value goes past the end of the frame
+    Truncated,
+    // A string or a vector is longer than the maximum of its field
+    TooLong,
+    BadId,
+    // The packet doesn't use the whole frame
+    TrailingBytes,
+    // A compressed frame doesn't decompress to the size it announces, see Compression.hpp
+    BadCompression,
+    // A varint doesn't fit in its integer, see Encoding.hpp
+    BadVarint
+};
+
+inline char const* to_string(DecodeError error) {
+    switch(error) {
+        case DecodeError::None:             return "None";
+        case DecodeError::Truncated:        return "Truncated";
+        case DecodeError::TooLong:          return "TooLong";
+        case DecodeError::BadId:            return "BadId";
+        case DecodeError::TrailingBytes:    return "TrailingBytes";
+        case DecodeError::BadCompression:   return "BadCompression";
+        case DecodeError::BadVarint:        return "BadVarint";
+    }
+
+    return "Unknown";
+}
+
+}
+
+namespace pong::packet::details {
+
+/*
+    Deserialize values from a frame [position, end), with the encoding of sf::Packet or `Encoding::Compact` (see Writer)
+
+    Every read is checked against the remaining bytes, and the size of a string is checked before any allocation.
+    The first error is kept in `error` and the reader jumps to the end of the frame,
+    so the following reads fail without touching memory and the caller only checks `error` once, at the end.
+*/
+struct Reader {
+    std::byte const* position;
+    std::byte const* end;
+    Encoding encoding;
+    DecodeError error{ DecodeError::None };
+
+
+    Reader(void const* data, std::size_t size, Encoding _encoding = Encoding::Sfml)
+    :   position{ static_cast<std::byte const*>(data) }
+    ,   end{ static_cast<std::byte const*>(data) + size }
+    ,   encoding{ _encoding } {}
+
+
+    std::size_t remaining() const {
+        return static_cast<std::size_t>(end - position);
+    }
+
+
+    bool failed() const {
+        return error != DecodeError::None;
+    }
+
+
+    void fail(DecodeError reason) {
+        if (!failed()) {
+            error = reason;
+        }
+        position = end;
+    }
+
+
+    /*
+        The frame was decoded without error and entirely
+    */
+    DecodeError finish() {
+        if (!failed() && position != end) {
+            fail(DecodeError::TrailingBytes);
+        }
+        return error;
+    }
+
+
+    template<typename T>
+    Reader& operator >> (T& value) {
+        static_assert(std::is_arithmetic_v<T>, "Only arithmetic values can be read as they are");
+
+        if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+            if (encoding == Encoding::Compact) {
+                read_varint(value);
+                return *this;
+            }
+        }
+
+        if (remaining() < sizeof(T)) {
+            fail(DecodeError::Truncated);
+            value = T{};
+            return *this;
+        }
+
+
+        if constexpr (std::is_same_v<T, bool>) {
+            value = *position++ != std::byte{ 0 };
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            std::memcpy(&value, position, sizeof(value));
+            position += sizeof(value);
+        }
+        else {
+            using unsigned_t = std::make_unsigned_t<T>;
+            unsigned_t bits{ 0 };
+
+            for(std::size_t i{ 0 }; i < sizeof(T); ++i) {
+                bits = static_cast<unsigned_t>((bits << 8) | std::to_integer<unsigned_t>(*position++));
+            }
+            value = static_cast<T>(bits);
+        }
+
+        return *this;
+    }
+
+
+    /*
+        The varint of an integer, at most `max_varint_size` bytes and no bit beyond the ones of T
+        A value has a single encoding, a varint ending with a zero byte is refused
+    */
+    template<typename T>
+    void read_varint(T& value) {
+        std::uint64_t bits{ 0 };
+        value = T{};
+
+        for(unsigned shift{ 0 }; shift < 7 * max_varint_size(sizeof(T)); shift += 7) {
+            if (position == end) {
+                return fail(DecodeError::Truncated);
+            }
+
+            auto byte = std::to_integer<std::uint64_t>(*position++);
+            auto payload = byte & 0x7F;
+
+            // Bits past the 64th of the last byte of a sf::Uint64
+            if (shift > 57 && (payload >> (64 - shift)) != 0) {
+                return fail(DecodeError::BadVarint);
+            }
+            bits |= payload << shift;
+
+            if ((byte & 0x80) == 0) {
+                if (bits > max_varint_bits<T>() || (shift > 0 && byte == 0)) {
+                    return fail(DecodeError::BadVarint);
+                }
+
+                value = from_varint_bits<T>(bits);
+                return;
+            }
+        }
+
+        fail(DecodeError::BadVarint);
+    }
+
+
+    void read_string(std::string& value, std::size_t max_size) {
+        std::string_view view;
+        read_string(view, max_size);
+        value.assign(view);
+    }
+
+
+    /*
+        The view refers to the bytes of the frame, no copy is made
+    */
+    void read_string(std::string_view& value, std::size_t max_size) {
+        sf::Uint32 size;
+        *this >> size;
+
+        if (size > max_size) {
+            value = {};
+            return fail(DecodeError::TooLong);
+        }
+
+        if (size > remaining()) {
+            value = {};
+            return fail(DecodeError::Truncated);
+        }
+
+
+        value = std::string_view{ reinterpret_cast<char const*>(position), size };
+        position += size;
+    }
+
+
+    Reader& operator >> (pong::Ball& ball) {
+        return *this >> ball.position.x >> ball.position.y >> ball.speed.x >> ball.speed.y;
+    }
+
+
+    Reader& operator >> (pong::Pad& pad) {
+        return *this >> pad.y >> pad.speed;
+    }
+};
+
+}
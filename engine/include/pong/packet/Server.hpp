@@ -6,38 +6,114 @@
 #include <multipong/Game.hpp>
 #include <pong/packet/MakePacket.hpp>
 #include <pong/packet/Utility.hpp>
+#include <pong/packet/Fields.hpp>
+#include <tuple>
 
 namespace pong::packet::server {
 
+/*
+    Summary of a room as seen from the lobby
+    Not a packet by itself, it's embedded in `LobbyInfo` and `RoomUpdate`
+*/
+struct RoomSummary {
+    unsigned id;
+    unsigned user_count;
+    bool left_player;
+    bool right_player;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&RoomSummary::id),
+            details::field_as<sf::Uint32>(&RoomSummary::user_count),
+            details::field_as<sf::Uint8>(&RoomSummary::left_player),
+            details::field_as<sf::Uint8>(&RoomSummary::right_player)
+        );
+    }
+};
+
+sf::Packet& operator << (sf::Packet& p, RoomSummary const& summary);
+bool operator == (RoomSummary const& lhs, RoomSummary const& rhs);
+std::size_t serialized_size(RoomSummary const& summary);
+std::string to_string(RoomSummary const& summary);
+
+/*
+    Compact id of a username
+    A name id is declared to a client with `UserName` before any packet references it
+    The id `no_name` never refers to a user (e.g. no player on a side in `RoomInfo`)
+*/
+using name_id_t = unsigned;
+constexpr name_id_t no_name = 0;
+
+// Longest lists accepted when decoding `LobbyInfo` and `RoomInfo`
+constexpr std::size_t max_room_summaries{ 1 << 16 };
+constexpr std::size_t max_spectators{ 1 << 16 };
+
 MAKE_PACKET(ChangeUsernameResponse) {
     static constexpr char const* name = "ChangeUsernameResponse";
     bool valid;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&ChangeUsernameResponse::valid)
+        );
+    }
 };
 
 MAKE_PACKET(LobbyInfo) {
     static constexpr char const* name = "LobbyInfo";
-    std::vector<std::string> users;
-    std::vector<int> rooms;
+    unsigned user_count;
+    std::vector<RoomSummary> rooms;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&LobbyInfo::user_count),
+            details::field(&LobbyInfo::rooms, max_room_summaries)
+        );
+    }
 };
 
 MAKE_PACKET(NewUser) {
     static constexpr char const* name = "NewUser";
-    std::string username;
+    name_id_t user;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&NewUser::user)
+        );
+    }
 };
 
 MAKE_PACKET(OldUser) {
     static constexpr char const* name = "OldUser";
-    std::string username;
+    name_id_t user;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&OldUser::user)
+        );
+    }
 };
 
 MAKE_PACKET(NewRoom) {
     static constexpr char const* name = "NewRoom";
     unsigned id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&NewRoom::id)
+        );
+    }
 };
 
 MAKE_PACKET(OldRoom) {
     static constexpr char const* name = "OldRoom";
     unsigned id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&OldRoom::id)
+        );
+    }
 };
 
 MAKE_PACKET(EnterRoomResponse) {
@@ -49,17 +125,37 @@ MAKE_PACKET(EnterRoomResponse) {
     };
 
     Result result;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&EnterRoomResponse::result)
+        );
+    }
 };
 
 MAKE_PACKET(RoomInfo) {
     static constexpr char const* name = "RoomInfo";
-    std::string left_player, right_player;
-    std::vector<std::string> spectators;
+    name_id_t left_player, right_player;
+    std::vector<name_id_t> spectators;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&RoomInfo::left_player),
+            details::field_as<sf::Uint32>(&RoomInfo::right_player),
+            details::field(&RoomInfo::spectators, max_spectators)
+        );
+    }
 };
 
 MAKE_PACKET(FetchRoomError) {
     static constexpr char const* name = "FetchRoomError";
     unsigned id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&FetchRoomError::id)
+        );
+    }
 };
 
 MAKE_PACKET(GameState) {
@@ -67,29 +163,64 @@ MAKE_PACKET(GameState) {
     pong::Ball ball;
     pong::Pad left;
     pong::Pad right;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field(&GameState::ball),
+            details::field(&GameState::left),
+            details::field(&GameState::right)
+        );
+    }
 };
 
 MAKE_PACKET(Score) {
     static constexpr char const* name = "Score";
     unsigned left;
     unsigned right;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&Score::left),
+            details::field_as<sf::Uint32>(&Score::right)
+        );
+    }
 };
 
 MAKE_PACKET(BePlayer) {
     static constexpr char const* name = "BePlayer";
     pong::Side side;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&BePlayer::side)
+        );
+    }
 };
 
 MAKE_PACKET(NewPlayer) {
     static constexpr char const* name = "NewPlayer";
     pong::Side side;
-    std::string username;
+    name_id_t user;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&NewPlayer::side),
+            details::field_as<sf::Uint32>(&NewPlayer::user)
+        );
+    }
 };
 
 MAKE_PACKET(OldPlayer) {
     static constexpr char const* name = "OldPlayer";
     pong::Side side;
-    std::string username;
+    name_id_t user;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&OldPlayer::side),
+            details::field_as<sf::Uint32>(&OldPlayer::user)
+        );
+    }
 };
 
 MAKE_PACKET(CreateRoomResponse) {
@@ -100,6 +231,12 @@ MAKE_PACKET(CreateRoomResponse) {
     };
 
     Reason reason;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&CreateRoomResponse::reason)
+        );
+    }
 };
 
 MAKE_PACKET(LeaveRoomResponse) {
@@ -110,6 +247,12 @@ MAKE_PACKET(LeaveRoomResponse) {
     };
 
     Reason reason;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&LeaveRoomResponse::reason)
+        );
+    }
 };
 
 MAKE_PACKET(GameOver) {
@@ -122,6 +265,12 @@ MAKE_PACKET(GameOver) {
     };
 
     Result result;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&GameOver::result)
+        );
+    }
 };
 
 MAKE_PACKET(BeNextPlayer) {
@@ -132,6 +281,93 @@ MAKE_PACKET(DeniedBePlayer) {
     static constexpr char const* name = "DeniedBePlayer";
 };
 
+MAKE_PACKET(UserCount) {
+    static constexpr char const* name = "UserCount";
+    unsigned count;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&UserCount::count)
+        );
+    }
+};
+
+MAKE_PACKET(RoomUpdate) {
+    static constexpr char const* name = "RoomUpdate";
+    RoomSummary summary;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field(&RoomUpdate::summary)
+        );
+    }
+};
+
+MAKE_PACKET(UserName) {
+    static constexpr char const* name = "UserName";
+    name_id_t id;
+    std::string username;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&UserName::id),
+            details::field(&UserName::username, max_username_size)
+        );
+    }
+};
+
+// Longest host name accepted in `Redirect`
+constexpr std::size_t max_address_size{ 255 };
+
+/*
+    Answer to `EnterRoom` or `CreateRoom` when the room is on (or should be created by) another server of the federation
+    The client connects to `address`:`port`, logs in again with the same username and repeats its request there
+*/
+MAKE_PACKET(Redirect) {
+    static constexpr char const* name = "Redirect";
+    enum class Request : char {
+        EnterRoom,
+        CreateRoom
+    };
+
+    Request request;
+    std::string address;
+    sf::Uint16 port;
+    // The room to enter for `Request::EnterRoom`
+    unsigned room_id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint8>(&Redirect::request),
+            details::field(&Redirect::address, max_address_size),
+            details::field(&Redirect::port),
+            details::field_as<sf::Uint32>(&Redirect::room_id)
+        );
+    }
+};
+
+/*
+    The user waiting in the matchmaking is paired: it's moved into the new room `room_id`, as if it entered it, and queued there
+    `RoomInfo` follows, then `BeNextPlayer`
+*/
+MAKE_PACKET(MatchFound) {
+    static constexpr char const* name = "MatchFound";
+    unsigned room_id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(
+            details::field_as<sf::Uint32>(&MatchFound::room_id)
+        );
+    }
+};
+
+/*
+    Answer to `LeaveMatchmaking` when the user was still waiting, it got `MatchFound` otherwise
+*/
+MAKE_PACKET(LeftMatchmaking) {
+    static constexpr char const* name = "LeftMatchmaking";
+};
+
 using Any = std::variant<
     ChangeUsernameResponse,
     LobbyInfo,
@@ -150,11 +386,26 @@ using Any = std::variant<
     GameOver,
     BeNextPlayer,
     DeniedBePlayer,
-    LeaveRoomResponse
+    LeaveRoomResponse,
+    UserCount,
+    RoomUpdate,
+    UserName,
+    Redirect,
+    MatchFound,
+    LeftMatchmaking
 >;
 
+/*
+    Decode a whole packet from [data, data + size), without trusting any length read from it
+    The packet of a compressed frame is decompressed first, see Compression.hpp
+    `encoding` is the one of the connection, see Encoding.hpp
+*/
+DecodeError decode(void const* data, std::size_t size, Any& packet, Encoding encoding = Encoding::Sfml);
+
+// Throws std::runtime_error if the packet is malformed
 sf::Packet& operator >> (sf::Packet& p, Any& packet);
 sf::Packet& operator << (sf::Packet& p, Any const& packet);
+std::size_t serialized_size(Any const& packet);
 std::ostream& operator <<(std::ostream& os, Any const& packet);
 std::string to_string(Any const& packet);
 
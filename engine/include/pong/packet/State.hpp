@@ -14,6 +14,8 @@ enum class SubState {
     Lobby_RegularUser,
     Lobby_EnteringRoom,
     Lobby_CreatingRoom,
+    Lobby_FindingMatch,
+    Lobby_LeavingMatchmaking,
     Room_New,
     Room_Leaving,
     Room_Spectator,
@@ -35,6 +37,8 @@ constexpr std::string_view to_string_view(SubState state) {
         case SubState::Lobby_RegularUser: return "Lobby::RegularUser";
         case SubState::Lobby_EnteringRoom: return "Lobby::EnteringRoom";
         case SubState::Lobby_CreatingRoom: return "Lobby::CreatingRoom";
+        case SubState::Lobby_FindingMatch: return "Lobby::FindingMatch";
+        case SubState::Lobby_LeavingMatchmaking: return "Lobby::LeavingMatchmaking";
         case SubState::Room_New: return "Room::New";
         case SubState::Room_Leaving: return "Room::Leaving";
         case SubState::Room_Spectator: return "Room::Spectator";
@@ -55,6 +59,8 @@ constexpr State get_master_state(SubState state) {
         case SubState::Lobby_RegularUser: return State::Lobby;
         case SubState::Lobby_EnteringRoom: return State::Lobby;
         case SubState::Lobby_CreatingRoom: return State::Lobby;
+        case SubState::Lobby_FindingMatch: return State::Lobby;
+        case SubState::Lobby_LeavingMatchmaking: return State::Lobby;
         case SubState::Room_New: return State::Room;
         case SubState::Room_Leaving: return State::Room;
         case SubState::Room_Spectator: return State::Room;
@@ -116,6 +122,7 @@ constexpr bool is_packet_expected_in(SubState state, T const& = T{}) {
         case SubState::NewUser_Invalid:
             return
                 is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, client::Capabilities>
             ||  std::is_same_v<T, client::ChangeUsername>;
 
         case SubState::NewUser_Connecting:
@@ -131,43 +138,66 @@ constexpr bool is_packet_expected_in(SubState state, T const& = T{}) {
         case SubState::Lobby_RegularUser:
             return
                 is_packet_ignored_in<T>(state)
-            ||  std::is_same_v<T, server::NewUser>
-            ||  std::is_same_v<T, server::OldUser>
+            ||  std::is_same_v<T, server::UserCount>
             ||  std::is_same_v<T, server::NewRoom>
             ||  std::is_same_v<T, server::OldRoom>
-            ||  std::is_same_v<T, server::RoomInfo>
+            ||  std::is_same_v<T, server::RoomUpdate>
             ||  std::is_same_v<T, client::SubscribeRoomInfo>
             ||  std::is_same_v<T, client::EnterRoom>
-            ||  std::is_same_v<T, client::CreateRoom>;
+            ||  std::is_same_v<T, client::CreateRoom>
+            ||  std::is_same_v<T, client::FindMatch>;
 
         case SubState::Lobby_EnteringRoom:
             return
                 is_packet_ignored_in<T>(state)
-            ||  std::is_same_v<T, server::NewUser>
-            ||  std::is_same_v<T, server::OldUser>
+            ||  std::is_same_v<T, server::UserCount>
             ||  std::is_same_v<T, server::NewRoom>
             ||  std::is_same_v<T, server::OldRoom>
-            ||  std::is_same_v<T, server::RoomInfo>
-            ||  std::is_same_v<T, server::EnterRoomResponse>;
+            ||  std::is_same_v<T, server::RoomUpdate>
+            ||  std::is_same_v<T, server::EnterRoomResponse>
+            ||  std::is_same_v<T, server::Redirect>;
 
         case SubState::Lobby_CreatingRoom:
             return
                 is_packet_ignored_in<T>(state)
-            ||  std::is_same_v<T, server::NewUser>
-            ||  std::is_same_v<T, server::OldUser>
+            ||  std::is_same_v<T, server::UserCount>
+            ||  std::is_same_v<T, server::NewRoom>
+            ||  std::is_same_v<T, server::OldRoom>
+            ||  std::is_same_v<T, server::RoomUpdate>
+            ||  std::is_same_v<T, server::CreateRoomResponse>
+            ||  std::is_same_v<T, server::Redirect>;
+
+        case SubState::Lobby_FindingMatch:
+            return
+                is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserCount>
+            ||  std::is_same_v<T, server::NewRoom>
+            ||  std::is_same_v<T, server::OldRoom>
+            ||  std::is_same_v<T, server::RoomUpdate>
+            ||  std::is_same_v<T, server::MatchFound>
+            ||  std::is_same_v<T, client::SubscribeRoomInfo>
+            ||  std::is_same_v<T, client::LeaveMatchmaking>;
+
+        case SubState::Lobby_LeavingMatchmaking:
+            return
+                is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserCount>
             ||  std::is_same_v<T, server::NewRoom>
             ||  std::is_same_v<T, server::OldRoom>
-            ||  std::is_same_v<T, server::RoomInfo>
-            ||  std::is_same_v<T, server::CreateRoomResponse>;
+            ||  std::is_same_v<T, server::RoomUpdate>
+            ||  std::is_same_v<T, server::MatchFound>
+            ||  std::is_same_v<T, server::LeftMatchmaking>;
 
         case SubState::Room_New:
             return
                 is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserName>
             ||  std::is_same_v<T, server::RoomInfo>;
 
         case SubState::Room_Leaving:
             return
                 is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserName>
             ||  std::is_same_v<T, server::NewUser>
             ||  std::is_same_v<T, server::OldUser>
             ||  std::is_same_v<T, server::NewPlayer>
@@ -180,6 +210,7 @@ constexpr bool is_packet_expected_in(SubState state, T const& = T{}) {
         case SubState::Room_Spectator:
             return
                 is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserName>
             ||  std::is_same_v<T, server::NewUser>
             ||  std::is_same_v<T, server::OldUser>
             ||  std::is_same_v<T, server::NewPlayer>
@@ -193,6 +224,7 @@ constexpr bool is_packet_expected_in(SubState state, T const& = T{}) {
         case SubState::Room_Queued:
             return
                 is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserName>
             ||  std::is_same_v<T, server::NewUser>
             ||  std::is_same_v<T, server::OldUser>
             ||  std::is_same_v<T, server::NewPlayer>
@@ -207,6 +239,7 @@ constexpr bool is_packet_expected_in(SubState state, T const& = T{}) {
         case SubState::Room_AcceptingBePlayer:
             return
                 is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserName>
             ||  std::is_same_v<T, server::NewUser>
             ||  std::is_same_v<T, server::OldUser>
             ||  std::is_same_v<T, server::NewPlayer>
@@ -222,6 +255,7 @@ constexpr bool is_packet_expected_in(SubState state, T const& = T{}) {
         case SubState::Room_NextPlayer:
             return
                 is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserName>
             ||  std::is_same_v<T, server::NewUser>
             ||  std::is_same_v<T, server::OldUser>
             ||  std::is_same_v<T, server::NewPlayer>
@@ -235,6 +269,7 @@ constexpr bool is_packet_expected_in(SubState state, T const& = T{}) {
         case SubState::Room_Player:
             return
                 is_packet_ignored_in<T>(state)
+            ||  std::is_same_v<T, server::UserName>
             ||  std::is_same_v<T, server::NewUser>
             ||  std::is_same_v<T, server::OldUser>
             ||  std::is_same_v<T, server::NewPlayer>
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <vector>
 #include <variant>
 #include <type_traits>
 
@@ -48,33 +47,4 @@ sf::Packet& operator << (sf::Packet& p, By<E, T> const& by) {
     return p << static_cast<E>(by.t);
 }
 
-
-
-
-template<typename T>
-sf::Packet& operator << (sf::Packet& p, std::vector<T> const& v) {
-    p << by<sf::Uint64, std::size_t const>(v.size());
-    for(auto const& s : v) {
-        p << s;
-    }
-
-    return p;
-}
-
-template<typename T>
-sf::Packet& operator >> (sf::Packet& p, std::vector<T>& v) {
-    sf::Uint64 size;
-    p >> size;
-
-    v.clear();
-    v.reserve(size);
-    for(; size > 0; --size) {
-        p >> v.emplace_back();
-    }
-
-    return p;
-}
-
-
-
 }
\ No newline at end of file
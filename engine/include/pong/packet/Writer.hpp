@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include <SFML/Network.hpp>
+
+#include <multipong/Game.hpp>
+#include <pong/packet/Encoding.hpp>
+
+namespace pong::packet::details {
+
+/*
+    Serialize values in place into a memory region, with the encoding of sf::Packet:
+    integers in network byte order, floats as they are, bools as sf::Uint8 and strings prefixed by their size (sf::Uint32)
+    With `Encoding::Compact` the integers are varints instead, see Encoding.hpp
+
+    The writer doesn't check any bound, the region must be sized beforehand (see `encoded_size` in Fields.hpp)
+*/
+struct Writer {
+    std::byte* position;
+    Encoding encoding{ Encoding::Sfml };
+
+
+    void append(void const* data, std::size_t size) {
+        if (size > 0) {
+            std::memcpy(position, data, size);
+            position += size;
+        }
+    }
+
+
+    template<typename T>
+    Writer& operator << (T value) {
+        static_assert(std::is_arithmetic_v<T>, "Only arithmetic values can be written as they are");
+
+        if constexpr (std::is_same_v<T, bool>) {
+            return *this << static_cast<sf::Uint8>(value);
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            append(&value, sizeof(value));
+        }
+        else if (encoding == Encoding::Compact) {
+            auto bits = varint_bits(value);
+            for(; bits >= 0x80; bits >>= 7) {
+                *position++ = static_cast<std::byte>(bits | 0x80);
+            }
+            *position++ = static_cast<std::byte>(bits);
+        }
+        else {
+            write_fixed(value);
+        }
+
+        return *this;
+    }
+
+
+    /*
+        Integer in network byte order whatever the encoding, for the sizes of the frames
+    */
+    template<typename T>
+    void write_fixed(T value) {
+        static_assert(std::is_integral_v<T>);
+
+        using unsigned_t = std::make_unsigned_t<T>;
+        auto bits = static_cast<unsigned_t>(value);
+
+        for(std::size_t shift{ 8 * sizeof(T) }; shift > 0; shift -= 8) {
+            *position++ = static_cast<std::byte>(bits >> (shift - 8));
+        }
+    }
+
+
+    Writer& operator << (std::string const& value) {
+        *this << static_cast<sf::Uint32>(value.size());
+        append(value.data(), value.size());
+        return *this;
+    }
+
+
+    Writer& operator << (pong::Ball const& ball) {
+        return *this << ball.position.x << ball.position.y << ball.speed.x << ball.speed.y;
+    }
+
+
+    Writer& operator << (pong::Pad const& pad) {
+        return *this << pad.y << pad.speed;
+    }
+};
+
+}
@@ -1,5 +1,8 @@
 #include <pong/packet/Client.hpp>
 #include <pong/packet/Utility.hpp>
+#include <pong/packet/Fields.hpp>
+
+#include <stdexcept>
 
 namespace pong::packet::client {
 
@@ -9,21 +12,7 @@ namespace pong::packet::client {
     std::string username
 */
 
-sf::Packet& operator >> (sf::Packet& p, ChangeUsername& packet) {
-    return p >> packet.username;
-}
-
-sf::Packet& operator << (sf::Packet& p, ChangeUsername const& packet) {
-    return p << id_of(packet) << packet.username;
-}
-
-bool operator == (ChangeUsername const& lhs, ChangeUsername const& rhs) {
-    return lhs.username == rhs.username;
-}
-
-std::ostream& operator <<(std::ostream& os, ChangeUsername const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(ChangeUsername)
 
 std::string to_string(ChangeUsername const& packet) {
     return std::string{ packet.name };
@@ -37,21 +26,7 @@ std::string to_string(ChangeUsername const& packet) {
     CreateRoom
 */
 
-sf::Packet& operator >> (sf::Packet& p, CreateRoom&) {
-    return p;
-}
-
-sf::Packet& operator << (sf::Packet& p, CreateRoom const& packet) {
-    return p << id_of(packet);
-}
-
-bool operator == (CreateRoom const&, CreateRoom const&) {
-    return true;
-}
-
-std::ostream& operator <<(std::ostream& os, CreateRoom const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(CreateRoom)
 
 std::string to_string(CreateRoom const& packet) {
     return std::string{ packet.name };
@@ -65,21 +40,7 @@ std::string to_string(CreateRoom const& packet) {
     LeaveRoom
 */
 
-sf::Packet& operator >> (sf::Packet& p, LeaveRoom&) {
-    return p;
-}
-
-sf::Packet& operator << (sf::Packet& p, LeaveRoom const& packet) {
-    return p << id_of(packet);
-}
-
-bool operator == (LeaveRoom const&, LeaveRoom const&) {
-    return true;
-}
-
-std::ostream& operator <<(std::ostream& os, LeaveRoom const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(LeaveRoom)
 
 std::string to_string(LeaveRoom const& packet) {
     return std::string{ packet.name };
@@ -93,21 +54,7 @@ std::string to_string(LeaveRoom const& packet) {
     EnterQueue
 */
 
-sf::Packet& operator >> (sf::Packet& p, EnterQueue&) {
-    return p;
-}
-
-sf::Packet& operator << (sf::Packet& p, EnterQueue const& packet) {
-    return p << id_of(packet);
-}
-
-bool operator == (EnterQueue const&, EnterQueue const&) {
-    return true;
-}
-
-std::ostream& operator <<(std::ostream& os, EnterQueue const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(EnterQueue)
 
 std::string to_string(EnterQueue const& packet) {
     return std::string{ packet.name };
@@ -121,21 +68,7 @@ std::string to_string(EnterQueue const& packet) {
     LeaveQueue
 */
 
-sf::Packet& operator >> (sf::Packet& p, LeaveQueue&) {
-    return p;
-}
-
-sf::Packet& operator << (sf::Packet& p, LeaveQueue const& packet) {
-    return p << id_of(packet);
-}
-
-bool operator == (LeaveQueue const&, LeaveQueue const&) {
-    return true;
-}
-
-std::ostream& operator <<(std::ostream& os, LeaveQueue const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(LeaveQueue)
 
 std::string to_string(LeaveQueue const& packet) {
     return std::string{ packet.name };
@@ -149,21 +82,7 @@ std::string to_string(LeaveQueue const& packet) {
     Abandon
 */
 
-sf::Packet& operator >> (sf::Packet& p, Abandon&) {
-    return p;
-}
-
-sf::Packet& operator << (sf::Packet& p, Abandon const& packet) {
-    return p << id_of(packet);
-}
-
-bool operator == (Abandon const&, Abandon const&) {
-    return true;
-}
-
-std::ostream& operator <<(std::ostream& os, Abandon const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(Abandon)
 
 std::string to_string(Abandon const& packet) {
     return std::string{ packet.name };
@@ -179,21 +98,7 @@ std::string to_string(Abandon const& packet) {
     unsigned id
 */
 
-sf::Packet& operator >> (sf::Packet& p, EnterRoom& packet) {
-    return p >> details::by<sf::Uint32>(packet.id);
-}
-
-sf::Packet& operator << (sf::Packet& p, EnterRoom const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint32>(packet.id);
-}
-
-bool operator == (EnterRoom const& lhs, EnterRoom const& rhs) {
-    return lhs.id == rhs.id;
-}
-
-std::ostream& operator <<(std::ostream& os, EnterRoom const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(EnterRoom)
 
 std::string to_string(EnterRoom const& packet) {
     return std::string{ packet.name };
@@ -209,21 +114,7 @@ std::string to_string(EnterRoom const& packet) {
     pong::Input input
 */
 
-sf::Packet& operator >> (sf::Packet& p, Input& packet) {
-    return p >> details::by<sf::Uint8>(packet.input);
-}
-
-sf::Packet& operator << (sf::Packet& p, Input const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.input);
-}
-
-bool operator == (Input const& lhs, Input const& rhs) {
-    return lhs.input == rhs.input;
-}
-
-std::ostream& operator <<(std::ostream& os, Input const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(Input)
 
 std::string to_string(Input const& packet) {
     char const* input_str = 
@@ -247,21 +138,7 @@ std::string to_string(Input const& packet) {
     unsigned range_max_excluded
 */
 
-sf::Packet& operator >> (sf::Packet& p, SubscribeRoomInfo& packet) {
-    return p >> details::by<sf::Uint32>(packet.range_min) >> details::by<sf::Uint32>(packet.range_max_excluded);
-}
-
-sf::Packet& operator << (sf::Packet& p, SubscribeRoomInfo const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint32>(packet.range_min) << details::by<sf::Uint32>(packet.range_max_excluded);
-}
-
-bool operator == (SubscribeRoomInfo const& lhs, SubscribeRoomInfo const& rhs) {
-    return lhs.range_min == rhs.range_min && lhs.range_max_excluded == rhs.range_max_excluded;
-}
-
-std::ostream& operator <<(std::ostream& os, SubscribeRoomInfo const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(SubscribeRoomInfo)
 
 std::string to_string(SubscribeRoomInfo const& packet) {
     return std::string{ packet.name } + "{" + std::to_string(packet.range_min) + ".." + std::to_string(packet.range_max_excluded) + "}";
@@ -275,23 +152,55 @@ std::string to_string(SubscribeRoomInfo const& packet) {
     AcceptBePlayer
 */
 
-sf::Packet& operator >> (sf::Packet& p, AcceptBePlayer&) {
-    return p;
-}
+PACKET_CODEC(AcceptBePlayer)
 
-sf::Packet& operator << (sf::Packet& p, AcceptBePlayer const& packet) {
-    return p << id_of(packet);
+std::string to_string(AcceptBePlayer const& packet) {
+    return std::string{ packet.name };
 }
 
-bool operator == (AcceptBePlayer const&, AcceptBePlayer const&) {
-    return true;
+
+
+
+
+/*
+    Capabilities
+
+    sf::Uint32 flags
+*/
+
+PACKET_CODEC(Capabilities)
+
+std::string to_string(Capabilities const& packet) {
+    return std::string{ packet.name } + "{" + std::to_string(packet.flags) + "}";
 }
 
-std::ostream& operator <<(std::ostream& os, AcceptBePlayer const& packet) {
-    return os << to_string(packet);
+
+
+
+
+/*
+    FindMatch
+
+    unsigned rating
+*/
+
+PACKET_CODEC(FindMatch)
+
+std::string to_string(FindMatch const& packet) {
+    return std::string{ packet.name } + "{" + std::to_string(packet.rating) + "}";
 }
 
-std::string to_string(AcceptBePlayer const& packet) {
+
+
+
+
+/*
+    LeaveMatchmaking
+*/
+
+PACKET_CODEC(LeaveMatchmaking)
+
+std::string to_string(LeaveMatchmaking const& packet) {
     return std::string{ packet.name };
 }
 
@@ -312,94 +221,35 @@ std::string to_string(AcceptBePlayer const& packet) {
         EnterQueue, 
         LeaveQueue,
         SubscribeRoomInfo,
-        AcceptBePlayer
+        AcceptBePlayer,
+        Capabilities,
+        FindMatch,
+        LeaveMatchmaking
     >;
 */
 
-sf::Packet& operator >> (sf::Packet& p, Any& any_packet) {
-    unsigned id;
-    p >> id;
-    switch(id) {
-        case id_of<ChangeUsername>(): {
-            ChangeUsername packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<CreateRoom>(): {
-            CreateRoom packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<EnterRoom>(): {
-            EnterRoom packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<Input>(): {
-            Input packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<LeaveRoom>(): {
-            LeaveRoom packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<Abandon>(): {
-            Abandon packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<EnterQueue>(): {
-            EnterQueue packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<LeaveQueue>(): {
-            LeaveQueue packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<SubscribeRoomInfo>(): {
-            SubscribeRoomInfo packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        case id_of<AcceptBePlayer>(): {
-            AcceptBePlayer packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        } 
-
-        default:
-            throw std::runtime_error("Bad packet id\n");
+DecodeError decode(void const* data, std::size_t size, Any& any_packet, Encoding encoding) {
+    details::Reader reader{ data, size, encoding };
+    return details::decode_any(reader, any_packet);
+}
 
+sf::Packet& operator >> (sf::Packet& p, Any& any_packet) {
+    auto const* unread = static_cast<char const*>(p.getData()) + p.getReadPosition();
+    if (auto error = decode(unread, p.getDataSize() - p.getReadPosition(), any_packet); error != DecodeError::None) {
+        throw std::runtime_error(std::string{ "Malformed packet: " } + to_string(error) + "\n");
     }
+
+    return p;
 }
 
 sf::Packet& operator << (sf::Packet& p, Any const& any_packet) {
     return std::visit([&p] (auto const& packet) -> decltype(auto) { return p << packet; }, any_packet);
 }
 
+std::size_t serialized_size(Any const& any_packet) {
+    return std::visit([] (auto const& packet) { return serialized_size(packet); }, any_packet);
+}
+
 std::ostream& operator <<(std::ostream& os, Any const& any_packet) {
     return std::visit([&os] (auto const& packet) -> decltype(auto) { return os << packet; }, any_packet);
 }
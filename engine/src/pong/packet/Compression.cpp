@@ -0,0 +1,232 @@
+#include <pong/packet/Compression.hpp>
+#include <pong/packet/Reader.hpp>
+#include <pong/packet/Writer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace pong::packet {
+
+namespace {
+
+constexpr std::size_t min_match{ 4 };
+constexpr std::size_t max_offset{ 65535 };
+
+// The last bytes of a block are always literals, so a match never reads past the end of the data
+constexpr std::size_t end_literals{ 5 };
+
+constexpr unsigned hash_bits{ 12 };
+constexpr std::size_t no_position{ std::numeric_limits<std::size_t>::max() };
+
+constexpr std::size_t header_size{ sizeof(sf::Uint32) + sizeof(id_t) + sizeof(sf::Uint32) };
+
+
+std::uint32_t read_32(std::byte const* data) {
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+
+std::uint32_t hash(std::uint32_t value) {
+    return (value * 2654435761u) >> (32 - hash_bits);
+}
+
+
+/*
+    Rest of a length that doesn't fit in its nibble
+*/
+std::byte* write_length(std::byte* out, std::size_t length) {
+    for(; length >= 255; length -= 255) {
+        *out++ = std::byte{ 255 };
+    }
+    *out++ = static_cast<std::byte>(length);
+    return out;
+}
+
+
+/*
+    `match_length` 0 for the last sequence
+*/
+std::byte* write_sequence(std::byte* out, std::byte const* literals, std::size_t literal_count, std::size_t match_length, std::size_t offset) {
+    auto literal_nibble = std::min<std::size_t>(literal_count, 15);
+    auto match_nibble = match_length > 0 ? std::min<std::size_t>(match_length - min_match, 15) : 0;
+    *out++ = static_cast<std::byte>((literal_nibble << 4) | match_nibble);
+
+    if (literal_nibble == 15) {
+        out = write_length(out, literal_count - 15);
+    }
+
+    if (literal_count > 0) {
+        std::memcpy(out, literals, literal_count);
+        out += literal_count;
+    }
+
+    if (match_length > 0) {
+        *out++ = static_cast<std::byte>(offset & 0xFF);
+        *out++ = static_cast<std::byte>(offset >> 8);
+
+        if (match_nibble == 15) {
+            out = write_length(out, match_length - min_match - 15);
+        }
+    }
+
+    return out;
+}
+
+
+/*
+    Add the bytes of an extended length, false if the block ends before
+*/
+bool read_length(std::byte const*& in, std::byte const* end, std::size_t& length) {
+    while(in != end) {
+        auto byte = std::to_integer<std::size_t>(*in++);
+        length += byte;
+        if (byte != 255) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}
+
+
+
+
+
+std::size_t compress(std::byte const* data, std::size_t size, std::byte* out) {
+    auto* const out_begin = out;
+
+    std::array<std::size_t, 1 << hash_bits> table;
+    table.fill(no_position);
+
+    std::size_t anchor{ 0 };
+    std::size_t i{ 0 };
+
+    while(i + min_match + end_literals <= size) {
+        auto value = read_32(data + i);
+        auto& slot = table[hash(value)];
+        auto candidate = slot;
+        slot = i;
+
+        if (candidate == no_position || i - candidate > max_offset || read_32(data + candidate) != value) {
+            ++i;
+            continue;
+        }
+
+
+        auto length = min_match;
+        while(i + length + end_literals < size && data[candidate + length] == data[i + length]) {
+            ++length;
+        }
+
+        out = write_sequence(out, data + anchor, i - anchor, length, i - candidate);
+        i += length;
+        anchor = i;
+    }
+
+    out = write_sequence(out, data + anchor, size - anchor, 0, 0);
+    return static_cast<std::size_t>(out - out_begin);
+}
+
+
+bool decompress(std::byte const* data, std::size_t size, std::byte* out, std::size_t out_size) {
+    auto const* in = data;
+    auto const* const in_end = data + size;
+    auto* const out_begin = out;
+    auto* const out_end = out + out_size;
+
+    while(in != in_end) {
+        auto token = std::to_integer<std::size_t>(*in++);
+
+        std::size_t literal_count{ token >> 4 };
+        if (literal_count == 15 && !read_length(in, in_end, literal_count)) {
+            return false;
+        }
+
+        if (literal_count > static_cast<std::size_t>(in_end - in) || literal_count > static_cast<std::size_t>(out_end - out)) {
+            return false;
+        }
+
+        if (literal_count > 0) {
+            std::memcpy(out, in, literal_count);
+            in += literal_count;
+            out += literal_count;
+        }
+
+
+        // Last sequence
+        if (in == in_end) {
+            return out == out_end;
+        }
+
+
+        if (in_end - in < 2) {
+            return false;
+        }
+
+        auto offset = std::to_integer<std::size_t>(in[0]) | (std::to_integer<std::size_t>(in[1]) << 8);
+        in += 2;
+
+        std::size_t match_length{ token & 15 };
+        if (match_length == 15 && !read_length(in, in_end, match_length)) {
+            return false;
+        }
+        match_length += min_match;
+
+        if (offset == 0 || offset > static_cast<std::size_t>(out - out_begin) || match_length > static_cast<std::size_t>(out_end - out)) {
+            return false;
+        }
+
+
+        // The match may overlap the bytes it produces, byte per byte
+        auto const* match = out - offset;
+        for(std::size_t k{ 0 }; k < match_length; ++k) {
+            *out++ = match[k];
+        }
+    }
+
+    return false;
+}
+
+
+void write_compressed_frame(std::byte const* packet, std::size_t size, std::vector<std::byte>& frame) {
+    frame.resize(header_size + max_compressed_size(size));
+
+    auto compressed_size = compress(packet, size, frame.data() + header_size);
+    frame.resize(header_size + compressed_size);
+
+    details::Writer writer{ frame.data() };
+    writer << static_cast<sf::Uint32>(frame.size() - sizeof(sf::Uint32)) << compressed_id << static_cast<sf::Uint32>(size);
+}
+
+
+bool is_compressed(void const* packet, std::size_t size) {
+    details::Reader reader{ packet, size };
+
+    id_t id;
+    reader >> id;
+    return !reader.failed() && id == compressed_id;
+}
+
+
+bool decompress_packet(void const* data, std::size_t size, std::vector<std::byte>& packet) {
+    details::Reader reader{ data, size };
+
+    id_t id;
+    sf::Uint32 packet_size;
+    reader >> id >> packet_size;
+    if (reader.failed() || id != compressed_id || packet_size > max_decompressed_size) {
+        return false;
+    }
+
+    packet.resize(packet_size);
+    return decompress(reader.position, reader.remaining(), packet.data(), packet.size());
+}
+
+}
@@ -0,0 +1,187 @@
+#include <pong/packet/Federation.hpp>
+#include <pong/packet/Utility.hpp>
+#include <pong/packet/Fields.hpp>
+
+namespace pong::packet::federation {
+
+/*
+    Join
+
+    std::string address
+    sf::Uint16 port
+    unsigned first_slot
+    unsigned slot_count
+*/
+
+PACKET_CODEC(Join)
+
+std::string to_string(Join const& packet) {
+    return std::string{ packet.name } + "{" + packet.address + ":" + std::to_string(packet.port) + ", ["
+        + std::to_string(packet.first_slot) + ", +" + std::to_string(packet.slot_count) + ")}";
+}
+
+
+
+
+
+/*
+    Welcome
+
+    node_id_t node
+    unsigned first_slot
+    unsigned slot_count
+*/
+
+PACKET_CODEC(Welcome)
+
+std::string to_string(Welcome const& packet) {
+    return std::string{ packet.name } + "{#" + std::to_string(packet.node) + ", ["
+        + std::to_string(packet.first_slot) + ", +" + std::to_string(packet.slot_count) + ")}";
+}
+
+
+
+
+
+/*
+    NodeInfo
+
+    node_id_t node
+    std::string address
+    sf::Uint16 port
+    unsigned first_slot
+    unsigned slot_count
+*/
+
+PACKET_CODEC(NodeInfo)
+
+std::string to_string(NodeInfo const& packet) {
+    return std::string{ packet.name } + "{#" + std::to_string(packet.node) + ", " + packet.address + ":" + std::to_string(packet.port) + ", ["
+        + std::to_string(packet.first_slot) + ", +" + std::to_string(packet.slot_count) + ")}";
+}
+
+
+
+
+
+/*
+    OldNode
+
+    node_id_t node
+*/
+
+PACKET_CODEC(OldNode)
+
+std::string to_string(OldNode const& packet) {
+    return std::string{ packet.name } + "#" + std::to_string(packet.node);
+}
+
+
+
+
+
+/*
+    Load
+
+    node_id_t node
+    unsigned users
+    unsigned lobby_users
+    unsigned rooms
+*/
+
+PACKET_CODEC(Load)
+
+std::string to_string(Load const& packet) {
+    return std::string{ packet.name } + "{#" + std::to_string(packet.node) + ", " + std::to_string(packet.users) + " users, "
+        + std::to_string(packet.lobby_users) + " in the lobby, " + std::to_string(packet.rooms) + " rooms}";
+}
+
+
+
+
+
+/*
+    Placement
+
+    node_id_t node
+*/
+
+PACKET_CODEC(Placement)
+
+std::string to_string(Placement const& packet) {
+    return std::string{ packet.name } + "#" + std::to_string(packet.node);
+}
+
+
+
+
+
+/*
+    RoomUpdate
+
+    server::RoomSummary summary
+*/
+
+PACKET_CODEC(RoomUpdate)
+
+std::string to_string(RoomUpdate const& packet) {
+    return std::string{ packet.name } + server::to_string(packet.summary);
+}
+
+
+
+
+
+/*
+    OldRoom
+
+    unsigned id
+*/
+
+PACKET_CODEC(OldRoom)
+
+std::string to_string(OldRoom const& packet) {
+    return std::string{ packet.name } + "#" + std::to_string(packet.id);
+}
+
+
+
+
+
+/*
+    Any
+
+    std::variant<
+        Join,
+        Welcome,
+        NodeInfo,
+        OldNode,
+        Load,
+        Placement,
+        RoomUpdate,
+        OldRoom
+    >;
+*/
+
+DecodeError decode(void const* data, std::size_t size, Any& any_packet, Encoding encoding) {
+    details::Reader reader{ data, size, encoding };
+    return details::decode_any(reader, any_packet);
+}
+
+sf::Packet& operator << (sf::Packet& p, Any const& any_packet) {
+    return std::visit([&p] (auto const& packet) -> decltype(auto) { return p << packet; }, any_packet);
+}
+
+std::size_t serialized_size(Any const& any_packet) {
+    return std::visit([] (auto const& packet) { return serialized_size(packet); }, any_packet);
+}
+
+std::ostream& operator <<(std::ostream& os, Any const& any_packet) {
+    return std::visit([&os] (auto const& packet) -> decltype(auto) { return os << packet; }, any_packet);
+}
+
+std::string to_string(Any const& any_packet) {
+    return std::visit([] (auto const& packet) -> decltype(auto) { return to_string(packet); }, any_packet);
+}
+
+}
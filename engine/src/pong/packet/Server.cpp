@@ -1,30 +1,50 @@
 #include <pong/packet/Server.hpp>
 #include <pong/packet/Utility.hpp>
+#include <pong/packet/Fields.hpp>
+#include <pong/packet/Compression.hpp>
+
+#include <stdexcept>
 
 namespace pong::packet::server {
 
 /*
-    ChangeUsernameResponse
+    RoomSummary
 
-    Result result
+    unsigned id
+    unsigned user_count
+    bool left_player
+    bool right_player
 */
 
-sf::Packet& operator >> (sf::Packet& p, ChangeUsernameResponse& packet) {
-    return p >> details::by<sf::Uint8>(packet.valid);
+sf::Packet& operator << (sf::Packet& p, RoomSummary const& summary) {
+    return details::encode_fields(p, summary);
 }
 
-sf::Packet& operator << (sf::Packet& p, ChangeUsernameResponse const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.valid);
+bool operator == (RoomSummary const& lhs, RoomSummary const& rhs) {
+    return details::equal_fields(lhs, rhs);
 }
 
-bool operator == (ChangeUsernameResponse const& lhs, ChangeUsernameResponse const& rhs) {
-    return lhs.valid == rhs.valid;
+std::size_t serialized_size(RoomSummary const& summary) {
+    return details::fields_size(summary);
 }
 
-std::ostream& operator <<(std::ostream& os, ChangeUsernameResponse const& packet) {
-    return os << to_string(packet);
+std::string to_string(RoomSummary const& summary) {
+    return "#" + std::to_string(summary.id) + "{" + std::to_string(summary.user_count) + " users, " 
+        + (summary.left_player ? "L" : "-") + (summary.right_player ? "R" : "-") + "}";
 }
 
+
+
+
+
+/*
+    ChangeUsernameResponse
+
+    Result result
+*/
+
+PACKET_CODEC(ChangeUsernameResponse)
+
 std::string to_string(ChangeUsernameResponse const& packet) {
     char const* result_str = packet.valid ? "Valid" : "Invalid";
     return std::string{ packet.name } + "::" + result_str;
@@ -37,50 +57,23 @@ std::string to_string(ChangeUsernameResponse const& packet) {
 /*
     LobbyInfo
 
-    std::vector<std::string> users
-    std::vector<int> rooms
+    unsigned user_count
+    std::vector<RoomSummary> rooms
 */
 
-sf::Packet& operator >> (sf::Packet& p, LobbyInfo& packet) {
-    using details::operator>>;
-    return p >> packet.users >> packet.rooms;
-}
-
-sf::Packet& operator << (sf::Packet& p, LobbyInfo const& packet) {
-    using details::operator<<;
-    return p << id_of(packet) << packet.users << packet.rooms;
-}
-
-bool operator == (LobbyInfo const& lhs, LobbyInfo const& rhs) {
-    return lhs.users == rhs.users && lhs.rooms == rhs.rooms;
-}
-
-std::ostream& operator <<(std::ostream& os, LobbyInfo const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(LobbyInfo)
 
 std::string to_string(LobbyInfo const& packet) {
-    auto str = std::string{ packet.name } + "{[";
-    bool first = true;
-    for(auto const& user : packet.users) {
-        if (!first) {
-            str += ", ";            
-        }
-        first = false;
-        
-        str += user;
-    }
-
-    str += "], [";
+    auto str = std::string{ packet.name } + "{" + std::to_string(packet.user_count) + " users, [";
 
-    first = true;
+    bool first = true;
     for(auto const& room : packet.rooms) {
         if (!first) {
             str += ", ";            
         }
         first = false;
         
-        str += std::to_string(room);
+        str += to_string(room);
     }
 
     str += "]}";
@@ -94,27 +87,13 @@ std::string to_string(LobbyInfo const& packet) {
 /*
     NewUser
 
-    std::string username
+    name_id_t user
 */
 
-sf::Packet& operator >> (sf::Packet& p, NewUser& packet) {
-    return p >> packet.username;
-}
-
-sf::Packet& operator << (sf::Packet& p, NewUser const& packet) {
-    return p << id_of(packet) << packet.username;
-}
-
-bool operator == (NewUser const& lhs, NewUser const& rhs) {
-    return lhs.username == rhs.username;
-}
-
-std::ostream& operator <<(std::ostream& os, NewUser const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(NewUser)
 
 std::string to_string(NewUser const& packet) {
-    return std::string{ packet.name } + "{" + packet.username + "}";
+    return std::string{ packet.name } + "{#" + std::to_string(packet.user) + "}";
 }
 
 
@@ -124,27 +103,13 @@ std::string to_string(NewUser const& packet) {
 /*
     OldUser
 
-    std::string username
+    name_id_t user
 */
 
-sf::Packet& operator >> (sf::Packet& p, OldUser& packet) {
-    return p >> packet.username;
-}
-
-sf::Packet& operator << (sf::Packet& p, OldUser const& packet) {
-    return p << id_of(packet) << packet.username;
-}
-
-bool operator == (OldUser const& lhs, OldUser const& rhs) {
-    return lhs.username == rhs.username;
-}
-
-std::ostream& operator <<(std::ostream& os, OldUser const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(OldUser)
 
 std::string to_string(OldUser const& packet) {
-    return std::string{ packet.name } + "{" + packet.username + "}";
+    return std::string{ packet.name } + "{#" + std::to_string(packet.user) + "}";
 }
 
 
@@ -157,21 +122,7 @@ std::string to_string(OldUser const& packet) {
     unsigned id
 */
 
-sf::Packet& operator >> (sf::Packet& p, NewRoom& packet) {
-    return p >> details::by<sf::Uint32>(packet.id);
-}
-
-sf::Packet& operator << (sf::Packet& p, NewRoom const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint32>(packet.id);
-}
-
-bool operator == (NewRoom const& lhs, NewRoom const& rhs) {
-    return lhs.id == rhs.id;
-}
-
-std::ostream& operator <<(std::ostream& os, NewRoom const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(NewRoom)
 
 std::string to_string(NewRoom const& packet) {
     return std::string{ packet.name } + "#" + std::to_string(packet.id);
@@ -187,21 +138,7 @@ std::string to_string(NewRoom const& packet) {
     unsigned id
 */
 
-sf::Packet& operator >> (sf::Packet& p, OldRoom& packet) {
-    return p >> details::by<sf::Uint32>(packet.id);
-}
-
-sf::Packet& operator << (sf::Packet& p, OldRoom const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint32>(packet.id);
-}
-
-bool operator == (OldRoom const& lhs, OldRoom const& rhs) {
-    return lhs.id == rhs.id;
-}
-
-std::ostream& operator <<(std::ostream& os, OldRoom const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(OldRoom)
 
 std::string to_string(OldRoom const& packet) {
     return std::string{ packet.name } + "#" + std::to_string(packet.id);
@@ -217,21 +154,7 @@ std::string to_string(OldRoom const& packet) {
     Result result
 */
 
-sf::Packet& operator >> (sf::Packet& p, EnterRoomResponse& packet) {
-    return p >> details::by<sf::Uint8>(packet.result);
-}
-
-sf::Packet& operator << (sf::Packet& p, EnterRoomResponse const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.result);
-}
-
-bool operator == (EnterRoomResponse const& lhs, EnterRoomResponse const& rhs) {
-    return lhs.result == rhs.result;
-}
-
-std::ostream& operator <<(std::ostream& os, EnterRoomResponse const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(EnterRoomResponse)
 
 std::string to_string(EnterRoomResponse const& packet) {
     char const* result_str = 
@@ -250,35 +173,16 @@ std::string to_string(EnterRoomResponse const& packet) {
 /*
     RoomInfo
 
-    std::string left_player
-    std::string right_player
-    std::vector<std::string> spectators
+    name_id_t left_player
+    name_id_t right_player
+    std::vector<name_id_t> spectators
 */
 
-sf::Packet& operator >> (sf::Packet& p, RoomInfo& packet) {
-    using details::operator>>;
-    return p >> packet.left_player >> packet.right_player >> packet.spectators;
-}
-
-sf::Packet& operator << (sf::Packet& p, RoomInfo const& packet) {
-    using details::operator<<;
-    return p << id_of(packet) << packet.left_player << packet.right_player << packet.spectators;
-}
-
-bool operator == (RoomInfo const& lhs, RoomInfo const& rhs) {
-    return 
-        lhs.left_player == rhs.left_player 
-    &&  lhs.right_player == rhs.right_player
-    &&  lhs.spectators == rhs.spectators;
-}
-
-std::ostream& operator <<(std::ostream& os, RoomInfo const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(RoomInfo)
 
 std::string to_string(RoomInfo const& packet) {
     auto str = std::string{ packet.name } + "{";
-    str +=  packet.left_player + " vs " + packet.right_player + ", [";
+    str +=  "#" + std::to_string(packet.left_player) + " vs #" + std::to_string(packet.right_player) + ", [";
     bool first = true;
     for(auto const& user : packet.spectators) {
         if (!first) {
@@ -286,7 +190,7 @@ std::string to_string(RoomInfo const& packet) {
         }
         first = false;
         
-        str += user;
+        str += "#" + std::to_string(user);
     }
     str += "]}";
     return str;
@@ -304,26 +208,7 @@ std::string to_string(RoomInfo const& packet) {
     pong::Pad right
 */
 
-sf::Packet& operator >> (sf::Packet& p, GameState& packet) {
-    using details::operator>>;
-    return p >> packet.ball >> packet.left >> packet.right;
-}
-
-sf::Packet& operator << (sf::Packet& p, GameState const& packet) {
-    using details::operator<<;
-    return p << id_of(packet) << packet.ball << packet.left << packet.right;
-}
-
-bool operator == (GameState const& lhs, GameState const& rhs) {
-    return 
-        lhs.ball == rhs.ball 
-    &&  lhs.left == rhs.left
-    &&  lhs.right == rhs.right;
-}
-
-std::ostream& operator <<(std::ostream& os, GameState const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(GameState)
 
 std::string to_string(GameState const& packet) {
     auto const vector_to_string = [] (sf::Vector2f const& v) {
@@ -352,23 +237,7 @@ std::string to_string(GameState const& packet) {
     pong::Side side
 */
 
-sf::Packet& operator >> (sf::Packet& p, BePlayer& packet) {
-    using details::operator>>;
-    return p >> details::by<sf::Uint8>(packet.side);
-}
-
-sf::Packet& operator << (sf::Packet& p, BePlayer const& packet) {
-    using details::operator<<;
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.side);
-}
-
-bool operator == (BePlayer const& lhs, BePlayer const& rhs) {
-    return lhs.side == rhs.side;
-}
-
-std::ostream& operator <<(std::ostream& os, BePlayer const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(BePlayer)
 
 std::string to_string(BePlayer const& packet) {
     char const* side_str = packet.side == pong::Side::Left ?
@@ -385,32 +254,16 @@ std::string to_string(BePlayer const& packet) {
     NewPlayer
 
     pong::Side side
-    std::string username
+    name_id_t user
 */
 
-sf::Packet& operator >> (sf::Packet& p, NewPlayer& packet) {
-    using details::operator>>;
-    return p >> details::by<sf::Uint8>(packet.side) >> packet.username;
-}
-
-sf::Packet& operator << (sf::Packet& p, NewPlayer const& packet) {
-    using details::operator<<;
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.side) << packet.username;
-}
-
-bool operator == (NewPlayer const& lhs, NewPlayer const& rhs) {
-    return lhs.side == rhs.side && lhs.username == rhs.username;
-}
-
-std::ostream& operator <<(std::ostream& os, NewPlayer const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(NewPlayer)
 
 std::string to_string(NewPlayer const& packet) {
     char const* side_str = packet.side == pong::Side::Left ?
             "Left"
         :   "Right";
-    return std::string{ packet.name } + "{" + packet.username + ", " + side_str + "}";
+    return std::string{ packet.name } + "{#" + std::to_string(packet.user) + ", " + side_str + "}";
 }
 
 
@@ -421,32 +274,16 @@ std::string to_string(NewPlayer const& packet) {
     OldPlayer
 
     pong::Side side
-    std::string username
+    name_id_t user
 */
 
-sf::Packet& operator >> (sf::Packet& p, OldPlayer& packet) {
-    using details::operator>>;
-    return p >> details::by<sf::Uint8>(packet.side) >> packet.username;
-}
-
-sf::Packet& operator << (sf::Packet& p, OldPlayer const& packet) {
-    using details::operator<<;
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.side) << packet.username;
-}
-
-bool operator == (OldPlayer const& lhs, OldPlayer const& rhs) {
-    return lhs.side == rhs.side && lhs.username == rhs.username;
-}
-
-std::ostream& operator <<(std::ostream& os, OldPlayer const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(OldPlayer)
 
 std::string to_string(OldPlayer const& packet) {
     char const* side_str = packet.side == pong::Side::Left ?
             "Left"
         :   "Right";
-    return std::string{ packet.name } + "{" + packet.username + ", " + side_str + "}";
+    return std::string{ packet.name } + "{#" + std::to_string(packet.user) + ", " + side_str + "}";
 }
 
 
@@ -459,21 +296,7 @@ std::string to_string(OldPlayer const& packet) {
     Reason reason
 */
 
-sf::Packet& operator >> (sf::Packet& p, CreateRoomResponse& packet) {
-    return p >> details::by<sf::Uint8>(packet.reason);
-}
-
-sf::Packet& operator << (sf::Packet& p, CreateRoomResponse const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.reason);
-}
-
-bool operator == (CreateRoomResponse const& lhs, CreateRoomResponse const& rhs) {
-    return lhs.reason == rhs.reason;
-}
-
-std::ostream& operator <<(std::ostream& os, CreateRoomResponse const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(CreateRoomResponse)
 
 std::string to_string(CreateRoomResponse const& packet) {
     char const* reason_str = packet.reason == CreateRoomResponse::Reason::Okay ?
@@ -492,21 +315,7 @@ std::string to_string(CreateRoomResponse const& packet) {
     Reason reason
 */
 
-sf::Packet& operator >> (sf::Packet& p, LeaveRoomResponse& packet) {
-    return p >> details::by<sf::Uint8>(packet.reason);
-}
-
-sf::Packet& operator << (sf::Packet& p, LeaveRoomResponse const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.reason);
-}
-
-bool operator == (LeaveRoomResponse const& lhs, LeaveRoomResponse const& rhs) {
-    return lhs.reason == rhs.reason;
-}
-
-std::ostream& operator <<(std::ostream& os, LeaveRoomResponse const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(LeaveRoomResponse)
 
 std::string to_string(LeaveRoomResponse const& packet) {
     char const* reason_str = packet.reason == LeaveRoomResponse::Reason::Okay ?
@@ -525,21 +334,7 @@ std::string to_string(LeaveRoomResponse const& packet) {
     Result result
 */
 
-sf::Packet& operator >> (sf::Packet& p, GameOver& packet) {
-    return p >> details::by<sf::Uint8>(packet.result);
-}
-
-sf::Packet& operator << (sf::Packet& p, GameOver const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint8>(packet.result);
-}
-
-bool operator == (GameOver const& lhs, GameOver const& rhs) {
-    return lhs.result == rhs.result;
-}
-
-std::ostream& operator <<(std::ostream& os, GameOver const& packet) {
-    return os << to_string(packet);
-}
+PACKET_CODEC(GameOver)
 
 std::string to_string(GameOver const& packet) {
     char const* result_str = 
@@ -561,23 +356,23 @@ std::string to_string(GameOver const& packet) {
     BeNextPlayer
 */
 
-sf::Packet& operator >> (sf::Packet& p, BeNextPlayer&) {
-    return p;
-}
+PACKET_CODEC(BeNextPlayer)
 
-sf::Packet& operator << (sf::Packet& p, BeNextPlayer const& packet) {
-    return p << id_of(packet);
+std::string to_string(BeNextPlayer const& packet) {
+    return std::string{ packet.name };
 }
 
-bool operator == (BeNextPlayer const&, BeNextPlayer const&) {
-    return true;
-}
 
-std::ostream& operator <<(std::ostream& os, BeNextPlayer const& packet) {
-    return os << to_string(packet);
-}
 
-std::string to_string(BeNextPlayer const& packet) {
+
+
+/*
+    DeniedBePlayer
+*/
+
+PACKET_CODEC(DeniedBePlayer)
+
+std::string to_string(DeniedBePlayer const& packet) {
     return std::string{ packet.name };
 }
 
@@ -586,27 +381,31 @@ std::string to_string(BeNextPlayer const& packet) {
 
 
 /*
-    DeniedBePlayer
+    UserCount
+
+    unsigned count
 */
 
-sf::Packet& operator >> (sf::Packet& p, DeniedBePlayer&) {
-    return p;
-}
+PACKET_CODEC(UserCount)
 
-sf::Packet& operator << (sf::Packet& p, DeniedBePlayer const& packet) {
-    return p << id_of(packet);
+std::string to_string(UserCount const& packet) {
+    return std::string{ packet.name } + "{" + std::to_string(packet.count) + "}";
 }
 
-bool operator == (DeniedBePlayer const&, DeniedBePlayer const&) {
-    return true;
-}
 
-std::ostream& operator <<(std::ostream& os, DeniedBePlayer const& packet) {
-    return os << to_string(packet);
-}
 
-std::string to_string(DeniedBePlayer const& packet) {
-    return std::string{ packet.name };
+
+
+/*
+    RoomUpdate
+
+    RoomSummary summary
+*/
+
+PACKET_CODEC(RoomUpdate)
+
+std::string to_string(RoomUpdate const& packet) {
+    return std::string{ packet.name } + to_string(packet.summary);
 }
 
 
@@ -614,28 +413,85 @@ std::string to_string(DeniedBePlayer const& packet) {
 
 
 /*
-    Score
+    UserName
 
-    unsigned left
-    unsigned right
+    name_id_t id
+    std::string username
 */
 
-sf::Packet& operator >> (sf::Packet& p, Score& packet) {
-    return p >> details::by<sf::Uint32>(packet.left) >> details::by<sf::Uint32>(packet.right);
+PACKET_CODEC(UserName)
+
+std::string to_string(UserName const& packet) {
+    return std::string{ packet.name } + "{#" + std::to_string(packet.id) + ", " + packet.username + "}";
 }
 
-sf::Packet& operator << (sf::Packet& p, Score const& packet) {
-    return p << id_of(packet) << details::by<sf::Uint32>(packet.left) << details::by<sf::Uint32>(packet.right);
+
+
+
+
+/*
+    Redirect
+
+    Request request
+    std::string address
+    sf::Uint16 port
+    unsigned room_id
+*/
+
+PACKET_CODEC(Redirect)
+
+std::string to_string(Redirect const& packet) {
+    char const* request_str = packet.request == Redirect::Request::EnterRoom ? "EnterRoom" : "CreateRoom";
+    auto str = std::string{ packet.name } + "::" + request_str;
+    if (packet.request == Redirect::Request::EnterRoom) {
+        str += "#" + std::to_string(packet.room_id);
+    }
+    return str + "{" + packet.address + ":" + std::to_string(packet.port) + "}";
 }
 
-bool operator == (Score const& lhs, Score const& rhs) {
-    return lhs.left == rhs.left && lhs.right == rhs.right;
+
+
+
+
+/*
+    MatchFound
+
+    unsigned room_id
+*/
+
+PACKET_CODEC(MatchFound)
+
+std::string to_string(MatchFound const& packet) {
+    return std::string{ packet.name } + "#" + std::to_string(packet.room_id);
 }
 
-std::ostream& operator <<(std::ostream& os, Score const& packet) {
-    return os << to_string(packet);
+
+
+
+
+/*
+    LeftMatchmaking
+*/
+
+PACKET_CODEC(LeftMatchmaking)
+
+std::string to_string(LeftMatchmaking const& packet) {
+    return std::string{ packet.name };
 }
 
+
+
+
+
+/*
+    Score
+
+    unsigned left
+    unsigned right
+*/
+
+PACKET_CODEC(Score)
+
 std::string to_string(Score const& packet) {
     return std::string{ packet.name } + "{" + std::to_string(packet.left) + ":" + std::to_string(packet.right) + "}";
 }
@@ -665,150 +521,49 @@ std::string to_string(Score const& packet) {
         GameOver,
         BeNextPlayer,
         DeniedBePlayer,
-        LeaveRoomResponse
+        LeaveRoomResponse,
+        UserCount,
+        RoomUpdate,
+        UserName,
+        Redirect,
+        MatchFound,
+        LeftMatchmaking
     >;
 */
 
-sf::Packet& operator >> (sf::Packet& p, Any& any_packet) {
-    unsigned id;
-    p >> id;
-    switch(id) {
-        case id_of<ChangeUsernameResponse>(): {
-            ChangeUsernameResponse packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<LobbyInfo>(): {
-            LobbyInfo packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<NewUser>(): {
-            NewUser packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<OldUser>(): {
-            OldUser packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<NewRoom>(): {
-            NewRoom packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<OldRoom>(): {
-            OldRoom packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
+DecodeError decode(void const* data, std::size_t size, Any& any_packet, Encoding encoding) {
+    if (is_compressed(data, size)) {
+        // Keeps its capacity for the next compressed frames
+        thread_local std::vector<std::byte> packet;
+        if (!decompress_packet(data, size, packet)) {
+            return DecodeError::BadCompression;
         }
 
-        case id_of<EnterRoomResponse>(): {
-            EnterRoomResponse packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<RoomInfo>(): {
-            RoomInfo packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<GameState>(): {
-            GameState packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<BePlayer>(): {
-            BePlayer packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<NewPlayer>(): {
-            NewPlayer packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<OldPlayer>(): {
-            OldPlayer packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<Score>(): {
-            Score packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<CreateRoomResponse>(): {
-            CreateRoomResponse packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<GameOver>(): {
-            GameOver packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<BeNextPlayer>(): {
-            BeNextPlayer packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<DeniedBePlayer>(): {
-            DeniedBePlayer packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
-
-        case id_of<LeaveRoomResponse>(): {
-            LeaveRoomResponse packet;
-            p >> packet;
-            any_packet = std::move(packet);
-            return p;
-        }
+        details::Reader reader{ packet.data(), packet.size(), encoding };
+        return details::decode_any(reader, any_packet);
+    }
 
-        default:
-            throw std::runtime_error("Bad packet id\n");
+    details::Reader reader{ data, size, encoding };
+    return details::decode_any(reader, any_packet);
+}
 
+sf::Packet& operator >> (sf::Packet& p, Any& any_packet) {
+    auto const* unread = static_cast<char const*>(p.getData()) + p.getReadPosition();
+    if (auto error = decode(unread, p.getDataSize() - p.getReadPosition(), any_packet); error != DecodeError::None) {
+        throw std::runtime_error(std::string{ "Malformed packet: " } + to_string(error) + "\n");
     }
+
+    return p;
 }
 
 sf::Packet& operator << (sf::Packet& p, Any const& any_packet) {
     return std::visit([&p] (auto const& packet) -> decltype(auto) { return p << packet; }, any_packet);
 }
 
+std::size_t serialized_size(Any const& any_packet) {
+    return std::visit([] (auto const& packet) { return serialized_size(packet); }, any_packet);
+}
+
 std::ostream& operator <<(std::ostream& os, Any const& any_packet) {
     return std::visit([&os] (auto const& packet) -> decltype(auto) { return os << packet; }, any_packet);
 }
@@ -0,0 +1,660 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+
+#include <pong/packet/Client.hpp>
+#include <pong/packet/Server.hpp>
+#include <pong/packet/State.hpp>
+#include <pong/packet/Compression.hpp>
+#include <pong/packet/Reader.hpp>
+#include <pong/packet/Writer.hpp>
+
+#include <pong/loadgen/Stats.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pong::loadgen {
+
+/*
+    Pace of the simulated users, in the ranges of a person clicking through the client
+    Each duration is drawn uniformly in its range
+*/
+struct Behavior {
+    using duration = std::chrono::milliseconds;
+    using range = std::pair<duration, duration>;
+
+    // In the lobby, between two actions
+    range think{ duration{ 1000 }, duration{ 5000 } };
+    // As a spectator, before queuing or leaving the room
+    range spectate{ duration{ 2000 }, duration{ 10000 } };
+    // Before accepting `BeNextPlayer`, the server waits 5 seconds
+    range reaction{ duration{ 200 }, duration{ 1500 } };
+    // In the queue, before leaving it
+    range queue_patience{ duration{ 15000 }, duration{ 60000 } };
+    // As a player, before abandoning the game
+    range game{ duration{ 20000 }, duration{ 90000 } };
+    // As a player, between two inputs
+    range input{ duration{ 80 }, duration{ 300 } };
+    // Looking for a match, before giving up
+    range match_patience{ duration{ 5000 }, duration{ 30000 } };
+
+    double browse_probability{ 0.3 };
+    double create_room_probability{ 0.1 };
+    double queue_probability{ 0.7 };
+    double find_match_probability{ 0.2 };
+    // Of the users looking for a match, the others have a rating drawn uniformly in `ratings`
+    double unrated_probability{ 0.2 };
+    std::pair<unsigned, unsigned> ratings{ 800, 2400 };
+
+    // Rooms with this number of users aren't entered
+    unsigned max_room_users{ 8 };
+    // The lobby is browsed in windows of `SubscribeRoomInfo` up to this slot
+    unsigned browsed_slots{ 256 };
+};
+
+
+
+
+/*
+    A simulated client, driven by `pong::packet::SubState` as the real client
+
+    The bot logs in, browses the lobby, creates and enters rooms or looks for a match, queues, accepts `BeNextPlayer` and plays.
+    Every packet it receives is checked against its sub-state (see State.hpp), a request left without response
+    for `response_timeout` or a frame that can't be decoded closes the connection.
+    A bot lives on a single thread, its counters go to the Stats of the thread
+*/
+struct Bot {
+
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds response_timeout{ 10 };
+    static constexpr std::size_t receive_size{ 4096 };
+
+
+    Bot(std::size_t _number, Behavior const& _behavior, Stats& _stats, sf::Uint32 _capabilities)
+    :   number{ _number }
+    ,   behavior{ _behavior }
+    ,   stats{ _stats }
+    ,   capabilities{ _capabilities }
+    ,   engine{ _number + 1 } {}
+
+    Bot(Bot const&) = delete;
+    Bot& operator=(Bot const&) = delete;
+
+
+    /*
+        Blocking connection, then the bot logs in
+    */
+    bool connect(sf::IpAddress const& address, unsigned short port, sf::Time timeout) {
+        auto start = clock::now();
+        if (socket.connect(address, port, timeout) != sf::Socket::Done) {
+            ++stats.failed_connections;
+            return false;
+        }
+
+        now = clock::now();
+        stats.record_connection(now - start);
+        socket.setBlocking(false);
+        connected = true;
+
+
+        // Always in `Encoding::Sfml`, the frames after it use the negotiated encoding
+        if (capabilities != 0) {
+            send(pong::packet::client::Capabilities{ capabilities });
+            if (capabilities & pong::packet::CompactEncoding) {
+                encoding = pong::packet::Encoding::Compact;
+            }
+        }
+
+        log_in();
+        flush();
+        return connected;
+    }
+
+
+    bool is_connected() const {
+        return connected;
+    }
+
+
+    /*
+        Handle the received packets, act if it's time to, and write what's pending
+    */
+    void update(clock::time_point _now) {
+        now = _now;
+
+        receive();
+
+        if (redirection && !connected) {
+            follow_redirection();
+        }
+
+        if (connected && pending && now - pending->sent > response_timeout) {
+            stats.record_timeout(pending->request);
+            disconnect();
+        }
+
+        if (connected && now >= next_action) {
+            act();
+        }
+
+        if (connected) {
+            flush();
+        }
+    }
+
+
+private:
+
+
+    struct Pending {
+        Request request;
+        clock::time_point sent;
+    };
+
+
+    std::size_t number;
+    Behavior const& behavior;
+    Stats& stats;
+    sf::Uint32 capabilities;
+    std::minstd_rand engine;
+
+    sf::TcpSocket socket;
+    bool connected{ false };
+    pong::packet::Encoding encoding{ pong::packet::Encoding::Sfml };
+
+    std::vector<std::byte> input_buffer;
+    std::vector<std::byte> output_buffer;
+    pong::packet::server::Any packet;
+
+    clock::time_point now{};
+    pong::packet::SubState state{ pong::packet::SubState::NewUser_Invalid };
+    std::optional<Pending> pending;
+    clock::time_point next_action{ clock::time_point::max() };
+
+    unsigned username_attempt{ 0 };
+    // Known by the lobby packets
+    std::vector<pong::packet::server::RoomSummary> rooms;
+    unsigned entering_room{ 0 };
+    clock::time_point game_end{};
+    // Set by `MatchFound`, the bot is queued in the room of the match once in
+    bool matched{ false };
+    clock::time_point match_search_start{};
+    // Request to perform again on the server the bot is redirected to
+    std::optional<pong::packet::server::Redirect> redirection;
+
+
+
+
+    clock::duration draw(Behavior::range const& range) {
+        std::uniform_int_distribution<Behavior::duration::rep> distribution{ range.first.count(), range.second.count() };
+        return Behavior::duration{ distribution(engine) };
+    }
+
+
+    bool chance(double probability) {
+        return std::uniform_real_distribution<double>{ 0., 1. }(engine) < probability;
+    }
+
+
+    void disconnect() {
+        socket.disconnect();
+        connected = false;
+        ++stats.disconnections;
+    }
+
+
+
+
+    template<typename P>
+    void send(P const& client_packet) {
+        assert(pong::packet::is_packet_expected_in(state, client_packet) && "The bot must follow the protocol");
+
+        auto frame_encoding = std::is_same_v<P, pong::packet::client::Capabilities> ? pong::packet::Encoding::Sfml : encoding;
+        auto size = pong::packet::details::frame_size(client_packet, frame_encoding);
+        auto offset = output_buffer.size();
+        output_buffer.resize(offset + size);
+
+        pong::packet::details::Writer writer{ output_buffer.data() + offset, frame_encoding };
+        pong::packet::details::write_frame(writer, pong::packet::client::id_of<P>(), client_packet);
+
+        ++stats.packets_sent[pong::packet::client::id_of<P>()];
+        stats.bytes_sent += size;
+    }
+
+
+    template<typename P>
+    void request(P const& client_packet, Request request) {
+        send(client_packet);
+        pending = Pending{ request, now };
+        next_action = clock::time_point::max();
+    }
+
+
+    void respond(Request request) {
+        if (pending && pending->request == request) {
+            stats.record_response(request, now - pending->sent);
+            pending.reset();
+        }
+    }
+
+
+    void flush() {
+        std::size_t written{ 0 };
+        while(written < output_buffer.size()) {
+            std::size_t sent{ 0 };
+            auto status = socket.send(output_buffer.data() + written, output_buffer.size() - written, sent);
+            written += sent;
+
+            if (status == sf::Socket::Partial || status == sf::Socket::NotReady) {
+                break;
+            }
+            if (status != sf::Socket::Done) {
+                disconnect();
+                break;
+            }
+        }
+
+        output_buffer.erase(std::begin(output_buffer), std::begin(output_buffer) + static_cast<std::ptrdiff_t>(written));
+    }
+
+
+
+
+    void receive() {
+        while(connected) {
+            auto offset = input_buffer.size();
+            input_buffer.resize(offset + receive_size);
+
+            std::size_t received{ 0 };
+            auto status = socket.receive(input_buffer.data() + offset, receive_size, received);
+            input_buffer.resize(offset + received);
+
+            if (status == sf::Socket::NotReady) {
+                break;
+            }
+            if (status != sf::Socket::Done) {
+                disconnect();
+                break;
+            }
+
+            stats.bytes_received += received;
+        }
+
+        read_frames();
+    }
+
+
+    void read_frames() {
+        std::size_t position{ 0 };
+        while(connected && input_buffer.size() - position >= sizeof(sf::Uint32)) {
+            pong::packet::details::Reader header{ input_buffer.data() + position, sizeof(sf::Uint32) };
+            sf::Uint32 size;
+            header >> size;
+
+            if (size > pong::packet::max_decompressed_size) {
+                ++stats.decode_errors[pong::packet::DecodeError::TooLong];
+                disconnect();
+                break;
+            }
+            if (input_buffer.size() - position - sizeof(sf::Uint32) < size) {
+                break;
+            }
+
+            read_frame(input_buffer.data() + position + sizeof(sf::Uint32), size);
+            position += sizeof(sf::Uint32) + size;
+        }
+
+        input_buffer.erase(std::begin(input_buffer), std::begin(input_buffer) + static_cast<std::ptrdiff_t>(position));
+    }
+
+
+    void read_frame(std::byte const* data, std::size_t size) {
+        // Also decompresses the compressed frames
+        auto error = pong::packet::server::decode(data, size, packet, encoding);
+        if (error != pong::packet::DecodeError::None) {
+            ++stats.decode_errors[error];
+            disconnect();
+            return;
+        }
+
+        std::visit([this] (auto const& p) { on_packet(p); }, packet);
+    }
+
+
+    template<typename P>
+    void on_packet(P const& server_packet) {
+        ++stats.packets_received[pong::packet::server::id_of<P>()];
+
+        if (!pong::packet::is_packet_expected_in(state, server_packet)) {
+            stats.record_unexpected(state, P::name);
+            return;
+        }
+
+        if (!pong::packet::is_packet_ignored_in(state, server_packet)) {
+            handle(server_packet);
+        }
+    }
+
+
+
+
+    void log_in() {
+        auto username = "bot" + std::to_string(number);
+        if (username_attempt != 0) {
+            username += "x" + std::to_string(username_attempt);
+        }
+
+        request(pong::packet::client::ChangeUsername{ username }, Request::ChangeUsername);
+        state = pong::packet::SubState::NewUser_Connecting;
+    }
+
+
+    void act() {
+        using pong::packet::SubState;
+
+        switch(state) {
+            case SubState::Lobby_RegularUser: {
+                act_in_lobby();
+                break;
+            }
+
+            case SubState::Lobby_FindingMatch: {
+                request(pong::packet::client::LeaveMatchmaking{}, Request::LeaveMatchmaking);
+                state = SubState::Lobby_LeavingMatchmaking;
+                break;
+            }
+
+            case SubState::Room_Spectator: {
+                if (chance(behavior.queue_probability)) {
+                    send(pong::packet::client::EnterQueue{});
+                    state = SubState::Room_Queued;
+                    next_action = now + draw(behavior.queue_patience);
+                } else {
+                    request(pong::packet::client::LeaveRoom{}, Request::LeaveRoom);
+                    state = SubState::Room_Leaving;
+                }
+                break;
+            }
+
+            case SubState::Room_Queued: {
+                send(pong::packet::client::LeaveQueue{});
+                state = SubState::Room_Spectator;
+                next_action = now + draw(behavior.spectate);
+                break;
+            }
+
+            case SubState::Room_AcceptingBePlayer: {
+                request(pong::packet::client::AcceptBePlayer{}, Request::AcceptBePlayer);
+                state = SubState::Room_NextPlayer;
+                break;
+            }
+
+            case SubState::Room_Player: {
+                if (now >= game_end) {
+                    send(pong::packet::client::Abandon{});
+                    state = SubState::Room_Spectator;
+                    next_action = now + draw(behavior.spectate);
+                } else {
+                    auto input = static_cast<pong::Input>(std::uniform_int_distribution<int>{ 0, 2 }(engine));
+                    send(pong::packet::client::Input{ input });
+                    next_action = now + draw(behavior.input);
+                }
+                break;
+            }
+
+            // Waiting for a response
+            default: {
+                next_action = clock::time_point::max();
+                break;
+            }
+        }
+    }
+
+
+    void act_in_lobby() {
+        using pong::packet::SubState;
+
+        if (chance(behavior.browse_probability)) {
+            auto first = std::uniform_int_distribution<unsigned>{ 0, behavior.browsed_slots }(engine);
+            send(pong::packet::client::SubscribeRoomInfo{ first, first + 16 });
+            next_action = now + draw(behavior.think);
+            return;
+        }
+
+        if (chance(behavior.find_match_probability)) {
+            auto rating = chance(behavior.unrated_probability)
+                ? pong::packet::client::no_rating
+                : std::uniform_int_distribution<unsigned>{ behavior.ratings.first, behavior.ratings.second }(engine);
+
+            // Answered by `MatchFound` whenever an opponent is found
+            send(pong::packet::client::FindMatch{ rating });
+            state = SubState::Lobby_FindingMatch;
+            match_search_start = now;
+            next_action = now + draw(behavior.match_patience);
+            return;
+        }
+
+
+        std::vector<unsigned> open_rooms;
+        for(auto const& summary : rooms) {
+            if (summary.user_count < behavior.max_room_users) {
+                open_rooms.push_back(summary.id);
+            }
+        }
+
+        if (!open_rooms.empty() && !chance(behavior.create_room_probability)) {
+            entering_room = open_rooms[std::uniform_int_distribution<std::size_t>{ 0, open_rooms.size() - 1 }(engine)];
+            request(pong::packet::client::EnterRoom{ entering_room }, Request::EnterRoom);
+            state = SubState::Lobby_EnteringRoom;
+        } else {
+            request(pong::packet::client::CreateRoom{}, Request::CreateRoom);
+            state = SubState::Lobby_CreatingRoom;
+        }
+    }
+
+
+    void enter_lobby(std::vector<pong::packet::server::RoomSummary> const& summaries) {
+        rooms = summaries;
+        state = pong::packet::SubState::Lobby_RegularUser;
+        next_action = now + draw(behavior.think);
+
+        if (redirection) {
+            if (redirection->request == pong::packet::server::Redirect::Request::EnterRoom) {
+                entering_room = redirection->room_id;
+                request(pong::packet::client::EnterRoom{ entering_room }, Request::EnterRoom);
+                state = pong::packet::SubState::Lobby_EnteringRoom;
+            } else {
+                request(pong::packet::client::CreateRoom{}, Request::CreateRoom);
+                state = pong::packet::SubState::Lobby_CreatingRoom;
+            }
+
+            redirection.reset();
+        }
+    }
+
+
+    /*
+        The connection to the previous server is closed by `handle(Redirect)`, the frames after it are dropped
+    */
+    void follow_redirection() {
+        input_buffer.clear();
+        output_buffer.clear();
+        encoding = pong::packet::Encoding::Sfml;
+        state = pong::packet::SubState::NewUser_Invalid;
+        rooms.clear();
+
+        if (!connect(sf::IpAddress{ redirection->address }, redirection->port, sf::seconds(2.f))) {
+            redirection.reset();
+        }
+    }
+
+
+    void update_room(pong::packet::server::RoomSummary const& summary) {
+        auto it = std::find_if(std::begin(rooms), std::end(rooms), [&summary] (auto const& room) { return room.id == summary.id; });
+        if (it != std::end(rooms)) {
+            *it = summary;
+        } else {
+            rooms.push_back(summary);
+        }
+    }
+
+
+    void forget_room(unsigned id) {
+        rooms.erase(std::remove_if(std::begin(rooms), std::end(rooms), [id] (auto const& room) { return room.id == id; }), std::end(rooms));
+    }
+
+
+
+
+    // The packets expected in the current sub-state and not ignored, the others do nothing
+    template<typename P>
+    void handle(P const&) {}
+
+
+    void handle(pong::packet::server::ChangeUsernameResponse const& response) {
+        respond(Request::ChangeUsername);
+
+        if (response.valid) {
+            state = pong::packet::SubState::Lobby_New;
+        } else {
+            ++stats.refused_usernames;
+            ++username_attempt;
+            state = pong::packet::SubState::NewUser_Invalid;
+            log_in();
+        }
+    }
+
+
+    void handle(pong::packet::server::LobbyInfo const& lobby_info) {
+        enter_lobby(lobby_info.rooms);
+    }
+
+
+    void handle(pong::packet::server::NewRoom const& new_room) {
+        update_room({ new_room.id, 0, false, false });
+    }
+
+
+    void handle(pong::packet::server::OldRoom const& old_room) {
+        forget_room(old_room.id);
+    }
+
+
+    void handle(pong::packet::server::RoomUpdate const& room_update) {
+        update_room(room_update.summary);
+    }
+
+
+    void handle(pong::packet::server::Redirect const& redirect) {
+        respond(redirect.request == pong::packet::server::Redirect::Request::EnterRoom ? Request::EnterRoom : Request::CreateRoom);
+        ++stats.redirections;
+
+        // Not counted as a lost connection, `update` connects to the other server
+        redirection = redirect;
+        socket.disconnect();
+        connected = false;
+    }
+
+
+    void handle(pong::packet::server::CreateRoomResponse const& response) {
+        respond(Request::CreateRoom);
+
+        if (response.reason == pong::packet::server::CreateRoomResponse::Reason::Okay) {
+            state = pong::packet::SubState::Room_New;
+        } else {
+            state = pong::packet::SubState::Lobby_RegularUser;
+            next_action = now + draw(behavior.think);
+        }
+    }
+
+
+    void handle(pong::packet::server::EnterRoomResponse const& response) {
+        respond(Request::EnterRoom);
+
+        if (response.result == pong::packet::server::EnterRoomResponse::Okay) {
+            state = pong::packet::SubState::Room_New;
+        } else {
+            forget_room(entering_room);
+            state = pong::packet::SubState::Lobby_RegularUser;
+            next_action = now + draw(behavior.think);
+        }
+    }
+
+
+    void handle(pong::packet::server::MatchFound const&) {
+        respond(Request::LeaveMatchmaking);
+        stats.record_match(now - match_search_start);
+
+        matched = true;
+        state = pong::packet::SubState::Room_New;
+        next_action = clock::time_point::max();
+    }
+
+
+    void handle(pong::packet::server::LeftMatchmaking const&) {
+        respond(Request::LeaveMatchmaking);
+        state = pong::packet::SubState::Lobby_RegularUser;
+        next_action = now + draw(behavior.think);
+    }
+
+
+    void handle(pong::packet::server::RoomInfo const&) {
+        if (state == pong::packet::SubState::Room_New && matched) {
+            matched = false;
+            state = pong::packet::SubState::Room_Queued;
+            next_action = now + draw(behavior.queue_patience);
+        } else if (state == pong::packet::SubState::Room_New) {
+            state = pong::packet::SubState::Room_Spectator;
+            next_action = now + draw(behavior.spectate);
+        }
+    }
+
+
+    void handle(pong::packet::server::LeaveRoomResponse const&) {
+        respond(Request::LeaveRoom);
+        state = pong::packet::SubState::Lobby_New;
+    }
+
+
+    void handle(pong::packet::server::BeNextPlayer const&) {
+        state = pong::packet::SubState::Room_AcceptingBePlayer;
+        next_action = now + draw(behavior.reaction);
+    }
+
+
+    void handle(pong::packet::server::DeniedBePlayer const&) {
+        respond(Request::AcceptBePlayer);
+        state = pong::packet::SubState::Room_Spectator;
+        next_action = now + draw(behavior.spectate);
+    }
+
+
+    void handle(pong::packet::server::BePlayer const&) {
+        respond(Request::AcceptBePlayer);
+        state = pong::packet::SubState::Room_Player;
+        game_end = now + draw(behavior.game);
+        next_action = now + draw(behavior.input);
+    }
+
+
+    void handle(pong::packet::server::GameOver const&) {
+        // The other player abandoned, the server puts the remaining player back in the queue
+        if (state == pong::packet::SubState::Room_Player) {
+            state = pong::packet::SubState::Room_Queued;
+            next_action = now + draw(behavior.queue_patience);
+        }
+    }
+
+};
+
+}
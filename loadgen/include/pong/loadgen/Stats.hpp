@@ -0,0 +1,210 @@
+#pragma once
+
+#include <pong/packet/Client.hpp>
+#include <pong/packet/Server.hpp>
+#include <pong/packet/State.hpp>
+
+#include <pong/server/HdrHistogram.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+namespace pong::loadgen {
+
+using pong::server::HdrHistogram;
+
+
+/*
+    Requests of a bot answered by a single packet of the server, see `Bot::request` and `Bot::respond`
+*/
+enum class Request : std::uint8_t {
+    ChangeUsername,     // ChangeUsernameResponse
+    CreateRoom,         // CreateRoomResponse
+    EnterRoom,          // EnterRoomResponse
+    LeaveRoom,          // LeaveRoomResponse
+    AcceptBePlayer,     // BePlayer or DeniedBePlayer
+    LeaveMatchmaking    // LeftMatchmaking or MatchFound
+};
+
+static constexpr std::size_t number_of_request{ 6 };
+
+static constexpr std::array<char const*, number_of_request> request_names{
+    "ChangeUsername", "CreateRoom", "EnterRoom", "LeaveRoom", "AcceptBePlayer", "LeaveMatchmaking"
+};
+
+
+/*
+    What the bots of a thread measured, merged into a single Stats for the report
+    The durations are in nanoseconds
+*/
+struct Stats {
+
+    static constexpr std::size_t number_of_client_packet{ std::variant_size_v<pong::packet::client::Any> };
+    static constexpr std::size_t number_of_server_packet{ std::variant_size_v<pong::packet::server::Any> };
+
+
+    HdrHistogram connect_latency;
+    std::array<HdrHistogram, number_of_request> response_times;
+    // From `FindMatch` to `MatchFound`
+    HdrHistogram time_to_match;
+
+    std::uint64_t connections{ 0 };
+    std::uint64_t failed_connections{ 0 };
+    // Closed by the server, or after a protocol error
+    std::uint64_t disconnections{ 0 };
+    // `Redirect` to another server of the federation, followed by a new connection
+    std::uint64_t redirections{ 0 };
+    // Requests without a response after `Bot::response_timeout`
+    std::array<std::uint64_t, number_of_request> timeouts{};
+
+    // Packets received in a sub-state where they aren't expected, see State.hpp
+    std::map<std::pair<pong::packet::SubState, std::string_view>, std::uint64_t> unexpected_packets;
+    std::map<pong::packet::DecodeError, std::uint64_t> decode_errors;
+    std::uint64_t refused_usernames{ 0 };
+
+    std::array<std::uint64_t, number_of_client_packet> packets_sent{};
+    std::array<std::uint64_t, number_of_server_packet> packets_received{};
+    std::uint64_t bytes_sent{ 0 };
+    std::uint64_t bytes_received{ 0 };
+
+
+    void record_connection(std::chrono::nanoseconds latency) {
+        ++connections;
+        connect_latency.record(static_cast<std::uint64_t>(latency.count()));
+    }
+
+
+    void record_response(Request request, std::chrono::nanoseconds time) {
+        response_times[static_cast<std::size_t>(request)].record(static_cast<std::uint64_t>(time.count()));
+    }
+
+
+    void record_match(std::chrono::nanoseconds time) {
+        time_to_match.record(static_cast<std::uint64_t>(time.count()));
+    }
+
+
+    void record_timeout(Request request) {
+        ++timeouts[static_cast<std::size_t>(request)];
+    }
+
+
+    void record_unexpected(pong::packet::SubState state, std::string_view packet_name) {
+        ++unexpected_packets[{ state, packet_name }];
+    }
+
+
+    void merge(Stats const& other) {
+        connect_latency.merge(other.connect_latency);
+        for(std::size_t i{ 0 }; i < number_of_request; ++i) {
+            response_times[i].merge(other.response_times[i]);
+            timeouts[i] += other.timeouts[i];
+        }
+        time_to_match.merge(other.time_to_match);
+
+        connections += other.connections;
+        failed_connections += other.failed_connections;
+        disconnections += other.disconnections;
+        redirections += other.redirections;
+
+        for(auto const& [key, count] : other.unexpected_packets) {
+            unexpected_packets[key] += count;
+        }
+        for(auto const& [error, count] : other.decode_errors) {
+            decode_errors[error] += count;
+        }
+        refused_usernames += other.refused_usernames;
+
+        for(std::size_t i{ 0 }; i < number_of_client_packet; ++i) {
+            packets_sent[i] += other.packets_sent[i];
+        }
+        for(std::size_t i{ 0 }; i < number_of_server_packet; ++i) {
+            packets_received[i] += other.packets_received[i];
+        }
+        bytes_sent += other.bytes_sent;
+        bytes_received += other.bytes_received;
+    }
+
+
+    void report(std::ostream& os, std::chrono::duration<double> elapsed) const {
+        auto ms = [] (std::uint64_t ns) { return static_cast<double>(ns) / 1e6; };
+        auto write = [&os, &ms] (char const* name, HdrHistogram const& histogram) {
+            os << "  " << name << ": " << histogram.count() << ", p50 " << ms(histogram.value_at(0.5))
+                << " ms, p99 " << ms(histogram.value_at(0.99)) << " ms, p99.9 " << ms(histogram.value_at(0.999))
+                << " ms, max " << ms(histogram.maximum()) << " ms\n";
+        };
+        auto per_second = [&elapsed] (std::uint64_t count) { return static_cast<double>(count) / elapsed.count(); };
+
+
+        os << "Connections: " << connections << ", " << failed_connections << " failed, " << disconnections << " lost, " << redirections << " redirected\n";
+        write("Connect", connect_latency);
+
+        os << "Response times:\n";
+        for(std::size_t i{ 0 }; i < number_of_request; ++i) {
+            write(request_names[i], response_times[i]);
+        }
+
+        os << "Matchmaking:\n";
+        write("Time to match", time_to_match);
+
+
+        os << "Traffic: " << per_second(bytes_sent) << " B/s sent, " << per_second(bytes_received) << " B/s received\n";
+        write_packets<pong::packet::client::Any>(os, "  Sent/s:", packets_sent, per_second);
+        write_packets<pong::packet::server::Any>(os, "  Received/s:", packets_received, per_second);
+
+
+        std::uint64_t violations{ refused_usernames };
+        for(auto count : timeouts) {
+            violations += count;
+        }
+        for(auto const& [key, count] : unexpected_packets) {
+            violations += count;
+        }
+        for(auto const& [error, count] : decode_errors) {
+            violations += count;
+        }
+
+        os << "Protocol violations: " << violations << '\n';
+        for(std::size_t i{ 0 }; i < number_of_request; ++i) {
+            if (timeouts[i] != 0) {
+                os << "  " << request_names[i] << " without response: " << timeouts[i] << '\n';
+            }
+        }
+        for(auto const& [key, count] : unexpected_packets) {
+            os << "  " << key.second << " received in " << pong::packet::to_string_view(key.first) << ": " << count << '\n';
+        }
+        for(auto const& [error, count] : decode_errors) {
+            os << "  Frames not decoded (" << pong::packet::to_string(error) << "): " << count << '\n';
+        }
+        if (refused_usernames != 0) {
+            os << "  Refused usernames: " << refused_usernames << '\n';
+        }
+    }
+
+
+private:
+
+
+    template<typename Any, std::size_t N, typename F>
+    static void write_packets(std::ostream& os, char const* title, std::array<std::uint64_t, N> const& counts, F&& per_second) {
+        write_packets<Any>(os, title, counts, per_second, std::make_index_sequence<N>{});
+    }
+
+
+    template<typename Any, std::size_t N, typename F, std::size_t...Is>
+    static void write_packets(std::ostream& os, char const* title, std::array<std::uint64_t, N> const& counts, F&& per_second, std::index_sequence<Is...>) {
+        os << title;
+        ((counts[Is] != 0 ? void(os << ' ' << std::variant_alternative_t<Is, Any>::name << ' ' << per_second(counts[Is])) : void()), ...);
+        os << '\n';
+    }
+
+};
+
+}
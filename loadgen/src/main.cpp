@@ -0,0 +1,154 @@
+#include <SFML/Network.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pong/loadgen/Bot.hpp>
+#include <pong/loadgen/Stats.hpp>
+
+/*
+    Swarm of headless bots playing on a server through the real protocol
+
+    The bots are split between the threads, each thread connects its bots at its share of `--ramp`
+    and updates them every `update_period` until the end of the run.
+    The connect latency, the response times per request and the protocol violations are reported at the end.
+    A response is seen on the update following its arrival, the response times are known within `update_period`
+    Build with `make`, run against a server started with `make run` in server/
+*/
+
+namespace {
+
+using clock_type = pong::loadgen::Bot::clock;
+
+static constexpr std::chrono::milliseconds update_period{ 1 };
+static constexpr std::chrono::seconds progress_period{ 5 };
+
+
+struct Options {
+    std::size_t clients{ 1000 };
+    std::size_t threads{ 4 };
+    std::chrono::seconds duration{ 60 };
+    std::string host{ "127.0.0.1" };
+    unsigned short port{ 48624 };
+    // New connections per second, for all the threads
+    double ramp{ 500. };
+    sf::Uint32 capabilities{ 0 };
+};
+
+
+void run_bots(std::size_t thread, Options const& options, pong::loadgen::Behavior const& behavior, pong::loadgen::Stats& stats,
+    clock_type::time_point start, std::atomic<std::size_t>& online) {
+
+    // Bots `thread`, `thread + threads`, ... so that the threads ramp up together
+    std::vector<std::unique_ptr<pong::loadgen::Bot>> bots;
+    for(std::size_t number{ thread }; number < options.clients; number += options.threads) {
+        bots.push_back(std::make_unique<pong::loadgen::Bot>(number, behavior, stats, options.capabilities));
+    }
+
+
+    sf::IpAddress address{ options.host };
+    auto end = start + options.duration;
+    std::size_t connected{ 0 };
+
+    for(auto now = clock_type::now(); now < end; now = clock_type::now()) {
+        auto elapsed = std::chrono::duration<double>(now - start).count();
+        auto due = std::min(bots.size(), static_cast<std::size_t>(elapsed * options.ramp / static_cast<double>(options.threads)) + 1);
+
+        for(; connected < due; ++connected) {
+            if (bots[connected]->connect(address, options.port, sf::seconds(5.f))) {
+                ++online;
+            }
+        }
+
+
+        now = clock_type::now();
+        for(std::size_t i{ 0 }; i < connected; ++i) {
+            auto& bot = *bots[i];
+            if (bot.is_connected()) {
+                bot.update(now);
+                if (!bot.is_connected()) {
+                    --online;
+                }
+            }
+        }
+
+        std::this_thread::sleep_for(update_period);
+    }
+}
+
+}
+
+
+/*
+    --clients <n>: number of bots (1000)
+    --threads <n>: threads updating the bots (4)
+    --duration <seconds>: length of the run (60)
+    --host <address>, --port <port>: the server (127.0.0.1:48624)
+    --ramp <n>: connections per second (500)
+    --compact: negotiate `Encoding::Compact`
+    --compressed: negotiate the compressed frames
+*/
+int main(int argc, char** argv) {
+    Options options;
+    for(int i{ 1 }; i < argc; ++i) {
+        auto has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--clients") == 0 && has_value) {
+            options.clients = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && has_value) {
+            options.threads = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--duration") == 0 && has_value) {
+            options.duration = std::chrono::seconds{ std::strtol(argv[++i], nullptr, 10) };
+        } else if (std::strcmp(argv[i], "--host") == 0 && has_value) {
+            options.host = argv[++i];
+        } else if (std::strcmp(argv[i], "--port") == 0 && has_value) {
+            options.port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--ramp") == 0 && has_value) {
+            options.ramp = std::max(1., std::strtod(argv[++i], nullptr));
+        } else if (std::strcmp(argv[i], "--compact") == 0) {
+            options.capabilities |= pong::packet::CompactEncoding;
+        } else if (std::strcmp(argv[i], "--compressed") == 0) {
+            options.capabilities |= pong::packet::CompressedFrames;
+        } else {
+            std::cerr << "[Warning] Unknown argument: " << argv[i] << '\n';
+        }
+    }
+
+    std::cout << options.clients << " bots on " << options.threads << " threads for " << options.duration.count()
+        << " s, against " << options.host << ':' << options.port << std::endl;
+
+
+    pong::loadgen::Behavior behavior;
+    std::vector<pong::loadgen::Stats> stats(options.threads);
+    std::atomic<std::size_t> online{ 0 };
+    auto start = clock_type::now();
+
+    std::vector<std::thread> threads;
+    for(std::size_t thread{ 0 }; thread < options.threads; ++thread) {
+        threads.emplace_back(run_bots, thread, std::cref(options), std::cref(behavior), std::ref(stats[thread]), start, std::ref(online));
+    }
+
+    for(auto now = clock_type::now(); now < start + options.duration; now = clock_type::now()) {
+        std::this_thread::sleep_for(std::min<clock_type::duration>(progress_period, start + options.duration - now));
+        std::cout << std::chrono::duration_cast<std::chrono::seconds>(clock_type::now() - start).count() << " s: "
+            << online << " bots connected" << std::endl;
+    }
+
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+
+    pong::loadgen::Stats total;
+    for(auto const& thread_stats : stats) {
+        total.merge(thread_stats);
+    }
+
+    total.report(std::cout, clock_type::now() - start);
+}
@@ -1,28 +1,26 @@
 #pragma once
 
-#include<numeric>
-
-namespace pong::server {
-
-using user_t = std::string;
-
-template<typename...Ts>
-sf::Packet to_packet(Ts&&... ts) {
-    sf::Packet p;
-    (p << ... << ts);
-    return p;
-}
-
-template<typename T>
-T from_packet(sf::Packet& p) {
-    T t;
-    p >> t;
-    return t;
-}
+#include <SFML/Network.hpp>
 
+#include <pong/packet/Encoding.hpp>
 
+#include <pong/server/InputBuffer.hpp>
+#include <pong/server/OutputBuffer.hpp>
+#include <pong/server/TcpSocket.hpp>
+#include <pong/server/Username.hpp>
 
+#include<numeric>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
 
+namespace pong::server {
 
 #define make_getter(C, F) getter<C, decltype(C::F), &C::F>
 
@@ -34,17 +32,102 @@ T& getter(C& c) {
 
 
 
-using user_id_t = std::uintptr_t;
+using user_id_t = std::uint64_t;
 constexpr user_id_t invalid_user_id = 0;
 using user_handle_t = std::size_t;
 constexpr user_handle_t invalid_user_handle = std::numeric_limits<std::size_t>::max();
 
+using room_id_t = unsigned;
+
 
 
 
+/*
+    Window of room ids a lobby user is interested in, [min, max_excluded)
+*/
+struct RoomRange {
+    unsigned min;
+    unsigned max_excluded;
+
+    constexpr bool contains(unsigned room_id) const {
+        return room_id >= min && room_id < max_excluded;
+    }
+};
+
+
+
+
+
+/*
+    Messages queued and writes made to the sockets, since the start of the server
+    With the messages bundled per tick, `sends` grows with the number of sockets and not of messages
+    `syscalls` are the ones made by the transport to receive and send
+*/
+struct TrafficCounters {
+    std::size_t messages{ 0 };
+    std::size_t sends{ 0 };
+    std::size_t bytes_sent{ 0 };
+    std::size_t syscalls{ 0 };
+};
+
+
+/*
+    Frames compressed for the users that negotiated it, see `StateBase::send_with`
+    `bytes_in` and `bytes_out` are the sizes of the frames before and after, `time` the CPU spent compressing
+*/
+struct CompressionCounters {
+    std::size_t frames{ 0 };
+    std::size_t bytes_in{ 0 };
+    std::size_t bytes_out{ 0 };
+    std::chrono::nanoseconds time{ 0 };
+};
+
+
+
+
+
+/*
+    Place of a user in a UserQueue, a user waits in one queue at most
+    `queue` is the queue it's in, nullptr when it isn't waiting
+*/
+struct QueueLink {
+    void const* queue{ nullptr };
+    user_id_t previous{ invalid_user_id };
+    user_id_t next{ invalid_user_id };
+};
+
+
+
+
+
+/*
+    Session of a connected user, owned by the UserRegistry
+*/
 struct User {
-    std::unique_ptr<sf::TcpSocket> socket;
-    std::vector<sf::Packet> packets {};
+    std::unique_ptr<TcpSocket> socket;
+    InputBuffer input {};
+    OutputBuffer output {};
+    KnownNames known_names {};
+    Username username {};
+
+    // State the user is member of, and its handle in that state
+    void const* state { nullptr };
+    user_handle_t handle { invalid_user_handle };
+
+    // Set by the transport when the connection failed, the state removes the user
+    bool disconnected { false };
+
+    // The client decompresses large frames, see `client::Capabilities`
+    bool compressed_frames { false };
+
+    // Encoding of the frames after `client::Capabilities`, both ways
+    pong::packet::Encoding encoding { pong::packet::Encoding::Sfml };
+
+    // Pending output bytes already written to the capture, see `UserRegistry::flush`
+    std::size_t captured_output { 0 };
+
+    // Queue the user waits in (the queue of its room, the matchmaking), see UserQueue.hpp
+    QueueLink queue_link {};
 };
 
 
@@ -67,7 +150,22 @@ struct UserData<void> {
 
 
 struct Idle {};
-using Leave = std::function<void()>;
+
+/*
+    Move of a user to another state, queued in the TransitionQueue and executed once every state received its packets
+    The target state and the arguments of its `create` are stored inline, so no allocation is made
+*/
+struct Leave {
+    static constexpr std::size_t max_payload_size{ 16 };
+
+    using enter_t = void (*)(void* state, user_id_t id, std::byte const* payload);
+
+    void* state;
+    user_id_t user;
+    enter_t enter;
+    std::array<std::byte, max_payload_size> payload;
+};
+
 struct Abord {}; 
 
 
@@ -83,6 +181,9 @@ using decltype_on_user_leave = decltype(&S::on_user_leave);
 template<typename S>
 using decltype_on_user_enter = decltype(&S::on_user_enter); 
 
+template<typename S>
+using decltype_on_empty = decltype(&S::on_empty);
+
 
 
 
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/MainLobby.hpp>
+#include <pong/server/FederationDirectory.hpp>
+#include <pong/server/FederationConnection.hpp>
+
+#include <pong/packet/Federation.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Coordinator of a federation of servers
+
+    The coordinator cuts the room slots in ranges of `slots_per_node` and gives one to each server joining,
+    so the ids of the rooms are unique across the federation. It keeps the rooms and the load of each server,
+    forwards them to the others, and chooses the server where the new rooms are created: the one with the least users,
+    changed only when another has `placement_margin` users less, so that the users creating rooms together meet.
+    No game traffic goes through it, a server that loses it goes on alone
+
+    A server that lost the coordinator joins again with its range (see FederationLink), so the range of a lost server
+    isn't given to a new one for `reservation_period`. The coordinator doesn't know the ranges used before it started:
+    for the same period, the new servers wait for the ones joining again
+*/
+struct Coordinator {
+
+    using clock = std::chrono::steady_clock;
+
+    static constexpr unsigned placement_margin{ 8 };
+    // Far above the reconnection period of the servers, below the time they wait for `Welcome`
+    static constexpr std::chrono::seconds reservation_period{ 6 };
+
+
+    Coordinator(unsigned _slots_per_node)
+    :   slots_per_node{ _slots_per_node }
+    ,   new_nodes_from{ clock::now() + reservation_period } {}
+
+
+    void accept(std::unique_ptr<sf::TcpSocket> socket) {
+        auto& node = nodes.emplace_back(std::make_unique<Node>());
+        node->connection.adopt(std::move(socket));
+    }
+
+
+    void update() {
+        auto now = clock::now();
+        reservations.erase(std::remove_if(std::begin(reservations), std::end(reservations), [now] (auto const& reservation) {
+            return reservation.until <= now;
+        }), std::end(reservations));
+
+        if (now >= new_nodes_from) {
+            for(auto& node : nodes) {
+                if (auto join = std::exchange(node->waiting_join, std::nullopt)) {
+                    on_join(*node, *join);
+                }
+            }
+        }
+
+        for(std::size_t index{ 0 }; index < nodes.size(); ++index) {
+            auto& node = *nodes[index];
+            node.connection.receive([this, &node] (pong::packet::federation::Any const& any_packet) {
+                std::visit([this, &node] (auto const& packet) { on_node(node, packet); }, any_packet);
+            });
+        }
+
+        remove_lost_nodes();
+        update_placement();
+
+        for(auto& node : nodes) {
+            node->connection.flush();
+        }
+    }
+
+
+    std::size_t number_of_node() const {
+        return nodes.size();
+    }
+
+
+private:
+
+    struct Node {
+        FederationConnection connection;
+        // no_node until `Join`
+        node_id_t id{ pong::packet::federation::no_node };
+
+        std::string address;
+        sf::Uint16 port{ 0 };
+        unsigned first_slot{ 0 };
+        unsigned slot_count{ 0 };
+
+        pong::packet::federation::Load load{};
+        std::map<room_id_t, pong::packet::server::RoomSummary> rooms;
+
+        // `Join` of a new server received before `new_nodes_from`
+        std::optional<pong::packet::federation::Join> waiting_join;
+
+
+        bool has_joined() const {
+            return id != pong::packet::federation::no_node;
+        }
+
+        pong::packet::federation::NodeInfo info() const {
+            return { id, address, port, first_slot, slot_count };
+        }
+    };
+
+
+    template<typename P>
+    void send_to_others(Node const& from, P const& packet) {
+        for(auto& node : nodes) {
+            if (node.get() != &from && node->has_joined()) {
+                node->connection.send(packet);
+            }
+        }
+    }
+
+
+    /*
+        Range of a server that left, kept for it until `until`
+    */
+    struct Reservation {
+        unsigned first_slot;
+        unsigned slot_count;
+        clock::time_point until;
+    };
+
+
+    static bool overlap(unsigned first_slot, unsigned slot_count, unsigned other_first_slot, unsigned other_slot_count) {
+        return first_slot < other_first_slot + other_slot_count && other_first_slot < first_slot + slot_count;
+    }
+
+
+    // The reserved ranges are only free for the servers joining again
+    bool is_range_free(unsigned first_slot, unsigned slot_count, bool reserved_ones) const {
+        if (slot_count == 0 || first_slot + std::size_t{ slot_count } > RoomRegistry::max_number_of_room) {
+            return false;
+        }
+
+        auto is_taken = std::any_of(std::begin(nodes), std::end(nodes), [first_slot, slot_count] (auto const& node) {
+            return node->has_joined() && overlap(first_slot, slot_count, node->first_slot, node->slot_count);
+        });
+        auto is_reserved = std::any_of(std::begin(reservations), std::end(reservations), [first_slot, slot_count] (auto const& reservation) {
+            return overlap(first_slot, slot_count, reservation.first_slot, reservation.slot_count);
+        });
+
+        return !is_taken && (reserved_ones || !is_reserved);
+    }
+
+
+    // Packets of the servers
+
+    void on_node(Node& node, pong::packet::federation::Join const& packet) {
+        if (node.has_joined() || node.waiting_join) {
+            std::cerr << "[Warning] Node #" << node.id << " joined twice\n";
+            return node.connection.disconnect();
+        }
+
+        // The servers that used a range before the start of the coordinator may not be back yet
+        if (packet.slot_count == 0 && clock::now() < new_nodes_from) {
+            node.waiting_join = packet;
+            return;
+        }
+
+        on_join(node, packet);
+    }
+
+
+    void on_join(Node& node, pong::packet::federation::Join const& packet) {
+        // A server joining again keeps its range, a new one takes the first range free and not reserved
+        auto first_slot = packet.first_slot;
+        auto slot_count = packet.slot_count;
+        auto joins_again = slot_count != 0;
+        if (!joins_again) {
+            first_slot = 0;
+            slot_count = slots_per_node;
+            while(first_slot + std::size_t{ slot_count } <= RoomRegistry::max_number_of_room && !is_range_free(first_slot, slot_count, false)) {
+                first_slot += slot_count;
+            }
+        }
+
+        if (!is_range_free(first_slot, slot_count, joins_again)) {
+            std::cerr << "[Warning] No range of slots for " << packet.address << ':' << packet.port << '\n';
+            return node.connection.disconnect();
+        }
+
+        reservations.erase(std::remove_if(std::begin(reservations), std::end(reservations), [first_slot, slot_count] (auto const& reservation) {
+            return overlap(first_slot, slot_count, reservation.first_slot, reservation.slot_count);
+        }), std::end(reservations));
+
+        node.id = next_node_id++;
+        node.address = packet.address;
+        node.port = packet.port;
+        node.first_slot = first_slot;
+        node.slot_count = slot_count;
+        node.load.node = node.id;
+
+        std::cout << "Node #" << node.id << " " << node.address << ':' << node.port << " joined with the slots ["
+            << first_slot << ", " << first_slot + slot_count << ")" << std::endl;
+
+        node.connection.send(pong::packet::federation::Welcome{ node.id, first_slot, slot_count });
+        for(auto const& other : nodes) {
+            if (other.get() != &node && other->has_joined()) {
+                node.connection.send(other->info());
+                node.connection.send(other->load);
+                for(auto const& [id, summary] : other->rooms) {
+                    node.connection.send(pong::packet::federation::RoomUpdate{ summary });
+                }
+            }
+        }
+
+        send_to_others(node, node.info());
+
+        if (placement != pong::packet::federation::no_node) {
+            node.connection.send(pong::packet::federation::Placement{ placement });
+        }
+    }
+
+
+    void on_node(Node& node, pong::packet::federation::Load const& packet) {
+        if (node.has_joined()) {
+            node.load = packet;
+            node.load.node = node.id;
+            send_to_others(node, node.load);
+        }
+    }
+
+
+    void on_node(Node& node, pong::packet::federation::RoomUpdate const& packet) {
+        auto slot = RoomRegistry::index_of(packet.summary.id);
+        if (!node.has_joined() || slot < node.first_slot || slot - node.first_slot >= node.slot_count) {
+            std::cerr << "[Warning] Node #" << node.id << " updated the room #" << packet.summary.id << " it doesn't own\n";
+            return node.connection.disconnect();
+        }
+
+        node.rooms[packet.summary.id] = packet.summary;
+        send_to_others(node, packet);
+    }
+
+
+    void on_node(Node& node, pong::packet::federation::OldRoom const& packet) {
+        if (node.rooms.erase(packet.id) != 0) {
+            send_to_others(node, packet);
+        }
+    }
+
+
+    template<typename P>
+    void on_node(Node& node, P const&) {
+        std::cerr << "[Warning] Received " << P::name << " from a server\n";
+        node.connection.disconnect();
+    }
+
+
+    void remove_lost_nodes() {
+        for(auto& node : nodes) {
+            if (!node->connection.is_connected() && node->has_joined()) {
+                std::cout << "Node #" << node->id << " left" << std::endl;
+                // The servers forget the rooms of the node with it
+                send_to_others(*node, pong::packet::federation::OldNode{ node->id });
+                reservations.push_back({ node->first_slot, node->slot_count, clock::now() + reservation_period });
+            }
+        }
+
+        nodes.erase(std::remove_if(std::begin(nodes), std::end(nodes), [] (auto const& node) {
+            return !node->connection.is_connected();
+        }), std::end(nodes));
+    }
+
+
+    void update_placement() {
+        Node const* best{ nullptr };
+        Node const* current{ nullptr };
+        for(auto const& node : nodes) {
+            if (!node->has_joined()) {
+                continue;
+            }
+
+            if (!best || node->load.users < best->load.users) {
+                best = node.get();
+            }
+            if (node->id == placement) {
+                current = node.get();
+            }
+        }
+
+        if (!best || (current && current->load.users < best->load.users + placement_margin)) {
+            return;
+        }
+
+        placement = best->id;
+        std::cout << "New rooms are created on node #" << placement << std::endl;
+
+        for(auto& node : nodes) {
+            if (node->has_joined()) {
+                node->connection.send(pong::packet::federation::Placement{ placement });
+            }
+        }
+    }
+
+
+    unsigned slots_per_node;
+    std::vector<std::unique_ptr<Node>> nodes;
+    node_id_t next_node_id{ 1 };
+    node_id_t placement{ pong::packet::federation::no_node };
+
+    std::vector<Reservation> reservations;
+    // Before it, the new servers wait in `waiting_join`
+    clock::time_point new_nodes_from;
+
+};
+
+}
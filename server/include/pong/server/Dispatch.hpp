@@ -0,0 +1,103 @@
+#pragma once
+
+#include <pong/packet/Client.hpp>
+
+#include <pong/server/Common.hpp>
+
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+#include <variant>
+
+namespace pong::server {
+
+/*
+    Type a receiver `Action (C::*)(user_handle_t, T const&)` takes the packet as
+*/
+template<typename F>
+struct ReceivedType;
+
+template<typename C, typename T>
+struct ReceivedType<Action (C::*)(user_handle_t, T const&)> {
+    using type = T;
+};
+
+
+/*
+    A packet is received as itself, or as a view of it decoded in place (`T::packet_t` being the packet)
+*/
+template<typename T, typename P, typename = void>
+struct IsReceivedAs : std::is_same<T, P> {};
+
+template<typename T, typename P>
+struct IsReceivedAs<T, P, std::void_t<typename T::packet_t>> : std::is_same<typename T::packet_t, P> {};
+
+
+/*
+    Receiver `F` of the client packet `P`, a member function `Action (user_handle_t, P const&)`
+    A state lists its receivers in a `handlers` member type:
+
+        using handlers = Handlers<
+            Handler<pong::packet::client::CreateRoom, &MainLobbyState::on_create_room>,
+            ...
+        >;
+
+    The receiver can take a view of the packet instead, e.g. `client::ChangeUsernameView` for `client::ChangeUsername`
+*/
+template<typename P, auto F>
+struct Handler {
+    using packet_t = P;
+    using received_t = typename ReceivedType<decltype(F)>::type;
+
+    static_assert(IsReceivedAs<received_t, P>::value, "The receiver must take the packet, or a view of it");
+
+    static constexpr auto function = F;
+};
+
+template<typename...Hs>
+struct Handlers {};
+
+
+
+static constexpr std::size_t number_of_client_packet{ std::variant_size_v<pong::packet::client::Any> };
+
+
+/*
+    Decode the packet of the handler H from the rest of the frame, then call its receiver
+    A malformed packet ends the session of the user
+*/
+template<typename C, typename H>
+Action receive(C& state, user_handle_t handle, pong::packet::details::Reader& reader) {
+    typename H::received_t packet;
+    pong::packet::details::decode_fields(reader, packet);
+
+    if (auto error = reader.finish(); error != pong::packet::DecodeError::None) {
+        std::cerr << "[Warning] Received malformed " << H::packet_t::name << " (" << pong::packet::to_string(error) << ")\n";
+        return Abord{};
+    }
+
+    return (state.*H::function)(handle, packet);
+}
+
+
+/*
+    Table indexed by the id of the client packets (their index in `client::Any`)
+    Packets without receiver have a null entry
+*/
+template<typename C, typename receiver_t, typename...Hs>
+constexpr std::array<receiver_t, number_of_client_packet> make_dispatch_table(Handlers<Hs...>) {
+    std::array<receiver_t, number_of_client_packet> table{};
+
+    auto add = [&table] (std::size_t id, receiver_t receiver) {
+        if (table[id] != nullptr) {
+            throw "Two receivers for the same packet";
+        }
+        table[id] = receiver;
+    };
+
+    (add(pong::packet::client::id_of<typename Hs::packet_t>(), &receive<C, Hs>), ...);
+    return table;
+}
+
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+
+#include <pong/packet/Federation.hpp>
+#include <pong/packet/Encoding.hpp>
+#include <pong/packet/Compression.hpp>
+#include <pong/packet/Reader.hpp>
+#include <pong/packet/Writer.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Connection between a server and the coordinator of its federation, on both ends
+
+    The frames are the ones of the clients, in `Encoding::Compact` and never compressed.
+    The socket is non-blocking once connected (or adopted by the coordinator): the frames are read by `receive`
+    and written by `flush`, once per tick. A frame that can't be decoded closes the connection.
+    A server connecting during its ticks uses `connect_async`, the connection is made by another thread
+*/
+struct FederationConnection {
+
+    static constexpr std::size_t receive_size{ 4096 };
+    // A `RoomUpdate` or a `NodeInfo` is far below
+    static constexpr std::size_t max_frame_size{ 1024 };
+
+
+    FederationConnection() : socket{ std::make_unique<sf::TcpSocket>() } {}
+
+    FederationConnection(FederationConnection const&) = delete;
+    FederationConnection& operator=(FederationConnection const&) = delete;
+
+
+    enum class ConnectStatus {
+        Connected,
+        Connecting,
+        Failed
+    };
+
+
+    /*
+        Blocking connection of a server to its coordinator
+    */
+    bool connect(sf::IpAddress const& address, unsigned short port, sf::Time timeout) {
+        if (socket->connect(address, port, timeout) != sf::Socket::Done) {
+            return false;
+        }
+
+        start();
+        return true;
+    }
+
+
+    /*
+        Connection of a server to its coordinator without blocking, checked by `check_connect`
+    */
+    void connect_async(sf::IpAddress const& address, unsigned short port, sf::Time timeout) {
+        future_socket = std::async(std::launch::async, [address, port, timeout] () -> std::unique_ptr<sf::TcpSocket> {
+            auto new_socket = std::make_unique<sf::TcpSocket>();
+            if (new_socket->connect(address, port, timeout) != sf::Socket::Done) {
+                return nullptr;
+            }
+            return new_socket;
+        });
+    }
+
+
+    bool is_connecting() const {
+        return future_socket.valid();
+    }
+
+
+    ConnectStatus check_connect() {
+        if (!future_socket.valid() || future_socket.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready) {
+            return ConnectStatus::Connecting;
+        }
+
+        auto new_socket = future_socket.get();
+        if (!new_socket) {
+            return ConnectStatus::Failed;
+        }
+
+        adopt(std::move(new_socket));
+        return ConnectStatus::Connected;
+    }
+
+
+    /*
+        Connection accepted by the coordinator
+    */
+    void adopt(std::unique_ptr<sf::TcpSocket> _socket) {
+        socket = std::move(_socket);
+        start();
+    }
+
+
+    bool is_connected() const {
+        return connected;
+    }
+
+
+    void disconnect() {
+        if (connected) {
+            socket->disconnect();
+            connected = false;
+        }
+    }
+
+
+    template<typename P>
+    void send(P const& federation_packet) {
+        auto size = pong::packet::details::frame_size(federation_packet, pong::packet::Encoding::Compact);
+        auto offset = output_buffer.size();
+        output_buffer.resize(offset + size);
+
+        pong::packet::details::Writer writer{ output_buffer.data() + offset, pong::packet::Encoding::Compact };
+        pong::packet::details::write_frame(writer, pong::packet::federation::id_of<P>(), federation_packet);
+    }
+
+
+    void send(pong::packet::federation::Any const& any_packet) {
+        std::visit([this] (auto const& federation_packet) { send(federation_packet); }, any_packet);
+    }
+
+
+    /*
+        Call `on_packet(pong::packet::federation::Any const&)` with each packet received since the last call
+    */
+    template<typename F>
+    void receive(F&& on_packet) {
+        while(connected) {
+            auto offset = input_buffer.size();
+            input_buffer.resize(offset + receive_size);
+
+            std::size_t received{ 0 };
+            auto status = socket->receive(input_buffer.data() + offset, receive_size, received);
+            input_buffer.resize(offset + received);
+
+            if (status == sf::Socket::NotReady) {
+                break;
+            }
+            if (status != sf::Socket::Done) {
+                disconnect();
+                break;
+            }
+        }
+
+
+        std::size_t position{ 0 };
+        while(input_buffer.size() - position >= sizeof(sf::Uint32)) {
+            pong::packet::details::Reader header{ input_buffer.data() + position, sizeof(sf::Uint32) };
+            sf::Uint32 size;
+            header >> size;
+
+            if (size > max_frame_size) {
+                std::cerr << "[Warning] Received a federation frame of " << size << " bytes\n";
+                disconnect();
+                break;
+            }
+            if (input_buffer.size() - position - sizeof(sf::Uint32) < size) {
+                break;
+            }
+
+            auto error = pong::packet::federation::decode(input_buffer.data() + position + sizeof(sf::Uint32), size, packet);
+            position += sizeof(sf::Uint32) + size;
+
+            if (error != pong::packet::DecodeError::None) {
+                std::cerr << "[Warning] Can't decode a federation frame\n";
+                disconnect();
+                break;
+            }
+
+            on_packet(static_cast<pong::packet::federation::Any const&>(packet));
+        }
+
+        input_buffer.erase(std::begin(input_buffer), std::begin(input_buffer) + static_cast<std::ptrdiff_t>(position));
+        if (!connected) {
+            input_buffer.clear();
+        }
+    }
+
+
+    void flush() {
+        std::size_t written{ 0 };
+        while(connected && written < output_buffer.size()) {
+            std::size_t sent{ 0 };
+            auto status = socket->send(output_buffer.data() + written, output_buffer.size() - written, sent);
+            written += sent;
+
+            if (status == sf::Socket::Partial || status == sf::Socket::NotReady) {
+                break;
+            }
+            if (status != sf::Socket::Done) {
+                disconnect();
+                break;
+            }
+        }
+
+        output_buffer.erase(std::begin(output_buffer), std::begin(output_buffer) + static_cast<std::ptrdiff_t>(written));
+    }
+
+
+    sf::IpAddress remote_address() const {
+        return socket->getRemoteAddress();
+    }
+
+
+private:
+
+    void start() {
+        socket->setBlocking(false);
+        connected = true;
+        input_buffer.clear();
+        output_buffer.clear();
+    }
+
+
+    std::unique_ptr<sf::TcpSocket> socket;
+    bool connected{ false };
+    // Valid during `connect_async`
+    std::future<std::unique_ptr<sf::TcpSocket>> future_socket;
+
+    std::vector<std::byte> input_buffer;
+    std::vector<std::byte> output_buffer;
+    pong::packet::federation::Any packet;
+
+};
+
+}
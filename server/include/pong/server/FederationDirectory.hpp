@@ -0,0 +1,101 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/RoomRegistry.hpp>
+
+#include <pong/packet/Federation.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace pong::server {
+
+using node_id_t = pong::packet::federation::node_id_t;
+
+
+/*
+    Another server of the federation, as told by the coordinator
+*/
+struct FederationNode {
+    node_id_t id;
+    std::string address;
+    sf::Uint16 port;
+    std::size_t first_slot;
+    std::size_t slot_count;
+
+    // Last `Load` received
+    unsigned users{ 0 };
+    unsigned lobby_users{ 0 };
+    unsigned rooms{ 0 };
+
+
+    bool owns(room_id_t room_id) const {
+        auto slot = RoomRegistry::index_of(room_id);
+        return slot >= first_slot && slot - first_slot < slot_count;
+    }
+};
+
+
+/*
+    The other servers of the federation, kept by the FederationLink of the server for its MainLobbyState
+*/
+struct FederationDirectory {
+
+    node_id_t self{ pong::packet::federation::no_node };
+    // Where the new rooms are created
+    node_id_t placement{ pong::packet::federation::no_node };
+
+    std::vector<FederationNode> nodes;
+
+
+    FederationNode* find(node_id_t id) {
+        for(auto& node : nodes) {
+            if (node.id == id) {
+                return &node;
+            }
+        }
+
+        return nullptr;
+    }
+
+
+    FederationNode const* find(node_id_t id) const {
+        return const_cast<FederationDirectory*>(this)->find(id);
+    }
+
+
+    /*
+        The server owning the room, nullptr if it's this one or none
+    */
+    FederationNode const* node_of(room_id_t room_id) const {
+        for(auto const& node : nodes) {
+            if (node.owns(room_id)) {
+                return &node;
+            }
+        }
+
+        return nullptr;
+    }
+
+
+    /*
+        The server where the new rooms are created, nullptr if it's this one
+    */
+    FederationNode const* placement_node() const {
+        return placement == self ? nullptr : find(placement);
+    }
+
+
+    unsigned remote_lobby_users() const {
+        unsigned count{ 0 };
+        for(auto const& node : nodes) {
+            count += node.lobby_users;
+        }
+
+        return count;
+    }
+
+};
+
+}
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/MainLobby.hpp>
+#include <pong/server/RoomRegistry.hpp>
+#include <pong/server/UserRegistry.hpp>
+#include <pong/server/FederationDirectory.hpp>
+#include <pong/server/FederationConnection.hpp>
+
+#include <pong/packet/Federation.hpp>
+
+#include <SFML/Network.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <variant>
+
+namespace pong::server {
+
+/*
+    Link of a server to the coordinator of its federation
+
+    `join` is blocking and done before the first client: the server is given its node id and its range of room slots.
+    Then `update` is called once per tick after `MainLobbyState::update_rooms`: it sends the changes of the local rooms
+    and the load of the server, and gives the rooms and the nodes forwarded by the coordinator to the lobby.
+    When the coordinator is lost the rooms of the other servers are forgotten and the server goes on alone,
+    it joins again with its range, the ids of its rooms are kept: the connection is made by another thread, the ticks go on
+    (see `FederationConnection::connect_async`). A server that couldn't join at the start stays alone:
+    its rooms may already use any slot
+*/
+struct FederationLink {
+
+    static constexpr std::chrono::seconds load_period{ 1 };
+    static constexpr std::chrono::seconds reconnection_period{ 2 };
+
+
+    FederationLink(UserRegistry& _users, MainLobbyState& _lobby, RoomRegistry& _rooms, sf::IpAddress _coordinator_address, unsigned short _coordinator_port,
+        std::string _public_address, unsigned short _public_port)
+    :   users{ _users }
+    ,   lobby{ _lobby }
+    ,   rooms{ _rooms }
+    ,   coordinator_address{ _coordinator_address }
+    ,   coordinator_port{ _coordinator_port }
+    ,   public_address{ std::move(_public_address) }
+    ,   public_port{ _public_port } {}
+
+    FederationLink(FederationLink const&) = delete;
+    FederationLink& operator=(FederationLink const&) = delete;
+
+
+    FederationDirectory directory;
+
+
+    /*
+        Connect and wait for `Welcome`, false if the server must run alone
+    */
+    bool join(sf::Time timeout) {
+        if (!connect()) {
+            return false;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds{ timeout.asMicroseconds() };
+        while(connection.is_connected() && directory.self == pong::packet::federation::no_node && std::chrono::steady_clock::now() < deadline) {
+            connection.flush();
+            receive();
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+        }
+
+        if (directory.self == pong::packet::federation::no_node) {
+            std::cerr << "[Warning] The coordinator didn't welcome the server\n";
+            connection.disconnect();
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void update() {
+        auto now = std::chrono::steady_clock::now();
+
+        if (connection.is_connecting()) {
+            auto status = connection.check_connect();
+            if (status == FederationConnection::ConnectStatus::Connected) {
+                on_connected();
+            } else if (status == FederationConnection::ConnectStatus::Failed) {
+                std::cerr << "[Warning] Can't connect to the coordinator " << coordinator_address << ':' << coordinator_port << '\n';
+            }
+        } else if (!connection.is_connected() && has_range() && now - last_connection >= reconnection_period) {
+            last_connection = now;
+            connection.connect_async(coordinator_address, coordinator_port, sf::seconds(2.f));
+        }
+
+        receive();
+
+        if (is_joined()) {
+            for(auto const& change : lobby.federation_outbox) {
+                connection.send(change);
+            }
+
+            if (now - last_load >= load_period) {
+                last_load = now;
+                connection.send(pong::packet::federation::Load{
+                    directory.self,
+                    static_cast<unsigned>(users.number_of_user()),
+                    static_cast<unsigned>(lobby.number_of_user()),
+                    static_cast<unsigned>(rooms.number_of_room())
+                });
+            }
+        }
+
+        lobby.federation_outbox.clear();
+        connection.flush();
+    }
+
+
+    bool is_joined() const {
+        return connection.is_connected() && directory.self != pong::packet::federation::no_node;
+    }
+
+
+private:
+
+    // Blocking, only before the first client
+    bool connect() {
+        last_connection = std::chrono::steady_clock::now();
+
+        if (!connection.connect(coordinator_address, coordinator_port, sf::seconds(2.f))) {
+            std::cerr << "[Warning] Can't connect to the coordinator " << coordinator_address << ':' << coordinator_port << '\n';
+            return false;
+        }
+
+        on_connected();
+        return true;
+    }
+
+
+    void on_connected() {
+        std::cout << "Connected to the coordinator " << coordinator_address << ':' << coordinator_port << std::endl;
+
+        // A server that owned a range asks for it again, its rooms keep their ids
+        connection.send(pong::packet::federation::Join{
+            public_address,
+            public_port,
+            static_cast<unsigned>(has_range() ? rooms.first_assigned_slot() : 0),
+            static_cast<unsigned>(has_range() ? rooms.number_of_assigned_slot() : 0)
+        });
+    }
+
+
+    bool has_range() const {
+        return rooms.number_of_assigned_slot() != RoomRegistry::max_number_of_room;
+    }
+
+
+    void receive() {
+        connection.receive([this] (pong::packet::federation::Any const& any_packet) {
+            std::visit([this] (auto const& packet) { on_coordinator(packet); }, any_packet);
+        });
+
+        if (!connection.is_connected() && directory.self != pong::packet::federation::no_node) {
+            std::cerr << "[Warning] The connection to the coordinator is closed, the server is alone\n";
+            leave();
+        }
+    }
+
+
+    void leave() {
+        directory.self = pong::packet::federation::no_node;
+        directory.placement = pong::packet::federation::no_node;
+        directory.nodes.clear();
+        lobby.remove_remote_rooms_if([] (room_id_t) { return true; });
+    }
+
+
+    // Packets of the coordinator
+
+    void on_coordinator(pong::packet::federation::Welcome const& packet) {
+        if (!has_range()) {
+            rooms.assign_slots(packet.first_slot, packet.slot_count);
+        } else if (packet.first_slot != rooms.first_assigned_slot() || packet.slot_count != rooms.number_of_assigned_slot()) {
+            std::cerr << "[Warning] The coordinator gave another range of slots, the server stays alone\n";
+            return connection.disconnect();
+        }
+
+        directory.self = packet.node;
+        directory.placement = packet.node;
+        std::cout << "Joined the federation as node #" << packet.node << " with the slots ["
+            << packet.first_slot << ", " << packet.first_slot + packet.slot_count << ")" << std::endl;
+
+        // The coordinator forgot the rooms of a server reconnecting
+        for(auto const& summary : lobby.get_room_summaries({ 0, static_cast<unsigned>(RoomRegistry::max_number_of_room) })) {
+            connection.send(pong::packet::federation::RoomUpdate{ summary });
+        }
+    }
+
+
+    void on_coordinator(pong::packet::federation::NodeInfo const& packet) {
+        auto* node = directory.find(packet.node);
+        if (!node) {
+            node = &directory.nodes.emplace_back();
+            node->id = packet.node;
+        }
+
+        node->address = packet.address;
+        node->port = packet.port;
+        node->first_slot = packet.first_slot;
+        node->slot_count = packet.slot_count;
+    }
+
+
+    void on_coordinator(pong::packet::federation::OldNode const& packet) {
+        if (auto const* node = directory.find(packet.node)) {
+            auto old_node = *node;
+            lobby.remove_remote_rooms_if([&old_node] (room_id_t id) { return old_node.owns(id); });
+
+            directory.nodes.erase(directory.nodes.begin() + (node - directory.nodes.data()));
+        }
+    }
+
+
+    void on_coordinator(pong::packet::federation::Load const& packet) {
+        if (auto* node = directory.find(packet.node)) {
+            node->users = packet.users;
+            node->lobby_users = packet.lobby_users;
+            node->rooms = packet.rooms;
+        }
+    }
+
+
+    void on_coordinator(pong::packet::federation::Placement const& packet) {
+        directory.placement = packet.node;
+    }
+
+
+    void on_coordinator(pong::packet::federation::RoomUpdate const& packet) {
+        // Only the rooms of the known servers, a late update of an old server is dropped
+        if (directory.node_of(packet.summary.id)) {
+            lobby.update_remote_room(packet.summary);
+        }
+    }
+
+
+    void on_coordinator(pong::packet::federation::OldRoom const& packet) {
+        lobby.remove_remote_room(packet.id);
+    }
+
+
+    void on_coordinator(pong::packet::federation::Join const&) {
+        std::cerr << "[Warning] Received Join from the coordinator\n";
+    }
+
+
+    UserRegistry& users;
+    MainLobbyState& lobby;
+    RoomRegistry& rooms;
+
+    sf::IpAddress coordinator_address;
+    unsigned short coordinator_port;
+    std::string public_address;
+    unsigned short public_port;
+
+    FederationConnection connection;
+    std::chrono::steady_clock::time_point last_connection{};
+    std::chrono::steady_clock::time_point last_load{};
+
+};
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace pong::server {
+
+/*
+    Values (durations in nanoseconds) in buckets of bounded relative error, as in HdrHistogram:
+    the values below 2^sub_bucket_bits have their own bucket, each power of two above it is split
+    in 2^sub_bucket_bits buckets, so a value is known within 1/2^sub_bucket_bits (3%)
+*/
+struct HdrHistogram {
+
+    static constexpr unsigned sub_bucket_bits{ 5 };
+    static constexpr std::uint64_t sub_bucket_count{ std::uint64_t{ 1 } << sub_bucket_bits };
+    static constexpr std::size_t number_of_bucket{ (64 - sub_bucket_bits + 1) * sub_bucket_count };
+
+
+    static std::size_t index_of(std::uint64_t value) {
+        if (value < sub_bucket_count) {
+            return value;
+        }
+
+        unsigned exponent = std::bit_width(value) - 1;
+        unsigned shift = exponent - sub_bucket_bits;
+        auto sub_bucket = (value >> shift) - sub_bucket_count;
+        return (shift + 1) * sub_bucket_count + sub_bucket;
+    }
+
+
+    /*
+        Middle of the values of the bucket
+    */
+    static std::uint64_t value_of(std::size_t index) {
+        if (index < sub_bucket_count) {
+            return index;
+        }
+
+        auto shift = index / sub_bucket_count - 1;
+        auto sub_bucket = index % sub_bucket_count;
+        auto lowest = (sub_bucket_count + sub_bucket) << shift;
+        return lowest + ((std::uint64_t{ 1 } << shift) >> 1);
+    }
+
+
+    void record(std::uint64_t value) {
+        ++counts[index_of(value)];
+        ++total;
+        max = std::max(max, value);
+    }
+
+
+    /*
+        Value under which `quantile` (in [0, 1]) of the recorded values are
+    */
+    std::uint64_t value_at(double quantile) const {
+        if (total == 0) {
+            return 0;
+        }
+
+        auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(quantile * static_cast<double>(total) + 0.5));
+        std::uint64_t seen{ 0 };
+        for(std::size_t i{ 0 }; i < number_of_bucket; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(value_of(i), max);
+            }
+        }
+
+        return max;
+    }
+
+
+    std::uint64_t count() const {
+        return total;
+    }
+
+
+    std::uint64_t maximum() const {
+        return max;
+    }
+
+
+    void merge(HdrHistogram const& other) {
+        for(std::size_t i{ 0 }; i < number_of_bucket; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+
+
+    void reset() {
+        counts.fill(0);
+        total = 0;
+        max = 0;
+    }
+
+
+private:
+
+    std::array<std::uint64_t, number_of_bucket> counts{};
+    std::uint64_t total{ 0 };
+    std::uint64_t max{ 0 };
+};
+
+}
@@ -0,0 +1,575 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/MainLobby.hpp>
+#include <pong/server/Matchmaker.hpp>
+#include <pong/server/NewUser.hpp>
+#include <pong/server/RoomRegistry.hpp>
+#include <pong/server/RoomSnapshot.hpp>
+#include <pong/server/StateStream.hpp>
+#include <pong/server/UserRegistry.hpp>
+#include <pong/server/Username.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace pong::server {
+
+/*
+    Hot restart: a running server hands its connections and its state over to a new process, no connection is closed
+
+    The running server listens on a UNIX socket (`--handoff <path>`), the new one connects to it (`--take-over <path>`).
+    At the end of a tick, once the output buffers are flushed, the running server:
+    - stops accepting and its transport (see `Transport::release`), and creates the clients accepted during the tick.
+      The clients connecting from then on wait in the backlog of the listener, the new server accepts them
+    - writes the image of its state (see `write_server_image`)
+    - sends the image, then the handles of its listener, of its metrics listener and of every connection (SCM_RIGHTS)
+    - waits for the confirmation of the new server, and exits without closing anything: the sockets are shared
+      by both processes, the connections aren't shut down
+    The new server restores the state before its first tick and confirms. The games are stalled by the time of the handoff,
+    a few milliseconds for thousands of users. If the new server fails, the running one resumes its transport and goes on.
+
+    The users keep their rooms, their subscriptions, their place in the matchmaking and the names they know:
+    the name ids, their generations and the room ids are kept, only the user ids (local to a process) change. Not handed over:
+    - the matches being recorded, their file ends where it is and the match goes on unrecorded
+    - the federation, the new server joins the coordinator again with the range of slots of the old one
+*/
+
+// The last byte is the version of the image, both servers must have the same
+static constexpr std::array<char, 8> handoff_magic{ 'P', 'O', 'N', 'G', 'H', 'O', 'F', 4 };
+
+
+/*
+    The state handed over, owned by the client thread of the server
+*/
+struct ServerState {
+    UsernameTable& usernames;
+    UserRegistry& users;
+    RoomRegistry& rooms;
+    MainLobbyState& main_lobby;
+    NewUserState& new_users;
+};
+
+
+/*
+    What goes from a process to the next one
+*/
+struct Handoff {
+    std::vector<std::byte> image;
+
+    int listener{ -1 };
+    // -1 without metrics
+    int metrics_listener{ -1 };
+    // In the order of the users of the image
+    std::vector<int> connections;
+};
+
+
+
+
+
+namespace details {
+
+inline bool set_timeout(int fd, std::chrono::seconds timeout) {
+    timeval value{};
+    value.tv_sec = timeout.count();
+    return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value)) == 0
+        && setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value)) == 0;
+}
+
+
+inline bool send_all(int fd, void const* data, std::size_t size) {
+    auto const* bytes = static_cast<std::byte const*>(data);
+    while(size > 0) {
+        auto sent = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+
+        bytes += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+
+    return true;
+}
+
+
+inline bool receive_all(int fd, void* data, std::size_t size) {
+    auto* bytes = static_cast<std::byte*>(data);
+    while(size > 0) {
+        auto received = ::recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+
+        bytes += received;
+        size -= static_cast<std::size_t>(received);
+    }
+
+    return true;
+}
+
+
+// The kernel accepts up to 253 handles per message (SCM_MAX_FD)
+static constexpr std::size_t handles_per_message{ 250 };
+
+
+/*
+    The handles go by batches, each with a byte of data
+*/
+inline bool send_handles(int fd, std::vector<int> const& handles) {
+    for(std::size_t first{ 0 }; first < handles.size(); first += handles_per_message) {
+        auto count = std::min(handles_per_message, handles.size() - first);
+
+        alignas(cmsghdr) std::array<std::byte, CMSG_SPACE(sizeof(int) * handles_per_message)> control{};
+        char byte{ 0 };
+        iovec data{ &byte, 1 };
+
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control.data();
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+        auto* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        std::memcpy(CMSG_DATA(header), handles.data() + first, sizeof(int) * count);
+
+        ssize_t sent;
+        do {
+            sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+        } while(sent < 0 && errno == EINTR);
+
+        if (sent != 1) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+inline bool receive_handles(int fd, std::size_t count, std::vector<int>& handles) {
+    while(handles.size() < count) {
+        alignas(cmsghdr) std::array<std::byte, CMSG_SPACE(sizeof(int) * handles_per_message)> control{};
+        char byte{ 0 };
+        iovec data{ &byte, 1 };
+
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control.data();
+        message.msg_controllen = control.size();
+
+        ssize_t received;
+        do {
+            received = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        } while(received < 0 && errno == EINTR);
+
+        if (received != 1 || (message.msg_flags & MSG_CTRUNC)) {
+            return false;
+        }
+
+        for(auto* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                auto received_count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                auto offset = handles.size();
+                handles.resize(offset + received_count);
+                std::memcpy(handles.data() + offset, CMSG_DATA(header), sizeof(int) * received_count);
+            }
+        }
+    }
+
+    return handles.size() == count;
+}
+
+
+// Magic, size of the image, number of connections, metrics listener
+static constexpr std::size_t handoff_header_size{ handoff_magic.size() + 8 + 4 + 1 };
+static constexpr char handoff_confirmation{ 1 };
+
+}
+
+
+
+
+
+/*
+    Image of the state of the server, the handles of the connections are appended to `handoff.connections` in its order:
+        [slots of the server][recorded matches][usernames]
+        [new users: session][lobby users: session, subscription, matchmaking][slots: generation, room snapshot with its members]
+    The sessions and the rooms are the ones of the snapshots of rooms (see RoomSnapshot.hpp)
+*/
+inline void write_server_image(ServerState& server, StateWriter& writer, Handoff& handoff) {
+    writer.write_varint(server.rooms.first_assigned_slot());
+    writer.write_varint(server.rooms.number_of_assigned_slot());
+    writer.write_varint(server.rooms.recorded_matches);
+
+
+    writer.write_varint(server.usernames.number_of_id());
+    for(name_id_t id{ 1 }; id < server.usernames.number_of_id(); ++id) {
+        writer.write_string(server.usernames.name_of(id));
+        writer.write_varint(server.usernames.generation_of(id));
+    }
+
+
+    writer.write_varint(server.new_users.number_of_user());
+    for(user_handle_t handle{ 0 }; handle < server.new_users.number_of_user(); ++handle) {
+        details::write_user(writer, server.new_users.get_user(handle), handoff.connections);
+    }
+
+    auto& main_lobby = server.main_lobby;
+    auto now = main_lobby.matchmaker.now();
+    writer.write_varint(main_lobby.number_of_user());
+    for(user_handle_t handle{ 0 }; handle < main_lobby.number_of_user(); ++handle) {
+        auto const& subscription = main_lobby.get_user_data(handle).subscription;
+        details::write_user(writer, main_lobby.get_user(handle), handoff.connections);
+        writer.write_varint(subscription.min);
+        writer.write_varint(subscription.max_excluded);
+
+        // The time waited, the clocks of the processes aren't compared
+        auto const* waiting = main_lobby.matchmaker.find(main_lobby.get_user_id(handle));
+        writer.write_bool(waiting != nullptr);
+        if (waiting) {
+            writer.write_varint(waiting->rating);
+            writer.write_varint(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - waiting->since).count()));
+        }
+    }
+    writer.write_varint(main_lobby.user_count_sent);
+
+
+    auto& rooms = server.rooms;
+    auto first_slot = rooms.first_assigned_slot();
+    writer.write_varint(rooms.number_of_slot() - first_slot);
+    for(auto slot = first_slot; slot < rooms.number_of_slot(); ++slot) {
+        auto const* room = rooms.get_at(slot);
+        writer.write_varint(rooms.generation_at(slot));
+        writer.write_bool(room != nullptr);
+
+        if (room) {
+            details::write_room(writer, *room, handoff.connections);
+        }
+    }
+}
+
+
+/*
+    Restore the image in the states of a server that has no user and no room yet
+    false if the image is invalid, the server must not go on with what was restored
+*/
+inline bool read_server_image(ServerState& server, Handoff const& handoff) {
+    StateReader reader{ handoff.image.data(), handoff.image.size() };
+
+    auto first_slot = reader.read_varint();
+    auto slot_count = reader.read_varint();
+    if (reader.failed() || slot_count == 0 || slot_count > RoomRegistry::max_number_of_room || first_slot > RoomRegistry::max_number_of_room - slot_count) {
+        return false;
+    }
+    server.rooms.assign_slots(first_slot, slot_count);
+    server.rooms.recorded_matches = reader.read_varint();
+
+
+    auto name_count = reader.read_varint();
+    for(std::uint64_t id{ 1 }; id < name_count && !reader.failed(); ++id) {
+        auto username = reader.read_string();
+        server.usernames.restore_entry(std::move(username), static_cast<unsigned>(reader.read_varint()));
+    }
+
+
+    std::size_t next_connection{ 0 };
+
+    auto new_user_count = reader.read_varint();
+    for(std::uint64_t i{ 0 }; i < new_user_count && !reader.failed(); ++i) {
+        auto id = details::read_user(reader, server.users, server.usernames, handoff.connections, next_connection);
+        if (id == invalid_user_id) {
+            return false;
+        }
+
+        server.new_users.restore(id);
+    }
+
+    auto& main_lobby = server.main_lobby;
+    auto now = main_lobby.matchmaker.now();
+    auto lobby_user_count = reader.read_varint();
+    for(std::uint64_t i{ 0 }; i < lobby_user_count && !reader.failed(); ++i) {
+        auto id = details::read_user(reader, server.users, server.usernames, handoff.connections, next_connection);
+        RoomRange subscription{ static_cast<unsigned>(reader.read_varint()), static_cast<unsigned>(reader.read_varint()) };
+        auto searching = reader.read_bool();
+        auto rating = searching ? static_cast<unsigned>(reader.read_varint()) : 0u;
+        auto waited = std::chrono::milliseconds{ searching ? static_cast<std::int64_t>(reader.read_varint()) : 0 };
+        if (id == invalid_user_id) {
+            return false;
+        }
+
+        auto handle = main_lobby.restore(id);
+        if (subscription.min <= subscription.max_excluded && subscription.max_excluded - subscription.min <= LobbyUser::max_subscription_size) {
+            main_lobby.get_user_data(handle).subscription = subscription;
+        }
+        if (searching && !reader.failed()) {
+            main_lobby.matchmaker.enqueue(id, rating, now - waited);
+        }
+    }
+    main_lobby.user_count_sent = static_cast<unsigned>(reader.read_varint());
+
+
+    auto& rooms = server.rooms;
+    auto restored_slot_count = reader.read_varint();
+    if (reader.failed() || restored_slot_count > slot_count) {
+        return false;
+    }
+
+    for(std::uint64_t i{ 0 }; i < restored_slot_count; ++i) {
+        auto generation = static_cast<unsigned>(reader.read_varint());
+        auto live = reader.read_bool();
+        if (reader.failed()) {
+            return false;
+        }
+
+        auto* room = rooms.restore_slot(generation, live, main_lobby);
+        if (room && !details::read_room(reader, *room, server.usernames, handoff.connections, next_connection)) {
+            return false;
+        }
+    }
+
+    if (reader.failed() || !reader.at_end() || next_connection != handoff.connections.size()) {
+        return false;
+    }
+
+
+    // The lobby lists the rooms it listed, the empty ones are reclaimed
+    rooms.for_each([&main_lobby, &rooms] (RoomState& room) {
+        main_lobby.snapshot.update_room(MainLobbyState::get_room_summary(room));
+
+        if (room.is_empty() && !room.playback) {
+            rooms.schedule_reclaim(room.room_id);
+        }
+    });
+
+    server.usernames.end_restore();
+    return true;
+}
+
+
+
+
+
+/*
+    The running server, waiting for the server that replaces it
+*/
+class HandoffListener {
+public:
+
+    static constexpr std::chrono::seconds confirmation_timeout{ 10 };
+
+
+    HandoffListener() = default;
+
+    HandoffListener(HandoffListener const&) = delete;
+    HandoffListener& operator=(HandoffListener const&) = delete;
+
+    ~HandoffListener() {
+        for(auto handle : { connection, listener }) {
+            if (handle >= 0) {
+                ::close(handle);
+            }
+        }
+    }
+
+
+    /*
+        A file left at the path, by a previous server or by the one this server replaces, is removed
+    */
+    bool open(std::string const& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            return false;
+        }
+
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listener < 0) {
+            return false;
+        }
+
+        ::unlink(path.c_str());
+        return ::bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) == 0 && ::listen(listener, 1) == 0;
+    }
+
+
+    /*
+        A new server connected, checked once per tick without blocking
+    */
+    bool poll() {
+        if (listener >= 0 && connection < 0) {
+            connection = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        }
+
+        return connection >= 0;
+    }
+
+
+    /*
+        Send the image and the handles to the new server and wait for its confirmation
+        false if it failed, the server goes on with its connections
+    */
+    bool hand_over(Handoff const& handoff) {
+        std::vector<int> handles{ handoff.listener };
+        if (handoff.metrics_listener >= 0) {
+            handles.push_back(handoff.metrics_listener);
+        }
+        handles.insert(std::end(handles), std::begin(handoff.connections), std::end(handoff.connections));
+
+        StateWriter header;
+        header.write_raw(handoff_magic.data(), handoff_magic.size());
+        header.write_fixed64(handoff.image.size());
+        header.write_fixed32(static_cast<std::uint32_t>(handoff.connections.size()));
+        header.write_bool(handoff.metrics_listener >= 0);
+
+        char confirmation{ 0 };
+        auto done = details::set_timeout(connection, confirmation_timeout)
+            && details::send_all(connection, header.bytes.data(), header.bytes.size())
+            && details::send_all(connection, handoff.image.data(), handoff.image.size())
+            && details::send_handles(connection, handles)
+            && details::receive_all(connection, &confirmation, 1)
+            && confirmation == details::handoff_confirmation;
+
+        ::close(connection);
+        connection = -1;
+        return done;
+    }
+
+
+private:
+
+    int listener{ -1 };
+    int connection{ -1 };
+
+};
+
+
+
+
+
+/*
+    The new server, taking over the running one
+*/
+class HandoffReceiver {
+public:
+
+    static constexpr std::chrono::seconds timeout{ 10 };
+    static constexpr std::uint64_t max_image_size{ std::uint64_t{ 1 } << 30 };
+
+
+    HandoffReceiver() = default;
+
+    HandoffReceiver(HandoffReceiver const&) = delete;
+    HandoffReceiver& operator=(HandoffReceiver const&) = delete;
+
+    ~HandoffReceiver() {
+        if (connection >= 0) {
+            ::close(connection);
+        }
+    }
+
+
+    Handoff handoff;
+
+
+    /*
+        Blocking, before the server listens: its listener is the one of the running server
+    */
+    bool receive(std::string const& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            return false;
+        }
+
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        connection = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connection < 0 || ::connect(connection, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0
+        ||  !details::set_timeout(connection, timeout)) {
+            return false;
+        }
+
+
+        std::array<std::byte, details::handoff_header_size> header_bytes;
+        if (!details::receive_all(connection, header_bytes.data(), header_bytes.size())) {
+            return false;
+        }
+
+        StateReader header{ header_bytes.data(), header_bytes.size() };
+        auto magic = header.read_raw(handoff_magic.size());
+        auto image_size = header.read_fixed64();
+        auto connection_count = header.read_fixed32();
+        auto has_metrics_listener = header.read_bool();
+
+        if (header.failed() || std::memcmp(magic.data, handoff_magic.data(), handoff_magic.size()) != 0) {
+            std::cerr << "[Error] The running server isn't of the same version\n";
+            return false;
+        }
+        if (image_size > max_image_size) {
+            return false;
+        }
+
+
+        handoff.image.resize(image_size);
+        std::vector<int> handles;
+        if (!details::receive_all(connection, handoff.image.data(), handoff.image.size())
+        ||  !details::receive_handles(connection, std::size_t{ 1 } + (has_metrics_listener ? 1 : 0) + connection_count, handles)) {
+            return false;
+        }
+
+        auto next = std::begin(handles);
+        handoff.listener = *next++;
+        handoff.metrics_listener = has_metrics_listener ? *next++ : -1;
+        handoff.connections.assign(next, std::end(handles));
+
+        return true;
+    }
+
+
+    /*
+        The state is restored, the running server exits
+    */
+    bool confirm() {
+        auto done = details::send_all(connection, &details::handoff_confirmation, 1);
+
+        ::close(connection);
+        connection = -1;
+        return done;
+    }
+
+
+private:
+
+    int connection{ -1 };
+
+};
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+namespace pong::server {
+
+/*
+    Bytes received from a connection, split into frames: the size of the packet (sf::Uint32, network byte order)
+    followed by the packet, as sent by `sf::TcpSocket::send(sf::Packet&)`
+
+    The socket writes directly at the end of the buffer and the frames are decoded in place,
+    a frame returned by `next_frame` stays valid until the next `receive` or `append`.
+    The storage has a fixed capacity and is reused like a ring: instead of wrapping around, the incomplete frame
+    is moved to the front when the end is reached, so a frame is always contiguous.
+*/
+struct InputBuffer {
+
+    static constexpr std::size_t capacity{ 4096 };
+    static constexpr std::size_t header_size{ sizeof(sf::Uint32) };
+
+    // A frame must fit in the buffer, client packets are far smaller
+    static constexpr std::size_t max_packet_size{ capacity - header_size };
+
+
+    /*
+        Read what the socket has available, without blocking
+    */
+    sf::Socket::Status receive(sf::TcpSocket& socket) {
+        // Full of frames not processed yet, the socket keeps the rest
+        if (prepare(1) == 0) {
+            return sf::Socket::NotReady;
+        }
+
+
+        std::size_t received{ 0 };
+        auto status = socket.receive(data.get() + end, capacity - end, received);
+        end += received;
+
+        return status;
+    }
+
+
+    /*
+        Copy bytes already received by the transport
+        false if they don't fit, the peer sends faster than its frames are processed
+    */
+    bool append(void const* bytes, std::size_t size) {
+        if (prepare(size) < size) {
+            return false;
+        }
+
+        std::memcpy(data.get() + end, bytes, size);
+        end += size;
+        return true;
+    }
+
+
+    enum class FrameStatus {
+        Complete, Incomplete, TooLarge
+    };
+
+    struct Frame {
+        FrameStatus status;
+        std::byte const* packet;
+        std::size_t size;
+    };
+
+
+    /*
+        Next frame received entirely, it's consumed
+        `TooLarge` if the announced size can't fit in the buffer, the connection can't be read anymore
+    */
+    Frame next_frame() {
+        if (end - begin < header_size) {
+            return { FrameStatus::Incomplete, nullptr, 0 };
+        }
+
+
+        std::size_t size{ 0 };
+        for(std::size_t i{ 0 }; i < header_size; ++i) {
+            size = (size << 8) | std::to_integer<std::size_t>(data[begin + i]);
+        }
+
+        if (size > max_packet_size) {
+            return { FrameStatus::TooLarge, nullptr, size };
+        }
+
+        if (end - begin < header_size + size) {
+            return { FrameStatus::Incomplete, nullptr, 0 };
+        }
+
+
+        auto const* packet = data.get() + begin + header_size;
+        begin += header_size + size;
+        return { FrameStatus::Complete, packet, size };
+    }
+
+
+    /*
+        Bytes received and not returned by `next_frame` yet
+    */
+    std::byte const* pending() const {
+        return data.get() + begin;
+    }
+
+
+    std::size_t size() const {
+        return end - begin;
+    }
+
+
+private:
+
+    std::unique_ptr<std::byte[]> data;
+    std::size_t begin{ 0 };
+    std::size_t end{ 0 };
+
+
+    /*
+        Free space at the end, the incomplete frame is moved to the front if there's less than `wanted` bytes
+    */
+    std::size_t prepare(std::size_t wanted) {
+        if (!data) {
+            data = std::make_unique<std::byte[]>(capacity);
+        }
+
+
+        if (begin == end) {
+            begin = 0;
+            end = 0;
+        } else if (capacity - end < wanted) {
+            std::memmove(data.get(), data.get() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+
+        return capacity - end;
+    }
+
+};
+
+}
@@ -0,0 +1,580 @@
+#pragma once
+
+#include <pong/server/UserRegistry.hpp>
+
+#include <memory>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define PONG_SERVER_HAS_IO_URING 1
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#endif
+
+namespace pong::server {
+
+#if defined(PONG_SERVER_HAS_IO_URING)
+
+/*
+    Transport on io_uring, used directly through its syscalls (no liburing)
+
+    - Every connection has a multishot `recv`, armed once when the session starts: the kernel keeps receiving
+      into buffers taken from a ring of provided buffers registered with the ring, and posts a completion per read.
+      `receive` only reads the completion queue, shared with the kernel, and copies the bytes in the input buffers,
+      no syscall is made unless new requests are waiting to be submitted
+    - `flush` prepares a `send` per user with pending bytes and submits all of them with a single `io_uring_enter`.
+      The sends use MSG_DONTWAIT, they complete during the submission (possibly partially, like a non-blocking send)
+      so the output buffers are never written while the kernel reads them
+
+    A tick costs one or two syscalls whatever the number of connections, instead of one `recv` per connection
+    and one `send` per connection with messages. Needs Linux 6.0 (multishot `recv`), see `make_io_uring_transport`
+*/
+class IoUringTransport final : public Transport {
+public:
+
+    static constexpr unsigned queue_size{ 4096 };
+    static constexpr unsigned completion_queue_size{ 4 * queue_size };
+
+    // Provided buffers, their number must be a power of two
+    static constexpr unsigned number_of_buffer{ 1024 };
+    static constexpr unsigned buffer_size{ 2048 };
+    static constexpr unsigned short buffer_group{ 0 };
+
+
+    /*
+        nullptr if the kernel doesn't support the ring, the provided buffers or multishot `recv`
+    */
+    static std::unique_ptr<IoUringTransport> create() {
+        std::unique_ptr<IoUringTransport> transport{ new IoUringTransport{} };
+
+        if (!transport->setup() || !transport->probe_multishot_receive()) {
+            return nullptr;
+        }
+
+        return transport;
+    }
+
+
+    IoUringTransport(IoUringTransport const&) = delete;
+    IoUringTransport& operator=(IoUringTransport const&) = delete;
+
+
+    ~IoUringTransport() override {
+        if (buffer_ring != MAP_FAILED) {
+            munmap(buffer_ring, buffer_ring_size);
+        }
+        if (submission_entries != MAP_FAILED) {
+            munmap(submission_entries, submission_entries_size);
+        }
+        if (rings != MAP_FAILED) {
+            munmap(rings, rings_size);
+        }
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+    }
+
+
+    char const* name() const override {
+        return "io_uring";
+    }
+
+
+    void add(user_id_t id, User& user) override {
+        arm_receive(id, user);
+    }
+
+
+    /*
+        The `recv` is cancelled at once, before the socket is closed
+    */
+    void remove(user_id_t id, User&) override {
+        cancel_receive(id);
+        enter(0, 0);
+    }
+
+
+    void receive(UserRegistry& users) override {
+        if (has_unsubmitted_entries()) {
+            enter(0, 0);
+        }
+
+        // Completions the kernel couldn't post, the queue was full
+        if (__atomic_load_n(submission_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) {
+            enter(0, IORING_ENTER_GETEVENTS);
+        }
+
+        reap(users);
+        users.traffic.syscalls += std::exchange(syscalls, 0);
+    }
+
+
+    void flush(UserRegistry& users) override {
+        users.for_each([this, &users] (user_id_t id, User& user) {
+            if (user.disconnected || user.output.empty()) {
+                return;
+            }
+
+
+            auto* entry = next_entry();
+            entry->opcode = IORING_OP_SEND;
+            entry->fd = user.socket->handle();
+            entry->addr = reinterpret_cast<std::uint64_t>(user.output.pending());
+            entry->len = static_cast<std::uint32_t>(user.output.size());
+            entry->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+            entry->user_data = make_user_data(Operation::Send, id);
+
+            ++pending_sends;
+            ++users.traffic.sends;
+        });
+
+
+        while(pending_sends > 0) {
+            if (enter(pending_sends, IORING_ENTER_GETEVENTS) < 0 && errno != EBUSY && errno != EAGAIN) {
+                std::cerr << "[Error] io_uring_enter: " << std::strerror(errno) << '\n';
+                break;
+            }
+
+            reap(users);
+        }
+
+        users.traffic.syscalls += std::exchange(syscalls, 0);
+    }
+
+
+    /*
+        Every `recv` is cancelled and the completions are reaped up to the last cancellation,
+        the bytes the kernel read before are in the input buffers. No `recv` is armed again until `resume`
+    */
+    void release(UserRegistry& users) override {
+        releasing = true;
+        users.for_each([this] (user_id_t id, User&) {
+            cancel_receive(id);
+        });
+
+        while(pending_cancels > 0) {
+            if (enter(1, IORING_ENTER_GETEVENTS) < 0 && errno != EBUSY && errno != EAGAIN) {
+                std::cerr << "[Error] io_uring_enter: " << std::strerror(errno) << '\n';
+                break;
+            }
+
+            reap(users);
+        }
+
+        users.traffic.syscalls += std::exchange(syscalls, 0);
+    }
+
+
+    void resume(UserRegistry& users) override {
+        releasing = false;
+        users.for_each([this] (user_id_t id, User& user) {
+            if (!user.disconnected) {
+                arm_receive(id, user);
+            }
+        });
+    }
+
+
+private:
+
+    /*
+        The kind of request is kept in the 2 high bits of its `user_data`, the user id in the others,
+        so the generation of the user is truncated to 30 bits. It's enough to ignore the completions of a previous session
+    */
+    enum class Operation : std::uint64_t {
+        Receive, Send, Cancel, Probe
+    };
+
+    static constexpr unsigned operation_shift{ 62 };
+    static constexpr std::uint64_t id_mask{ (std::uint64_t{ 1 } << operation_shift) - 1 };
+
+
+    static std::uint64_t make_user_data(Operation operation, user_id_t id) {
+        return (static_cast<std::uint64_t>(operation) << operation_shift) | (id & id_mask);
+    }
+
+
+    /*
+        Id of the user of the request, `invalid_user_id` if its session ended
+    */
+    static user_id_t user_of(UserRegistry const& users, std::uint64_t user_data) {
+        auto id = users.id_at(UserRegistry::index_of(user_data & id_mask));
+        return (id & id_mask) == (user_data & id_mask) ? id : invalid_user_id;
+    }
+
+
+    int ring_fd{ -1 };
+
+    void* rings{ MAP_FAILED };
+    std::size_t rings_size{ 0 };
+
+    io_uring_sqe* submission_entries{ static_cast<io_uring_sqe*>(MAP_FAILED) };
+    std::size_t submission_entries_size{ 0 };
+
+    // Submission queue, shared with the kernel
+    unsigned const* submission_head{ nullptr };
+    unsigned* submission_tail{ nullptr };
+    unsigned const* submission_flags{ nullptr };
+    unsigned submission_mask{ 0 };
+    unsigned submission_entries_count{ 0 };
+
+    // Entries prepared, published to the kernel by `enter`
+    unsigned local_submission_tail{ 0 };
+
+    // Completion queue, shared with the kernel
+    unsigned* completion_head{ nullptr };
+    unsigned const* completion_tail{ nullptr };
+    unsigned completion_mask{ 0 };
+    io_uring_cqe const* completions{ nullptr };
+
+    /*
+        Ring of provided buffers, shared with the kernel. Its tail overlays the `resv` field of the first entry
+        (`io_uring_buf_ring`, whose flexible array has another offset when the header is compiled as C++)
+    */
+    io_uring_buf* buffer_ring{ static_cast<io_uring_buf*>(MAP_FAILED) };
+    std::size_t buffer_ring_size{ 0 };
+    std::unique_ptr<std::byte[]> buffers;
+    unsigned short buffer_tail{ 0 };
+
+    unsigned pending_sends{ 0 };
+    unsigned pending_cancels{ 0 };
+
+    // Between `release` and `resume`
+    bool releasing{ false };
+
+    // Since the last `receive` or `flush`
+    std::size_t syscalls{ 0 };
+
+
+    IoUringTransport() = default;
+
+
+    template<typename T>
+    T* at(std::size_t offset) const {
+        return static_cast<T*>(static_cast<void*>(static_cast<std::byte*>(rings) + offset));
+    }
+
+
+    bool setup() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = completion_queue_size;
+
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, queue_size, &params));
+        if (ring_fd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+            return false;
+        }
+
+
+        // Both queues share the same mapping
+        rings_size = std::max(
+            params.sq_off.array + params.sq_entries * sizeof(unsigned),
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe)
+        );
+        rings = mmap(nullptr, rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (rings == MAP_FAILED) {
+            return false;
+        }
+
+        submission_entries_size = params.sq_entries * sizeof(io_uring_sqe);
+        submission_entries = static_cast<io_uring_sqe*>(
+            mmap(nullptr, submission_entries_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES)
+        );
+        if (submission_entries == MAP_FAILED) {
+            return false;
+        }
+
+
+        submission_head = at<unsigned const>(params.sq_off.head);
+        submission_tail = at<unsigned>(params.sq_off.tail);
+        submission_flags = at<unsigned const>(params.sq_off.flags);
+        submission_mask = *at<unsigned const>(params.sq_off.ring_mask);
+        submission_entries_count = params.sq_entries;
+        local_submission_tail = *submission_tail;
+
+        // Entry i of the queue is always the submission entry i
+        auto* array = at<unsigned>(params.sq_off.array);
+        for(unsigned i{ 0 }; i < params.sq_entries; ++i) {
+            array[i] = i;
+        }
+
+        completion_head = at<unsigned>(params.cq_off.head);
+        completion_tail = at<unsigned const>(params.cq_off.tail);
+        completion_mask = *at<unsigned const>(params.cq_off.ring_mask);
+        completions = at<io_uring_cqe const>(params.cq_off.cqes);
+
+
+        return setup_buffers();
+    }
+
+
+    bool setup_buffers() {
+        buffer_ring_size = number_of_buffer * sizeof(io_uring_buf);
+        buffer_ring = static_cast<io_uring_buf*>(
+            mmap(nullptr, buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+        );
+        if (buffer_ring == MAP_FAILED) {
+            return false;
+        }
+
+
+        io_uring_buf_reg registration;
+        std::memset(&registration, 0, sizeof(registration));
+        registration.ring_addr = reinterpret_cast<std::uint64_t>(buffer_ring);
+        registration.ring_entries = number_of_buffer;
+        registration.bgid = buffer_group;
+
+        if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+            return false;
+        }
+
+
+        buffers = std::make_unique<std::byte[]>(std::size_t{ number_of_buffer } * buffer_size);
+        for(unsigned i{ 0 }; i < number_of_buffer; ++i) {
+            recycle(static_cast<unsigned short>(i));
+        }
+        __atomic_store_n(&buffer_ring[0].resv, buffer_tail, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+
+    /*
+        Multishot `recv` (Linux 6.0) on a socket pair, the kernels before reject it with EINVAL
+    */
+    bool probe_multishot_receive() {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            return false;
+        }
+
+
+        auto* entry = next_entry();
+        entry->opcode = IORING_OP_RECV;
+        entry->fd = pair[0];
+        entry->ioprio = IORING_RECV_MULTISHOT;
+        entry->flags = IOSQE_BUFFER_SELECT;
+        entry->buf_group = buffer_group;
+        entry->user_data = make_user_data(Operation::Probe, 0);
+
+        char const byte{ 0 };
+        bool supported{ false };
+
+        if (write(pair[1], &byte, 1) == 1 && enter(1, IORING_ENTER_GETEVENTS) >= 0) {
+            for_each_completion([this, &supported] (io_uring_cqe const& completion) {
+                if (completion.flags & IORING_CQE_F_BUFFER) {
+                    recycle(static_cast<unsigned short>(completion.flags >> IORING_CQE_BUFFER_SHIFT));
+                }
+
+                supported = supported || (completion.res == 1 && (completion.flags & IORING_CQE_F_MORE));
+            });
+        }
+
+
+        auto* cancel = next_entry();
+        cancel->opcode = IORING_OP_ASYNC_CANCEL;
+        cancel->fd = -1;
+        cancel->addr = make_user_data(Operation::Probe, 0);
+        cancel->user_data = make_user_data(Operation::Probe, 0);
+        enter(0, 0);
+
+        close(pair[0]);
+        close(pair[1]);
+        syscalls = 0;
+
+        return supported;
+    }
+
+
+    void arm_receive(user_id_t id, User& user) {
+        auto* entry = next_entry();
+        entry->opcode = IORING_OP_RECV;
+        entry->fd = user.socket->handle();
+        entry->ioprio = IORING_RECV_MULTISHOT;
+        entry->flags = IOSQE_BUFFER_SELECT;
+        entry->buf_group = buffer_group;
+        entry->user_data = make_user_data(Operation::Receive, id);
+    }
+
+
+    /*
+        Submitted by the next `enter`, the `recv` ends with ECANCELED
+    */
+    void cancel_receive(user_id_t id) {
+        auto* entry = next_entry();
+        entry->opcode = IORING_OP_ASYNC_CANCEL;
+        entry->fd = -1;
+        entry->addr = make_user_data(Operation::Receive, id);
+        entry->user_data = make_user_data(Operation::Cancel, id);
+
+        ++pending_cancels;
+    }
+
+
+    bool has_unsubmitted_entries() const {
+        return local_submission_tail != __atomic_load_n(submission_head, __ATOMIC_ACQUIRE);
+    }
+
+
+    /*
+        Zeroed entry, submitted by the next `enter`
+    */
+    io_uring_sqe* next_entry() {
+        if (local_submission_tail - __atomic_load_n(submission_head, __ATOMIC_ACQUIRE) == submission_entries_count) {
+            enter(0, 0);
+        }
+
+        auto* entry = &submission_entries[local_submission_tail & submission_mask];
+        ++local_submission_tail;
+
+        std::memset(entry, 0, sizeof(*entry));
+        return entry;
+    }
+
+
+    /*
+        Submit the prepared entries and, with IORING_ENTER_GETEVENTS, wait for `min_complete` completions
+    */
+    int enter(unsigned min_complete, unsigned flags) {
+        __atomic_store_n(submission_tail, local_submission_tail, __ATOMIC_RELEASE);
+        auto to_submit = local_submission_tail - __atomic_load_n(submission_head, __ATOMIC_ACQUIRE);
+
+        int result;
+        do {
+            ++syscalls;
+            result = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+        } while(result < 0 && errno == EINTR);
+
+        return result;
+    }
+
+
+    template<typename F>
+    void for_each_completion(F&& f) {
+        auto head = *completion_head;
+        auto tail = __atomic_load_n(completion_tail, __ATOMIC_ACQUIRE);
+
+        for(; head != tail; ++head) {
+            f(completions[head & completion_mask]);
+        }
+
+        __atomic_store_n(completion_head, head, __ATOMIC_RELEASE);
+        __atomic_store_n(&buffer_ring[0].resv, buffer_tail, __ATOMIC_RELEASE);
+    }
+
+
+    /*
+        Give a provided buffer back to the kernel, published with the completion queue head
+    */
+    void recycle(unsigned short buffer) {
+        auto& entry = buffer_ring[buffer_tail & (number_of_buffer - 1)];
+        entry.addr = reinterpret_cast<std::uint64_t>(buffers.get() + std::size_t{ buffer } * buffer_size);
+        entry.len = buffer_size;
+        entry.bid = buffer;
+        ++buffer_tail;
+    }
+
+
+    void reap(UserRegistry& users) {
+        for_each_completion([this, &users] (io_uring_cqe const& completion) {
+            auto operation = static_cast<Operation>(completion.user_data >> operation_shift);
+            auto id = user_of(users, completion.user_data);
+            auto* user = users.get(id);
+
+            switch(operation) {
+                case Operation::Receive:
+                    return complete_receive(id, user, completion);
+
+                case Operation::Send:
+                    --pending_sends;
+                    return complete_send(users, user, completion);
+
+                case Operation::Cancel:
+                    --pending_cancels;
+                    return;
+
+                case Operation::Probe:
+                    return;
+            }
+        });
+    }
+
+
+    void complete_receive(user_id_t id, User* user, io_uring_cqe const& completion) {
+        if (completion.flags & IORING_CQE_F_BUFFER) {
+            auto buffer = static_cast<unsigned short>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+
+            if (user && !user->disconnected && completion.res > 0) {
+                auto const* data = buffers.get() + std::size_t{ buffer } * buffer_size;
+
+                // The peer sends faster than its frames are handled, the kernel can't be asked to keep the bytes
+                if (!user->input.append(data, static_cast<std::size_t>(completion.res))) {
+                    std::cerr << "[Warning] Input buffer full\n";
+                    user->disconnected = true;
+                }
+            }
+
+            recycle(buffer);
+        }
+
+
+        if (!user || user->disconnected) {
+            return;
+        }
+
+        // ECANCELED: stopped by `release`, the connection isn't lost
+        if (completion.res == -ECANCELED) {
+            return;
+        }
+
+        // 0: end of stream. ENOBUFS: every provided buffer is in use, the `recv` stopped and is armed again
+        if (completion.res == 0 || (completion.res < 0 && completion.res != -ENOBUFS)) {
+            user->disconnected = true;
+        } else if (!(completion.flags & IORING_CQE_F_MORE) && !releasing) {
+            arm_receive(id, *user);
+        }
+    }
+
+
+    void complete_send(UserRegistry& users, User* user, io_uring_cqe const& completion) {
+        if (!user) {
+            return;
+        }
+
+        if (completion.res >= 0) {
+            user->output.consume(static_cast<std::size_t>(completion.res));
+            users.traffic.bytes_sent += static_cast<std::size_t>(completion.res);
+        } else if (completion.res != -EAGAIN) {
+            user->disconnected = true;
+        }
+    }
+
+};
+
+#endif
+
+
+
+/*
+    The io_uring transport if the system supports it, nullptr otherwise (use ClassicTransport)
+*/
+inline std::unique_ptr<Transport> make_io_uring_transport() {
+#if defined(PONG_SERVER_HAS_IO_URING)
+    return IoUringTransport::create();
+#else
+    return nullptr;
+#endif
+}
+
+}
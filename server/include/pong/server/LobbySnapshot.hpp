@@ -0,0 +1,128 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/RoomRegistry.hpp>
+
+#include <pong/packet/Server.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Pre-serialised content of `LobbyInfo` for the users subscribed to `window`
+
+    The summaries are updated incrementally when the lobby flushes its dirty rooms,
+    and only serialised again when a user enters after a change (`version` != its `serialized_versions`).
+    Each encoding has its own bytes, serialised for the first user entering with it.
+    The user count is not part of the cached bytes, so a join doesn't invalidate it
+*/
+struct LobbySnapshot {
+
+    LobbySnapshot(RoomRange _window) 
+    :   window{ _window }
+    ,   version{ 1 }
+    ,   serialized_versions{} {}
+
+
+    RoomRange window;
+
+    // Sorted by slot index, only the rooms inside `window` that are not empty (or are replays)
+    std::vector<pong::packet::server::RoomSummary> rooms;
+
+    std::size_t version;
+    std::array<std::size_t, pong::packet::number_of_encoding> serialized_versions;
+    std::array<std::vector<std::byte>, pong::packet::number_of_encoding> serialized_rooms;
+
+
+    void update_room(pong::packet::server::RoomSummary const& summary) {
+        if (!window.contains(static_cast<unsigned>(RoomRegistry::index_of(summary.id)))) {
+            return;
+        }
+
+        // Replay rooms are listed without spectators, their players are recorded
+        if (summary.user_count == 0 && !summary.left_player && !summary.right_player) {
+            return remove_room(summary.id);
+        }
+
+        auto it = find(summary.id);
+        if (it != std::end(rooms) && RoomRegistry::index_of(it->id) == RoomRegistry::index_of(summary.id)) {
+            if (*it == summary) {
+                return;
+            }
+
+            *it = summary;
+        } else {
+            rooms.insert(it, summary);
+        }
+
+        ++version;
+    }
+
+
+    void remove_room(room_id_t room_id) {
+        auto it = find(room_id);
+        if (it != std::end(rooms) && it->id == room_id) {
+            rooms.erase(it);
+            ++version;
+        }
+    }
+
+
+    std::size_t frame_size(pong::packet::Encoding encoding, unsigned user_count) {
+        auto index = pong::packet::index_of(encoding);
+        if (serialized_versions[index] != version) {
+            serialize_rooms(encoding);
+        }
+
+        return sizeof(sf::Uint32) + packet_size(encoding, user_count);
+    }
+
+
+    /*
+        Write the `LobbyInfo` frame, `frame_size` must be called first with the same arguments
+    */
+    void write_frame(pong::packet::details::Writer& writer, unsigned user_count) const {
+        auto const& rooms_bytes = serialized_rooms[pong::packet::index_of(writer.encoding)];
+        assert(serialized_versions[pong::packet::index_of(writer.encoding)] == version);
+
+        writer.write_fixed(static_cast<sf::Uint32>(packet_size(writer.encoding, user_count)));
+        writer << pong::packet::server::id_of<pong::packet::server::LobbyInfo>() << sf::Uint32{ user_count };
+        writer.append(rooms_bytes.data(), rooms_bytes.size());
+    }
+
+
+private:
+
+
+    std::vector<pong::packet::server::RoomSummary>::iterator find(room_id_t room_id) {
+        return std::lower_bound(std::begin(rooms), std::end(rooms), room_id, [] (auto const& summary, room_id_t id) {
+            return RoomRegistry::index_of(summary.id) < RoomRegistry::index_of(id);
+        });
+    }
+
+
+    std::size_t packet_size(pong::packet::Encoding encoding, unsigned user_count) const {
+        return pong::packet::details::id_size(encoding)
+            +  pong::packet::details::integer_size<sf::Uint32>(user_count, encoding)
+            +  serialized_rooms[pong::packet::index_of(encoding)].size();
+    }
+
+
+    void serialize_rooms(pong::packet::Encoding encoding) {
+        auto index = pong::packet::index_of(encoding);
+        auto& bytes = serialized_rooms[index];
+        bytes.resize(pong::packet::details::encoded_size<decltype(rooms)>(rooms, encoding));
+
+        pong::packet::details::Writer writer{ bytes.data(), encoding };
+        pong::packet::details::encode<decltype(rooms)>(writer, rooms);
+        serialized_versions[index] = version;
+    }
+
+};
+
+}
@@ -4,83 +4,266 @@
 #include <pong/server/State.hpp>
 
 #include <pong/server/Room.hpp>
+#include <pong/server/RoomRegistry.hpp>
+#include <pong/server/LobbySnapshot.hpp>
+#include <pong/server/FederationDirectory.hpp>
+#include <pong/server/Matchmaker.hpp>
+
+#include <pong/packet/Federation.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <string>
 
 namespace pong::server {
 
-struct MainLobbyState : public State<MainLobbyState, user_t> {
-    MainLobbyState(std::vector<std::unique_ptr<RoomState>>& _rooms) : State({
-        // Receive
-        { id_of(pong::packet::client::CreateRoom{}), &MainLobbyState::on_create_room },
-        { id_of(pong::packet::client::EnterRoom{}), &MainLobbyState::on_enter_room }
-    }), rooms{ _rooms } {}
+struct LobbyUser {
+    LobbyUser() 
+    :   subscription{ default_subscription } {}
+
+    static constexpr RoomRange default_subscription{ 0, 16 };
+    static constexpr unsigned max_subscription_size{ 64 };
+
+    RoomRange subscription;
+};
+
+/*
+    The lobby of a server, with the rooms of the other servers when it's part of a federation (see FederationLink.hpp)
+
+    The rooms of the other servers are listed like the local ones, a user entering one of them or creating a room
+    while another server is the placement is sent a `Redirect` to that server.
+    The changes of the local rooms are queued in `federation_outbox` for the coordinator
+
+    The users looking for an opponent wait in the `matchmaker`, a pair leaves the lobby for a new room of this server
+    (even in a federation, both users are connected to it) where they are queued to play, see `update_matchmaking`
+*/
+struct MainLobbyState : public State<MainLobbyState, LobbyUser> {
+    MainLobbyState(UserRegistry& _registry, RoomRegistry& _rooms) 
+    :   State(_registry)
+    ,   rooms{ _rooms }
+    ,   user_count_sent{ 0 }
+    ,   snapshot{ LobbyUser::default_subscription }
+    ,   matchmaker{ _registry }
+    ,   remote_rooms{ RoomRange{ 0, static_cast<unsigned>(RoomRegistry::max_number_of_room) } } {}
+
+    RoomRegistry& rooms;
+
+    // Rooms whose summary changed since the last `update_rooms`
+    std::vector<room_id_t> dirty_rooms;
+    // Last user count broadcasted, presence is only reported as a count
+    unsigned user_count_sent;
+    // `LobbyInfo` sent to the new users, they are all subscribed to the default window
+    LobbySnapshot snapshot;
+    // Users that sent `FindMatch`
+    Matchmaker matchmaker;
+
+    // nullptr for a standalone server
+    FederationDirectory const* federation{ nullptr };
+    // Rooms of the other servers
+    LobbySnapshot remote_rooms;
+    // Changes of the local rooms, sent to the coordinator by the FederationLink
+    std::vector<pong::packet::federation::Any> federation_outbox;
 
-    std::vector<std::unique_ptr<RoomState>>& rooms;
 
     void update_rooms() {
-        unsigned id{ 0 };
-        for(auto& room : rooms) {
-            if (room && room->is_empty()) {
-                std::cout << "update_rooms: Send OldRoom\n";
-                broadcast(pong::packet::server::OldRoom{ id });
-                room = nullptr;
+        rooms.reclaim([this] (room_id_t id) {
+            std::cout << "update_rooms: Send OldRoom\n";
+            broadcast_to_subscribers(id, pong::packet::server::OldRoom{ id });
+            snapshot.remove_room(id);
+
+            if (federation) {
+                federation_outbox.emplace_back(pong::packet::federation::OldRoom{ id });
             }
+        });
+
+
+        for(auto room_id : dirty_rooms) {
+            if (auto* room = rooms.get(room_id)) {
+                room->summary_dirty = false;
+
+                auto summary = get_room_summary(*room);
+                snapshot.update_room(summary);
+                broadcast_to_subscribers(room_id, pong::packet::server::RoomUpdate{ summary });
+
+                if (federation) {
+                    federation_outbox.emplace_back(pong::packet::federation::RoomUpdate{ summary });
+                }
+            }
+        }
 
-            ++id;
+        dirty_rooms.clear();
+
+
+        if (user_count_sent != user_count()) {
+            user_count_sent = user_count();
+            broadcast(pong::packet::server::UserCount{ user_count_sent });
         }
     }
 
-    std::vector<int> get_room_ids() const {
-        std::vector<int> room_ids;
 
-        for(std::size_t room_id{ 0 }; room_id < rooms.size(); ++room_id) {
-            if (rooms[room_id] && !rooms[room_id]->is_empty()) {
-                room_ids.emplace_back(static_cast<int>(room_id));
-            }
+    /*
+        Pair the users waiting for a match, called after `receive_packets`: the pairs join their rooms with the other transitions
+        A pair that doesn't get a room waits for the next call
+    */
+    void update_matchmaking() {
+        if (matchmaker.number_of_waiting() < 2) {
+            return;
         }
 
-        return room_ids;
+        auto now = matchmaker.now();
+        matchmaker.match(now, [this, now] (Matchmaker::Waiting const& lhs, Matchmaker::Waiting const& rhs) {
+            auto room_id = rooms.allocate(*this);
+            if (!room_id) {
+                std::cerr << "[Warning] Can't create a room for a match, the maximum has been reached\n";
+                return false;
+            }
+
+
+            std::cout << "Match found, room #" << *room_id << " created\n";
+
+
+            std::cout << "Send NewRoom\n";
+            auto index = static_cast<unsigned>(RoomRegistry::index_of(*room_id));
+
+            broadcast_if(pong::packet::server::NewRoom{ *room_id }, [this, &lhs, &rhs, index] (user_handle_t h) {
+                auto id = get_user_id(h);
+                return id != lhs.id && id != rhs.id && get_user_data(h).subscription.contains(index);
+            });
+
+            auto& room = *rooms.get(*room_id);
+            auto& metrics = user_registry().metrics;
+            for(auto const* waiting : { &lhs, &rhs }) {
+                // The handles change as the users leave
+                auto handle = get_user_handle(waiting->id);
+
+                std::cout << "Send MatchFound\n";
+                send(handle, pong::packet::server::MatchFound{ *room_id });
+                leave_for(room, handle, RoomState::Matched{});
+
+                auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - waiting->since);
+                metrics.matchmaking_wait_milliseconds.observe(static_cast<std::uint64_t>(waited.count()));
+            }
+
+            metrics.matches.add();
+            return true;
+        });
+    }
+
+
+    // Users of the lobby, with the ones of the other servers
+    unsigned user_count() const {
+        return static_cast<unsigned>(number_of_user()) + (federation ? federation->remote_lobby_users() : 0);
+    }
+
+
+    void update_remote_room(pong::packet::server::RoomSummary const& summary) {
+        remote_rooms.update_room(summary);
+        snapshot.update_room(summary);
+        broadcast_to_subscribers(summary.id, pong::packet::server::RoomUpdate{ summary });
     }
 
-    std::vector<std::string> get_all_usernames_except(user_handle_t except_handle) const {
-        std::vector<std::string> usernames;
-        usernames.reserve(number_of_user() - 1);
+
+    void remove_remote_room(room_id_t room_id) {
+        if (find_remote_room(room_id)) {
+            remote_rooms.remove_room(room_id);
+            snapshot.remove_room(room_id);
+            broadcast_to_subscribers(room_id, pong::packet::server::OldRoom{ room_id });
+        }
+    }
 
 
-        for(user_handle_t h{ 0 }; h < number_of_user(); ++h) {
-            if (is_valid(h) && h != except_handle) {
-                usernames.emplace_back(get_user_data(h));
+    // When a server leaves the federation or the coordinator is lost
+    void remove_remote_rooms_if(std::function<bool(room_id_t)> const& predicate) {
+        auto stale_rooms = remote_rooms.rooms;
+        for(auto const& summary : stale_rooms) {
+            if (predicate(summary.id)) {
+                remove_remote_room(summary.id);
             }
         }
+    }
+
+
+    pong::packet::server::RoomSummary const* find_remote_room(room_id_t room_id) const {
+        auto it = std::find_if(std::begin(remote_rooms.rooms), std::end(remote_rooms.rooms), [room_id] (auto const& summary) {
+            return summary.id == room_id;
+        });
 
-        return usernames;
+        return it != std::end(remote_rooms.rooms) ? &*it : nullptr;
     }
 
-    Action on_create_room(user_handle_t handle, packet_t) {
-        // Find an ID without a room
-        std::size_t room_id{ 0 };
-        for(; room_id < rooms.size(); ++room_id) {
-            if (rooms[room_id] == nullptr || rooms[room_id]->is_empty()) {
-                break;
-            }
+
+    void on_room_changed(room_id_t room_id) {
+        auto& room = *rooms.get(room_id);
+        if (!room.summary_dirty) {
+            room.summary_dirty = true;
+            dirty_rooms.push_back(room_id);
         }
+    }
+
+
+    template<typename P>
+    void broadcast_to_subscribers(room_id_t room_id, P const& packet) {
+        auto index = static_cast<unsigned>(RoomRegistry::index_of(room_id));
+
+        broadcast_if(packet, [this, index] (user_handle_t handle) {
+            return get_user_data(handle).subscription.contains(index);
+        });
+    }
 
 
-        std::cout << "New room #" << room_id << " created\n";
+    static pong::packet::server::RoomSummary get_room_summary(RoomState const& room) {
+        return {
+            room.room_id,
+            static_cast<unsigned>(room.number_of_user()),
+            room.left_player != invalid_user_id || room.playback != nullptr,
+            room.right_player != invalid_user_id || room.playback != nullptr
+        };
+    }
 
 
-        if (room_id >= rooms.size()) {
-            rooms.emplace_back(std::make_unique<RoomState>(*this));
+    std::vector<pong::packet::server::RoomSummary> get_room_summaries(RoomRange range) const {
+        std::vector<pong::packet::server::RoomSummary> summaries;
 
+        auto last = std::min<std::size_t>(range.max_excluded, rooms.number_of_slot());
+        for(std::size_t index{ range.min }; index < last; ++index) {
+            auto const* room = rooms.get_at(index);
+            if (room && (!room->is_empty() || room->playback)) {
+                summaries.emplace_back(get_room_summary(*room));
+            }
+        }
 
-        } else if(rooms[room_id] == nullptr) {
-            rooms[room_id] = std::make_unique<RoomState>(*this);
+        return summaries;
+    }
 
+    Action on_create_room(user_handle_t handle, pong::packet::client::CreateRoom const&) {
+        if (auto const* node = federation ? federation->placement_node() : nullptr) {
+            std::cout << "Send Redirect to " << node->address << ':' << node->port << " for CreateRoom\n";
+            send(handle, pong::packet::server::Redirect{
+                pong::packet::server::Redirect::Request::CreateRoom, node->address, node->port, 0
+            });
+            return Idle{};
+        }
 
+        auto room_id = rooms.allocate(*this);
+        if (!room_id) {
+            std::cerr << "[Warning] Can't create a room, the maximum has been reached\n";
+            send(handle, pong::packet::server::CreateRoomResponse{
+                pong::packet::server::CreateRoomResponse::Reason::Unknown
+            });
+            return Idle{};
         }
 
+
+        std::cout << "New room #" << *room_id << " created\n";
+
+
         std::cout << "Send NewRoom\n";
-        broadcast_other(handle, pong::packet::server::NewRoom{
-            static_cast<unsigned>(room_id)
+        auto index = static_cast<unsigned>(RoomRegistry::index_of(*room_id));
+
+        broadcast_if(pong::packet::server::NewRoom{ *room_id }, [this, handle, index] (user_handle_t h) {
+            return h != handle && get_user_data(h).subscription.contains(index);
         });
 
         send(handle, pong::packet::server::CreateRoomResponse{
@@ -88,27 +271,31 @@ struct MainLobbyState : public State<MainLobbyState, user_t> {
         });
 
         return order_change_state(
-            *rooms[room_id],
-            handle,
-            get_user_data(handle)
+            *rooms.get(*room_id),
+            handle
         );
     }
 
 
-    Action on_enter_room(user_handle_t handle, packet_t packet) {
-        auto room_id = static_cast<std::size_t>(from_packet<pong::packet::client::EnterRoom>(packet).id);
-        if (room_id < rooms.size() && rooms[room_id] != nullptr) {
+    Action on_enter_room(user_handle_t handle, pong::packet::client::EnterRoom const& packet) {
+        room_id_t room_id = packet.id;
+        if (auto* room = rooms.get(room_id)) {
             std::cout << "Send EnterRoomResponse\n";
             send(handle, pong::packet::server::EnterRoomResponse{
                 pong::packet::server::EnterRoomResponse::Result::Okay
             });
 
             return order_change_state(
-                *rooms[room_id],
-                handle,
-                get_user_data(handle)
+                *room,
+                handle
             );
             
+        } else if (auto const* node = federation && find_remote_room(room_id) ? federation->node_of(room_id) : nullptr) {
+            std::cout << "Send Redirect to " << node->address << ':' << node->port << " for room #" << room_id << '\n';
+            send(handle, pong::packet::server::Redirect{
+                pong::packet::server::Redirect::Request::EnterRoom, node->address, node->port, room_id
+            });
+
         } else {
             std::cout << "Send EnterRoomResponse\n";
             send(handle, pong::packet::server::EnterRoomResponse{
@@ -120,30 +307,121 @@ struct MainLobbyState : public State<MainLobbyState, user_t> {
     }
 
 
-    void on_user_enter(user_handle_t handle) {
+    Action on_subscribe_room_info(user_handle_t handle, pong::packet::client::SubscribeRoomInfo const& subscription) {
 
-        auto room_ids = get_room_ids();
-        auto usernames = get_all_usernames_except(handle);
+        if (subscription.range_min > subscription.range_max_excluded 
+        ||  subscription.range_max_excluded - subscription.range_min > LobbyUser::max_subscription_size) {
+            std::cerr << "[Warning] Received invalid PacketID::SubscribeRoomInfo [" 
+                << subscription.range_min << ", " << subscription.range_max_excluded << ")\n";
+            return Idle{};
+        }
 
-        std::cout << "Send LobbyInfo with " << usernames.size() << " people\n";
-        send(handle, pong::packet::server::LobbyInfo{
-            std::move(usernames), std::move(room_ids)
-        });
+        auto& range = get_user_data(handle).subscription;
+        auto old_range = range;
+        range = { subscription.range_min, subscription.range_max_excluded };
 
-        std::cout << "Send NewUser\n";
-        broadcast_other(handle, pong::packet::server::NewUser{
-            get_user_data(handle)
-        });
+        auto in_range = [] (RoomRange const& r, pong::packet::server::RoomSummary const& summary) {
+            return r.contains(static_cast<unsigned>(RoomRegistry::index_of(summary.id)));
+        };
+
+        // The rooms that left the window are retracted, the user would keep them listed otherwise
+        for(auto& summary : get_room_summaries(old_range)) {
+            if (!in_range(range, summary)) {
+                send(handle, pong::packet::server::OldRoom{ summary.id });
+            }
+        }
+
+        for(auto const& summary : remote_rooms.rooms) {
+            if (in_range(old_range, summary) && !in_range(range, summary)) {
+                send(handle, pong::packet::server::OldRoom{ summary.id });
+            }
+        }
+
+
+        for(auto& summary : get_room_summaries(range)) {
+            send(handle, pong::packet::server::RoomUpdate{ summary });
+        }
+
+        for(auto const& summary : remote_rooms.rooms) {
+            if (in_range(range, summary)) {
+                send(handle, pong::packet::server::RoomUpdate{ summary });
+            }
+        }
+
+        return Idle{};
     }
 
 
+    Action on_find_match(user_handle_t handle, pong::packet::client::FindMatch const& packet) {
+        if (!matchmaker.enqueue(get_user_id(handle), packet.rating, matchmaker.now())) {
+            std::cerr << "[Warning] Received PacketID::FindMatch from a user already looking for a match\n";
+        }
 
-    void on_user_leave(user_handle_t handle) {
-        std::cout << "MainLobby::on_user_leave: Send OldUser\n";
-        broadcast_other(handle, pong::packet::server::OldUser{
-            get_user_data(handle)
+        return Idle{};
+    }
+
+
+    Action on_leave_matchmaking(user_handle_t handle, pong::packet::client::LeaveMatchmaking const&) {
+        if (matchmaker.remove(get_user_id(handle))) {
+            std::cout << "Send LeftMatchmaking\n";
+            send(handle, pong::packet::server::LeftMatchmaking{});
+        } else {
+            std::cerr << "[Warning] Received PacketID::LeaveMatchmaking from a user not looking for a match\n";
+        }
+
+        return Idle{};
+    }
+
+
+    void on_user_enter(user_handle_t handle) {
+        std::cout << "Send LobbyInfo with " << snapshot.rooms.size() << " rooms\n";
+        auto user_count = this->user_count();
+        auto packet_id = pong::packet::server::id_of<pong::packet::server::LobbyInfo>();
+        send_with(handle, packet_id, snapshot.frame_size(get_user(handle).encoding, user_count), [this, user_count] (auto& writer) {
+            snapshot.write_frame(writer, user_count);
         });
+
+        // The new count is broadcasted by `update_rooms`
+    }
+
+
+    void on_user_leave(user_handle_t handle) {
+        matchmaker.remove(get_user_id(handle));
     }
+
+
+    // Receive
+    using handlers = Handlers<
+        Handler<pong::packet::client::CreateRoom, &MainLobbyState::on_create_room>,
+        Handler<pong::packet::client::EnterRoom, &MainLobbyState::on_enter_room>,
+        Handler<pong::packet::client::SubscribeRoomInfo, &MainLobbyState::on_subscribe_room_info>,
+        Handler<pong::packet::client::FindMatch, &MainLobbyState::on_find_match>,
+        Handler<pong::packet::client::LeaveMatchmaking, &MainLobbyState::on_leave_matchmaking>
+    >;
+
 };
 
+
+inline void RoomState::notify_lobby() {
+    main_lobby.on_room_changed(room_id);
+}
+
+inline void RoomState::on_empty() {
+    if (!playback) {
+        main_lobby.rooms.schedule_reclaim(room_id);
+    }
+}
+
+inline void RoomState::start_recording() {
+    auto& rooms = main_lobby.rooms;
+    if (rooms.recording_directory.empty()) {
+        return;
+    }
+
+    auto path = rooms.recording_directory + "/match-" + std::to_string(std::time(nullptr)) + '-' + std::to_string(++rooms.recorded_matches) + ".match";
+    if (recorder.start(path, room_id, get_username(get_user_handle(left_player)).str(), get_username(get_user_handle(right_player)).str(), current_keyframe())) {
+        std::cout << "Recording the match of room #" << room_id << " in " << path << '\n';
+    }
+}
+
 }
\ No newline at end of file
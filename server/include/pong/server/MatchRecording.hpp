@@ -0,0 +1,519 @@
+#pragma once
+
+#include <multipong/Game.hpp>
+
+#include <pong/server/Common.hpp>
+
+#include <pong/packet/Encoding.hpp>
+#include <pong/packet/Server.hpp>
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pong::server {
+
+/*
+    Record of a match played in a RoomState: the inputs of the players, the scores and keyframes of the game
+
+    The file starts with `match_magic` (its last byte is the version), the room, the names of the players
+    and the time of the start, then the records follow:
+
+        [record type][time since the previous record, in microseconds of the match][content]
+
+    - Input: a player changed its input, [side][input]
+    - Score: [left][right], followed by the Keyframe of the new ball
+    - Keyframe: the ball and the pads, [8 floats as 4 bytes little endian], every `keyframe_period` of the match
+    - End: [GameOver::Result]
+
+    Integers are LEB128 varints (see Encoding.hpp). The records are stamped with the clock of the match (the sum of
+    the `dt` given to the game), not with the ticks: the server loop has no fixed rate.
+    A match costs a few bytes per second and per input, where its GameState stream costs ~1 KB per second and per spectator.
+    The file is only appended to, and written at each keyframe, so an ongoing match can be played back while it is recorded
+*/
+
+static constexpr std::array<char, 8> match_magic{ 'P', 'O', 'N', 'G', 'M', 'T', 'C', 1 };
+
+enum class MatchRecord : std::uint8_t {
+    Input,
+    Score,
+    Keyframe,
+    End
+};
+
+static constexpr std::size_t number_of_match_record{ 4 };
+
+
+struct MatchKeyframe {
+    pong::Ball ball;
+    pong::Pad pad_left;
+    pong::Pad pad_right;
+};
+
+
+
+
+struct MatchRecorder {
+
+    static constexpr std::chrono::seconds keyframe_period{ 5 };
+
+
+    MatchRecorder() = default;
+
+    MatchRecorder(MatchRecorder const&) = delete;
+    MatchRecorder& operator=(MatchRecorder const&) = delete;
+
+
+    bool is_recording() const {
+        return file.is_open();
+    }
+
+
+    /*
+        false if the file can't be created
+    */
+    bool start(std::string const& path, room_id_t room_id, std::string const& left_name, std::string const& right_name, MatchKeyframe const& keyframe) {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "[Warning] Can't create the recording " << path << '\n';
+            return false;
+        }
+
+        elapsed = 0;
+        last_time = 0;
+        last_keyframe = 0;
+
+        buffer.insert(std::end(buffer), reinterpret_cast<std::byte const*>(match_magic.data()), reinterpret_cast<std::byte const*>(match_magic.data()) + match_magic.size());
+        write_varint(room_id);
+        write_string(left_name);
+        write_string(right_name);
+        write_varint(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()));
+
+        add_keyframe(keyframe);
+        return true;
+    }
+
+
+    /*
+        The game was updated with `dt`
+    */
+    void advance(float dt) {
+        elapsed += static_cast<double>(dt);
+    }
+
+
+    bool keyframe_due() const {
+        return now() - last_keyframe >= std::chrono::duration_cast<std::chrono::microseconds>(keyframe_period).count();
+    }
+
+
+    void input(pong::Side side, pong::Input input) {
+        begin(MatchRecord::Input);
+        buffer.push_back(static_cast<std::byte>(side));
+        buffer.push_back(static_cast<std::byte>(input));
+    }
+
+
+    void score(pong::packet::server::Score const& score) {
+        begin(MatchRecord::Score);
+        write_varint(score.left);
+        write_varint(score.right);
+    }
+
+
+    void keyframe(MatchKeyframe const& keyframe) {
+        add_keyframe(keyframe);
+    }
+
+
+    void end(pong::packet::server::GameOver::Result result) {
+        begin(MatchRecord::End);
+        buffer.push_back(static_cast<std::byte>(result));
+
+        write_buffer();
+        file.close();
+    }
+
+
+private:
+
+    std::ofstream file;
+    std::vector<std::byte> buffer;
+
+    // Seconds of the match
+    double elapsed{ 0 };
+    // Microseconds of the match of the last record and the last keyframe
+    std::int64_t last_time{ 0 };
+    std::int64_t last_keyframe{ 0 };
+
+
+    std::int64_t now() const {
+        return std::llround(elapsed * 1e6);
+    }
+
+
+    void begin(MatchRecord record) {
+        auto time = now();
+        buffer.push_back(static_cast<std::byte>(record));
+        write_varint(static_cast<std::uint64_t>(time - last_time));
+        last_time = time;
+    }
+
+
+    void add_keyframe(MatchKeyframe const& keyframe) {
+        begin(MatchRecord::Keyframe);
+        for(auto value : { keyframe.ball.position.x, keyframe.ball.position.y, keyframe.ball.speed.x, keyframe.ball.speed.y,
+                           keyframe.pad_left.y, keyframe.pad_left.speed, keyframe.pad_right.y, keyframe.pad_right.speed }) {
+            auto bits = std::bit_cast<std::uint32_t>(value);
+            for(int i{ 0 }; i < 4; ++i) {
+                buffer.push_back(static_cast<std::byte>(bits >> (8 * i)));
+            }
+        }
+
+        last_keyframe = last_time;
+        write_buffer();
+    }
+
+
+    void write_varint(std::uint64_t value) {
+        for(; value >= 0x80; value >>= 7) {
+            buffer.push_back(static_cast<std::byte>(value | 0x80));
+        }
+        buffer.push_back(static_cast<std::byte>(value));
+    }
+
+
+    void write_string(std::string const& string) {
+        write_varint(string.size());
+        buffer.insert(std::end(buffer), reinterpret_cast<std::byte const*>(string.data()), reinterpret_cast<std::byte const*>(string.data()) + string.size());
+    }
+
+
+    void write_buffer() {
+        file.write(reinterpret_cast<char const*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        file.flush();
+        buffer.clear();
+
+        if (!file) {
+            std::cerr << "[Warning] Can't write the recording, the match isn't recorded anymore\n";
+            file.close();
+        }
+    }
+
+};
+
+
+
+
+/*
+    Plays a recording back, memory-mapped: the records are read in place, in the order of the match
+
+    `advance` gives the records reached by the clock of the playback, the game is simulated between them by the room.
+    At the end of the mapped bytes without an End record, the match is still recorded:
+    the file is mapped again if it grew, checked at most every `remap_period` of playback
+*/
+struct MatchPlayback {
+
+    static constexpr std::chrono::seconds remap_period{ 1 };
+
+
+    struct Event {
+        MatchRecord record;
+        pong::Side side;
+        pong::Input input;
+        pong::packet::server::Score score;
+        MatchKeyframe keyframe;
+        pong::packet::server::GameOver::Result result;
+    };
+
+
+    MatchPlayback() = default;
+
+    MatchPlayback(MatchPlayback const&) = delete;
+    MatchPlayback& operator=(MatchPlayback const&) = delete;
+
+    ~MatchPlayback() {
+        unmap();
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+
+    /*
+        false if the file can't be mapped or isn't a recording
+    */
+    bool open(std::string const& _path) {
+        path = _path;
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0 || !map()) {
+            return false;
+        }
+
+        if (size < match_magic.size() || std::memcmp(data, match_magic.data(), match_magic.size()) != 0) {
+            return false;
+        }
+
+        position = match_magic.size();
+        room_id = static_cast<room_id_t>(read_varint());
+        left_name = read_string();
+        right_name = read_string();
+        start_time = read_varint();
+
+        first_record = position;
+        return !error;
+    }
+
+
+    /*
+        Call `f` with the events up to the current time, then move the clock by `dt`
+    */
+    template<typename F>
+    void advance(float dt, F&& f) {
+        while(!ended && !error) {
+            if (position == size && !remap()) {
+                break;
+            }
+
+            auto record_start = position;
+            auto type = read_byte();
+            auto time = next_time + static_cast<std::int64_t>(read_varint());
+
+            Event event{};
+            event.record = static_cast<MatchRecord>(type);
+            if (type >= number_of_match_record) {
+                error = true;
+                break;
+            }
+
+            if (!error && time > now()) {
+                position = record_start;
+                break;
+            }
+
+            // The end of the record isn't written yet
+            if (error || !read_content(event)) {
+                position = record_start;
+                error = false;
+                if (!remap()) {
+                    break;
+                }
+                continue;
+            }
+
+            next_time = time;
+            ended = event.record == MatchRecord::End;
+            f(event);
+        }
+
+        elapsed += static_cast<double>(dt);
+    }
+
+
+    /*
+        The End record was played
+    */
+    bool finished() const {
+        return ended;
+    }
+
+
+    void rewind() {
+        position = first_record;
+        next_time = 0;
+        elapsed = 0;
+        ended = false;
+    }
+
+
+    /*
+        Where the playback is, to go on from there in another process (see HotRestart.hpp)
+    */
+    struct Progress {
+        std::uint64_t position;
+        std::int64_t next_time;
+        double elapsed;
+        bool ended;
+    };
+
+
+    Progress progress() const {
+        return { position, next_time, elapsed, ended };
+    }
+
+
+    /*
+        Back to a progress of the same recording, from the start if it isn't in the mapped bytes
+    */
+    void seek(Progress const& progress) {
+        if (progress.position < first_record || progress.position > size) {
+            return rewind();
+        }
+
+        position = static_cast<std::size_t>(progress.position);
+        next_time = progress.next_time;
+        elapsed = progress.elapsed;
+        ended = progress.ended;
+    }
+
+
+    std::string path;
+    room_id_t room_id{ 0 };
+    std::string left_name;
+    std::string right_name;
+    // Seconds since the epoch
+    std::uint64_t start_time{ 0 };
+
+
+private:
+
+    int fd{ -1 };
+    std::byte const* data{ nullptr };
+    std::size_t size{ 0 };
+
+    std::size_t position{ 0 };
+    std::size_t first_record{ 0 };
+    bool error{ false };
+    bool ended{ false };
+
+    // Time of the last record played, in microseconds of the match
+    std::int64_t next_time{ 0 };
+    double elapsed{ 0 };
+    double last_remap{ 0 };
+
+
+    std::int64_t now() const {
+        return std::llround(elapsed * 1e6);
+    }
+
+
+    bool map() {
+        struct stat status;
+        if (::fstat(fd, &status) != 0 || status.st_size <= 0) {
+            return false;
+        }
+
+        auto* mapping = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+
+        unmap();
+        data = static_cast<std::byte const*>(mapping);
+        size = static_cast<std::size_t>(status.st_size);
+        return true;
+    }
+
+
+    void unmap() {
+        if (data != nullptr) {
+            ::munmap(const_cast<std::byte*>(data), size);
+            data = nullptr;
+        }
+    }
+
+
+    bool remap() {
+        if (elapsed - last_remap < static_cast<double>(remap_period.count())) {
+            return false;
+        }
+
+        last_remap = elapsed;
+        auto old_size = size;
+        return map() && size > old_size;
+    }
+
+
+    /*
+        false if the record is incomplete
+    */
+    bool read_content(Event& event) {
+        switch(event.record) {
+            case MatchRecord::Input:
+                event.side = static_cast<pong::Side>(read_byte());
+                event.input = static_cast<pong::Input>(read_byte());
+                break;
+
+            case MatchRecord::Score:
+                event.score.left = static_cast<unsigned>(read_varint());
+                event.score.right = static_cast<unsigned>(read_varint());
+                break;
+
+            case MatchRecord::Keyframe: {
+                std::array<float, 8> values{};
+                for(auto& value : values) {
+                    std::uint32_t bits{ 0 };
+                    for(int i{ 0 }; i < 4; ++i) {
+                        bits |= static_cast<std::uint32_t>(read_byte()) << (8 * i);
+                    }
+                    value = std::bit_cast<float>(bits);
+                }
+
+                event.keyframe.ball = pong::Ball{ { values[0], values[1] }, { values[2], values[3] } };
+                event.keyframe.pad_left = pong::Pad{ values[4], values[5] };
+                event.keyframe.pad_right = pong::Pad{ values[6], values[7] };
+                break;
+            }
+
+            case MatchRecord::End:
+                event.result = static_cast<pong::packet::server::GameOver::Result>(read_byte());
+                break;
+        }
+
+        return !error;
+    }
+
+
+    std::uint8_t read_byte() {
+        if (position >= size) {
+            error = true;
+            return 0;
+        }
+
+        return std::to_integer<std::uint8_t>(data[position++]);
+    }
+
+
+    std::uint64_t read_varint() {
+        std::uint64_t value{ 0 };
+        for(std::size_t i{ 0 }; i < pong::packet::details::max_varint_size(sizeof(std::uint64_t)); ++i) {
+            auto byte = read_byte();
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << (7 * i);
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+
+        error = true;
+        return 0;
+    }
+
+
+    std::string read_string() {
+        auto length = read_varint();
+        if (length > pong::packet::max_username_size || length > size - position) {
+            error = true;
+            return {};
+        }
+
+        std::string string(reinterpret_cast<char const*>(data + position), length);
+        position += length;
+        return string;
+    }
+
+};
+
+}
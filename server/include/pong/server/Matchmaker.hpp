@@ -0,0 +1,237 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/UserQueue.hpp>
+#include <pong/server/UserRegistry.hpp>
+
+#include <pong/packet/Client.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Users paired since the start of the server, and the time they waited
+*/
+struct MatchmakingCounters {
+    std::size_t matches{ 0 };
+    std::size_t users{ 0 };
+    std::chrono::steady_clock::duration waited{ 0 };
+};
+
+
+/*
+    Users of the lobby looking for an opponent, paired across the rooms (see `MainLobbyState::update_matchmaking`)
+
+    The users wait in a UserQueue per bucket of `bucket_width` rating points, the unrated ones in their own bucket:
+    entering and leaving are O(1), and a pass only looks at the first user of each bucket. A pass pairs:
+        - the first two users of a bucket, until one is left at most
+        - the users left in two neighbouring buckets, if the gap of their ratings is in the window of one of them
+          (`initial_rating_window`, growing by `rating_window_growth` per second waited)
+        - the unrated user left with the rated one that waited the most
+
+    The time waited is the one of the ticks (see `advance`), not of the wall clock: a capture replays the same pairs
+*/
+struct Matchmaker {
+
+    using clock = std::chrono::steady_clock;
+
+    static constexpr unsigned max_rating{ 5000 };
+    static constexpr unsigned bucket_width{ 100 };
+    static constexpr unsigned initial_rating_window{ 100 };
+    static constexpr unsigned rating_window_growth{ 50 /* per second */ };
+
+    // The unrated users, then the buckets up to `max_rating` included
+    static constexpr std::size_t number_of_bucket{ 1 + max_rating / bucket_width + 1 };
+
+
+    struct Waiting {
+        user_id_t id;
+        unsigned rating;
+        clock::time_point since;
+    };
+
+
+    Matchmaker(UserRegistry& registry) {
+        for(std::size_t bucket{ 0 }; bucket < number_of_bucket; ++bucket) {
+            buckets.emplace_back(registry);
+        }
+    }
+
+    Matchmaker(Matchmaker const&) = delete;
+    Matchmaker& operator=(Matchmaker const&) = delete;
+
+
+    MatchmakingCounters counters;
+
+
+    // Time of the ticks since the start of the matchmaker, the users wait from it
+    clock::time_point now() const {
+        return current_time;
+    }
+
+
+    // Called once per tick with its duration, the one written in the capture
+    void advance(clock::duration elapsed) {
+        current_time += elapsed;
+    }
+
+
+    /*
+        `since` is when the user started waiting, false if it's already waiting
+    */
+    bool enqueue(user_id_t id, unsigned rating, clock::time_point since) {
+        auto bucket = bucket_of(rating);
+        if (!buckets[bucket].push_back(id)) {
+            return false;
+        }
+
+        auto index = UserRegistry::index_of(id);
+        if (index >= entries.size()) {
+            entries.resize(index + 1);
+        }
+
+        entries[index] = { id, rating, since };
+        ++waiting_count;
+        return true;
+    }
+
+
+    bool remove(user_id_t id) {
+        auto const* entry = find(id);
+        if (entry == nullptr || !buckets[bucket_of(entry->rating)].remove(id)) {
+            return false;
+        }
+
+        entries[UserRegistry::index_of(id)].id = invalid_user_id;
+        --waiting_count;
+        return true;
+    }
+
+
+    // nullptr if the user isn't waiting
+    Waiting const* find(user_id_t id) const {
+        auto index = UserRegistry::index_of(id);
+        if (id == invalid_user_id || index >= entries.size() || entries[index].id != id) {
+            return nullptr;
+        }
+
+        return &entries[index];
+    }
+
+
+    std::size_t number_of_waiting() const {
+        return waiting_count;
+    }
+
+
+    /*
+        Pair the users that can be, `on_match(Waiting const&, Waiting const&)` is called for each pair once they left the matchmaking
+        If it returns false (no room for them), both wait again and the pass stops
+    */
+    template<typename F>
+    void match(clock::time_point now, F&& on_match) {
+        auto pair = [this, now, &on_match] (user_id_t lhs_id, user_id_t rhs_id) {
+            auto lhs = *find(lhs_id);
+            auto rhs = *find(rhs_id);
+            remove(lhs_id);
+            remove(rhs_id);
+
+            if (!on_match(lhs, rhs)) {
+                enqueue(lhs.id, lhs.rating, lhs.since);
+                enqueue(rhs.id, rhs.rating, rhs.since);
+                return false;
+            }
+
+            ++counters.matches;
+            counters.users += 2;
+            counters.waited += (now - lhs.since) + (now - rhs.since);
+            return true;
+        };
+
+
+        for(auto& bucket : buckets) {
+            while(bucket.size() >= 2) {
+                auto first = bucket.front();
+                if (!pair(first, bucket.next_of(first))) {
+                    return;
+                }
+            }
+        }
+
+
+        // One user is left per bucket at most, the closest ratings are in neighbouring buckets
+        user_id_t previous{ invalid_user_id };
+        for(std::size_t bucket{ 1 }; bucket < number_of_bucket; ++bucket) {
+            auto id = buckets[bucket].front();
+            if (id == invalid_user_id) {
+                continue;
+            }
+
+            if (previous != invalid_user_id && in_window(*find(previous), *find(id), now)) {
+                if (!pair(previous, id)) {
+                    return;
+                }
+                previous = invalid_user_id;
+            } else {
+                previous = id;
+            }
+        }
+
+
+        if (auto unrated = buckets[0].front(); unrated != invalid_user_id) {
+            user_id_t oldest{ invalid_user_id };
+            for(std::size_t bucket{ 1 }; bucket < number_of_bucket; ++bucket) {
+                auto id = buckets[bucket].front();
+                if (id != invalid_user_id && (oldest == invalid_user_id || find(id)->since < find(oldest)->since)) {
+                    oldest = id;
+                }
+            }
+
+            if (oldest != invalid_user_id) {
+                pair(unrated, oldest);
+            }
+        }
+    }
+
+
+private:
+
+
+    static std::size_t bucket_of(unsigned rating) {
+        if (rating == pong::packet::client::no_rating) {
+            return 0;
+        }
+
+        return 1 + std::min(rating, max_rating) / bucket_width;
+    }
+
+
+    static unsigned window_of(Waiting const& waiting, clock::time_point now) {
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(now - waiting.since).count();
+        return initial_rating_window + rating_window_growth * static_cast<unsigned>(std::max<decltype(seconds)>(seconds, 0));
+    }
+
+
+    static bool in_window(Waiting const& lhs, Waiting const& rhs, clock::time_point now) {
+        auto gap = lhs.rating > rhs.rating ? lhs.rating - rhs.rating : rhs.rating - lhs.rating;
+        return gap <= std::max(window_of(lhs, now), window_of(rhs, now));
+    }
+
+
+    // UserQueue can't be moved, a deque doesn't move its elements
+    std::deque<UserQueue> buckets;
+
+    // Indexed by the slot of the user (see `UserRegistry::index_of`), `id` is `invalid_user_id` if it isn't waiting
+    std::vector<Waiting> entries;
+    std::size_t waiting_count{ 0 };
+
+    clock::time_point current_time{};
+
+};
+
+}
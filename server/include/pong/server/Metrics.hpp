@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Metrics of the server, exposed as text by the MetricsEndpoint (see MetricsEndpoint.hpp)
+
+    Counters and histograms are split in shards, one per thread (modulo `number_of_shard`), each on its own cache line:
+    an update is an uncontended relaxed atomic add, the shards are only summed when the metrics are written.
+    Gauges are set by the thread owning the value, usually once per report.
+
+    The metrics are registered in a MetricsRegistry before the endpoint starts, their addresses are stable.
+    The text is the exposition format of Prometheus:
+
+        # HELP pong_packets_received_total Packets received, per type
+        # TYPE pong_packets_received_total counter
+        pong_packets_received_total{packet="ChangeUsername"} 12
+*/
+
+static constexpr std::size_t number_of_shard{ 8 };
+
+
+/*
+    Shard of the calling thread, the threads are numbered in the order of their first update
+*/
+inline std::size_t shard_of_thread() {
+    static std::atomic<std::size_t> next_thread{ 0 };
+    thread_local std::size_t shard{ next_thread.fetch_add(1, std::memory_order_relaxed) % number_of_shard };
+    return shard;
+}
+
+
+
+
+struct Counter {
+
+    void add(std::uint64_t count = 1) {
+        shards[shard_of_thread()].value.fetch_add(count, std::memory_order_relaxed);
+    }
+
+
+    std::uint64_t value() const {
+        std::uint64_t total{ 0 };
+        for(auto const& shard : shards) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+
+private:
+
+
+    struct alignas(64) Shard {
+        std::atomic<std::uint64_t> value{ 0 };
+    };
+
+    std::array<Shard, number_of_shard> shards;
+};
+
+
+
+
+struct Gauge {
+
+    void set(std::int64_t _value) {
+        current.store(_value, std::memory_order_relaxed);
+    }
+
+
+    std::int64_t value() const {
+        return current.load(std::memory_order_relaxed);
+    }
+
+
+private:
+
+    std::atomic<std::int64_t> current{ 0 };
+};
+
+
+
+
+/*
+    Distribution of integer values in power of two buckets: the bucket `i` counts the values up to 2^i
+    The last bucket counts the values above 2^(number_of_bucket - 2)
+*/
+struct Histogram {
+
+    static constexpr std::size_t number_of_bucket{ 32 };
+
+
+    static constexpr std::uint64_t upper_bound(std::size_t bucket) {
+        return std::uint64_t{ 1 } << bucket;
+    }
+
+
+    static std::size_t bucket_of(std::uint64_t value) {
+        std::size_t bucket = value <= 1 ? 0 : std::bit_width(value - 1);
+        return std::min(bucket, number_of_bucket - 1);
+    }
+
+
+    void observe(std::uint64_t value) {
+        auto& shard = shards[shard_of_thread()];
+        shard.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+
+    /*
+        Count of each bucket (not cumulative), and sum of the values
+    */
+    std::pair<std::array<std::uint64_t, number_of_bucket>, std::uint64_t> value() const {
+        std::array<std::uint64_t, number_of_bucket> counts{};
+        std::uint64_t sum{ 0 };
+
+        for(auto const& shard : shards) {
+            for(std::size_t i{ 0 }; i < number_of_bucket; ++i) {
+                counts[i] += shard.buckets[i].load(std::memory_order_relaxed);
+            }
+            sum += shard.sum.load(std::memory_order_relaxed);
+        }
+
+        return { counts, sum };
+    }
+
+
+private:
+
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<std::uint64_t>, number_of_bucket> buckets{};
+        std::atomic<std::uint64_t> sum{ 0 };
+    };
+
+    std::array<Shard, number_of_shard> shards;
+};
+
+
+
+
+/*
+    Gauges whose labels change while the server runs, e.g. one per room
+    The owner replaces all of them at once, a mutex protects them from the endpoint
+*/
+struct GaugeSet {
+
+    void replace(std::vector<std::pair<std::string, std::int64_t>>& _values) {
+        std::lock_guard lock{ mutex };
+        values.swap(_values);
+    }
+
+
+    template<typename F>
+    void for_each(F&& f) const {
+        std::lock_guard lock{ mutex };
+        for(auto const& [labels, value] : values) {
+            f(labels, value);
+        }
+    }
+
+
+private:
+
+    mutable std::mutex mutex;
+    std::vector<std::pair<std::string, std::int64_t>> values;
+};
+
+
+
+
+
+struct MetricsRegistry {
+
+    /*
+        `labels` is the list of the labels of the metric, as written between the braces: `packet="Input"`
+    */
+    Counter& counter(std::string const& name, std::string const& help, std::string const& labels = "") {
+        return add(counters, name, help, "counter", labels);
+    }
+
+
+    Gauge& gauge(std::string const& name, std::string const& help, std::string const& labels = "") {
+        return add(gauges, name, help, "gauge", labels);
+    }
+
+
+    Histogram& histogram(std::string const& name, std::string const& help, std::string const& labels = "") {
+        return add(histograms, name, help, "histogram", labels);
+    }
+
+
+    /*
+        Its gauges are labeled with `label`
+    */
+    GaugeSet& gauge_set(std::string const& name, std::string const& help, std::string const& label) {
+        auto& set = gauge_sets.emplace_back();
+        families.push_back({ name, help, "gauge", {} });
+        families.back().metrics.push_back({ label, &set });
+        return set;
+    }
+
+
+    void write_text(std::ostream& os) const {
+        for(auto const& family : families) {
+            os << "# HELP " << family.name << ' ' << family.help << '\n';
+            os << "# TYPE " << family.name << ' ' << family.type << '\n';
+
+            for(auto const& [labels, metric] : family.metrics) {
+                write_metric(os, family.name, labels, metric);
+            }
+        }
+    }
+
+
+private:
+
+
+    using metric_t = std::variant<Counter const*, Gauge const*, Histogram const*, GaugeSet const*>;
+
+    struct Family {
+        std::string name;
+        std::string help;
+        char const* type;
+        std::vector<std::pair<std::string, metric_t>> metrics;
+    };
+
+
+    // Deques: the metrics never move once registered
+    std::deque<Counter> counters;
+    std::deque<Gauge> gauges;
+    std::deque<Histogram> histograms;
+    std::deque<GaugeSet> gauge_sets;
+
+    // In the order of their registration, the metrics of a family are registered together
+    std::vector<Family> families;
+
+
+    template<typename M>
+    M& add(std::deque<M>& metrics, std::string const& name, std::string const& help, char const* type, std::string const& labels) {
+        auto& metric = metrics.emplace_back();
+
+        if (families.empty() || families.back().name != name) {
+            families.push_back({ name, help, type, {} });
+        }
+        families.back().metrics.push_back({ labels, &metric });
+
+        return metric;
+    }
+
+
+    static std::string with_labels(std::string const& labels, std::string const& extra = "") {
+        if (labels.empty() && extra.empty()) {
+            return "";
+        }
+
+        return "{" + labels + (labels.empty() || extra.empty() ? "" : ",") + extra + "}";
+    }
+
+
+    static void write_metric(std::ostream& os, std::string const& name, std::string const& labels, metric_t const& metric) {
+        if (auto* counter = std::get_if<Counter const*>(&metric)) {
+            os << name << with_labels(labels) << ' ' << (*counter)->value() << '\n';
+        }
+        else if (auto* gauge = std::get_if<Gauge const*>(&metric)) {
+            os << name << with_labels(labels) << ' ' << (*gauge)->value() << '\n';
+        }
+        else if (auto* set = std::get_if<GaugeSet const*>(&metric)) {
+            (*set)->for_each([&os, &name, &labels] (std::string const& value_label, std::int64_t value) {
+                os << name << '{' << labels << "=\"" << value_label << "\"} " << value << '\n';
+            });
+        }
+        else if (auto* histogram = std::get_if<Histogram const*>(&metric)) {
+            auto [counts, sum] = (*histogram)->value();
+
+            std::uint64_t cumulated{ 0 };
+            for(std::size_t i{ 0 }; i + 1 < Histogram::number_of_bucket; ++i) {
+                cumulated += counts[i];
+                os << name << "_bucket" << with_labels(labels, "le=\"" + std::to_string(Histogram::upper_bound(i)) + "\"") << ' ' << cumulated << '\n';
+            }
+            cumulated += counts.back();
+
+            os << name << "_bucket" << with_labels(labels, "le=\"+Inf\"") << ' ' << cumulated << '\n';
+            os << name << "_sum" << with_labels(labels) << ' ' << sum << '\n';
+            os << name << "_count" << with_labels(labels) << ' ' << cumulated << '\n';
+        }
+    }
+
+};
+
+}
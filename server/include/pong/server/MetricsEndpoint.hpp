@@ -0,0 +1,163 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+
+#include <pong/server/Metrics.hpp>
+#include <pong/server/TcpSocket.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace pong::server {
+
+/*
+    Serve the text of a MetricsRegistry on a local port, from its own thread
+
+    Each connection gets the metrics as an HTTP/1.0 response and is closed, so `curl` and Prometheus can scrape it:
+
+        curl http://127.0.0.1:48625/metrics
+
+    The request is read but not interpreted, any path gets the metrics.
+    A scraper that sends nothing or doesn't read the response is dropped after `request_timeout`, `stop` never waits more.
+    The metrics are read with relaxed atomics, the game thread only waits for the endpoint
+    when it replaces a GaugeSet while the endpoint writes it
+*/
+struct MetricsEndpoint {
+
+    static constexpr unsigned short default_port{ 48625 };
+
+    // How long the endpoint sleeps when no connection is waiting, the latency of `stop`
+    static constexpr std::chrono::milliseconds poll_period{ 100 };
+    static constexpr std::chrono::milliseconds request_timeout{ 1000 };
+
+
+    MetricsEndpoint(MetricsRegistry const& _registry) : registry{ _registry } {}
+
+    MetricsEndpoint(MetricsEndpoint const&) = delete;
+    MetricsEndpoint& operator=(MetricsEndpoint const&) = delete;
+
+    ~MetricsEndpoint() {
+        stop();
+    }
+
+
+    /*
+        false if the port can't be listened to
+    */
+    bool start(unsigned short port) {
+        if (listener.listen(port, sf::IpAddress::LocalHost) != sf::Socket::Done) {
+            return false;
+        }
+
+        listener.setBlocking(false);
+        thread = std::thread{ [this] { run(); } };
+        return true;
+    }
+
+
+    /*
+        Serve on the listener of the server this one replaces, see HotRestart.hpp
+    */
+    void adopt(sf::SocketHandle handle) {
+        listener.adopt(handle);
+        listener.setBlocking(false);
+        thread = std::thread{ [this] { run(); } };
+    }
+
+
+    bool is_started() const {
+        return thread.joinable();
+    }
+
+
+    sf::SocketHandle handle() const {
+        return listener.handle();
+    }
+
+
+    void stop() {
+        stopping = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+
+private:
+
+
+    MetricsRegistry const& registry;
+
+    TcpListener listener;
+    std::thread thread;
+    std::atomic_bool stopping{ false };
+
+
+    void run() {
+        while(!stopping) {
+            sf::TcpSocket client;
+            if (listener.accept(client) != sf::Socket::Done) {
+                std::this_thread::sleep_for(poll_period);
+                continue;
+            }
+
+            serve(client);
+        }
+    }
+
+
+    void serve(sf::TcpSocket& client) {
+        auto deadline = std::chrono::steady_clock::now() + request_timeout;
+        client.setBlocking(false);
+
+        sf::SocketSelector selector;
+        selector.add(client);
+        if (!selector.wait(sf::milliseconds(static_cast<sf::Int32>(request_timeout.count())))) {
+            std::cerr << "[Warning] The scraper sent no request\n";
+            client.disconnect();
+            return;
+        }
+
+        // The request fits in a segment, nothing is done with it
+        std::array<char, 1024> request;
+        std::size_t received{ 0 };
+        client.receive(request.data(), request.size(), received);
+
+
+        std::ostringstream body;
+        registry.write_text(body);
+        auto text = body.str();
+
+        std::string response = "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + std::to_string(text.size()) + "\r\n"
+            "\r\n" + text;
+
+        std::size_t written{ 0 };
+        while(written < response.size()) {
+            std::size_t sent{ 0 };
+            auto status = client.send(response.data() + written, response.size() - written, sent);
+            written += sent;
+
+            if (status == sf::Socket::Done) {
+                break;
+            }
+            if ((status != sf::Socket::Partial && status != sf::Socket::NotReady) || std::chrono::steady_clock::now() >= deadline) {
+                std::cerr << "[Warning] Couldn't send the metrics\n";
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+        }
+
+        client.disconnect();
+    }
+
+};
+
+}
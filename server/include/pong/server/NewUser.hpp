@@ -5,9 +5,11 @@
 
 #include <pong/server/MainLobby.hpp>
 
+#include <string_view>
+
 namespace pong::server {
 
-bool is_username_valid(std::string const& username) {
+inline bool is_username_valid(std::string_view username) {
     if (username.size() < 3) {
         std::cout << '"' << username << '"' << " is too short\n";
         return false;
@@ -31,29 +33,29 @@ bool is_username_valid(std::string const& username) {
 
 
 
-struct NewUserState : public State<NewUserState> {
-    NewUserState(MainLobbyState& _main_lobby) : State({
-
-
-        // Receive
-        { id_of(pong::packet::client::ChangeUsername{}), &NewUserState::on_username_changed }
-
-
-    }), main_lobby{ _main_lobby } {}
-
+/*
+    Log in of a connection, then the user goes to `L`: the MainLobbyState of a server, the RelayLobbyState of a relay
+*/
+template<typename L>
+struct BasicNewUserState : public State<BasicNewUserState<L>> {
+    BasicNewUserState(UserRegistry& _registry, L& _main_lobby, UsernameTable& _usernames) 
+    :   State<BasicNewUserState<L>>(_registry)
+    ,   main_lobby{ _main_lobby }
+    ,   usernames{ _usernames } {}
     
     
-    MainLobbyState& main_lobby;
+    L& main_lobby;
+    UsernameTable& usernames;
 
 
 
-    Action on_username_changed(user_handle_t handle, packet_t packet) {
-        auto username = from_packet<pong::packet::client::ChangeUsername>(packet).username;
+    Action on_username_changed(user_handle_t handle, pong::packet::client::ChangeUsernameView const& packet) {
+        auto username = packet.username;
 
         auto response = is_username_valid(username);
 
         std::cout << "Send ChangeUsernameResponse\n";
-        send(handle, pong::packet::server::ChangeUsernameResponse{
+        this->send(handle, pong::packet::server::ChangeUsernameResponse{
             response
         });
 
@@ -64,13 +66,36 @@ struct NewUserState : public State<NewUserState> {
 
         std::cout << username << " is now connected\n";
 
-        return order_change_state(
+        this->get_user(handle).username = usernames.intern(username);
+
+        return this->order_change_state(
             main_lobby,
-            handle,
-            username
+            handle
         );
 
     }
+
+
+    Action on_capabilities(user_handle_t handle, pong::packet::client::Capabilities const& capabilities) {
+        auto& user = this->get_user(handle);
+        user.compressed_frames = (capabilities.flags & pong::packet::Capability::CompressedFrames) != 0;
+
+        // From the next frame, both ways
+        user.encoding = (capabilities.flags & pong::packet::Capability::CompactEncoding) != 0 ?
+                pong::packet::Encoding::Compact
+            :   pong::packet::Encoding::Sfml;
+        return Idle{};
+    }
+
+
+    // Receive
+    using handlers = Handlers<
+        Handler<pong::packet::client::ChangeUsername, &BasicNewUserState::on_username_changed>,
+        Handler<pong::packet::client::Capabilities, &BasicNewUserState::on_capabilities>
+    >;
 };
 
+
+using NewUserState = BasicNewUserState<MainLobbyState>;
+
 }
\ No newline at end of file
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+
+#include <pong/packet/Client.hpp>
+#include <pong/packet/Server.hpp>
+#include <pong/packet/Encoding.hpp>
+#include <pong/packet/Compression.hpp>
+#include <pong/packet/Reader.hpp>
+#include <pong/packet/Writer.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Address of the server a relay forwards, and the name its connections log in with
+*/
+struct Origin {
+    sf::IpAddress address;
+    unsigned short port;
+    std::string username;
+};
+
+
+/*
+    Connection of a relay to its origin server, as a client
+
+    The connection is made without blocking the relay, by `connect_async`.
+    It negotiates `Encoding::Compact` and the compressed frames, logs in with the name of the relay
+    and is then non-blocking: the frames are read by `receive` and written by `flush`, once per tick.
+    `receive` gives the decoded packets, a frame that can't be decoded closes the connection
+*/
+struct OriginConnection {
+
+    static constexpr std::size_t receive_size{ 4096 };
+
+
+    OriginConnection() = default;
+
+    OriginConnection(OriginConnection const&) = delete;
+    OriginConnection& operator=(OriginConnection const&) = delete;
+
+
+    enum class ConnectStatus {
+        Connected,
+        Connecting,
+        Failed
+    };
+
+
+    /*
+        Connection made by another thread, the relay ticks meanwhile: checked by `check_connect`
+    */
+    void connect_async(Origin const& origin, sf::Time timeout) {
+        username = origin.username;
+        future_socket = std::async(std::launch::async, [address = origin.address, port = origin.port, timeout] () -> std::unique_ptr<sf::TcpSocket> {
+            auto new_socket = std::make_unique<sf::TcpSocket>();
+            if (new_socket->connect(address, port, timeout) != sf::Socket::Done) {
+                return nullptr;
+            }
+
+            return new_socket;
+        });
+    }
+
+
+    bool is_connecting() const {
+        return future_socket.valid();
+    }
+
+
+    /*
+        Once connected, the ChangeUsername is sent by the next `flush`
+    */
+    ConnectStatus check_connect() {
+        if (!future_socket.valid() || future_socket.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready) {
+            return ConnectStatus::Connecting;
+        }
+
+        socket = future_socket.get();
+        if (!socket) {
+            return ConnectStatus::Failed;
+        }
+
+        socket->setBlocking(false);
+        connected = true;
+        encoding = pong::packet::Encoding::Sfml;
+        input_buffer.clear();
+        output_buffer.clear();
+
+        // Always in `Encoding::Sfml`, the frames after it are compact
+        send(pong::packet::client::Capabilities{ pong::packet::CompactEncoding | pong::packet::CompressedFrames });
+        encoding = pong::packet::Encoding::Compact;
+
+        send(pong::packet::client::ChangeUsername{ username });
+        return ConnectStatus::Connected;
+    }
+
+
+    bool is_connected() const {
+        return connected;
+    }
+
+
+    void disconnect() {
+        if (connected) {
+            socket->disconnect();
+            connected = false;
+        }
+    }
+
+
+    template<typename P>
+    void send(P const& client_packet) {
+        auto size = pong::packet::details::frame_size(client_packet, encoding);
+        auto offset = output_buffer.size();
+        output_buffer.resize(offset + size);
+
+        pong::packet::details::Writer writer{ output_buffer.data() + offset, encoding };
+        pong::packet::details::write_frame(writer, pong::packet::client::id_of<P>(), client_packet);
+    }
+
+
+    /*
+        Call `on_packet(pong::packet::server::Any const&)` with each packet received since the last call
+    */
+    template<typename F>
+    void receive(F&& on_packet) {
+        while(connected) {
+            auto offset = input_buffer.size();
+            input_buffer.resize(offset + receive_size);
+
+            std::size_t received{ 0 };
+            auto status = socket->receive(input_buffer.data() + offset, receive_size, received);
+            input_buffer.resize(offset + received);
+
+            if (status == sf::Socket::NotReady) {
+                break;
+            }
+            if (status != sf::Socket::Done) {
+                std::cerr << "[Warning] The connection to the origin is closed\n";
+                disconnect();
+                break;
+            }
+
+            bytes_received += received;
+        }
+
+
+        std::size_t position{ 0 };
+        while(connected && input_buffer.size() - position >= sizeof(sf::Uint32)) {
+            pong::packet::details::Reader header{ input_buffer.data() + position, sizeof(sf::Uint32) };
+            sf::Uint32 size;
+            header >> size;
+
+            if (size > pong::packet::max_decompressed_size) {
+                std::cerr << "[Warning] The origin sent a frame of " << size << " bytes\n";
+                disconnect();
+                break;
+            }
+            if (input_buffer.size() - position - sizeof(sf::Uint32) < size) {
+                break;
+            }
+
+            auto error = pong::packet::server::decode(input_buffer.data() + position + sizeof(sf::Uint32), size, packet, encoding);
+            position += sizeof(sf::Uint32) + size;
+
+            if (error != pong::packet::DecodeError::None) {
+                std::cerr << "[Warning] Can't decode a frame of the origin\n";
+                disconnect();
+                break;
+            }
+
+            on_packet(static_cast<pong::packet::server::Any const&>(packet));
+        }
+
+        input_buffer.erase(std::begin(input_buffer), std::begin(input_buffer) + static_cast<std::ptrdiff_t>(position));
+    }
+
+
+    void flush() {
+        std::size_t written{ 0 };
+        while(connected && written < output_buffer.size()) {
+            std::size_t sent{ 0 };
+            auto status = socket->send(output_buffer.data() + written, output_buffer.size() - written, sent);
+            written += sent;
+
+            if (status == sf::Socket::Partial || status == sf::Socket::NotReady) {
+                break;
+            }
+            if (status != sf::Socket::Done) {
+                std::cerr << "[Warning] The connection to the origin is closed\n";
+                disconnect();
+                break;
+            }
+        }
+
+        output_buffer.erase(std::begin(output_buffer), std::begin(output_buffer) + static_cast<std::ptrdiff_t>(written));
+    }
+
+
+    std::uint64_t bytes_received{ 0 };
+
+
+private:
+
+    std::unique_ptr<sf::TcpSocket> socket;
+    bool connected{ false };
+    // Valid during `connect_async`
+    std::future<std::unique_ptr<sf::TcpSocket>> future_socket;
+    std::string username;
+    pong::packet::Encoding encoding{ pong::packet::Encoding::Sfml };
+
+    std::vector<std::byte> input_buffer;
+    std::vector<std::byte> output_buffer;
+    pong::packet::server::Any packet;
+
+};
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+namespace pong::server {
+
+/*
+    Bytes waiting to be sent to a connection, [begin, end) of `data`
+
+    Frames are written in place at the end with `allocate`, and the bytes are consumed from the front by the sends.
+    The buffer compacts itself before growing, and keeps its capacity once every byte is sent,
+    so after the first messages of a session writing a frame doesn't reallocate anymore.
+*/
+struct OutputBuffer {
+
+    static constexpr std::size_t initial_capacity{ 4096 };
+
+    // Messages that would make the pending bytes exceed it are dropped
+    static constexpr std::size_t max_size{ 1 << 16 };
+
+
+    /*
+        Region of `size` bytes at the end of the pending bytes, to be entirely written by the caller
+        nullptr if the buffer would exceed `max_size`
+    */
+    std::byte* allocate(std::size_t size) {
+        if (this->size() + size > max_size) {
+            return nullptr;
+        }
+
+
+        if (end + size > capacity) {
+            if (this->size() + size <= capacity) {
+                compact();
+            } else {
+                grow(this->size() + size);
+            }
+        }
+
+
+        auto* region = data.get() + end;
+        end += size;
+        return region;
+    }
+
+
+    /*
+        Remove the `count` first pending bytes, once they are sent
+    */
+    void consume(std::size_t count) {
+        begin += count;
+
+        if (begin == end) {
+            begin = 0;
+            end = 0;
+        }
+    }
+
+
+    std::byte const* pending() const {
+        return data.get() + begin;
+    }
+
+
+    std::size_t size() const {
+        return end - begin;
+    }
+
+
+    bool empty() const {
+        return begin == end;
+    }
+
+
+    std::size_t number_of_allocation() const {
+        return allocations;
+    }
+
+
+private:
+
+    std::unique_ptr<std::byte[]> data;
+    std::size_t capacity{ 0 };
+    std::size_t begin{ 0 };
+    std::size_t end{ 0 };
+
+    std::size_t allocations{ 0 };
+
+
+    void compact() {
+        std::memmove(data.get(), data.get() + begin, size());
+        end -= begin;
+        begin = 0;
+    }
+
+
+    void grow(std::size_t min_capacity) {
+        auto new_capacity = capacity == 0 ? initial_capacity : capacity;
+        while(new_capacity < min_capacity) {
+            new_capacity *= 2;
+        }
+
+
+        auto new_data = std::make_unique<std::byte[]>(new_capacity);
+        if (!empty()) {
+            std::memcpy(new_data.get(), pending(), size());
+        }
+
+        end -= begin;
+        begin = 0;
+        data = std::move(new_data);
+        capacity = new_capacity;
+        ++allocations;
+    }
+
+};
+
+}
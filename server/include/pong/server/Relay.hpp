@@ -0,0 +1,672 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/State.hpp>
+
+#include <pong/server/MainLobby.hpp>
+#include <pong/server/LobbySnapshot.hpp>
+#include <pong/server/OriginConnection.hpp>
+#include <pong/server/RoomRegistry.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    A relay is a server of spectators in front of an origin server (see relay.cpp)
+
+    Its lobby mirrors the lobby of the origin, through one connection subscribed to the rooms of the origin.
+    A room entered by a user of the relay opens a connection of the relay to the room on the origin, as a spectator:
+    the origin sends the room once to the relay, and the relay broadcasts it to its own spectators, serialized once
+    per encoding as any broadcast. The origin only sees one spectator per room and per relay.
+    The relay only has spectators, nobody plays through it: the requests of a player are ignored.
+*/
+
+struct RelayLobbyState;
+
+
+/*
+    A room of the origin, relayed to the spectators connected to the relay
+
+    The names of the origin are interned in the UsernameTable of the relay, the name ids of the packets
+    of the origin are rewritten to the ids of the relay, and introduced to the spectators before use.
+    The spectators of the relay aren't visible in the room, the others see the room as the origin sees it.
+    The connection to the origin is made during the ticks of the relay, the users entering meanwhile wait in the lobby
+    in `waiting`: the lobby answers their EnterRoom once RoomInfo is received, or once the room is lost.
+    The connection to the origin is closed `idle_timeout` after the last spectator left.
+    If it's lost, the spectators are disconnected: the relay can't tell them the room closed
+*/
+struct RelayRoomState : public State<RelayRoomState> {
+
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds idle_timeout{ 10 };
+
+
+    RelayRoomState(UserRegistry& _registry, RelayLobbyState& _lobby, UsernameTable& _usernames, room_id_t _room_id)
+    :   State(_registry)
+    ,   lobby{ _lobby }
+    ,   usernames{ _usernames }
+    ,   room_id{ _room_id }
+    ,   empty_since{ clock::now() } {}
+
+
+    RelayLobbyState& lobby;
+    UsernameTable& usernames;
+    room_id_t room_id;
+
+    OriginConnection origin;
+    // RoomInfo was received, the spectators can be told about the room
+    bool ready{ false };
+    bool lost{ false };
+    clock::time_point empty_since;
+
+    // Users of the lobby of the relay that asked to enter the room
+    std::vector<user_id_t> waiting;
+
+    // Name ids of the origin, to the names of the relay
+    std::unordered_map<name_id_t, Username> names;
+    // The origin doesn't introduce again a name the relay knows, the names of the users that left the room
+    // are kept as text, to be interned again if they come back without holding an id of the relay
+    std::unordered_map<name_id_t, std::string> departed;
+
+    // The room as the origin sends it
+    Username left_player;
+    Username right_player;
+    std::vector<Username> spectators;
+    pong::packet::server::Score score{ 0, 0 };
+
+
+    /*
+        Connect to the origin and enter the room, the room is lost if the origin can't be reached
+    */
+    void relay(Origin const& address) {
+        origin.connect_async(address, sf::seconds(2.f));
+    }
+
+
+    bool is_relaying() const {
+        return (origin.is_connected() || origin.is_connecting()) && !lost;
+    }
+
+
+    /*
+        Handle the packets of the origin and write the pending requests
+    */
+    void update() {
+        if (origin.is_connecting()) {
+            switch(origin.check_connect()) {
+                case OriginConnection::ConnectStatus::Connected:
+                    std::cout << "Relaying room #" << room_id << '\n';
+                    break;
+                case OriginConnection::ConnectStatus::Connecting:
+                    return;
+                case OriginConnection::ConnectStatus::Failed:
+                    std::cerr << "[Warning] Can't connect to the origin for room #" << room_id << '\n';
+                    break;
+            }
+        }
+
+        origin.receive([this] (pong::packet::server::Any const& packet) {
+            std::visit([this] (auto const& p) { on_origin(p); }, packet);
+        });
+        origin.flush();
+
+        if (!origin.is_connected() && !lost) {
+            close();
+        }
+    }
+
+
+    void close() {
+        std::cerr << "[Warning] Room #" << room_id << " isn't relayed anymore, its " << number_of_user() << " spectators are disconnected\n";
+        lost = true;
+        origin.disconnect();
+
+        for(user_handle_t handle{ 0 }; handle < number_of_user(); ++handle) {
+            if (is_valid(handle)) {
+                get_user(handle).disconnected = true;
+            }
+        }
+    }
+
+
+    Username const& name_of(name_id_t id) {
+        static Username const unknown{};
+
+        if (auto it = names.find(id); it != std::end(names)) {
+            return it->second;
+        }
+
+        auto it = departed.find(id);
+        if (it == std::end(departed)) {
+            return unknown;
+        }
+
+        auto& username = names.insert_or_assign(id, usernames.intern(it->second)).first->second;
+        departed.erase(it);
+        return username;
+    }
+
+
+    void send_room_info(user_handle_t handle) {
+        auto player_name = [this, handle] (Username const& username) {
+            if (username.id() == pong::packet::server::no_name) {
+                return pong::packet::server::no_name;
+            }
+
+            introduce(handle, username);
+            return username.id();
+        };
+
+        std::vector<name_id_t> spectator_names;
+        spectator_names.reserve(spectators.size());
+        for(auto const& spectator : spectators) {
+            introduce(handle, spectator);
+            spectator_names.push_back(spectator.id());
+        }
+
+        send(handle, pong::packet::server::RoomInfo{
+            player_name(left_player),
+            player_name(right_player),
+            std::move(spectator_names)
+        });
+        send(handle, score);
+    }
+
+
+    void remove_spectator(name_id_t id) {
+        auto it = std::find_if(std::begin(spectators), std::end(spectators), [id] (auto const& spectator) {
+            return spectator.id() == id;
+        });
+
+        if (it != std::end(spectators)) {
+            spectators.erase(it);
+        }
+    }
+
+
+    Username& player(pong::Side side) {
+        return side == pong::Side::Left ? left_player : right_player;
+    }
+
+
+    // Packets of the origin
+
+    void on_origin(pong::packet::server::ChangeUsernameResponse const& response) {
+        if (!response.valid) {
+            std::cerr << "[Warning] The origin refused the name of the relay\n";
+            return close();
+        }
+
+        origin.send(pong::packet::client::EnterRoom{ room_id });
+    }
+
+
+    void on_origin(pong::packet::server::EnterRoomResponse const& response) {
+        if (response.result != pong::packet::server::EnterRoomResponse::Result::Okay) {
+            std::cerr << "[Warning] Room #" << room_id << " can't be entered on the origin\n";
+            close();
+        }
+    }
+
+
+    void on_origin(pong::packet::server::UserName const& packet) {
+        // The id is introduced again when the origin gave it to another name, the previous name is released
+        departed.erase(packet.id);
+        names.insert_or_assign(packet.id, usernames.intern(packet.username));
+    }
+
+
+    void on_origin(pong::packet::server::RoomInfo const& packet) {
+        left_player = name_of(packet.left_player);
+        right_player = name_of(packet.right_player);
+
+        spectators.clear();
+        for(auto id : packet.spectators) {
+            spectators.push_back(name_of(id));
+        }
+
+        ready = true;
+        for(user_handle_t handle{ 0 }; handle < number_of_user(); ++handle) {
+            if (is_valid(handle)) {
+                send_room_info(handle);
+            }
+        }
+    }
+
+
+    void on_origin(pong::packet::server::NewUser const& packet) {
+        auto const& username = name_of(packet.user);
+        spectators.push_back(username);
+
+        introduce_to_other(invalid_user_handle, username);
+        broadcast(pong::packet::server::NewUser{ username.id() });
+    }
+
+
+    void on_origin(pong::packet::server::OldUser const& packet) {
+        auto id = name_of(packet.user).id();
+        remove_spectator(id);
+
+        broadcast(pong::packet::server::OldUser{ id });
+
+        if (auto it = names.find(packet.user); it != std::end(names)) {
+            departed.insert_or_assign(packet.user, it->second.str());
+            names.erase(it);
+        }
+    }
+
+
+    void on_origin(pong::packet::server::NewPlayer const& packet) {
+        auto const& username = name_of(packet.user);
+        remove_spectator(username.id());
+        player(packet.side) = username;
+
+        introduce_to_other(invalid_user_handle, username);
+        broadcast(pong::packet::server::NewPlayer{ packet.side, username.id() });
+    }
+
+
+    void on_origin(pong::packet::server::OldPlayer const& packet) {
+        // Still a spectator after an abandon, followed by OldUser if the player left
+        auto& username = player(packet.side);
+        auto id = username.id();
+        if (id != pong::packet::server::no_name) {
+            spectators.push_back(std::move(username));
+            username = Username{};
+        }
+
+        broadcast(pong::packet::server::OldPlayer{ packet.side, id });
+    }
+
+
+    void on_origin(pong::packet::server::Score const& packet) {
+        score = packet;
+        broadcast(packet);
+    }
+
+
+    void on_origin(pong::packet::server::GameState const& packet) {
+        broadcast(packet);
+    }
+
+
+    void on_origin(pong::packet::server::GameOver const& packet) {
+        broadcast(packet);
+    }
+
+
+    // The lobby of the origin before the room is entered, and the requests the relay never makes
+    template<typename P>
+    void on_origin(P const&) {}
+
+
+
+
+    void on_user_enter(user_handle_t handle) {
+        // Else RoomInfo is sent when the origin sends it
+        if (ready) {
+            send_room_info(handle);
+        }
+    }
+
+
+    void on_user_leave(user_handle_t) {
+        // The last user is leaving
+        if (number_of_user() == 1) {
+            empty_since = clock::now();
+        }
+    }
+
+
+    Action on_leave_room(user_handle_t handle, pong::packet::client::LeaveRoom const&);
+
+
+    template<typename P>
+    Action on_player_request(user_handle_t, P const&) {
+        std::cerr << "[Warning] Received PacketID::" << P::name << " in a relayed room\n";
+        return Idle{};
+    }
+
+
+    // Receive
+    using handlers = Handlers<
+        Handler<pong::packet::client::Input, &RelayRoomState::on_player_request<pong::packet::client::Input>>,
+        Handler<pong::packet::client::Abandon, &RelayRoomState::on_player_request<pong::packet::client::Abandon>>,
+        Handler<pong::packet::client::EnterQueue, &RelayRoomState::on_player_request<pong::packet::client::EnterQueue>>,
+        Handler<pong::packet::client::LeaveQueue, &RelayRoomState::on_player_request<pong::packet::client::LeaveQueue>>,
+        Handler<pong::packet::client::LeaveRoom, &RelayRoomState::on_leave_room>,
+        Handler<pong::packet::client::AcceptBePlayer, &RelayRoomState::on_player_request<pong::packet::client::AcceptBePlayer>>
+    >;
+};
+
+
+
+
+/*
+    The lobby of the origin, as seen by one connection subscribed to its first `relayed_slots` slots
+
+    The summaries of the origin are kept in `relayed_rooms`, for the subscriptions of the users of the relay,
+    and the new users get `LobbyInfo` from `snapshot` as on the origin. The user count is the one of the origin.
+    The connection is opened again every `reconnect_period` while it's lost
+*/
+struct RelayLobbyState : public State<RelayLobbyState, LobbyUser> {
+
+    using clock = std::chrono::steady_clock;
+
+    // The largest subscription the origin accepts
+    static constexpr unsigned relayed_slots{ LobbyUser::max_subscription_size };
+    static constexpr std::chrono::seconds reconnect_period{ 2 };
+
+
+    RelayLobbyState(UserRegistry& _registry, UsernameTable& _usernames, Origin _origin)
+    :   State(_registry)
+    ,   usernames{ _usernames }
+    ,   address{ std::move(_origin) }
+    ,   relayed_rooms{ RoomRange{ 0, relayed_slots } }
+    ,   snapshot{ LobbyUser::default_subscription } {}
+
+
+    UsernameTable& usernames;
+    Origin address;
+
+    OriginConnection origin;
+    clock::time_point next_connection{};
+
+    LobbySnapshot relayed_rooms;
+    LobbySnapshot snapshot;
+    unsigned user_count{ 0 };
+
+    std::unordered_map<room_id_t, std::unique_ptr<RelayRoomState>> rooms;
+
+
+    template<typename F>
+    void for_each_room(F&& f) {
+        for(auto& [room_id, room] : rooms) {
+            f(*room);
+        }
+    }
+
+
+    /*
+        Handle the packets of the origin, for the lobby and the rooms, and close the rooms left empty
+    */
+    void update() {
+        auto now = clock::now();
+        if (origin.is_connecting()) {
+            switch(origin.check_connect()) {
+                case OriginConnection::ConnectStatus::Connected:
+                    on_connected();
+                    break;
+                case OriginConnection::ConnectStatus::Connecting:
+                    break;
+                case OriginConnection::ConnectStatus::Failed:
+                    std::cerr << "[Warning] Can't connect to the origin " << address.address << ':' << address.port << '\n';
+                    break;
+            }
+        } else if (!origin.is_connected() && now >= next_connection) {
+            next_connection = now + reconnect_period;
+            origin.connect_async(address, sf::seconds(2.f));
+        }
+
+        origin.receive([this] (pong::packet::server::Any const& packet) {
+            std::visit([this] (auto const& p) { on_origin(p); }, packet);
+        });
+        origin.flush();
+
+
+        for(auto it = std::begin(rooms); it != std::end(rooms);) {
+            auto& room = *it->second;
+            room.update();
+            answer_waiting(room);
+
+            if (room.is_empty() && room.waiting.empty() && (!room.is_relaying() || now - room.empty_since >= RelayRoomState::idle_timeout)) {
+                std::cout << "Room #" << room.room_id << " isn't relayed anymore\n";
+                it = rooms.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+
+    void on_connected() {
+        std::cout << "Connected to the origin " << address.address << ':' << address.port << std::endl;
+
+        // The lobby known before is stale, LobbyInfo brings it back
+        auto stale_rooms = relayed_rooms.rooms;
+        for(auto const& summary : stale_rooms) {
+            on_origin(pong::packet::server::OldRoom{ summary.id });
+        }
+    }
+
+
+    template<typename P>
+    void broadcast_to_subscribers(room_id_t room_id, P const& packet) {
+        auto index = static_cast<unsigned>(RoomRegistry::index_of(room_id));
+
+        broadcast_if(packet, [this, index] (user_handle_t handle) {
+            return get_user_data(handle).subscription.contains(index);
+        });
+    }
+
+
+    pong::packet::server::RoomSummary const* find_room(room_id_t room_id) const {
+        auto it = std::find_if(std::begin(relayed_rooms.rooms), std::end(relayed_rooms.rooms), [room_id] (auto const& summary) {
+            return summary.id == room_id;
+        });
+
+        return it != std::end(relayed_rooms.rooms) ? &*it : nullptr;
+    }
+
+
+    // Packets of the origin
+
+    void on_origin(pong::packet::server::ChangeUsernameResponse const& response) {
+        if (!response.valid) {
+            std::cerr << "[Warning] The origin refused the name of the relay\n";
+            return origin.disconnect();
+        }
+
+        origin.send(pong::packet::client::SubscribeRoomInfo{ 0, relayed_slots });
+    }
+
+
+    void on_origin(pong::packet::server::LobbyInfo const& packet) {
+        on_origin(pong::packet::server::UserCount{ packet.user_count });
+        for(auto const& summary : packet.rooms) {
+            on_origin(pong::packet::server::RoomUpdate{ summary });
+        }
+    }
+
+
+    void on_origin(pong::packet::server::UserCount const& packet) {
+        user_count = packet.count;
+        broadcast(packet);
+    }
+
+
+    void on_origin(pong::packet::server::NewRoom const& packet) {
+        broadcast_to_subscribers(packet.id, packet);
+    }
+
+
+    void on_origin(pong::packet::server::RoomUpdate const& packet) {
+        relayed_rooms.update_room(packet.summary);
+        snapshot.update_room(packet.summary);
+        broadcast_to_subscribers(packet.summary.id, packet);
+    }
+
+
+    void on_origin(pong::packet::server::OldRoom const& packet) {
+        relayed_rooms.remove_room(packet.id);
+        snapshot.remove_room(packet.id);
+        broadcast_to_subscribers(packet.id, packet);
+    }
+
+
+    template<typename P>
+    void on_origin(P const&) {}
+
+
+
+
+    Action on_create_room(user_handle_t handle, pong::packet::client::CreateRoom const&) {
+        std::cerr << "[Warning] Received PacketID::CreateRoom on a relay\n";
+        send(handle, pong::packet::server::CreateRoomResponse{
+            pong::packet::server::CreateRoomResponse::Reason::Unknown
+        });
+        return Idle{};
+    }
+
+
+    Action on_enter_room(user_handle_t handle, pong::packet::client::EnterRoom const& packet) {
+        auto* room = find_room(packet.id) ? get_room(packet.id) : nullptr;
+
+        if (room == nullptr) {
+            std::cout << "Send EnterRoomResponse\n";
+            send(handle, pong::packet::server::EnterRoomResponse{
+                pong::packet::server::EnterRoomResponse::Result::InvalidID
+            });
+            return Idle{};
+        }
+
+        // Answered by `answer_waiting` once the origin sent the room
+        if (!room->ready) {
+            room->waiting.push_back(get_user_id(handle));
+            return Idle{};
+        }
+
+        std::cout << "Send EnterRoomResponse\n";
+        send(handle, pong::packet::server::EnterRoomResponse{
+            pong::packet::server::EnterRoomResponse::Result::Okay
+        });
+
+        // The user enters with the next transitions, the room must not be closed as idle before
+        room->empty_since = clock::now();
+
+        return order_change_state(
+            *room,
+            handle
+        );
+    }
+
+
+    /*
+        Answer the users waiting for the room once the origin sent it, or once it's lost
+        The users that left the lobby meanwhile are skipped
+    */
+    void answer_waiting(RelayRoomState& room) {
+        if (room.waiting.empty() || (!room.ready && room.is_relaying())) {
+            return;
+        }
+
+        auto result = room.is_relaying()
+            ? pong::packet::server::EnterRoomResponse::Result::Okay
+            : pong::packet::server::EnterRoomResponse::Result::InvalidID;
+
+        for(auto id : room.waiting) {
+            auto handle = get_user_handle(id);
+            if (handle == invalid_user_handle || get_user(handle).disconnected) {
+                continue;
+            }
+
+            std::cout << "Send EnterRoomResponse\n";
+            send(handle, pong::packet::server::EnterRoomResponse{ result });
+            if (result == pong::packet::server::EnterRoomResponse::Result::Okay) {
+                room.empty_since = clock::now();
+                leave_for(room, handle);
+            }
+        }
+
+        room.waiting.clear();
+    }
+
+
+    /*
+        The room relayed, connecting to the origin if it's not yet, nullptr if the room was lost
+    */
+    RelayRoomState* get_room(room_id_t room_id) {
+        auto it = rooms.find(room_id);
+        if (it != std::end(rooms) && it->second->is_relaying()) {
+            return it->second.get();
+        }
+
+        // A lost room is removed when its spectators are
+        if (it != std::end(rooms)) {
+            return nullptr;
+        }
+
+        auto room = std::make_unique<RelayRoomState>(user_registry(), *this, usernames, room_id);
+        room->relay(address);
+
+        return rooms.emplace(room_id, std::move(room)).first->second.get();
+    }
+
+
+    Action on_subscribe_room_info(user_handle_t handle, pong::packet::client::SubscribeRoomInfo const& subscription) {
+
+        if (subscription.range_min > subscription.range_max_excluded
+        ||  subscription.range_max_excluded - subscription.range_min > LobbyUser::max_subscription_size) {
+            std::cerr << "[Warning] Received invalid PacketID::SubscribeRoomInfo ["
+                << subscription.range_min << ", " << subscription.range_max_excluded << ")\n";
+            return Idle{};
+        }
+
+        auto& range = get_user_data(handle).subscription;
+        auto old_range = range;
+        range = { subscription.range_min, subscription.range_max_excluded };
+
+        // Only the first `relayed_slots` slots are known
+        // The rooms that left the window are retracted, as the origin does
+        for(auto const& summary : relayed_rooms.rooms) {
+            auto index = static_cast<unsigned>(RoomRegistry::index_of(summary.id));
+            if (old_range.contains(index) && !range.contains(index)) {
+                send(handle, pong::packet::server::OldRoom{ summary.id });
+            }
+        }
+
+        for(auto const& summary : relayed_rooms.rooms) {
+            if (range.contains(static_cast<unsigned>(RoomRegistry::index_of(summary.id)))) {
+                send(handle, pong::packet::server::RoomUpdate{ summary });
+            }
+        }
+
+        return Idle{};
+    }
+
+
+    void on_user_enter(user_handle_t handle) {
+        std::cout << "Send LobbyInfo with " << snapshot.rooms.size() << " rooms\n";
+        auto packet_id = pong::packet::server::id_of<pong::packet::server::LobbyInfo>();
+        send_with(handle, packet_id, snapshot.frame_size(get_user(handle).encoding, user_count), [this] (auto& writer) {
+            snapshot.write_frame(writer, user_count);
+        });
+    }
+
+
+    // Receive
+    using handlers = Handlers<
+        Handler<pong::packet::client::CreateRoom, &RelayLobbyState::on_create_room>,
+        Handler<pong::packet::client::EnterRoom, &RelayLobbyState::on_enter_room>,
+        Handler<pong::packet::client::SubscribeRoomInfo, &RelayLobbyState::on_subscribe_room_info>
+    >;
+
+};
+
+
+inline Action RelayRoomState::on_leave_room(user_handle_t handle, pong::packet::client::LeaveRoom const&) {
+    std::cout << "Send Valid LeaveRoomResponse\n";
+    send(handle, packet::server::LeaveRoomResponse{ packet::server::LeaveRoomResponse::Reason::Okay });
+    return order_change_state(lobby, handle);
+}
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/Transport.hpp>
+#include <pong/server/UserRegistry.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Transport without sockets, fed by the records of a capture (see SessionCapture)
+
+    The frames queued before a tick are given to the users by `receive`, as if the sockets had received them,
+    and `flush` takes every frame the states wrote, as if the sockets had sent them at once.
+    The frames sent are kept until `take_sent`, in the order of the users then of the frames.
+*/
+struct ReplayTransport final : Transport {
+
+    struct Frame {
+        user_id_t user;
+        std::vector<std::byte> bytes;
+    };
+
+
+    char const* name() const override {
+        return "replay";
+    }
+
+    void add(user_id_t, User&) override {}
+    void remove(user_id_t, User&) override {}
+
+
+    /*
+        The packet, without its size header, for the next `receive`
+    */
+    void queue_frame(user_id_t id, std::vector<std::byte> packet) {
+        inbound.push_back({ id, std::move(packet), 0 });
+    }
+
+
+    /*
+        A size header announcing `size` bytes and nothing else, more than the InputBuffer holds
+    */
+    void queue_oversized_frame(user_id_t id, std::size_t size) {
+        inbound.push_back({ id, {}, size });
+    }
+
+
+    void queue_disconnect(user_id_t id) {
+        disconnects.push_back(id);
+    }
+
+
+    void receive(UserRegistry& users) override {
+        for(auto& frame : inbound) {
+            auto* user = users.get(frame.user);
+            if (user == nullptr) {
+                continue;
+            }
+
+            auto size = frame.oversized_size != 0 ? frame.oversized_size : frame.packet.size();
+            std::byte header[InputBuffer::header_size];
+            for(std::size_t i{ 0 }; i < InputBuffer::header_size; ++i) {
+                header[i] = static_cast<std::byte>(size >> (8 * (InputBuffer::header_size - 1 - i)));
+            }
+
+            if (!user->input.append(header, sizeof(header)) || !user->input.append(frame.packet.data(), frame.packet.size())) {
+                std::cerr << "[Warning] The frames of a tick don't fit in the input buffer of user " << frame.user << '\n';
+            }
+        }
+        inbound.clear();
+
+
+        for(auto id : disconnects) {
+            if (auto* user = users.get(id)) {
+                user->disconnected = true;
+            }
+        }
+        disconnects.clear();
+    }
+
+
+    void flush(UserRegistry& users) override {
+        users.for_each([this] (user_id_t id, User& user) {
+            auto const* frames = user.output.pending();
+            std::size_t size{ user.output.size() };
+
+            std::size_t position{ 0 };
+            while(size - position >= sizeof(sf::Uint32)) {
+                std::size_t frame_size{ 0 };
+                for(std::size_t i{ 0 }; i < sizeof(sf::Uint32); ++i) {
+                    frame_size = (frame_size << 8) | std::to_integer<std::size_t>(frames[position + i]);
+                }
+                position += sizeof(sf::Uint32);
+
+                sent.push_back({ id, { frames + position, frames + position + frame_size } });
+                position += frame_size;
+            }
+
+            user.output.consume(size);
+        });
+    }
+
+
+    /*
+        The frames sent since the previous call
+    */
+    std::vector<Frame> take_sent() {
+        return std::exchange(sent, {});
+    }
+
+
+private:
+
+    struct Inbound {
+        user_id_t user;
+        std::vector<std::byte> packet;
+        std::size_t oversized_size;
+    };
+
+    std::vector<Inbound> inbound;
+    std::vector<user_id_t> disconnects;
+    std::vector<Frame> sent;
+
+};
+
+}
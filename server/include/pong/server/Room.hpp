@@ -2,8 +2,10 @@
 
 #include <pong/server/Common.hpp>
 #include <pong/server/State.hpp>
+#include <pong/server/MatchRecording.hpp>
+#include <pong/server/UserQueue.hpp>
 
-#include <deque>
+#include <memory>
 
 namespace pong::server {
 
@@ -50,36 +52,63 @@ struct Game {
     }
 };
 
-struct RoomState : public State<RoomState, user_t> {
-    RoomState(MainLobbyState& _main_lobby) 
-    : State({
-
-            // Receive
-            { id_of(pong::packet::client::Input{}), &RoomState::on_input },
-            { id_of(pong::packet::client::Abandon{}), &RoomState::on_abandon },
-            { id_of(pong::packet::client::EnterQueue{}), &RoomState::on_enter_queue },
-            { id_of(pong::packet::client::LeaveQueue{}), &RoomState::on_leave_queue },
-            { id_of(pong::packet::client::LeaveRoom{}), &RoomState::on_leave_room },
-            { id_of(pong::packet::client::AcceptBePlayer{}), &RoomState::on_accept_be_player }
-
-        })
+struct RoomState : public State<RoomState> {
+    RoomState(UserRegistry& _registry, MainLobbyState& _main_lobby, room_id_t _room_id) 
+    :   State(_registry)
     ,   main_lobby{ _main_lobby }
+    ,   room_id{ _room_id }
+    ,   summary_dirty{ false }
     ,   left_player{ invalid_user_id }
     ,   right_player{ invalid_user_id }
+    ,   queue{ _registry }
     ,   next_player_left{ invalid_user_id }
     ,   next_player_right{ invalid_user_id }
     ,   score{0, 0} {}
 
 
+    /*
+        Put back the room in its initial state, used when the RoomRegistry recycles it
+        The room must be empty
+    */
+    void reset(room_id_t new_room_id) {
+        assert(is_empty());
+
+        room_id = new_room_id;
+        summary_dirty = false;
+
+        left_player = invalid_user_id;
+        right_player = invalid_user_id;
+        queue.clear();
+
+        next_player_left = invalid_user_id;
+        next_player_left_timer = 0;
+        next_player_right = invalid_user_id;
+        next_player_right_timer = 0;
+
+        time = 0;
+        game = Game{};
+        score = { 0, 0 };
+
+        playback.reset();
+        playback_left_name = Username{};
+        playback_right_name = Username{};
+    }
+
+
 
 
 
 
     MainLobbyState& main_lobby;
+    room_id_t room_id;
+    // Set while the room is waiting in the lobby for its summary to be sent
+    bool summary_dirty;
+
     user_id_t left_player;
     user_id_t right_player;
 
-    std::deque<user_id_t> queue;
+    // Users waiting to play, the first one is the next player
+    UserQueue queue;
 
     user_id_t next_player_left;
     float next_player_left_timer;
@@ -94,15 +123,114 @@ struct RoomState : public State<RoomState, user_t> {
     Game game;
     pong::packet::server::Score score;
 
+    // The matches are recorded when `RoomRegistry::recording_directory` is set, see MatchRecording.hpp
+    MatchRecorder recorder;
+
+    // Set for a replay room: it plays a recording to its spectators instead of a game, and is never reclaimed
+    std::unique_ptr<MatchPlayback> playback;
+    Username playback_left_name;
+    Username playback_right_name;
+    float playback_restart_timer{ 0 };
+    static constexpr float playback_restart_delay = 5.f /* seconds */;
+
+
+
+
+
+
+    // Defined in MainLobby.hpp, MainLobbyState is incomplete here
+    void notify_lobby();
+    // The last users left, called by `receive_packets` and `leave_for` once they are removed
+    void on_empty();
+    void start_recording();
+
+
+    // Argument of `create` for the users paired by the matchmaking (see Matchmaker.hpp), they wait to play once in
+    struct Matched {};
+
+    using State::create;
+
+    user_handle_t create(user_id_t id, Matched) {
+        auto handle = create(id);
+        enter_queue(id);
+        return handle;
+    }
+
+
+    /*
+        The user waits to play after the ones already waiting
+    */
+    void enter_queue(user_id_t id) {
+        if (!queue.push_back(id)) {
+            std::cerr << "[Warning] User ID#" << id << " is already waiting to play\n";
+            return;
+        }
+
+        update_players();
+    }
+
+
+    /*
+        Turn the room into a replay room, it must be empty
+        The names of the players are interned for the RoomInfo of the spectators
+    */
+    void start_playback(std::unique_ptr<MatchPlayback> _playback, UsernameTable& usernames) {
+        assert(is_empty());
+
+        playback = std::move(_playback);
+        playback_left_name = usernames.intern(playback->left_name);
+        playback_right_name = usernames.intern(playback->right_name);
+        playback_restart_timer = 0;
+
+        // Listed in the lobby without spectators
+        notify_lobby();
+    }
+
+
+    MatchKeyframe current_keyframe() const {
+        return { game.ball, game.pad_left, game.pad_right };
+    }
 
 
+    void end_recording(packet::server::GameOver::Result result) {
+        if (recorder.is_recording()) {
+            recorder.end(result);
+        }
+    }
+
+
+    void on_score() {
+        broadcast(score);
+        game = Game{};
+
+        if (recorder.is_recording()) {
+            recorder.score(score);
+            recorder.keyframe(current_keyframe());
+        }
 
+        // force sending packet GameState
+        time = game_state_packet_interval;
+    }
+
+
+    void send_game_state(float dt) {
+        time += dt;
+
+        if (time > game_state_packet_interval) {
+            time -= game_state_packet_interval;
+            broadcast(pong::packet::server::GameState {
+                game.ball,
+                game.pad_left,
+                game.pad_right
+            });
+        }
+    }
 
 
     void update_players() {
 
         if (!queue.empty() && left_player == invalid_user_id && next_player_left == invalid_user_id) {
-            auto id = queue.back(); queue.pop_back();
+            auto id = queue.pop_front();
             next_player_left = id;
             next_player_left_timer = next_player_max_timer;
             std::cout << "! Try add left player(ID#" << id << ")\n";
@@ -112,7 +240,7 @@ struct RoomState : public State<RoomState, user_t> {
             std::cout << "Send NewPlayer\n";
             broadcast_other(handle, pong::packet::server::NewPlayer{
                 pong::Side::Left,
-                get_user_data(handle)
+                get_username(handle).id()
             });
     
             std::cout << "Send BePlayer\n";
@@ -127,7 +255,7 @@ struct RoomState : public State<RoomState, user_t> {
 
 
         if (!queue.empty() && right_player == invalid_user_id && next_player_right == invalid_user_id) {
-            auto id = queue.back(); queue.pop_back();
+            auto id = queue.pop_front();
             next_player_right = id;
             next_player_right_timer = next_player_max_timer;
             std::cout << "! Try add right player(ID#" << id << ")\n";
@@ -137,7 +265,7 @@ struct RoomState : public State<RoomState, user_t> {
             std::cout << "Send NewPlayer\n";
             broadcast_other(handle, pong::packet::server::NewPlayer{
                 pong::Side::Right,
-                get_user_data(handle)
+                get_username(handle).id()
             });
     
             std::cout << "Send BePlayer\n";
@@ -152,36 +280,79 @@ struct RoomState : public State<RoomState, user_t> {
     }
 
 
+    /*
+        The recorded events are applied when the clock of the playback reaches them, the game is simulated in between
+        (with the `dt` of the server, the keyframes correct the drift). The match starts again after `playback_restart_delay`
+    */
+    void update_playback(float dt) {
+        if (playback->finished()) {
+            playback_restart_timer -= dt;
+            if (playback_restart_timer < 0) {
+                playback->rewind();
+                game = Game{};
+                score = { 0, 0 };
+                broadcast(score);
+            }
+            return;
+        }
+
+
+        playback->advance(dt, [this] (MatchPlayback::Event const& event) {
+            switch(event.record) {
+                case MatchRecord::Input:
+                    (event.side == pong::Side::Left ? game.input_left : game.input_right) = event.input;
+                    break;
+
+                case MatchRecord::Score:
+                    score = event.score;
+                    on_score();
+                    break;
+
+                case MatchRecord::Keyframe:
+                    game.ball = event.keyframe.ball;
+                    game.pad_left = event.keyframe.pad_left;
+                    game.pad_right = event.keyframe.pad_right;
+                    break;
+
+                case MatchRecord::End:
+                    std::cout << "Send Game Over\n";
+                    broadcast(pong::packet::server::GameOver{ event.result });
+                    playback_restart_timer = playback_restart_delay;
+                    break;
+            }
+        });
+
+
+        if (!playback->finished()) {
+            // The scores are the recorded ones
+            game.update(dt);
+            send_game_state(dt);
+        }
+    }
+
+
     void update_game(float dt) {
+        if (playback) {
+            return update_playback(dt);
+        }
+
         if (left_player != invalid_user_id && right_player != invalid_user_id) {
             auto event = game.update(dt);
+            recorder.advance(dt);
+
             if (event == pong::CollisionEvent::LeftBoundary) {
                 ++score.left;
-                broadcast(score);
-                game = Game{};
-
-                // force sending packet GameState
-                time = game_state_packet_interval;
+                on_score();
             }
             else if (event == pong::CollisionEvent::RightBoundary) {
                 ++score.right;
-                broadcast(score);
-                game = Game{};
-
-                // force sending packet GameState
-                time = game_state_packet_interval;
+                on_score();
             }
-
-            time += dt;
-
-            if (time > game_state_packet_interval) {
-                time -= game_state_packet_interval;
-                broadcast(pong::packet::server::GameState {
-                    game.ball,
-                    game.pad_left,
-                    game.pad_right
-                });
+            else if (recorder.is_recording() && recorder.keyframe_due()) {
+                recorder.keyframe(current_keyframe());
             }
+
+            send_game_state(dt);
         }
 
         if (next_player_left != invalid_user_id) {
@@ -208,7 +379,7 @@ struct RoomState : public State<RoomState, user_t> {
     }
 
 
-    Action on_abandon(user_handle_t handle, packet_t) {
+    Action on_abandon(user_handle_t handle, pong::packet::client::Abandon const&) {
         auto id = get_user_id(handle);
 
         if (id == left_player) {
@@ -217,11 +388,12 @@ struct RoomState : public State<RoomState, user_t> {
             broadcast(pong::packet::server::GameOver{
                 packet::server::GameOver::Result::LeftAbandon
             });
+            end_recording(packet::server::GameOver::Result::LeftAbandon);
 
             std::cout << "Send OldPlayer\n";
             broadcast_other(handle, pong::packet::server::OldPlayer{
                 pong::Side::Left,
-                get_user_data(handle)
+                get_username(handle).id()
             });
 
             std::cout << "! Remove left player\n";
@@ -232,26 +404,28 @@ struct RoomState : public State<RoomState, user_t> {
                 auto right_handle = get_user_handle(right_player);
                 broadcast_other(right_handle, pong::packet::server::OldPlayer{
                     pong::Side::Right,
-                    get_user_data(right_handle)
+                    get_username(right_handle).id()
                 });
 
                 std::cout << "! Put right player in queue\n";
-                queue.push_front(right_player);
+                queue.push_back(right_player);
                 right_player = invalid_user_id;
             }
 
             update_players();
+            notify_lobby();
         }
         else if (id == right_player) {
             std::cout << "Send Game Over\n";
             broadcast(pong::packet::server::GameOver{
                 packet::server::GameOver::Result::RightAbandon
             });
+            end_recording(packet::server::GameOver::Result::RightAbandon);
 
             std::cout << "Send OldPlayer\n";
             broadcast_other(handle, pong::packet::server::OldPlayer{
                 pong::Side::Right,
-                get_user_data(handle)
+                get_username(handle).id()
             });
 
             std::cout << "! Remove right player\n";
@@ -262,15 +436,16 @@ struct RoomState : public State<RoomState, user_t> {
                 auto left_handle = get_user_handle(left_player);
                 broadcast_other(left_handle, pong::packet::server::OldPlayer{
                     pong::Side::Left,
-                    get_user_data(left_handle)
+                    get_username(left_handle).id()
                 });
 
                 std::cout << "! Put left player in queue\n";
-                queue.push_front(left_player);
+                queue.push_back(left_player);
                 left_player = invalid_user_id;
             }
 
             update_players();
+            notify_lobby();
         }
         else {
             std::cerr << "[Warning] Received PacketID::Abandon from a spectator\n";
@@ -280,21 +455,22 @@ struct RoomState : public State<RoomState, user_t> {
     }
 
 
-    Action on_enter_queue(user_handle_t handle, packet_t) {
+    Action on_enter_queue(user_handle_t handle, pong::packet::client::EnterQueue const&) {
         auto id = get_user_id(handle);
 
-        if (id == left_player || id == right_player || id == next_player_left || id == next_player_right) {
+        if (playback) {
+            std::cerr << "[Warning] Received PacketID::EnterQueue in a replay room\n";
+        } else if (id == left_player || id == right_player || id == next_player_left || id == next_player_right) {
             std::cerr << "[Warning] Received PacketID::EnterQueue from a [next] player\n";
         } else {
-            queue.push_front(id);
-            update_players();
+            enter_queue(id);
         }
 
         return Idle{};
     }
 
 
-    Action on_leave_queue(user_handle_t handle, packet_t) {
+    Action on_leave_queue(user_handle_t handle, pong::packet::client::LeaveQueue const&) {
         auto id = get_user_id(handle);
 
         if (id == left_player || id == right_player) {
@@ -308,7 +484,7 @@ struct RoomState : public State<RoomState, user_t> {
                 next_player_right = invalid_user_id;
             }
 
-            queue.erase(std::remove(std::begin(queue), std::end(queue), id), std::end(queue));
+            queue.remove(id);
             update_players();
         }
 
@@ -316,19 +492,29 @@ struct RoomState : public State<RoomState, user_t> {
     }
 
 
-    Action on_input(user_handle_t handle, packet_t packet) {
+    // Sent before the client got `MatchFound`, the user is already here
+    Action on_leave_matchmaking(user_handle_t, pong::packet::client::LeaveMatchmaking const&) {
+        return Idle{};
+    }
+
+
+    Action on_input(user_handle_t handle, pong::packet::client::Input const& packet) {
         auto id = get_user_id(handle);
 
         std::cout << "! Received input from handle ID#" << id << '\n';
         if (id == left_player) {
             std::cout << "Received Left input\n";
-            auto input = from_packet<pong::packet::client::Input>(packet);
-            game.input_left = input.input;
+            if (recorder.is_recording() && game.input_left != packet.input) {
+                recorder.input(pong::Side::Left, packet.input);
+            }
+            game.input_left = packet.input;
         }
         else if (id == right_player) {
             std::cout << "Received Right input\n";
-            auto input = from_packet<pong::packet::client::Input>(packet);
-            game.input_right = input.input;
+            if (recorder.is_recording() && game.input_right != packet.input) {
+                recorder.input(pong::Side::Right, packet.input);
+            }
+            game.input_right = packet.input;
         }
         else {
             std::cerr << "[Warning] Received PacketID::Input from a spectator\n";
@@ -338,14 +524,14 @@ struct RoomState : public State<RoomState, user_t> {
     }
 
 
-    Action on_leave_room(user_handle_t handle, packet_t) {
+    Action on_leave_room(user_handle_t handle, pong::packet::client::LeaveRoom const&) {
         std::cout << "Send Valid LeaveRoomResponse\n";
         send(handle, packet::server::LeaveRoomResponse{ packet::server::LeaveRoomResponse::Reason::Okay });
-        return order_change_state(main_lobby, handle, get_user_data(handle));
+        return order_change_state(main_lobby, handle);
     }
 
 
-    Action on_accept_be_player(user_handle_t handle, packet_t) {
+    Action on_accept_be_player(user_handle_t handle, pong::packet::client::AcceptBePlayer const&) {
         auto id = get_user_id(handle);
         if (id == next_player_left) {
             next_player_left = invalid_user_id;
@@ -354,7 +540,7 @@ struct RoomState : public State<RoomState, user_t> {
             std::cout << "Send NewPlayer\n";
             broadcast_other(handle, pong::packet::server::NewPlayer{
                 pong::Side::Left,
-                get_user_data(handle)
+                get_username(handle).id()
             });
     
             std::cout << "Send BePlayer\n";
@@ -366,7 +552,10 @@ struct RoomState : public State<RoomState, user_t> {
                 std::cout << "Start Game !\n";
                 game = Game{};
                 score = {0, 0};
+                start_recording();
             }
+
+            notify_lobby();
         }  
         
         else if (id == next_player_right) {
@@ -376,7 +565,7 @@ struct RoomState : public State<RoomState, user_t> {
             std::cout << "Send NewPlayer\n";
             broadcast_other(handle, pong::packet::server::NewPlayer{
                 pong::Side::Right,
-                get_user_data(handle)
+                get_username(handle).id()
             });
     
             std::cout << "Send BePlayer\n";
@@ -388,7 +577,10 @@ struct RoomState : public State<RoomState, user_t> {
                 std::cout << "Start Game !\n";
                 game = Game{};
                 score = {0, 0};
+                start_recording();
             }
+
+            notify_lobby();
         } 
         
         else {
@@ -400,32 +592,52 @@ struct RoomState : public State<RoomState, user_t> {
 
     void on_user_enter(user_handle_t handle) {
         std::cout << "Send NewUser\n";
+        introduce_to_other(handle, get_username(handle));
         broadcast_other(handle, pong::packet::server::NewUser{
-            get_user_data(handle)
+            get_username(handle).id()
         });
 
 
-        std::vector<std::string> spectators;
+        std::vector<name_id_t> spectators;
         spectators.reserve(number_of_user());
 
 
         for(user_handle_t h{ 0 }; h < number_of_user(); ++h) {
             if (is_valid(h) && get_user_id(h) != left_player && get_user_id(h) != right_player && h != handle) {
-                std::cout << "Push " << get_user_data(h) << '\n';
-                spectators.push_back(get_user_data(h));
+                std::cout << "Push " << get_username(h) << '\n';
+                introduce(handle, get_username(h));
+                spectators.push_back(get_username(h).id());
             }
         }
 
 
+        auto player_name = [this, handle] (user_handle_t player_handle) {
+            if (!is_valid(player_handle)) {
+                return pong::packet::server::no_name;
+            }
+
+            introduce(handle, get_username(player_handle));
+            return get_username(player_handle).id();
+        };
+
+
+        auto recorded_name = [this, handle] (Username const& username) {
+            introduce(handle, username);
+            return username.id();
+        };
+
+
         std::cout << "Send RoomInfo with " << spectators.size() << " spectators\n";
-        auto left_player_handle = get_user_handle(left_player);
-        auto right_player_handle = get_user_handle(right_player);
+        auto left_player_name = playback ? recorded_name(playback_left_name) : player_name(get_user_handle(left_player));
+        auto right_player_name = playback ? recorded_name(playback_right_name) : player_name(get_user_handle(right_player));
         send(handle, pong::packet::server::RoomInfo{
-            is_valid(left_player_handle) ? get_user_data(left_player_handle) : "",
-            is_valid(right_player_handle) ? get_user_data(right_player_handle) : "",
+            left_player_name,
+            right_player_name,
             std::move(spectators)
         });
         send(handle, score);
+
+        notify_lobby();
     }
 
 
@@ -434,22 +646,24 @@ struct RoomState : public State<RoomState, user_t> {
 
         if (id == left_player) {
             std::cout << "! Remove left player\n";
+            end_recording(packet::server::GameOver::Result::LeftAbandon);
             left_player = invalid_user_id;
             update_players();
             std::cout << "Send OldPlayer Left\n";
             broadcast_other(handle, pong::packet::server::OldPlayer{
                 pong::Side::Left,
-                get_user_data(handle)
+                get_username(handle).id()
             });
         }
         else if (id == right_player) {
             std::cout << "! Remove right player\n";
+            end_recording(packet::server::GameOver::Result::RightAbandon);
             right_player = invalid_user_id;
             update_players();
             std::cout << "Send OldPlayer Right\n";
             broadcast_other(handle, pong::packet::server::OldPlayer{
                 pong::Side::Right,
-                get_user_data(handle)
+                get_username(handle).id()
             });
         } else {
             if (id == next_player_left) {
@@ -460,15 +674,29 @@ struct RoomState : public State<RoomState, user_t> {
                 next_player_right = invalid_user_id;
             }
             
-            queue.erase(std::remove(std::begin(queue), std::end(queue), id), std::end(queue));
+            queue.remove(id);
             update_players();
         }
 
         std::cout << "Send OldUser\n";
         broadcast_other(handle, pong::packet::server::OldUser{
-            get_user_data(handle)
+            get_username(handle).id()
         });
+
+        notify_lobby();
     }
+
+
+    // Receive
+    using handlers = Handlers<
+        Handler<pong::packet::client::Input, &RoomState::on_input>,
+        Handler<pong::packet::client::Abandon, &RoomState::on_abandon>,
+        Handler<pong::packet::client::EnterQueue, &RoomState::on_enter_queue>,
+        Handler<pong::packet::client::LeaveQueue, &RoomState::on_leave_queue>,
+        Handler<pong::packet::client::LeaveRoom, &RoomState::on_leave_room>,
+        Handler<pong::packet::client::AcceptBePlayer, &RoomState::on_accept_be_player>,
+        Handler<pong::packet::client::LeaveMatchmaking, &RoomState::on_leave_matchmaking>
+    >;
 };
 
 }
\ No newline at end of file
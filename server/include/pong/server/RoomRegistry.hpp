@@ -0,0 +1,308 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/Room.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Owns every room of the server
+
+    A room id is made of the index of its slot (low 16 bits) and of the generation of the slot (high 16 bits).
+    The generation is incremented each time a room is reclaimed, so an id sent before the reclamation
+    (in a stale `EnterRoom` for example) doesn't match the new room of the slot.
+
+    Free slots are chained in a free-list, allocating and reclaiming a room are O(1).
+    The `RoomState` of a reclaimed slot is kept and reset on the next allocation instead of being destroyed.
+
+    In a federation each server owns a range of the slots, [first_slot, first_slot + slot_count) (see `assign_slots`),
+    so the ids of the rooms are unique across the servers and the server of a room is known from its slot.
+*/
+struct RoomRegistry {
+
+    static constexpr unsigned index_bits{ 16 };
+    static constexpr room_id_t index_mask{ (room_id_t{ 1 } << index_bits) - 1 };
+    static constexpr std::size_t max_number_of_room{ std::size_t{ 1 } << index_bits };
+    static constexpr std::size_t no_slot{ std::numeric_limits<std::size_t>::max() };
+
+
+    static constexpr room_id_t make_id(std::size_t index, unsigned generation) {
+        return (generation << index_bits) | static_cast<room_id_t>(index);
+    }
+
+    static constexpr std::size_t index_of(room_id_t id) {
+        return id & index_mask;
+    }
+
+    static constexpr unsigned generation_of(room_id_t id) {
+        return id >> index_bits;
+    }
+
+
+private:
+
+
+    struct Slot {
+        std::unique_ptr<RoomState> room;
+        unsigned generation;
+
+        // Position in `live_slots`, or `no_slot` if the slot is free
+        std::size_t live_position;
+        // Next free slot when the slot is free
+        std::size_t next_free;
+
+        bool reclaim_scheduled;
+    };
+
+
+    UserRegistry& users;
+
+    // `slots[i]` is the slot `first_slot + i`
+    std::size_t first_slot{ 0 };
+    std::size_t slot_count{ max_number_of_room };
+
+    std::vector<Slot> slots;
+    std::size_t first_free;
+
+    // Dense list of the allocated slots, so iterating rooms doesn't visit the free ones
+    std::vector<std::size_t> live_slots;
+
+    // Rooms whose last user left, reclaimed by `reclaim`
+    std::vector<room_id_t> to_reclaim;
+
+
+public:
+
+
+    RoomRegistry(UserRegistry& _users) : users{ _users }, first_free{ no_slot } {}
+
+
+    // Where the rooms record their matches, none are recorded if empty (see RoomState::start_recording)
+    std::string recording_directory;
+    std::uint64_t recorded_matches{ 0 };
+
+
+    /*
+        The range of slots of the server in a federation, before any room is allocated
+    */
+    void assign_slots(std::size_t first, std::size_t count) {
+        assert(slots.empty() && first + count <= max_number_of_room);
+        first_slot = first;
+        slot_count = count;
+    }
+
+
+    std::size_t first_assigned_slot() const {
+        return first_slot;
+    }
+
+
+    std::size_t number_of_assigned_slot() const {
+        return slot_count;
+    }
+
+
+    /*
+        Returns the id of a new empty room, or `std::nullopt` if every slot is used
+    */
+    std::optional<room_id_t> allocate(MainLobbyState& main_lobby) {
+        std::size_t index;
+
+        if (first_free != no_slot) {
+            index = first_free;
+            first_free = slots[index].next_free;
+        }
+        else if (slots.size() < slot_count) {
+            index = slots.size();
+            slots.push_back({ nullptr, 0, no_slot, no_slot, false });
+        }
+        else {
+            return std::nullopt;
+        }
+
+
+        auto& slot = slots[index];
+        auto id = make_id(first_slot + index, slot.generation);
+
+        if (slot.room) {
+            slot.room->reset(id);
+        } else {
+            slot.room = std::make_unique<RoomState>(users, main_lobby, id);
+        }
+
+        slot.live_position = live_slots.size();
+        slot.reclaim_scheduled = false;
+        live_slots.push_back(index);
+
+        return id;
+    }
+
+
+    RoomState* get(room_id_t id) {
+        auto index = local_index(index_of(id));
+        if (index < slots.size() && slots[index].live_position != no_slot && slots[index].generation == generation_of(id)) {
+            return slots[index].room.get();
+        }
+
+        return nullptr;
+    }
+
+
+    RoomState const* get(room_id_t id) const {
+        return const_cast<RoomRegistry*>(this)->get(id);
+    }
+
+
+    /*
+        Room at the index `index` whatever its generation, nullptr if the slot is free
+    */
+    RoomState* get_at(std::size_t slot) {
+        auto index = local_index(slot);
+        if (index < slots.size() && slots[index].live_position != no_slot) {
+            return slots[index].room.get();
+        }
+
+        return nullptr;
+    }
+
+
+    RoomState const* get_at(std::size_t slot) const {
+        return const_cast<RoomRegistry*>(this)->get_at(slot);
+    }
+
+
+    /*
+        Generation of the slot, of its room if it's allocated, of its next room otherwise
+    */
+    unsigned generation_at(std::size_t slot) const {
+        auto index = local_index(slot);
+        return index < slots.size() ? slots[index].generation : 0;
+    }
+
+
+    /*
+        Slot of the registry of another process (see HotRestart.hpp), the slots are restored in order from the first assigned one
+        The ids stay the same: the room of a live slot is returned empty, with its id, to be restored by the caller
+    */
+    RoomState* restore_slot(unsigned generation, bool live, MainLobbyState& main_lobby) {
+        assert(slots.size() < slot_count);
+
+        auto index = slots.size();
+        auto& slot = slots.emplace_back(Slot{ nullptr, generation & index_mask, no_slot, no_slot, false });
+        if (!live) {
+            slot.next_free = first_free;
+            first_free = index;
+            return nullptr;
+        }
+
+        slot.room = std::make_unique<RoomState>(users, main_lobby, make_id(first_slot + index, slot.generation));
+        slot.live_position = live_slots.size();
+        live_slots.push_back(index);
+
+        return slot.room.get();
+    }
+
+
+    /*
+        One past the last slot used
+    */
+    std::size_t number_of_slot() const {
+        return first_slot + slots.size();
+    }
+
+
+    std::size_t number_of_room() const {
+        return live_slots.size();
+    }
+
+
+    /*
+        Called by a room when its last user is leaving
+    */
+    void schedule_reclaim(room_id_t id) {
+        if (get(id) == nullptr) {
+            return;
+        }
+
+        auto& slot = slots[local_index(index_of(id))];
+        if (!slot.reclaim_scheduled) {
+            slot.reclaim_scheduled = true;
+            to_reclaim.push_back(id);
+        }
+    }
+
+
+    /*
+        Release the rooms scheduled for reclamation that are still empty
+        `on_reclaim` is called with the id of each released room
+    */
+    template<typename F>
+    void reclaim(F&& on_reclaim) {
+        for(auto id : to_reclaim) {
+            auto* room = get(id);
+            if (room == nullptr) {
+                continue;
+            }
+
+            auto index = local_index(index_of(id));
+            slots[index].reclaim_scheduled = false;
+
+            // Someone entered the room since it got empty
+            if (!room->is_empty()) {
+                continue;
+            }
+
+            release(index);
+            on_reclaim(id);
+        }
+
+        to_reclaim.clear();
+    }
+
+
+    template<typename F>
+    void for_each(F&& f) {
+        for(std::size_t i{ 0 }; i < live_slots.size(); ++i) {
+            f(*slots[live_slots[i]].room);
+        }
+    }
+
+
+private:
+
+
+    /*
+        Index in `slots` of the slot, `no_slot` if it's not owned by the server
+    */
+    std::size_t local_index(std::size_t slot) const {
+        return slot >= first_slot && slot - first_slot < slot_count ? slot - first_slot : no_slot;
+    }
+
+
+    void release(std::size_t index) {
+        auto& slot = slots[index];
+
+        // Swap-remove from the live slots
+        auto position = slot.live_position;
+        auto last = live_slots.back();
+        live_slots[position] = last;
+        slots[last].live_position = position;
+        live_slots.pop_back();
+
+        slot.live_position = no_slot;
+        ++slot.generation;
+        slot.generation &= index_mask;
+
+        slot.next_free = first_free;
+        first_free = index;
+    }
+
+};
+
+}
@@ -0,0 +1,503 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/MainLobby.hpp>
+#include <pong/server/StateStream.hpp>
+#include <pong/server/UserRegistry.hpp>
+#include <pong/server/Username.hpp>
+
+#include <SFML/Network.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    A room and the sessions of its members as a value: to move the room to another process or thread, or to keep it
+
+        [version][players][queue][next players and their timers][time][game][score][playback][names known in the room]
+        [members: id, name, encoding, known names, unread input, unsent output]
+
+    The sockets aren't in the bytes, `connections` has the handle of each member in their order.
+    The restore creates a user per member in the registry of the room and its socket adopts the handle:
+    another process receives the handles with SCM_RIGHTS (see HotRestart.hpp), another thread is given duplicates.
+    The members know the names by id, so the names are restored by id: the table must be the one of the snapshot,
+    or one restored from it. The names known in the room are written once, and the names of each member against them
+    (see `NameTable`). Measured at -O2 with bench_snapshot.cpp, every member knowing the names of the others
+    and having 200 bytes of output pending: 8 members take ~2 us to snapshot and ~3 us to restore (1.9 KB),
+    64 members ~10 us and ~30 us (15 KB), 512 members ~200 us and ~500 us (118 KB). Most of it is spent on the sessions
+    (creating the users, copying their buffers), the names are ~1/3 for 512 members
+*/
+struct RoomSnapshot {
+    static constexpr std::uint8_t version{ 3 };
+
+    std::vector<std::byte> bytes;
+    std::vector<sf::SocketHandle> connections;
+};
+
+
+
+
+
+namespace details {
+
+inline void write_game(StateWriter& writer, Game const& game) {
+    writer.write_varint(static_cast<std::uint64_t>(game.input_left));
+    writer.write_varint(static_cast<std::uint64_t>(game.input_right));
+
+    for(auto value : { game.ball.position.x, game.ball.position.y, game.ball.speed.x, game.ball.speed.y,
+                       game.pad_left.y, game.pad_left.speed, game.pad_right.y, game.pad_right.speed }) {
+        writer.write_float(value);
+    }
+
+    writer.write_bool(game.force_refresh);
+}
+
+
+inline bool read_game(StateReader& reader, Game& game) {
+    auto input_left = reader.read_varint();
+    auto input_right = reader.read_varint();
+    if (input_left > static_cast<std::uint64_t>(pong::Input::Down) || input_right > static_cast<std::uint64_t>(pong::Input::Down)) {
+        return false;
+    }
+
+    game.input_left = static_cast<pong::Input>(input_left);
+    game.input_right = static_cast<pong::Input>(input_right);
+
+    for(auto* value : { &game.ball.position.x, &game.ball.position.y, &game.ball.speed.x, &game.ball.speed.y,
+                        &game.pad_left.y, &game.pad_left.speed, &game.pad_right.y, &game.pad_right.speed }) {
+        *value = reader.read_float();
+    }
+
+    game.force_refresh = reader.read_bool();
+    return !reader.failed();
+}
+
+
+/*
+    Names known by the members of a room, written once before them. Each member is written as:
+        - `Whole`: it knows every name of the table, nothing else
+        - `Subset`: a bit per name of the table, in the order of the ids
+        - `Runs`: its own runs of ids, when it knows a generation of a name that isn't the one of the table
+    A room is joined by names that are often consecutive ids, the table is written in runs too.
+    Alone (the users of the lobby), the table is empty and the members are written in runs
+*/
+struct NameTable {
+    enum class Encoding : std::uint8_t { Whole, Subset, Runs };
+
+    // The generation of an id is the one known by the first member knowing it
+    KnownNames names;
+    // The known ids, in order
+    std::vector<std::size_t> ids;
+
+
+    void add(KnownNames const& known_names) {
+        auto const& generations = known_names.generations;
+        // Most members know the same names, a comparison is enough
+        if (generations.size() <= names.generations.size()
+        &&  std::equal(std::begin(generations), std::end(generations), std::begin(names.generations))) {
+            return;
+        }
+
+        if (generations.size() > names.generations.size()) {
+            names.generations.resize(generations.size(), 0);
+        }
+
+        for(std::size_t id{ 0 }; id < generations.size(); ++id) {
+            if (names.generations[id] == 0) {
+                names.generations[id] = generations[id];
+            }
+        }
+    }
+
+
+    void index() {
+        ids.clear();
+        for(std::size_t id{ 0 }; id < names.generations.size(); ++id) {
+            if (names.generations[id] != 0) {
+                ids.push_back(id);
+            }
+        }
+    }
+
+
+    Encoding encoding_of(KnownNames const& known_names) const {
+        auto const& generations = known_names.generations;
+        auto const& table = names.generations;
+        auto common = std::min(generations.size(), table.size());
+        auto is_zero = [] (unsigned generation) { return generation == 0; };
+
+        if (std::equal(std::begin(generations), std::begin(generations) + static_cast<std::ptrdiff_t>(common), std::begin(table))
+        &&  std::all_of(std::begin(generations) + static_cast<std::ptrdiff_t>(common), std::end(generations), is_zero)
+        &&  std::all_of(std::begin(table) + static_cast<std::ptrdiff_t>(common), std::end(table), is_zero)) {
+            return Encoding::Whole;
+        }
+
+        for(std::size_t id{ 0 }; id < generations.size(); ++id) {
+            if (generations[id] != 0 && (id >= table.size() || generations[id] != table[id])) {
+                return Encoding::Runs;
+            }
+        }
+
+        return Encoding::Subset;
+    }
+};
+
+
+/*
+    Runs of consecutive known ids: [ids skipped since the previous run][length][generation + 1 of each id]
+*/
+inline void write_generations(StateWriter& writer, std::vector<unsigned> const& generations) {
+    auto next_run = [&generations] (std::size_t from) {
+        auto first = std::find_if(std::begin(generations) + static_cast<std::ptrdiff_t>(from), std::end(generations), [] (unsigned generation) { return generation != 0; });
+        auto last = std::find(first, std::end(generations), 0u);
+        return std::pair{ static_cast<std::size_t>(first - std::begin(generations)), static_cast<std::size_t>(last - std::begin(generations)) };
+    };
+
+    std::size_t run_count{ 0 };
+    for(auto [first, last] = next_run(0); first < generations.size(); std::tie(first, last) = next_run(last)) {
+        ++run_count;
+    }
+
+    writer.write_varint(run_count);
+    std::size_t previous_end{ 0 };
+    for(auto [first, last] = next_run(0); first < generations.size(); std::tie(first, last) = next_run(last)) {
+        writer.write_varint(first - previous_end);
+        writer.write_varint(last - first);
+        for(auto id = first; id < last; ++id) {
+            writer.write_varint(generations[id]);
+        }
+        previous_end = last;
+    }
+}
+
+
+inline bool read_generations(StateReader& reader, UsernameTable const& usernames, std::vector<unsigned>& generations) {
+    auto run_count = reader.read_varint();
+    std::uint64_t end{ 0 };
+    for(std::uint64_t i{ 0 }; i < run_count && !reader.failed(); ++i) {
+        auto first = end + reader.read_varint();
+        end = first + reader.read_varint();
+        if (end > usernames.number_of_id() || first > end) {
+            return false;
+        }
+
+        generations.resize(end, 0);
+        for(auto id = first; id < end; ++id) {
+            generations[id] = static_cast<unsigned>(reader.read_varint());
+        }
+    }
+
+    return !reader.failed();
+}
+
+
+inline void write_known_names(StateWriter& writer, KnownNames const& known_names, NameTable const& table) {
+    auto encoding = table.encoding_of(known_names);
+    writer.write_varint(static_cast<std::uint64_t>(encoding));
+
+    if (encoding == NameTable::Encoding::Subset) {
+        std::vector<std::uint8_t> bits((table.ids.size() + 7) / 8, 0);
+        for(std::size_t i{ 0 }; i < table.ids.size(); ++i) {
+            auto id = table.ids[i];
+            if (id < known_names.generations.size() && known_names.generations[id] != 0) {
+                bits[i / 8] = static_cast<std::uint8_t>(bits[i / 8] | (1u << (i % 8)));
+            }
+        }
+        writer.write_bytes(bits.data(), bits.size());
+    } else if (encoding == NameTable::Encoding::Runs) {
+        write_generations(writer, known_names.generations);
+    }
+}
+
+
+inline bool read_known_names(StateReader& reader, UsernameTable const& usernames, NameTable const& table, KnownNames& known_names) {
+    auto encoding = reader.read_varint();
+
+    if (encoding == static_cast<std::uint64_t>(NameTable::Encoding::Whole)) {
+        known_names = table.names;
+    } else if (encoding == static_cast<std::uint64_t>(NameTable::Encoding::Subset)) {
+        auto bits = reader.read_bytes();
+        if (bits.size != (table.ids.size() + 7) / 8) {
+            return false;
+        }
+
+        for(std::size_t i{ 0 }; i < table.ids.size(); ++i) {
+            if ((std::to_integer<unsigned>(bits.data[i / 8]) >> (i % 8)) & 1u) {
+                auto id = table.ids[i];
+                known_names.generations.resize(std::max(known_names.generations.size(), id + 1), 0);
+                known_names.generations[id] = table.names.generations[id];
+            }
+        }
+    } else if (encoding == static_cast<std::uint64_t>(NameTable::Encoding::Runs)) {
+        return read_generations(reader, usernames, known_names.generations);
+    } else {
+        return false;
+    }
+
+    return !reader.failed();
+}
+
+
+/*
+    The session of a user, its handle is appended to `connections`
+    Its known names are written against `table`, the one of its room (see `NameTable`)
+*/
+inline void write_user(StateWriter& writer, User const& user, std::vector<sf::SocketHandle>& connections, NameTable const& table = {}) {
+    writer.write_bool(user.disconnected);
+    writer.write_varint(user.username.id());
+    writer.write_varint(user.username.generation());
+    writer.write_string(user.username.str());
+    writer.write_varint(pong::packet::index_of(user.encoding));
+    writer.write_bool(user.compressed_frames);
+    write_known_names(writer, user.known_names, table);
+
+    writer.write_bytes(user.input.pending(), user.input.size());
+    writer.write_bytes(user.output.pending(), user.output.size());
+
+    connections.push_back(user.socket->handle());
+}
+
+
+/*
+    Create the user of the next session, its socket adopts the next handle
+    `invalid_user_id` if the session is invalid or its name isn't the one of the table
+*/
+inline user_id_t read_user(StateReader& reader, UserRegistry& users, UsernameTable& usernames,
+    std::vector<sf::SocketHandle> const& connections, std::size_t& next_connection, NameTable const& table = {}) {
+
+    auto disconnected = reader.read_bool();
+    auto name_id = reader.read_varint();
+    auto name_generation = reader.read_varint();
+    auto name = reader.read_string();
+    auto encoding = reader.read_varint();
+    auto compressed_frames = reader.read_bool();
+
+    KnownNames known_names;
+    if (!read_known_names(reader, usernames, table, known_names)) {
+        return invalid_user_id;
+    }
+
+    auto input = reader.read_bytes();
+    auto output = reader.read_bytes();
+
+    if (reader.failed() || encoding >= pong::packet::number_of_encoding || next_connection >= connections.size()) {
+        return invalid_user_id;
+    }
+    if (name_id != pong::packet::server::no_name
+    &&  (name_id >= usernames.number_of_id() || usernames.generation_of(static_cast<name_id_t>(name_id)) != name_generation
+         || usernames.name_of(static_cast<name_id_t>(name_id)) != name)) {
+        std::cerr << "[Warning] The name " << name << " isn't in the table of the snapshot\n";
+        return invalid_user_id;
+    }
+
+
+    auto socket = std::make_unique<TcpSocket>();
+    socket->adopt(connections[next_connection++]);
+    socket->setBlocking(false);
+
+    auto user_id = users.create(std::move(socket));
+    auto& user = *users.get(user_id);
+    user.disconnected = disconnected;
+    if (name_id != pong::packet::server::no_name) {
+        user.username = Username{ usernames, static_cast<name_id_t>(name_id) };
+    }
+    user.encoding = static_cast<pong::packet::Encoding>(encoding);
+    user.compressed_frames = compressed_frames;
+    user.known_names = std::move(known_names);
+
+    auto* region = output.size > 0 ? user.output.allocate(output.size) : nullptr;
+    if (!user.input.append(input.data, input.size) || (output.size > 0 && region == nullptr)) {
+        users.destroy(user_id);
+        return invalid_user_id;
+    }
+    if (region) {
+        std::memcpy(region, output.data, output.size);
+    }
+
+    return user_id;
+}
+
+
+/*
+    Appended to the writer, the handles of the members to `connections`
+*/
+inline void write_room(StateWriter& writer, RoomState const& room, std::vector<sf::SocketHandle>& connections) {
+    writer.write_varint(RoomSnapshot::version);
+
+    writer.write_varint(room.left_player);
+    writer.write_varint(room.right_player);
+
+    // From the next player to the last one
+    writer.write_varint(room.queue.size());
+    room.queue.for_each([&writer] (user_id_t id) {
+        writer.write_varint(id);
+    });
+
+    writer.write_varint(room.next_player_left);
+    writer.write_float(room.next_player_left_timer);
+    writer.write_varint(room.next_player_right);
+    writer.write_float(room.next_player_right_timer);
+
+    writer.write_float(room.time);
+    write_game(writer, room.game);
+    writer.write_varint(room.score.left);
+    writer.write_varint(room.score.right);
+
+    writer.write_bool(room.playback != nullptr);
+    if (room.playback) {
+        auto progress = room.playback->progress();
+        writer.write_string(room.playback->path);
+        writer.write_varint(progress.position);
+        writer.write_fixed64(static_cast<std::uint64_t>(progress.next_time));
+        writer.write_double(progress.elapsed);
+        writer.write_bool(progress.ended);
+        writer.write_float(room.playback_restart_timer);
+    }
+
+    NameTable table;
+    for(user_handle_t handle{ 0 }; handle < room.number_of_user(); ++handle) {
+        table.add(room.get_user(handle).known_names);
+    }
+    table.index();
+    write_generations(writer, table.names.generations);
+
+    writer.write_varint(room.number_of_user());
+    for(user_handle_t handle{ 0 }; handle < room.number_of_user(); ++handle) {
+        writer.write_varint(room.get_user_id(handle));
+        write_user(writer, room.get_user(handle), connections, table);
+    }
+}
+
+
+/*
+    `room` is an empty room of its RoomRegistry, the lobby is told about it once restored
+*/
+inline bool read_room(StateReader& reader, RoomState& room, UsernameTable& usernames,
+    std::vector<sf::SocketHandle> const& connections, std::size_t& next_connection) {
+
+    if (reader.read_varint() != RoomSnapshot::version) {
+        std::cerr << "[Warning] The snapshot of room #" << room.room_id << " isn't of the same version\n";
+        return false;
+    }
+
+    // The ids of the snapshot, replaced once the members are restored
+    auto left_player = reader.read_varint();
+    auto right_player = reader.read_varint();
+
+    std::vector<user_id_t> queue;
+    auto queue_size = reader.read_varint();
+    for(std::uint64_t i{ 0 }; i < queue_size && !reader.failed(); ++i) {
+        queue.push_back(reader.read_varint());
+    }
+
+    auto next_player_left = reader.read_varint();
+    room.next_player_left_timer = reader.read_float();
+    auto next_player_right = reader.read_varint();
+    room.next_player_right_timer = reader.read_float();
+
+    room.time = reader.read_float();
+    if (!read_game(reader, room.game)) {
+        return false;
+    }
+    room.score.left = static_cast<unsigned>(reader.read_varint());
+    room.score.right = static_cast<unsigned>(reader.read_varint());
+
+    if (reader.read_bool()) {
+        auto path = reader.read_string();
+        MatchPlayback::Progress progress;
+        progress.position = reader.read_varint();
+        progress.next_time = static_cast<std::int64_t>(reader.read_fixed64());
+        progress.elapsed = reader.read_double();
+        progress.ended = reader.read_bool();
+        auto restart_timer = reader.read_float();
+
+        // Before the members, the room must be empty
+        auto playback = std::make_unique<MatchPlayback>();
+        if (!reader.failed() && playback->open(path)) {
+            room.start_playback(std::move(playback), usernames);
+            room.playback->seek(progress);
+            room.playback_restart_timer = restart_timer;
+        } else {
+            std::cerr << "[Warning] Can't replay " << path << " anymore, room #" << room.room_id << " is a normal room\n";
+        }
+    }
+
+
+    NameTable table;
+    if (!read_generations(reader, usernames, table.names.generations)) {
+        return false;
+    }
+    table.index();
+
+    std::unordered_map<user_id_t, user_id_t> ids;
+    auto member_count = reader.read_varint();
+    for(std::uint64_t i{ 0 }; i < member_count && !reader.failed(); ++i) {
+        auto old_id = reader.read_varint();
+        auto id = read_user(reader, room.user_registry(), usernames, connections, next_connection, table);
+        if (id == invalid_user_id) {
+            return false;
+        }
+
+        room.restore(id);
+        ids.emplace(old_id, id);
+    }
+
+    auto restored_id = [&ids] (user_id_t old_id) {
+        auto it = ids.find(old_id);
+        return it != std::end(ids) ? it->second : invalid_user_id;
+    };
+
+    room.left_player = restored_id(left_player);
+    room.right_player = restored_id(right_player);
+    room.next_player_left = restored_id(next_player_left);
+    room.next_player_right = restored_id(next_player_right);
+    for(auto old_id : queue) {
+        if (auto id = restored_id(old_id); id != invalid_user_id && !room.queue.push_back(id)) {
+            std::cerr << "[Warning] User ID#" << old_id << " is twice in the queue of room #" << room.room_id << '\n';
+        }
+    }
+
+    room.notify_lobby();
+    return !reader.failed();
+}
+
+}
+
+
+
+
+
+inline RoomSnapshot snapshot_room(RoomState const& room) {
+    RoomSnapshot snapshot;
+    StateWriter writer;
+    details::write_room(writer, room, snapshot.connections);
+    snapshot.bytes = std::move(writer.bytes);
+
+    return snapshot;
+}
+
+
+/*
+    `room` must be an empty room of its RoomRegistry, allocated for the snapshot
+    false if the snapshot is invalid, the members restored until then are in the room
+*/
+inline bool restore_room(RoomSnapshot const& snapshot, RoomState& room, UsernameTable& usernames) {
+    StateReader reader{ snapshot.bytes.data(), snapshot.bytes.size() };
+    std::size_t next_connection{ 0 };
+
+    return details::read_room(reader, room, usernames, snapshot.connections, next_connection)
+        && reader.at_end() && next_connection == snapshot.connections.size();
+}
+
+}
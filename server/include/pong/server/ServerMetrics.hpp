@@ -0,0 +1,135 @@
+#pragma once
+
+#include <pong/server/Metrics.hpp>
+
+#include <pong/packet/Client.hpp>
+#include <pong/packet/Server.hpp>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <variant>
+
+namespace pong::server {
+
+/*
+    Metrics of a game thread, owned by its UserRegistry
+
+    The counters of the packets are updated by the states as they receive and send (see `StateBase`),
+    the gauges by `publish` (see main2.cpp) from the states and the registry
+*/
+struct ServerMetrics {
+
+    static constexpr std::size_t number_of_client_packet{ std::variant_size_v<pong::packet::client::Any> };
+    static constexpr std::size_t number_of_server_packet{ std::variant_size_v<pong::packet::server::Any> };
+
+
+    MetricsRegistry registry;
+
+
+    // Indexed by the id of the packet, the last entry counts the unknown ids
+    std::array<Counter*, number_of_client_packet + 1> packets_received;
+    std::array<Counter*, number_of_client_packet + 1> bytes_received;
+
+    // Indexed by the id of the packet, the bytes are the ones of the frame, compressed or not
+    std::array<Counter*, number_of_server_packet> packets_sent;
+    std::array<Counter*, number_of_server_packet> bytes_sent;
+
+    // Messages not queued because the output buffer of the user was full
+    std::array<Counter*, number_of_server_packet> packets_dropped;
+
+    // Pending bytes of each user with messages, observed at every flush
+    Histogram& output_queue_bytes;
+    // Bytes still pending after the last flush, for all the users
+    Gauge& output_backlog_bytes;
+
+    Gauge& users;
+    Gauge& new_users;
+    Gauge& lobby_users;
+    GaugeSet& room_users;
+    Gauge& rooms;
+
+    Counter& connections;
+    Counter& write_syscalls;
+    Counter& socket_syscalls;
+    Counter& compressed_bytes_in;
+    Counter& compressed_bytes_out;
+    // CPU time spent compressing the frames
+    Counter& compression_microseconds;
+
+    // From `FindMatch` to `MatchFound`, per user paired
+    Histogram& matchmaking_wait_milliseconds;
+    Counter& matches;
+    Gauge& matchmaking_users;
+
+
+    ServerMetrics()
+    :   output_queue_bytes{ registry.histogram("pong_output_queue_bytes", "Pending bytes of a user when its messages are flushed") }
+    ,   output_backlog_bytes{ registry.gauge("pong_output_backlog_bytes", "Bytes not written by the last flush, for every user") }
+    ,   users{ registry.gauge("pong_users", "Connected users") }
+    ,   new_users{ registry.gauge("pong_state_users", "Users per state", "state=\"NewUserState\"") }
+    ,   lobby_users{ registry.gauge("pong_state_users", "Users per state", "state=\"MainLobbyState\"") }
+    ,   room_users{ registry.gauge_set("pong_room_users", "Users per room (RoomState)", "room") }
+    ,   rooms{ registry.gauge("pong_rooms", "Rooms") }
+    ,   connections{ registry.counter("pong_connections_total", "Accepted connections") }
+    ,   write_syscalls{ registry.counter("pong_socket_writes_total", "Writes to the sockets") }
+    ,   socket_syscalls{ registry.counter("pong_socket_syscalls_total", "Syscalls made by the transport to receive and send") }
+    ,   compressed_bytes_in{ registry.counter("pong_compression_bytes_in_total", "Bytes of the frames before compression") }
+    ,   compressed_bytes_out{ registry.counter("pong_compression_bytes_out_total", "Bytes of the frames after compression") }
+    ,   compression_microseconds{ registry.counter("pong_compression_microseconds_total", "CPU time spent compressing the frames") }
+    ,   matchmaking_wait_milliseconds{ registry.histogram("pong_matchmaking_wait_milliseconds", "Time a user waited for a match, once paired") }
+    ,   matches{ registry.counter("pong_matches_total", "Pairs of users made by the matchmaking") }
+    ,   matchmaking_users{ registry.gauge("pong_matchmaking_users", "Users waiting for a match") } {
+
+        register_packets<pong::packet::client::Any>(packets_received, "pong_packets_received_total", "Packets received, per type");
+        register_packets<pong::packet::client::Any>(bytes_received, "pong_bytes_received_total", "Bytes of the frames received, per packet type");
+        register_packets<pong::packet::server::Any>(packets_sent, "pong_packets_sent_total", "Packets queued to be sent, per type");
+        register_packets<pong::packet::server::Any>(bytes_sent, "pong_bytes_sent_total", "Bytes of the frames queued to be sent, per packet type");
+        register_packets<pong::packet::server::Any>(packets_dropped, "pong_packets_dropped_total", "Packets dropped because the output buffer of the user was full, per type");
+    }
+
+    ServerMetrics(ServerMetrics const&) = delete;
+    ServerMetrics& operator=(ServerMetrics const&) = delete;
+
+
+    void on_received(pong::packet::id_t id, std::size_t frame_size) {
+        auto index = std::min<std::size_t>(id, number_of_client_packet);
+        packets_received[index]->add();
+        bytes_received[index]->add(frame_size);
+    }
+
+
+    void on_sent(pong::packet::id_t id, std::size_t frame_size) {
+        packets_sent[id]->add();
+        bytes_sent[id]->add(frame_size);
+    }
+
+
+    void on_dropped(pong::packet::id_t id) {
+        packets_dropped[id]->add();
+    }
+
+
+private:
+
+
+    template<typename Any, std::size_t N>
+    void register_packets(std::array<Counter*, N>& counters, char const* name, char const* help) {
+        register_packets<Any>(counters, name, help, std::make_index_sequence<std::variant_size_v<Any>>{});
+
+        // The entry of the unknown ids
+        if constexpr (N > std::variant_size_v<Any>) {
+            counters.back() = &registry.counter(name, help, "packet=\"Unknown\"");
+        }
+    }
+
+
+    template<typename Any, std::size_t N, std::size_t...Is>
+    void register_packets(std::array<Counter*, N>& counters, char const* name, char const* help, std::index_sequence<Is...>) {
+        ((counters[Is] = &registry.counter(name, help, std::string{ "packet=\"" } + std::variant_alternative_t<Is, Any>::name + "\"")), ...);
+    }
+
+};
+
+}
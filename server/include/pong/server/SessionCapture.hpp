@@ -0,0 +1,338 @@
+#pragma once
+
+#include <SFML/System.hpp>
+
+#include <pong/server/Common.hpp>
+
+#include <pong/packet/Encoding.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Log of the sessions of a server: every frame received and sent, with its time and the id of its user
+
+    The file starts with `capture_magic` (its last byte is the version), then the records follow:
+
+        [record type][time since the previous record, in microseconds][user id][content]
+
+    Integers are LEB128 varints (see Encoding.hpp), so a record of a small frame is the frame plus ~4 bytes.
+    The frames are stored without their size header, they're the packets as the states see them:
+    - Connect: a session is created, before any of its frames
+    - Inbound: a frame handled by a state, [size][bytes]
+    - OversizedFrame: a frame announcing [size] bytes, more than an InputBuffer holds; the session is closed
+    - Disconnect: the session is closed because the connection failed
+    - Update: the `dt` given to the games, [microseconds], no user
+    - Outbound: a frame written to the socket of the user, [size][bytes]
+
+    A tick of the server loop is its Connect, Inbound, OversizedFrame and Disconnect records, its Update, then its Outbound records.
+    Inbound frames are recorded when a state handles them, so a replay feeding the inbound frames of a tick
+    to the same states at the same tick takes the same decisions (see ReplayTransport and replay.cpp).
+    `dt` is kept in microseconds, as sf::Time does, the seconds given to the games are found back exactly.
+    An idle tick costs ~3 bytes, the records are buffered and written every `buffer_size` bytes or `write_period`
+*/
+
+static constexpr std::array<char, 8> capture_magic{ 'P', 'O', 'N', 'G', 'C', 'A', 'P', 1 };
+
+enum class CaptureRecord : std::uint8_t {
+    Connect,
+    Inbound,
+    OversizedFrame,
+    Disconnect,
+    Update,
+    Outbound
+};
+
+static constexpr std::size_t number_of_capture_record{ 6 };
+
+
+
+
+struct SessionCapture {
+
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t buffer_size{ 1 << 16 };
+    static constexpr std::chrono::seconds write_period{ 1 };
+
+
+    SessionCapture() = default;
+
+    SessionCapture(SessionCapture const&) = delete;
+    SessionCapture& operator=(SessionCapture const&) = delete;
+
+    ~SessionCapture() {
+        write_buffer();
+    }
+
+
+    /*
+        false if the file can't be created
+    */
+    bool open(std::string const& path) {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        file.write(capture_magic.data(), capture_magic.size());
+        last_record = clock::now();
+        last_write = last_record;
+        buffer.reserve(buffer_size);
+        return true;
+    }
+
+
+    /*
+        End of the receive phase of a tick, `dt` is given to the games
+    */
+    void update(sf::Time dt) {
+        // The previous ticks are complete
+        if (last_record - last_write >= write_period) {
+            write_buffer();
+        }
+
+        begin(CaptureRecord::Update);
+        write_varint(static_cast<std::uint64_t>(dt.asMicroseconds()));
+    }
+
+
+    void connect(user_id_t user) {
+        begin(CaptureRecord::Connect, user);
+    }
+
+
+    void inbound(user_id_t user, std::byte const* packet, std::size_t size) {
+        begin(CaptureRecord::Inbound, user);
+        write_bytes(packet, size);
+    }
+
+
+    void oversized(user_id_t user, std::size_t size) {
+        begin(CaptureRecord::OversizedFrame, user);
+        write_varint(size);
+    }
+
+
+    void disconnect(user_id_t user) {
+        begin(CaptureRecord::Disconnect, user);
+    }
+
+
+    /*
+        Frames [frames, frames + size) queued for the user, with their size header, as in its OutputBuffer
+    */
+    void outbound(user_id_t user, std::byte const* frames, std::size_t size) {
+        std::size_t position{ 0 };
+        while(size - position >= sizeof(sf::Uint32)) {
+            std::size_t frame_size{ 0 };
+            for(std::size_t i{ 0 }; i < sizeof(sf::Uint32); ++i) {
+                frame_size = (frame_size << 8) | std::to_integer<std::size_t>(frames[position + i]);
+            }
+            position += sizeof(sf::Uint32);
+
+            begin(CaptureRecord::Outbound, user);
+            write_bytes(frames + position, frame_size);
+            position += frame_size;
+        }
+    }
+
+
+private:
+
+
+    std::ofstream file;
+    std::vector<std::byte> buffer;
+    clock::time_point last_record{};
+    clock::time_point last_write{};
+    bool failed{ false };
+
+
+    void begin(CaptureRecord record, user_id_t user = invalid_user_id) {
+        if (buffer.size() >= buffer_size) {
+            write_buffer();
+        }
+
+        auto now = clock::now();
+        buffer.push_back(static_cast<std::byte>(record));
+        write_varint(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - last_record).count()));
+        last_record = now;
+
+        if (record != CaptureRecord::Update) {
+            write_varint(user);
+        }
+    }
+
+
+    void write_varint(std::uint64_t value) {
+        for(; value >= 0x80; value >>= 7) {
+            buffer.push_back(static_cast<std::byte>(value | 0x80));
+        }
+        buffer.push_back(static_cast<std::byte>(value));
+    }
+
+
+    void write_bytes(std::byte const* bytes, std::size_t size) {
+        write_varint(size);
+        buffer.insert(std::end(buffer), bytes, bytes + size);
+    }
+
+
+    void write_buffer() {
+        last_write = last_record;
+        if (buffer.empty() || failed) {
+            buffer.clear();
+            return;
+        }
+
+        file.write(reinterpret_cast<char const*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        file.flush();
+        if (!file) {
+            std::cerr << "[Warning] Can't write the capture, the sessions aren't recorded anymore\n";
+            failed = true;
+        }
+        buffer.clear();
+    }
+
+};
+
+
+
+
+/*
+    A record of a capture, see SessionCapture
+*/
+struct CaptureEvent {
+    CaptureRecord record;
+    // Since the first record
+    std::chrono::microseconds time;
+    user_id_t user;
+    sf::Time dt;
+    // Announced by `OversizedFrame`
+    std::size_t size;
+    // The frame without its size header, for `Inbound` and `Outbound`
+    std::vector<std::byte> bytes;
+};
+
+
+/*
+    Reads the records of a capture one by one
+*/
+struct CaptureReader {
+
+    // A larger frame means the file is corrupted
+    static constexpr std::size_t max_frame_size{ std::size_t{ 1 } << 24 };
+
+
+    bool open(std::string const& path) {
+        file.open(path, std::ios::binary);
+
+        std::array<char, capture_magic.size()> magic{};
+        file.read(magic.data(), magic.size());
+        return file && magic == capture_magic;
+    }
+
+
+    /*
+        false at the end of the file, or if the record is malformed (see `failed`)
+    */
+    bool next(CaptureEvent& event) {
+        auto type = file.get();
+        if (type == std::ifstream::traits_type::eof()) {
+            return false;
+        }
+        if (type >= static_cast<int>(number_of_capture_record)) {
+            error = true;
+            return false;
+        }
+
+
+        event.record = static_cast<CaptureRecord>(type);
+        time += std::chrono::microseconds{ read_varint() };
+        event.time = time;
+        event.user = invalid_user_id;
+        event.bytes.clear();
+
+        switch(event.record) {
+            case CaptureRecord::Update: {
+                event.dt = sf::microseconds(static_cast<sf::Int64>(read_varint()));
+                break;
+            }
+
+            case CaptureRecord::OversizedFrame: {
+                event.user = read_varint();
+                event.size = read_varint();
+                break;
+            }
+
+            case CaptureRecord::Inbound:
+            case CaptureRecord::Outbound: {
+                event.user = read_varint();
+                auto size = read_varint();
+                if (size > max_frame_size) {
+                    error = true;
+                    return false;
+                }
+
+                event.bytes.resize(size);
+                file.read(reinterpret_cast<char*>(event.bytes.data()), static_cast<std::streamsize>(size));
+                break;
+            }
+
+            case CaptureRecord::Connect:
+            case CaptureRecord::Disconnect: {
+                event.user = read_varint();
+                break;
+            }
+        }
+
+        if (!file || error) {
+            error = true;
+            return false;
+        }
+        return true;
+    }
+
+
+    bool failed() const {
+        return error;
+    }
+
+
+private:
+
+    std::ifstream file;
+    std::chrono::microseconds time{ 0 };
+    bool error{ false };
+
+
+    std::uint64_t read_varint() {
+        std::uint64_t value{ 0 };
+        for(std::size_t i{ 0 }; i < pong::packet::details::max_varint_size(sizeof(std::uint64_t)); ++i) {
+            auto byte = file.get();
+            if (byte == std::ifstream::traits_type::eof()) {
+                error = true;
+                return 0;
+            }
+
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << (7 * i);
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+
+        error = true;
+        return 0;
+    }
+
+};
+
+}
@@ -10,66 +10,82 @@
 #include <functional>
 #include <atomic>
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <variant>
 #include <cassert>
 #include <unordered_set>
 #include <experimental/type_traits>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 
 #include <multipong/Game.hpp>
 #include <multipong/Packets.hpp>
 
 #include <pong/packet/Client.hpp>
+#include <pong/packet/Compression.hpp>
 #include <pong/packet/Server.hpp>
 #include <multipong/Game.hpp>
 
 #include <pong/server/Common.hpp>
+#include <pong/server/Dispatch.hpp>
+#include <pong/server/UserRegistry.hpp>
 
 namespace pong::server {
 
 template<typename C>
 struct StateBase {
-    using packet_t = sf::Packet;
-
-    using receiver_t = Action (C::*)(user_handle_t, packet_t);
-    using sender_t = Action (C::*)(user_handle_t);
-
-    using receiver_map_t = std::unordered_map<pong::packet::id_t, receiver_t>;
-    using sender_map_t = std::unordered_map<pong::packet::id_t, sender_t>;
+    using receiver_t = Action (*)(C&, user_handle_t, pong::packet::details::Reader&);
 
     using on_user_enter_t = void (C::*)(user_handle_t);
     using on_user_leave_t = void (C::*)(user_handle_t);
+    using on_empty_t = void (C::*)();
 
     static constexpr bool has_on_user_leave{ std::experimental::is_detected_exact_v<on_user_leave_t, decltype_on_user_leave, C> };
     static constexpr bool has_on_user_enter{ std::experimental::is_detected_exact_v<on_user_enter_t, decltype_on_user_enter, C> };
+    static constexpr bool has_on_empty{ std::experimental::is_detected_exact_v<on_empty_t, decltype_on_empty, C> };
 
 
-    static constexpr std::size_t max_number_of_packet{ 16 };
+private:
 
+    UserRegistry& registry;
 
-private:
+    // Ids of the members of the state, a user handle is an index in it
+    std::vector<user_id_t> members;
 
-    template<typename C_> friend struct StateBase;
+    // Serialized packet of the last broadcast, and its compressed frame, per encoding
+    std::array<std::vector<std::byte>, pong::packet::number_of_encoding> broadcast_frames;
+    std::array<std::vector<std::byte>, pong::packet::number_of_encoding> broadcast_compressed_frames;
 
-    receiver_map_t receivers;
-    std::vector<User> users;
+    // Last frame sent to a user with `compressed_frames`, before and after compression
+    std::vector<std::byte> uncompressed_frame;
+    std::vector<std::byte> compressed_frame;
 
 
 public:
 
 
-    StateBase(
-        receiver_map_t const& receive = {}
-    ) : receivers{ receive } {}
+    /*
+        Frames of this size or more are compressed for the users with `compressed_frames`:
+        the rosters of `LobbyInfo` and `RoomInfo` on a busy server, the packets of a game are far smaller
+    */
+    static constexpr std::size_t compression_threshold{ 512 };
+
+
+    StateBase(UserRegistry& _registry) : registry{ _registry } {}
 
 
-    template<typename...Args>
-    user_handle_t create(std::unique_ptr<sf::TcpSocket> socket) {
-        assert(socket && "Socket must not be null");
+    user_handle_t create(user_id_t id) {
+        auto* user = registry.get(id);
+        assert(user && "User must be alive");
 
 
         user_handle_t handle = number_of_user();
-        users.push_back({ std::move(socket) });
+        members.push_back(id);
+        user->state = this;
+        user->handle = handle;
 
 
         // State has the `on_user_enter` member
@@ -82,44 +98,72 @@ public:
     }
 
 
+    /*
+        Member of the state in another process (see HotRestart.hpp), nothing is sent: the user already got what it knows
+        The members are restored in the order of their handles
+    */
+    user_handle_t restore(user_id_t id) {
+        auto* user = registry.get(id);
+        assert(user && "User must be alive");
+
+        user_handle_t handle = number_of_user();
+        members.push_back(id);
+        user->state = this;
+        user->handle = handle;
+
+        return handle;
+    }
+
+
     bool is_valid(user_handle_t handle) const {
-        return handle != invalid_user_handle && handle < users.size() && users[handle].socket != nullptr;
+        if (handle == invalid_user_handle || handle >= members.size()) {
+            return false;
+        }
+
+        auto const* user = registry.get(members[handle]);
+        return user != nullptr && user->state == this;
     }
 
 
     User& get_user(user_handle_t handle) {
         assert(is_valid(handle));
 
-        return users[handle];
+        return *registry.get(members[handle]);
     }
 
 
     User const& get_user(user_handle_t handle) const {
         assert(is_valid(handle));
 
-        return users[handle];
+        return *registry.get(members[handle]);
     }
 
 
     user_id_t get_user_id(user_handle_t handle) const {
-        return reinterpret_cast<user_id_t>(get_user(handle).socket.get());
+        assert(handle < members.size());
+
+        return members[handle];
     }
 
 
     user_handle_t get_user_handle(user_id_t id) const {
-        for(user_handle_t handle = 0; handle < users.size(); ++handle) {
-            if (reinterpret_cast<user_id_t>(users[handle].socket.get()) == id) {
-                assert(is_valid(handle));
-                return handle;
-            }
+        auto const* user = registry.get(id);
+        if (user != nullptr && user->state == this) {
+            assert(members[user->handle] == id);
+            return user->handle;
         }
 
         return invalid_user_handle;
     }
 
 
+    Username const& get_username(user_handle_t handle) const {
+        return get_user(handle).username;
+    }
+
+
     std::size_t number_of_user() const {
-        return users.size();
+        return members.size();
     }
 
 
@@ -128,89 +172,280 @@ public:
     }
 
 
-    template<typename...Args>
-    void send(user_handle_t handle, Args&&...args) {
-        return send_packet(handle, to_packet(std::forward<Args>(args)...));
+    UserRegistry& user_registry() {
+        return registry;
     }
 
 
-    void send_packet(user_handle_t handle, sf::Packet const& packet) {
-        assert(is_valid(handle));
-
+    /*
+        Write the frame of the packet `packet_id`, `frame_size` bytes, at the end of the output buffer of the user with `write(Writer&)`
+        The writer has the encoding of the user, `frame_size` must be computed with it
+        The message is dropped if the output buffer is full
 
-        if(users[handle].packets.size() >= max_number_of_packet) {
-            std::cerr << "User packets count can't exceed the maximum allowed\n";
-            return;
+        A frame from `compression_threshold` bytes sent to a user with `compressed_frames` is written aside first,
+        and replaced by its compressed frame if it's smaller
+    */
+    template<typename F>
+    void send_with(user_handle_t handle, pong::packet::id_t packet_id, std::size_t frame_size, F&& write) {
+        if (frame_size >= compression_threshold && get_user(handle).compressed_frames) {
+            uncompressed_frame.resize(frame_size);
+            pong::packet::details::Writer writer{ uncompressed_frame.data(), get_user(handle).encoding };
+            write(writer);
+            assert(writer.position == uncompressed_frame.data() + frame_size && "The frame must fill its region");
+
+            compress_frame(uncompressed_frame, compressed_frame);
+            return send_smallest(handle, packet_id, uncompressed_frame, compressed_frame);
         }
 
+        write_frame(handle, packet_id, frame_size, std::forward<F>(write));
+    }
+
 
-        users[handle].packets.push_back(packet);
+    /*
+        Serialize the packet directly into the output buffer of the user, its size is computed first
+    */
+    template<typename P>
+    void send(user_handle_t handle, P const& packet) {
+        constexpr auto packet_id = pong::packet::server::id_of<P>();
+        send_with(handle, packet_id, pong::packet::details::frame_size(packet, get_user(handle).encoding), [&packet] (auto& writer) {
+            pong::packet::details::write_frame(writer, packet_id, packet);
+        });
     }
 
 
-    template<typename...Ps>
-    void broadcast(Ps&&... ps) {
-        auto packet = to_packet(std::forward<Ps>(ps)...);
+    /*
+        Serialize the packet once per encoding, and copy it to the users satisfying `predicate(handle)`
+        The users detached by a transition during `receive_packets` are skipped, they wait at the end to be removed
+    */
+    template<typename P, typename F>
+    void broadcast_if(P const& packet, F&& predicate) {
+        constexpr auto packet_id = pong::packet::server::id_of<P>();
+        std::array<bool, pong::packet::number_of_encoding> serialized{};
+        std::array<bool, pong::packet::number_of_encoding> compressed{};
+
         for(user_handle_t handle{ 0 }; handle < number_of_user(); ++handle) {
-            send_packet(handle, packet);
+            if (!is_valid(handle) || !predicate(handle)) {
+                continue;
+            }
+
+
+            auto const& user = get_user(handle);
+            auto encoding = pong::packet::index_of(user.encoding);
+            auto& frame = broadcast_frames[encoding];
+
+            if (!serialized[encoding]) {
+                // Reuse the capacity of the previous broadcasts
+                frame.resize(pong::packet::details::frame_size(packet, user.encoding));
+                pong::packet::details::Writer writer{ frame.data(), user.encoding };
+                pong::packet::details::write_frame(writer, packet_id, packet);
+                serialized[encoding] = true;
+            }
+
+
+            if (frame.size() >= compression_threshold && user.compressed_frames) {
+                auto& compressed_broadcast = broadcast_compressed_frames[encoding];
+                if (!compressed[encoding]) {
+                    compress_frame(frame, compressed_broadcast);
+                    compressed[encoding] = true;
+                }
+
+                send_smallest(handle, packet_id, frame, compressed_broadcast);
+                continue;
+            }
+
+
+            write_frame(handle, packet_id, frame.size(), [&frame] (auto& writer) {
+                writer.append(frame.data(), frame.size());
+            });
         }
     }
 
 
-    template<typename...Ps>
-    void broadcast_other(user_handle_t except_handle, Ps&&... ps) {
-        auto packet = to_packet(std::forward<Ps>(ps)...);
+    template<typename P>
+    void broadcast(P const& packet) {
+        broadcast_if(packet, [] (user_handle_t) { return true; });
+    }
+
+
+    template<typename P>
+    void broadcast_other(user_handle_t except_handle, P const& packet) {
+        broadcast_if(packet, [except_handle] (user_handle_t handle) { return handle != except_handle; });
+    }
+
+
+    /*
+        Send `UserName` if the user doesn't know the name yet
+        Must be called before sending a packet referencing the name id
+    */
+    void introduce(user_handle_t handle, Username const& username) {
+        auto& known_names = get_user(handle).known_names;
+        if (!known_names.knows(username)) {
+            known_names.learn(username);
+            send(handle, pong::packet::server::UserName{ username.id(), username.str() });
+        }
+    }
+
+
+    void introduce_to_other(user_handle_t except_handle, Username const& username) {
         for(user_handle_t handle{ 0 }; handle < number_of_user(); ++handle) {
             if (handle != except_handle) {
-                send_packet(handle, packet);
+                introduce(handle, username);
             }
         }
     }
 
 
+    /*
+        The session stays in the UserRegistry, only its id joins the other state
+        The arguments of the `create` of the other state are copied in the transition, they must be trivially copyable
+        Packets sent by `on_user_enter` are queued after the pending ones
+    */
     template<typename S, typename...Args>
     Action order_change_state(S& state, user_handle_t handle, Args&&...args) {
-        return [this, handle, &socket = users[handle].socket, &state, tuple_args = std::make_tuple(std::forward<Args>(args)...)] () mutable {
-            auto new_handle = std::apply([&socket, &state] (auto&&..._args) {
-                return state.create(std::move(socket), std::forward<decltype(_args)>(_args)...);
-            }, std::move(tuple_args));
-
-            std::swap(users[handle].packets, state.users[new_handle].packets);
-            for(auto p : users[handle].packets) {
-                state.users[new_handle].packets.push_back(p);
-            }
+        static_assert((std::is_trivially_copyable_v<std::decay_t<Args>> && ...), "Transition arguments must be trivially copyable");
+        static_assert((std::is_default_constructible_v<std::decay_t<Args>> && ...), "Transition arguments must be default constructible");
+        static_assert((sizeof(std::decay_t<Args>) + ... + 0) <= Leave::max_payload_size, "Transition arguments are too big");
+
+
+        Leave leave{ &state, get_user_id(handle), [] (void* target, user_id_t id, std::byte const* payload) {
+            std::size_t offset{ 0 };
+            [[maybe_unused]] auto read = [payload, &offset] (auto* value) {
+                std::memcpy(value, payload + offset, sizeof(*value));
+                offset += sizeof(*value);
+            };
+
+            std::tuple<std::decay_t<Args>...> values;
+            std::apply([&read] (auto&...value) { (read(&value), ...); }, values);
+
+            std::apply([target, id] (auto&...value) {
+                static_cast<S*>(target)->create(id, value...);
+            }, values);
+        }, {} };
+
+
+        std::size_t offset{ 0 };
+        [[maybe_unused]] auto write = [&leave, &offset] (auto const& value) {
+            std::memcpy(leave.payload.data() + offset, &value, sizeof(value));
+            offset += sizeof(value);
         };
+        (write(std::decay_t<Args>{ std::forward<Args>(args) }), ...);
+
+
+        return leave;
+    }
+
+
+    /*
+        Receivers of the state, built at compile time from `C::handlers`
+        C is incomplete when StateBase<C> is instantiated, hence the function
+    */
+    static std::array<receiver_t, number_of_client_packet> const& dispatch_table() {
+        static constexpr auto table = make_dispatch_table<C, receiver_t>(typename C::handlers{});
+        return table;
     }
 
 
-    std::optional<Action> invoke_receiver(pong::packet::id_t packet_id, user_handle_t handle, sf::Packet packet) {
+    std::optional<Action> invoke_receiver(pong::packet::id_t packet_id, user_handle_t handle, pong::packet::details::Reader& reader) {
         if (has_receiver_for(packet_id)) {
-            return (static_cast<C*>(this)->*receivers[packet_id])(handle, packet);
+            return dispatch_table()[packet_id](*static_cast<C*>(this), handle, reader);
         } else {
             return std::nullopt;
         }
     }
 
-    bool has_receiver_for(pong::packet::id_t packet_id) const {
-        return receivers.count(packet_id);
+    static bool has_receiver_for(pong::packet::id_t packet_id) {
+        return packet_id < number_of_client_packet && dispatch_table()[packet_id] != nullptr;
+    }
+
+
+private:
+
+
+    template<typename F>
+    void write_frame(user_handle_t handle, pong::packet::id_t packet_id, std::size_t frame_size, F&& write) {
+        auto& user = get_user(handle);
+        auto* region = user.output.allocate(frame_size);
+        if (region == nullptr) {
+            std::cerr << "User output can't exceed the maximum allowed\n";
+            registry.metrics.on_dropped(packet_id);
+            return;
+        }
+
+
+        pong::packet::details::Writer writer{ region, user.encoding };
+        write(writer);
+        ++registry.traffic.messages;
+        registry.metrics.on_sent(packet_id, frame_size);
+        assert(writer.position == region + frame_size && "The frame must fill its region");
+    }
+
+
+    void compress_frame(std::vector<std::byte> const& frame, std::vector<std::byte>& compressed) {
+        auto start = std::chrono::steady_clock::now();
+
+        pong::packet::write_compressed_frame(frame.data() + sizeof(sf::Uint32), frame.size() - sizeof(sf::Uint32), compressed);
+
+        registry.compression.time += std::chrono::steady_clock::now() - start;
+    }
+
+
+    /*
+        The compressed frame unless compression didn't reduce the size
+    */
+    void send_smallest(user_handle_t handle, pong::packet::id_t packet_id, std::vector<std::byte> const& frame, std::vector<std::byte> const& compressed) {
+        auto const& smallest = compressed.size() < frame.size() ? compressed : frame;
+
+        write_frame(handle, packet_id, smallest.size(), [&smallest] (auto& writer) {
+            writer.append(smallest.data(), smallest.size());
+        });
+
+        auto& counters = registry.compression;
+        ++counters.frames;
+        counters.bytes_in += frame.size();
+        counters.bytes_out += smallest.size();
     }
 
 
 protected:
 
 
+    /*
+        The user is leaving for another state, its session must survive the removal
+    */
+    void detach(user_handle_t handle) {
+        auto& user = get_user(handle);
+        user.state = nullptr;
+        user.handle = invalid_user_handle;
+    }
+
+
     void swap_users(user_handle_t lhs, user_handle_t rhs) {
         if (lhs != rhs) {
-            std::iter_swap(std::begin(users) + lhs, std::begin(users) + rhs);
+            std::iter_swap(std::begin(members) + lhs, std::begin(members) + rhs);
+
+            // A user detached by a transition isn't member anymore
+            for(auto handle : { lhs, rhs }) {
+                auto* user = registry.get(members[handle]);
+                if (user != nullptr && user->state == this) {
+                    user->handle = handle;
+                }
+            }
         }
     }
 
+    /*
+        Users still member of the state are removed because of an error, their session ends
+    */
     void remove_users(user_handle_t first_non_valid_handle) {
-        auto first = std::begin(users) + first_non_valid_handle;
-        auto last = std::end(users);
+        for(auto it = std::begin(members) + first_non_valid_handle; it != std::end(members); ++it) {
+            auto* user = registry.get(*it);
+            if (user != nullptr && user->state == this) {
+                registry.destroy(*it);
+            }
+        }
 
 
-        users.erase(first, last);
+        members.erase(std::begin(members) + first_non_valid_handle, std::end(members));
     }
 
 
@@ -233,18 +468,16 @@ private:
 public:
 
 
-    StateWithData(
-        typename base_t::receiver_map_t const& receive = {}
-    ) : StateBase<C>(receive) {}
+    StateWithData(UserRegistry& _registry) : StateBase<C>(_registry) {}
 
 
     template<typename...Args>
-    user_handle_t create(std::unique_ptr<sf::TcpSocket> socket, Args&&...args) {
+    user_handle_t create(user_id_t id, Args&&...args) {
         // Push the data before creating the user otherwise on_user_enter won't have access to it
         user_datas.emplace_back(std::forward<Args>(args)...);
 
 
-        auto handle = base_t::create(std::move(socket));
+        auto handle = base_t::create(id);
         assert(handle == user_datas.size() - 1);
 
 
@@ -252,6 +485,17 @@ public:
     }
 
 
+    template<typename...Args>
+    user_handle_t restore(user_id_t id, Args&&...args) {
+        user_datas.emplace_back(std::forward<Args>(args)...);
+
+        auto handle = base_t::restore(id);
+        assert(handle == user_datas.size() - 1);
+
+        return handle;
+    }
+
+
     T& get_user_data(user_handle_t handle) {
         assert(base_t::is_valid(handle));
         assert(handle != invalid_user_handle);
@@ -303,9 +547,7 @@ private:
 public:
 
 
-    StateWithData(
-        typename base_t::receiver_map_t const& receive = {}
-    ) : StateBase<C>(receive) {}
+    StateWithData(UserRegistry& _registry) : StateBase<C>(_registry) {}
 
 
 };
@@ -317,47 +559,92 @@ struct State : StateWithData<C, T> {
     using base_t = StateWithData<C, T>;
 
     using typename base_t::receiver_t;
-    using typename base_t::sender_t;
-    using typename base_t::receiver_map_t;
-    using typename base_t::sender_map_t;
 
     using base_t::has_on_user_leave;
     using base_t::has_on_user_enter;
+    using base_t::has_on_empty;
+
+    // Frames handled per user and per `receive_packets`, the others wait for the next call
+    static constexpr std::size_t max_packet_per_receive{ 16 };
 
-    State(
-        receiver_map_t const& receive = {}
-    ) : StateWithData<C, T>(receive) {}
+
+    State(UserRegistry& _registry) : StateWithData<C, T>(_registry) {}
 
 
 private:
 
 
+    /*
+        Packet in [packet, packet + size), decoded in place
+    */
+    Action
+    proccess_packet(user_handle_t handle, std::byte const* packet, std::size_t size) {
+        pong::packet::details::Reader reader{ packet, size, base_t::get_user(handle).encoding };
+
+        pong::packet::id_t packet_id;
+        reader >> packet_id;
+        if (reader.failed()) {
+            std::cerr << "[Warning] Received a packet without id\n";
+            return Abord{};
+        }
+
+        base_t::user_registry().metrics.on_received(packet_id, sizeof(sf::Uint32) + size);
+
+        auto action = base_t::invoke_receiver(packet_id, handle, reader);
+        if (action) {
+            return std::move(*action);
+        }
+
+        
+        std::cerr << "[Warning] Received Packet #" << static_cast<int>(packet_id) << " but wasn't expected\n";
+        return Idle{};
+    }
+
+
+    /*
+        Handle the frames received by the user (see `UserRegistry::receive`), until one of them makes it leave the state
+        The frames left are handled by its next state
+    */
     Action
     proccess_receive_packets(user_handle_t handle) {
-        sf::Packet packet;
-        switch(base_t::get_user(handle).socket->receive(packet)) {
-            case sf::Socket::NotReady: {
-                return Idle{};
-            }
+        if (base_t::get_user(handle).disconnected) {
+            std::cerr << "Connection lost\n";
+            return Abord{};
+        }
+
 
-            case sf::Socket::Done: {
-                auto packet_id = from_packet<pong::packet::id_t>(packet); 
+        for(std::size_t count{ 0 }; count < max_packet_per_receive; ++count) {
+            auto frame = base_t::get_user(handle).input.next_frame();
 
-                auto action = base_t::invoke_receiver(packet_id, handle, packet);
-                if (action) {
-                    return std::move(*action);
+            switch(frame.status) {
+                case InputBuffer::FrameStatus::Incomplete: {
+                    return Idle{};
                 }
 
-                
-                std::cerr << "[Warning] Received Packet #" << static_cast<int>(packet_id) << " but wasn't expected\n";
-                return Idle{};
-            }
+                case InputBuffer::FrameStatus::TooLarge: {
+                    if (auto& capture = base_t::user_registry().capture) {
+                        capture->oversized(base_t::get_user_id(handle), frame.size);
+                    }
+
+                    std::cerr << "[Warning] Received a frame of " << frame.size << " bytes, the maximum is " << InputBuffer::max_packet_size << "\n";
+                    return Abord{};
+                }
 
-            default: {
-                std::cerr << "Error when sending a packet\n";
-                return Abord{};
+                case InputBuffer::FrameStatus::Complete: {
+                    if (auto& capture = base_t::user_registry().capture) {
+                        capture->inbound(base_t::get_user_id(handle), frame.packet, frame.size);
+                    }
+
+                    auto action = proccess_packet(handle, frame.packet, frame.size);
+                    if (!std::holds_alternative<Idle>(action)) {
+                        return action;
+                    }
+                    break;
+                }
             }
         }
+
+        return Idle{};
     }
 
 
@@ -385,8 +672,9 @@ public:
                 }
 
 
-                if (auto* finalize_leave = std::get_if<Leave>(&action)) {
-                    (*finalize_leave)();
+                if (auto* leave = std::get_if<Leave>(&action)) {
+                    base_t::detach(handle);
+                    base_t::user_registry().transitions.push(*leave);
                 } 
 
 
@@ -398,77 +686,52 @@ public:
         }
 
         // Finally, remove the users that got an error
+        auto someone_left = first_invalid_handler < base_t::number_of_user();
         base_t::remove_users(first_invalid_handler);
-    }
-
 
-private:
+        if (someone_left) {
+            notify_if_empty();
+        }
+    }
 
-    using packet_iterator_t = typename std::vector<sf::Packet>::iterator;
 
     /*
-        std::nullopt => Remove user
-        { iterator } => Remove packets before iterator (not included)
+        Move a member to another state outside of `receive_packets`, as if one of its packets asked for it
+        (the users paired by the matchmaking). The move is made by the next `execute_transitions`
+        The last member takes the handle of the user, the handles kept must be looked up again
     */
-    static std::optional<packet_iterator_t>
-    proccess_send_packets(packet_iterator_t packet_it, packet_iterator_t const end_packets, sf::TcpSocket& socket) {
-        for(; packet_it != end_packets; ++packet_it) {
-            switch(socket.send(*packet_it)) {
-                case sf::Socket::Partial:
-                case sf::Socket::Done:
-                    break;
+    template<typename S, typename...Args>
+    void leave_for(S& state, user_handle_t handle, Args&&...args) {
+        auto action = base_t::order_change_state(state, handle, std::forward<Args>(args)...);
 
-                default: {
-                    std::cerr << "Error when sending a packet\n";
-                    return std::nullopt;
-                }
-            }
+        if constexpr (base_t::has_on_user_leave) {
+            static_cast<C*>(this)->on_user_leave(handle);
         }
 
-        return packet_it;
-    }
-
-
-public:
-
-
-    void send_packets() {
-
+        base_t::detach(handle);
+        base_t::user_registry().transitions.push(std::get<Leave>(action));
 
-        std::size_t first_invalid_handler{ base_t::number_of_user() };
-
-
-        for(user_handle_t handle{ 0 }; handle < first_invalid_handler;) {
-            auto& user = base_t::get_user(handle);
-            auto& packets = user.packets;
-            
-
-            auto res = proccess_send_packets(std::begin(packets), std::end(packets), *user.socket);
-            if (res) {
-
-
-                packets.erase(std::begin(packets), *res);
+        auto last = base_t::number_of_user() - 1;
+        base_t::swap_users(handle, last);
+        base_t::remove_users(last);
 
-                ++handle;
-
-
-            } else {
+        notify_if_empty();
+    }
 
 
-                if constexpr (has_on_user_leave) {
-                    static_cast<C*>(this)->on_user_leave(handle);
-                }
-
+private:
 
-                base_t::swap_users(handle, first_invalid_handler - 1);
-                --first_invalid_handler;
 
+    /*
+        Once the users that left are removed: `on_user_leave` is called while every leaver of the pass is still a member,
+        it can't tell whether the state gets empty
+    */
+    void notify_if_empty() {
+        if constexpr (has_on_empty) {
+            if (base_t::is_empty()) {
+                static_cast<C*>(this)->on_empty();
             }
         }
-
-
-        // Finally, remove the users that got an error
-        base_t::remove_users(first_invalid_handler);
     }
 
 };
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Image of the state of the server, written by a process and read by the next one (see HotRestart.hpp)
+
+    Integers are LEB128 varints and floats their 4 bytes in little endian, like the match recordings (see MatchRecording.hpp),
+    strings and byte arrays are prefixed by their size. The image is only read by a server of the same version,
+    nothing is aligned and nothing is named.
+    `fixed32` and `fixed64` have a known size, for the headers read before the rest
+*/
+struct StateWriter {
+
+    std::vector<std::byte> bytes;
+
+
+    void write_varint(std::uint64_t value) {
+        for(; value >= 0x80; value >>= 7) {
+            bytes.push_back(static_cast<std::byte>(value | 0x80));
+        }
+        bytes.push_back(static_cast<std::byte>(value));
+    }
+
+
+    void write_fixed32(std::uint32_t value) {
+        for(int i{ 0 }; i < 4; ++i) {
+            bytes.push_back(static_cast<std::byte>(value >> (8 * i)));
+        }
+    }
+
+
+    void write_fixed64(std::uint64_t value) {
+        write_fixed32(static_cast<std::uint32_t>(value));
+        write_fixed32(static_cast<std::uint32_t>(value >> 32));
+    }
+
+
+    void write_float(float value) {
+        write_fixed32(std::bit_cast<std::uint32_t>(value));
+    }
+
+
+    void write_double(double value) {
+        write_fixed64(std::bit_cast<std::uint64_t>(value));
+    }
+
+
+    void write_bool(bool value) {
+        bytes.push_back(static_cast<std::byte>(value ? 1 : 0));
+    }
+
+
+    void write_bytes(void const* data, std::size_t size) {
+        write_varint(size);
+        write_raw(data, size);
+    }
+
+
+    void write_string(std::string const& string) {
+        write_bytes(string.data(), string.size());
+    }
+
+
+    /*
+        Without size, the reader must know it
+    */
+    void write_raw(void const* data, std::size_t size) {
+        auto const* first = static_cast<std::byte const*>(data);
+        bytes.insert(std::end(bytes), first, first + size);
+    }
+
+};
+
+
+
+
+/*
+    Reads an image written by a StateWriter, never past its end
+    A truncated or corrupted image sets `failed`, the values read then are zeros and empty strings
+*/
+struct StateReader {
+
+    struct Bytes {
+        std::byte const* data;
+        std::size_t size;
+    };
+
+
+    StateReader(std::byte const* _data, std::size_t _size) : data{ _data }, size{ _size } {}
+
+
+    bool failed() const {
+        return error;
+    }
+
+
+    /*
+        Every byte was read
+    */
+    bool at_end() const {
+        return position == size;
+    }
+
+
+    std::uint64_t read_varint() {
+        std::uint64_t value{ 0 };
+        for(unsigned shift{ 0 }; shift < 64; shift += 7) {
+            auto byte = read_byte();
+            value |= std::uint64_t{ byte & 0x7fu } << shift;
+
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+
+        error = true;
+        return 0;
+    }
+
+
+    std::uint32_t read_fixed32() {
+        std::uint32_t value{ 0 };
+        for(int i{ 0 }; i < 4; ++i) {
+            value |= std::uint32_t{ read_byte() } << (8 * i);
+        }
+
+        return value;
+    }
+
+
+    std::uint64_t read_fixed64() {
+        auto low = read_fixed32();
+        return (std::uint64_t{ read_fixed32() } << 32) | low;
+    }
+
+
+    float read_float() {
+        return std::bit_cast<float>(read_fixed32());
+    }
+
+
+    double read_double() {
+        return std::bit_cast<double>(read_fixed64());
+    }
+
+
+    bool read_bool() {
+        return read_byte() != 0;
+    }
+
+
+    /*
+        In place, valid as long as the image
+    */
+    Bytes read_bytes() {
+        auto length = read_varint();
+        return read_raw(length);
+    }
+
+
+    std::string read_string() {
+        auto bytes = read_bytes();
+        return { reinterpret_cast<char const*>(bytes.data), bytes.size };
+    }
+
+
+    Bytes read_raw(std::uint64_t length) {
+        if (error || length > size - position) {
+            error = true;
+            return { data + position, 0 };
+        }
+
+        std::size_t count = length;
+        position += count;
+        return { data + position - count, count };
+    }
+
+
+private:
+
+    std::byte const* data;
+    std::size_t size;
+    std::size_t position{ 0 };
+    bool error{ false };
+
+
+    std::uint8_t read_byte() {
+        if (error || position >= size) {
+            error = true;
+            return 0;
+        }
+
+        return std::to_integer<std::uint8_t>(data[position++]);
+    }
+
+};
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+
+#include <cstddef>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+namespace pong::server {
+
+/*
+    TCP options of the connections
+
+    The messages of a tick are bundled in the output buffer of the user and written with a single send at the end of the tick,
+    the options only decide when the kernel pushes the bundle on the wire:
+    - `no_delay` disables Nagle's algorithm, the bundle leaves at once instead of waiting for the ACK of the previous one
+      (SFML enables it on every socket, it's the default here too)
+    - `cork` keeps the socket corked and uncorks it after each flush, so a bundle that needs several writes
+      (larger than the send buffer) still leaves as full segments. It costs two `setsockopt` per flush, Linux only
+*/
+struct SocketOptions {
+    bool no_delay{ true };
+    bool cork{ false };
+};
+
+
+
+/*
+    sf::TcpSocket giving access to the options of its handle
+*/
+struct TcpSocket : sf::TcpSocket {
+
+    /*
+        Must be called once connected, false if an option isn't supported
+    */
+    bool configure(SocketOptions const& _options) {
+        options = _options;
+        return set_option(tcp_level, no_delay_option, options.no_delay)
+            && (!options.cork || set_cork(true));
+    }
+
+
+    /*
+        Write the pending bytes of a tick, `sent` of them are accepted by the kernel
+    */
+    Status flush(void const* data, std::size_t size, std::size_t& sent) {
+        auto status = send(data, size, sent);
+
+        if (options.cork && sent > 0) {
+            set_cork(false);
+            set_cork(true);
+        }
+
+        return status;
+    }
+
+
+    /*
+        For the transports that use the socket directly
+    */
+    sf::SocketHandle handle() const {
+        return getHandle();
+    }
+
+
+    /*
+        Take the connected handle of another process (see HotRestart.hpp), the socket must be new
+        The kernel kept the options of the handle, the blocking mode is the one of the socket
+    */
+    void adopt(sf::SocketHandle handle) {
+        create(handle);
+    }
+
+
+private:
+
+    SocketOptions options;
+
+
+#if defined(__unix__) || defined(__APPLE__)
+    static constexpr int tcp_level{ IPPROTO_TCP };
+    static constexpr int no_delay_option{ TCP_NODELAY };
+#else
+    static constexpr int tcp_level{ -1 };
+    static constexpr int no_delay_option{ -1 };
+#endif
+
+
+    bool set_option(int level, int option, bool enabled) {
+#if defined(__unix__) || defined(__APPLE__)
+        int value{ enabled ? 1 : 0 };
+        return setsockopt(getHandle(), level, option, &value, sizeof(value)) == 0;
+#else
+        (void) level;
+        (void) option;
+        return !enabled;
+#endif
+    }
+
+
+    bool set_cork(bool enabled) {
+#if defined(TCP_CORK)
+        return set_option(tcp_level, TCP_CORK, enabled);
+#else
+        return !enabled;
+#endif
+    }
+
+};
+
+
+
+/*
+    sf::TcpListener whose handle can be given to another process, see HotRestart.hpp
+*/
+struct TcpListener : sf::TcpListener {
+
+    sf::SocketHandle handle() const {
+        return getHandle();
+    }
+
+
+    /*
+        Listen with the handle of another process, the listener must be new
+    */
+    void adopt(sf::SocketHandle handle) {
+        create(handle);
+    }
+
+};
+
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/HdrHistogram.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Durations of the phases of the server loop, tick after tick
+
+    Each phase goes in its HdrHistogram, and the ticks are kept in a ring buffer of the last `ring_size` ticks.
+    With a budget, the rooms are timed too (with their members), and a tick longer than the budget is dumped
+    as a Chrome trace (chrome://tracing, or ui.perfetto.dev) in `trace_directory`, along with the ticks of the ring buffer.
+    The dumps are written by the game thread, at most one every `min_dump_period`
+
+        profiler.begin_tick();
+        {
+            auto scope = profiler.measure(TickProfiler::Phase::Receive);
+            users.receive();
+        }
+        ...
+        profiler.end_tick();
+*/
+struct TickProfiler {
+
+    using clock = std::chrono::steady_clock;
+
+    enum class Phase : std::uint8_t {
+        Accept,
+        Receive,
+        NewUsers,
+        MainLobby,
+        Rooms,
+        Transitions,
+        UpdateLobby,
+        UpdateGames,
+        Flush,
+        Report
+    };
+
+    static constexpr std::size_t number_of_phase{ 10 };
+
+    static constexpr std::array<char const*, number_of_phase> phase_names{
+        "Accept", "Receive", "NewUserState", "MainLobbyState", "RoomState", "Transitions", "UpdateLobby", "UpdateGames", "Flush", "Report"
+    };
+
+    static constexpr std::size_t ring_size{ 256 };
+    static constexpr std::chrono::seconds min_dump_period{ 10 };
+
+
+    struct Tick {
+        std::uint64_t number{ 0 };
+        clock::time_point start{};
+        std::array<clock::time_point, number_of_phase> phase_starts{};
+        std::array<std::chrono::nanoseconds, number_of_phase> phases{};
+        std::chrono::nanoseconds duration{ 0 };
+    };
+
+
+    /*
+        A room processed during a phase of the current tick
+        Its members are `users[first_user, first_user + user_count)`
+    */
+    struct Span {
+        Phase phase;
+        room_id_t room;
+        clock::time_point start;
+        std::chrono::nanoseconds duration;
+        std::size_t first_user;
+        std::size_t user_count;
+    };
+
+
+    /*
+        Measure a phase of the current tick until its destruction
+    */
+    struct Scope {
+        TickProfiler& profiler;
+        Phase phase;
+        clock::time_point start;
+
+        ~Scope() {
+            profiler.add(phase, start, clock::now() - start);
+        }
+    };
+
+
+    /*
+        `budget` of zero: no room is timed and no tick is dumped
+    */
+    TickProfiler(std::chrono::nanoseconds _budget = std::chrono::nanoseconds{ 0 }, std::string _trace_directory = ".")
+    :   budget{ _budget }
+    ,   trace_directory{ std::move(_trace_directory) } {}
+
+
+    bool captures_slow_ticks() const {
+        return budget.count() > 0;
+    }
+
+
+    void begin_tick() {
+        current = Tick{};
+        current.number = ++tick_count;
+        current.start = clock::now();
+        spans.clear();
+        users.clear();
+    }
+
+
+    Scope measure(Phase phase) {
+        return Scope{ *this, phase, clock::now() };
+    }
+
+
+    /*
+        Run `f` for the room during `phase`, timed with its members when slow ticks are captured
+    */
+    template<typename R, typename F>
+    void measure_room(Phase phase, R const& room, F&& f) {
+        if (!captures_slow_ticks()) {
+            f();
+            return;
+        }
+
+
+        auto first_user = users.size();
+        for(user_handle_t handle{ 0 }; handle < room.number_of_user(); ++handle) {
+            if (room.is_valid(handle)) {
+                users.push_back(room.get_user_id(handle));
+            }
+        }
+
+        auto start = clock::now();
+        f();
+        spans.push_back({ phase, room.room_id, start, clock::now() - start, first_user, users.size() - first_user });
+    }
+
+
+    void end_tick() {
+        current.duration = clock::now() - current.start;
+        ticks[current.number % ring_size] = current;
+
+        tick_durations.record(static_cast<std::uint64_t>(current.duration.count()));
+        for(std::size_t i{ 0 }; i < number_of_phase; ++i) {
+            phase_durations[i].record(static_cast<std::uint64_t>(current.phases[i].count()));
+        }
+
+
+        if (captures_slow_ticks() && current.duration > budget) {
+            ++slow_ticks;
+
+            auto now = clock::now();
+            if (last_dump == clock::time_point{} || now - last_dump >= min_dump_period) {
+                dump_trace();
+                last_dump = now;
+            }
+        }
+    }
+
+
+    /*
+        Percentiles of the tick and of its phases since the last report, in microseconds
+    */
+    void report(std::ostream& os) {
+        if (tick_durations.count() == 0) {
+            return;
+        }
+
+        auto us = [] (std::uint64_t ns) { return static_cast<double>(ns) / 1000.; };
+        auto write = [&os, &us] (char const* name, HdrHistogram const& histogram) {
+            os << "  " << name << ": p50 " << us(histogram.value_at(0.5)) << " us, p99 " << us(histogram.value_at(0.99))
+                << " us, p99.9 " << us(histogram.value_at(0.999)) << " us, max " << us(histogram.maximum()) << " us\n";
+        };
+
+        os << tick_durations.count() << " ticks";
+        if (captures_slow_ticks()) {
+            os << ", " << slow_ticks << " over the budget of " << us(static_cast<std::uint64_t>(budget.count())) << " us";
+        }
+        os << '\n';
+
+        write("Tick", tick_durations);
+        for(std::size_t i{ 0 }; i < number_of_phase; ++i) {
+            write(phase_names[i], phase_durations[i]);
+        }
+
+
+        tick_durations.reset();
+        for(auto& histogram : phase_durations) {
+            histogram.reset();
+        }
+        slow_ticks = 0;
+    }
+
+
+private:
+
+
+    std::chrono::nanoseconds budget;
+    std::string trace_directory;
+
+    std::uint64_t tick_count{ 0 };
+    Tick current;
+    std::array<Tick, ring_size> ticks{};
+
+    // Of the current tick
+    std::vector<Span> spans;
+    std::vector<user_id_t> users;
+
+    HdrHistogram tick_durations;
+    std::array<HdrHistogram, number_of_phase> phase_durations;
+    std::uint64_t slow_ticks{ 0 };
+
+    clock::time_point last_dump{};
+
+
+    void add(Phase phase, clock::time_point start, std::chrono::nanoseconds duration) {
+        auto index = static_cast<std::size_t>(phase);
+        if (current.phases[index].count() == 0) {
+            current.phase_starts[index] = start;
+        }
+        current.phases[index] += duration;
+    }
+
+
+    void dump_trace() const {
+        auto path = trace_directory + "/slow-tick-" + std::to_string(current.number) + ".json";
+        std::ofstream file{ path };
+        if (!file) {
+            std::cerr << "[Warning] Can't write the trace " << path << '\n';
+            return;
+        }
+
+
+        // Microseconds since the oldest tick of the ring buffer
+        auto origin = current.start;
+        for(auto const& tick : ticks) {
+            if (tick.number != 0) {
+                origin = std::min(origin, tick.start);
+            }
+        }
+
+        auto us = [origin] (clock::time_point time) {
+            return std::chrono::duration<double, std::micro>(time - origin).count();
+        };
+        auto duration_us = [] (std::chrono::nanoseconds duration) {
+            return std::chrono::duration<double, std::micro>(duration).count();
+        };
+
+
+        file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Ticks\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"Rooms of tick " << current.number << "\"}}";
+
+        for(auto const& tick : ticks) {
+            if (tick.number == 0) {
+                continue;
+            }
+
+            file << ",\n{\"name\":\"Tick " << tick.number << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << us(tick.start)
+                << ",\"dur\":" << duration_us(tick.duration) << "}";
+
+            for(std::size_t i{ 0 }; i < number_of_phase; ++i) {
+                if (tick.phases[i].count() > 0) {
+                    file << ",\n{\"name\":\"" << phase_names[i] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << us(tick.phase_starts[i])
+                        << ",\"dur\":" << duration_us(tick.phases[i]) << "}";
+                }
+            }
+        }
+
+
+        for(auto const& span : spans) {
+            file << ",\n{\"name\":\"" << phase_names[static_cast<std::size_t>(span.phase)] << " #" << span.room
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":" << us(span.start) << ",\"dur\":" << duration_us(span.duration)
+                << ",\"args\":{\"room\":" << span.room << ",\"users\":[";
+
+            // As strings, the ids don't fit in the doubles of JSON
+            for(std::size_t i{ 0 }; i < span.user_count; ++i) {
+                file << (i == 0 ? "\"" : ",\"") << users[span.first_user + i] << '"';
+            }
+            file << "]}}";
+        }
+
+        file << "\n]}\n";
+
+        std::cerr << "[Warning] Tick " << current.number << " took " << duration_us(current.duration) << " us, trace written to " << path << '\n';
+    }
+
+};
+
+}
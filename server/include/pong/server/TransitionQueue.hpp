@@ -0,0 +1,54 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Transitions ordered by the states during `receive_packets`
+    The storage is reused from one tick to another, a whole room going back to the lobby doesn't allocate
+*/
+struct TransitionQueue {
+
+    static constexpr std::size_t initial_capacity{ 64 };
+
+
+    TransitionQueue() {
+        pending.reserve(initial_capacity);
+    }
+
+
+    void push(Leave const& leave) {
+        pending.push_back(leave);
+    }
+
+
+    bool empty() const {
+        return pending.empty();
+    }
+
+
+    /*
+        `is_alive` tells if the user of a transition still exists
+    */
+    template<typename F>
+    void execute(F&& is_alive) {
+        for(auto const& leave : pending) {
+            if (is_alive(leave.user)) {
+                leave.enter(leave.state, leave.user, leave.payload.data());
+            }
+        }
+
+        pending.clear();
+    }
+
+
+private:
+
+    std::vector<Leave> pending;
+
+};
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+
+namespace pong::server {
+
+struct UserRegistry;
+
+/*
+    Moves the bytes between the sockets and the buffers of the sessions, for every user at once:
+    `receive` fills the input buffers before the states handle the frames, `flush` writes the output buffers at the end of the tick.
+    The states never touch the sockets, a session whose connection failed is marked `disconnected` and its state removes it.
+
+    The UserRegistry tells the transport about the sessions it creates and destroys
+*/
+struct Transport {
+    virtual ~Transport() = default;
+
+    virtual char const* name() const = 0;
+
+    virtual void add(user_id_t id, User& user) = 0;
+    virtual void remove(user_id_t id, User& user) = 0;
+
+    virtual void receive(UserRegistry& users) = 0;
+    virtual void flush(UserRegistry& users) = 0;
+
+    /*
+        Stop reading the sockets before they are given to another process (see HotRestart.hpp):
+        what the transport already read is in the input buffers, the rest stays in the sockets.
+        `resume` if the server goes on with them
+    */
+    virtual void release(UserRegistry&) {}
+    virtual void resume(UserRegistry&) {}
+};
+
+
+
+/*
+    One non-blocking `recv` per socket and per tick, and one `send` per socket that has bytes to send
+*/
+struct ClassicTransport final : Transport {
+    char const* name() const override {
+        return "classic";
+    }
+
+    void add(user_id_t, User&) override {}
+    void remove(user_id_t, User&) override {}
+
+    void receive(UserRegistry& users) override;
+    void flush(UserRegistry& users) override;
+};
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/UserRegistry.hpp>
+
+#include <cassert>
+#include <cstddef>
+
+namespace pong::server {
+
+/*
+    Users waiting in line, first in first out
+
+    The links are in the users (`User::queue_link`): entering, leaving from any place and taking the first one
+    are O(1) and don't allocate, a user leaving doesn't search the queue. A user waits in one queue at most,
+    and must leave it before its session ends (see `UserRegistry::destroy`)
+*/
+struct UserQueue {
+
+    UserQueue(UserRegistry& _registry) : registry{ _registry } {}
+
+    UserQueue(UserQueue const&) = delete;
+    UserQueue& operator=(UserQueue const&) = delete;
+
+    ~UserQueue() {
+        clear();
+    }
+
+
+    /*
+        false if the user already waits, in this queue or another one
+    */
+    bool push_back(user_id_t id) {
+        auto* user = registry.get(id);
+        assert(user && "User must be alive");
+
+        auto& link = user->queue_link;
+        if (link.queue != nullptr) {
+            return false;
+        }
+
+        link = { this, last, invalid_user_id };
+        if (last != invalid_user_id) {
+            registry.get(last)->queue_link.next = id;
+        } else {
+            first = id;
+        }
+
+        last = id;
+        ++count;
+        return true;
+    }
+
+
+    /*
+        false if the user doesn't wait in this queue
+    */
+    bool remove(user_id_t id) {
+        auto* user = registry.get(id);
+        if (user == nullptr || user->queue_link.queue != this) {
+            return false;
+        }
+
+        auto link = user->queue_link;
+        user->queue_link = QueueLink{};
+
+        if (link.previous != invalid_user_id) {
+            registry.get(link.previous)->queue_link.next = link.next;
+        } else {
+            first = link.next;
+        }
+
+        if (link.next != invalid_user_id) {
+            registry.get(link.next)->queue_link.previous = link.previous;
+        } else {
+            last = link.previous;
+        }
+
+        --count;
+        return true;
+    }
+
+
+    bool contains(user_id_t id) const {
+        auto const* user = registry.get(id);
+        return user != nullptr && user->queue_link.queue == this;
+    }
+
+
+    // `invalid_user_id` if the queue is empty
+    user_id_t front() const {
+        return first;
+    }
+
+
+    // The user after `id` in this queue, `invalid_user_id` for the last one
+    user_id_t next_of(user_id_t id) const {
+        assert(contains(id));
+        return registry.get(id)->queue_link.next;
+    }
+
+
+    user_id_t pop_front() {
+        auto id = first;
+        if (id != invalid_user_id) {
+            remove(id);
+        }
+
+        return id;
+    }
+
+
+    std::size_t size() const {
+        return count;
+    }
+
+
+    bool empty() const {
+        return count == 0;
+    }
+
+
+    void clear() {
+        while(!empty()) {
+            pop_front();
+        }
+    }
+
+
+    // From the first to the last, `f` must not change the queue
+    template<typename F>
+    void for_each(F&& f) const {
+        for(auto id = first; id != invalid_user_id; id = registry.get(id)->queue_link.next) {
+            f(id);
+        }
+    }
+
+
+private:
+
+
+    UserRegistry& registry;
+
+    user_id_t first{ invalid_user_id };
+    user_id_t last{ invalid_user_id };
+    std::size_t count{ 0 };
+
+};
+
+}
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <pong/server/Common.hpp>
+#include <pong/server/ServerMetrics.hpp>
+#include <pong/server/SessionCapture.hpp>
+#include <pong/server/TransitionQueue.hpp>
+#include <pong/server/Transport.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace pong::server {
+
+/*
+    Owns the session of every connected user: socket, output buffer, known names and username
+
+    A user id is made of the index of its slot (low 32 bits) and of the generation of the slot (high 32 bits).
+    Generations start at 1 so `invalid_user_id` (0) never matches a user, and are incremented when a session ends,
+    so an id kept by a state (a player, the queue of a room) after its user disconnected doesn't resolve anymore.
+
+    States only store the ids of their members, moving a user from a state to another doesn't touch its session.
+    `create` may reallocate the slots, references to users must not be kept across it.
+
+    The sockets of the sessions are read and written by the transport, once per tick (`receive` and `flush`).
+    With a `capture`, the sessions and the frames they send are recorded, the states record the frames they receive.
+*/
+struct UserRegistry {
+
+    static constexpr unsigned index_bits{ 32 };
+    static constexpr user_id_t index_mask{ (user_id_t{ 1 } << index_bits) - 1 };
+    static constexpr std::size_t no_slot{ std::numeric_limits<std::size_t>::max() };
+
+
+    static constexpr user_id_t make_id(std::size_t index, std::uint32_t generation) {
+        return (user_id_t{ generation } << index_bits) | (index & index_mask);
+    }
+
+    static constexpr std::size_t index_of(user_id_t id) {
+        return id & index_mask;
+    }
+
+    static constexpr std::uint32_t generation_of(user_id_t id) {
+        return static_cast<std::uint32_t>(id >> index_bits);
+    }
+
+
+private:
+
+
+    struct Slot {
+        User user;
+        std::uint32_t generation;
+        bool alive;
+
+        // Next free slot when the slot is free
+        std::size_t next_free;
+    };
+
+
+    // Declared before the slots, the sessions are closed before it
+    std::unique_ptr<Transport> transport;
+
+    std::vector<Slot> slots;
+    std::size_t first_free;
+    std::size_t user_count;
+
+
+public:
+
+
+    // Users between two states
+    TransitionQueue transitions;
+
+    TrafficCounters traffic;
+    CompressionCounters compression;
+
+    ServerMetrics metrics;
+
+    // Set before the first session to record them
+    std::unique_ptr<SessionCapture> capture;
+
+
+    UserRegistry() : UserRegistry(std::make_unique<ClassicTransport>()) {}
+
+    UserRegistry(std::unique_ptr<Transport> _transport) 
+    :   transport{ std::move(_transport) }
+    ,   first_free{ no_slot }
+    ,   user_count{ 0 } {
+
+        assert(transport && "Transport must not be null");
+    }
+
+    UserRegistry(UserRegistry const&) = delete;
+    UserRegistry& operator=(UserRegistry const&) = delete;
+
+
+    user_id_t create(std::unique_ptr<TcpSocket> socket) {
+        assert(socket && "Socket must not be null");
+
+        std::size_t index;
+
+        if (first_free != no_slot) {
+            index = first_free;
+            first_free = slots[index].next_free;
+        }
+        else {
+            index = slots.size();
+            slots.push_back({ User{}, 1, false, no_slot });
+        }
+
+
+        auto& slot = slots[index];
+        slot.user = User{ std::move(socket) };
+        slot.alive = true;
+        ++user_count;
+
+        auto id = make_id(index, slot.generation);
+        transport->add(id, slot.user);
+
+        if (capture) {
+            capture->connect(id);
+        }
+        return id;
+    }
+
+
+    User* get(user_id_t id) {
+        auto index = index_of(id);
+        if (index < slots.size() && slots[index].alive && slots[index].generation == generation_of(id)) {
+            return &slots[index].user;
+        }
+
+        return nullptr;
+    }
+
+
+    User const* get(user_id_t id) const {
+        return const_cast<UserRegistry*>(this)->get(id);
+    }
+
+
+    /*
+        End the session, closing the socket and releasing the username
+    */
+    void destroy(user_id_t id) {
+        if (get(id) == nullptr) {
+            return;
+        }
+
+        auto index = index_of(id);
+        auto& slot = slots[index];
+        assert(slot.user.queue_link.queue == nullptr && "The user must leave its queue first");
+
+        if (capture && slot.user.disconnected) {
+            capture->disconnect(id);
+        }
+
+        transport->remove(id, slot.user);
+        slot.user = User{};
+        slot.alive = false;
+
+        ++slot.generation;
+        if (slot.generation == 0) {
+            slot.generation = 1;
+        }
+
+        slot.next_free = first_free;
+        first_free = index;
+        --user_count;
+    }
+
+
+    std::size_t number_of_user() const {
+        return user_count;
+    }
+
+
+    /*
+        Id of the user of the slot `index`, `invalid_user_id` if the slot is free
+    */
+    user_id_t id_at(std::size_t index) const {
+        if (index < slots.size() && slots[index].alive) {
+            return make_id(index, slots[index].generation);
+        }
+
+        return invalid_user_id;
+    }
+
+
+    template<typename F>
+    void for_each(F&& f) {
+        for(std::size_t index{ 0 }; index < slots.size(); ++index) {
+            if (slots[index].alive) {
+                f(make_id(index, slots[index].generation), slots[index].user);
+            }
+        }
+    }
+
+
+    /*
+        Read the sockets of every user, before the states receive their packets
+    */
+    void receive() {
+        transport->receive(*this);
+    }
+
+
+    /*
+        Write the messages of the tick, once the states are done
+    */
+    void flush() {
+        for_each([this] (user_id_t id, User& user) {
+            if (!user.output.empty()) {
+                metrics.output_queue_bytes.observe(user.output.size());
+            }
+
+            // The bytes left by the previous flush were recorded then
+            if (capture && user.output.size() > user.captured_output) {
+                capture->outbound(id, user.output.pending() + user.captured_output, user.output.size() - user.captured_output);
+            }
+        });
+
+        transport->flush(*this);
+
+        if (capture) {
+            for_each([] (user_id_t, User& user) {
+                user.captured_output = user.output.size();
+            });
+        }
+    }
+
+
+    /*
+        See `Transport::release`
+    */
+    void release_transport() {
+        transport->release(*this);
+    }
+
+
+    void resume_transport() {
+        transport->resume(*this);
+    }
+
+
+    char const* transport_name() const {
+        return transport->name();
+    }
+
+
+    /*
+        Move the users that left a state during `receive_packets` into their new state
+    */
+    void execute_transitions() {
+        transitions.execute([this] (user_id_t id) {
+            return get(id) != nullptr;
+        });
+    }
+
+};
+
+
+
+
+
+
+inline void ClassicTransport::receive(UserRegistry& users) {
+    users.for_each([&users] (user_id_t, User& user) {
+        if (user.disconnected) {
+            return;
+        }
+
+        ++users.traffic.syscalls;
+        switch(user.input.receive(*user.socket)) {
+            case sf::Socket::NotReady:
+            case sf::Socket::Partial:
+            case sf::Socket::Done:
+                break;
+
+            default:
+                user.disconnected = true;
+        }
+    });
+}
+
+
+inline void ClassicTransport::flush(UserRegistry& users) {
+    users.for_each([&users] (user_id_t, User& user) {
+        if (user.disconnected || user.output.empty()) {
+            return;
+        }
+
+
+        std::size_t sent{ 0 };
+        auto status = user.socket->flush(user.output.pending(), user.output.size(), sent);
+        ++users.traffic.sends;
+        ++users.traffic.syscalls;
+        users.traffic.bytes_sent += sent;
+
+        switch(status) {
+            case sf::Socket::NotReady:
+            case sf::Socket::Partial:
+            case sf::Socket::Done:
+                user.output.consume(sent);
+                break;
+
+            default:
+                user.disconnected = true;
+        }
+    });
+}
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <pong/packet/Server.hpp>
+
+#include <cassert>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pong::server {
+
+using name_id_t = pong::packet::server::name_id_t;
+
+class Username;
+
+
+/*
+    Server-wide table of the usernames of the connected users
+
+    Each distinct username gets a compact id, reference counted by the `Username` handles.
+    When the last handle of a name is destroyed its id goes back to the free-list and the generation of the id
+    is incremented, so a connection knowing the old name is told about the new one.
+    The id `no_name` (0) is never given.
+*/
+struct UsernameTable {
+
+    UsernameTable() : entries(1, Entry{ "", 0, 0 }) {}
+
+    UsernameTable(UsernameTable const&) = delete;
+    UsernameTable& operator=(UsernameTable const&) = delete;
+
+
+    Username intern(std::string_view username);
+
+
+    std::string const& name_of(name_id_t id) const {
+        assert(id < entries.size());
+        return entries[id].username;
+    }
+
+
+    unsigned generation_of(name_id_t id) const {
+        assert(id < entries.size());
+        return entries[id].generation;
+    }
+
+
+    std::size_t number_of_name() const {
+        return ids.size();
+    }
+
+
+    /*
+        One past the last id given, free ones included
+    */
+    std::size_t number_of_id() const {
+        return entries.size();
+    }
+
+
+    /*
+        Entry of the table of another process (see HotRestart.hpp), restored in the order of the ids from 1:
+        the ids and generations are kept, so are the names the restored users know.
+        An empty name is a free id. The restored names have no reference, `end_restore` frees the ones still without one
+    */
+    void restore_entry(std::string username, unsigned generation) {
+        auto id = static_cast<name_id_t>(entries.size());
+        if (username.empty()) {
+            free_ids.push_back(id);
+        } else {
+            ids.emplace(username, id);
+        }
+
+        entries.push_back({ std::move(username), 0, generation });
+    }
+
+
+    void end_restore() {
+        for(name_id_t id{ 1 }; id < entries.size(); ++id) {
+            if (entries[id].reference_count == 0 && !entries[id].username.empty()) {
+                acquire(id);
+                release(id);
+            }
+        }
+    }
+
+
+private:
+
+    friend class Username;
+
+
+    struct Entry {
+        std::string username;
+        unsigned reference_count;
+        unsigned generation;
+    };
+
+
+    std::vector<Entry> entries;
+    std::vector<name_id_t> free_ids;
+    std::unordered_map<std::string, name_id_t> ids;
+
+
+    void acquire(name_id_t id) {
+        ++entries[id].reference_count;
+    }
+
+
+    void release(name_id_t id) {
+        auto& entry = entries[id];
+
+        assert(entry.reference_count > 0);
+        if (--entry.reference_count > 0) {
+            return;
+        }
+
+        ids.erase(entry.username);
+        entry.username.clear();
+        ++entry.generation;
+        free_ids.push_back(id);
+    }
+
+};
+
+
+
+
+
+/*
+    Reference to an interned username
+    Copying it only touches the reference count of the name, never the string
+*/
+class Username {
+    UsernameTable* table;
+    name_id_t name_id;
+
+public:
+
+    Username() : table{ nullptr }, name_id{ pong::packet::server::no_name } {}
+
+    Username(UsernameTable& _table, name_id_t _name_id) : table{ &_table }, name_id{ _name_id } {
+        table->acquire(name_id);
+    }
+
+    Username(Username const& other) : table{ other.table }, name_id{ other.name_id } {
+        if (table) {
+            table->acquire(name_id);
+        }
+    }
+
+    Username(Username&& other) noexcept : table{ std::exchange(other.table, nullptr) }, name_id{ other.name_id } {}
+
+    Username& operator=(Username other) noexcept {
+        std::swap(table, other.table);
+        std::swap(name_id, other.name_id);
+        return *this;
+    }
+
+    ~Username() {
+        if (table) {
+            table->release(name_id);
+        }
+    }
+
+
+    name_id_t id() const {
+        return name_id;
+    }
+
+
+    unsigned generation() const {
+        return table ? table->generation_of(name_id) : 0;
+    }
+
+
+    std::string const& str() const {
+        static std::string const empty;
+        return table ? table->name_of(name_id) : empty;
+    }
+
+};
+
+
+inline std::ostream& operator<<(std::ostream& os, Username const& username) {
+    return os << username.str();
+}
+
+
+inline Username UsernameTable::intern(std::string_view view) {
+    // Once per login, the received username is only copied here
+    std::string username{ view };
+    if (auto it = ids.find(username); it != std::end(ids)) {
+        return Username{ *this, it->second };
+    }
+
+    name_id_t id;
+    if (!free_ids.empty()) {
+        id = free_ids.back();
+        free_ids.pop_back();
+        entries[id].username = username;
+    } else {
+        id = static_cast<name_id_t>(entries.size());
+        entries.push_back({ username, 0, 0 });
+    }
+
+    ids.emplace(username, id);
+    return Username{ *this, id };
+}
+
+
+
+
+
+/*
+    Names a connection has already been told about, with the generation they were sent with
+*/
+struct KnownNames {
+    // Generation + 1 of each known id, 0 if unknown
+    std::vector<unsigned> generations;
+
+
+    bool knows(Username const& username) const {
+        return username.id() < generations.size() && generations[username.id()] == username.generation() + 1;
+    }
+
+
+    void learn(Username const& username) {
+        if (username.id() >= generations.size()) {
+            generations.resize(username.id() + 1, 0);
+        }
+
+        generations[username.id()] = username.generation() + 1;
+    }
+};
+
+}
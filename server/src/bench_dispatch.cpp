@@ -0,0 +1,136 @@
+#include <SFML/Network.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <pong/server/State.hpp>
+
+/*
+    Cost of dispatching a received packet to the receiver of a state
+
+    Compares the compile-time table of `StateBase::invoke_receiver` with the `std::unordered_map` it replaced
+    (a `count` followed by an `operator[]`), on random ids, some of them unknown
+    Both include the decoding of the packet by the receiver
+    Build with `make SRC_MAIN=bench_dispatch.cpp`
+*/
+
+namespace {
+
+namespace client = pong::packet::client;
+using pong::server::Action;
+using pong::server::Handler;
+using pong::server::Handlers;
+using pong::server::Idle;
+using pong::server::user_handle_t;
+
+
+struct BenchState : pong::server::State<BenchState> {
+    BenchState(pong::server::UserRegistry& _registry) : State(_registry) {}
+
+    unsigned long long received{ 0 };
+
+    template<typename P>
+    Action on_packet(user_handle_t, P const&) {
+        ++received;
+        return Idle{};
+    }
+
+
+    // Receive
+    using handlers = Handlers<
+        Handler<client::ChangeUsername, &BenchState::on_packet<client::ChangeUsername>>,
+        Handler<client::CreateRoom, &BenchState::on_packet<client::CreateRoom>>,
+        Handler<client::EnterRoom, &BenchState::on_packet<client::EnterRoom>>,
+        Handler<client::Input, &BenchState::on_packet<client::Input>>,
+        Handler<client::LeaveRoom, &BenchState::on_packet<client::LeaveRoom>>,
+        Handler<client::Abandon, &BenchState::on_packet<client::Abandon>>
+    >;
+};
+
+
+template<std::size_t...Is>
+client::Any make_default_packet(std::size_t id, std::index_sequence<Is...>) {
+    client::Any packet;
+    ((id == Is ? void(packet.emplace<Is>()) : void()), ...);
+    return packet;
+}
+
+client::Any make_default_packet(std::size_t id) {
+    return make_default_packet(id, std::make_index_sequence<pong::server::number_of_client_packet>{});
+}
+
+
+template<typename F>
+double nanoseconds_per_packet(std::vector<pong::packet::id_t> const& ids, F&& dispatch) {
+    auto start = std::chrono::steady_clock::now();
+    for(auto id : ids) {
+        dispatch(id);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(ids.size());
+}
+
+}
+
+
+int main() {
+    static constexpr std::size_t number_of_packet{ 1 << 22 };
+    static constexpr int number_of_run{ 5 };
+
+    pong::server::UserRegistry registry;
+    BenchState state{ registry };
+
+
+    std::unordered_map<pong::packet::id_t, BenchState::receiver_t> receivers;
+    for(pong::packet::id_t id{ 0 }; id < pong::server::number_of_client_packet; ++id) {
+        if (state.has_receiver_for(id)) {
+            receivers[id] = BenchState::dispatch_table()[id];
+        }
+    }
+
+
+    // A few ids out of `client::Any` to exercise the bound check
+    std::mt19937 engine{ 42 };
+    std::uniform_int_distribution<pong::packet::id_t> distribution{ 0, pong::server::number_of_client_packet + 2 };
+    std::vector<pong::packet::id_t> ids(number_of_packet);
+    for(auto& id : ids) {
+        id = distribution(engine);
+    }
+
+
+    // Serialized default packet of each id, the receivers decode it after the id
+    std::vector<sf::Packet> packets(pong::server::number_of_client_packet + 3);
+    for(std::size_t id{ 0 }; id < pong::server::number_of_client_packet; ++id) {
+        packets[id] << make_default_packet(id);
+    }
+
+    auto reader_of = [&packets] (pong::packet::id_t id) {
+        auto const& packet = packets[id];
+        auto header = std::min(packet.getDataSize(), sizeof(pong::packet::id_t));
+        return pong::packet::details::Reader{ static_cast<char const*>(packet.getData()) + header, packet.getDataSize() - header };
+    };
+
+    for(int run{ 0 }; run < number_of_run; ++run) {
+        auto map_ns = nanoseconds_per_packet(ids, [&] (pong::packet::id_t id) {
+            if (receivers.count(id)) {
+                auto reader = reader_of(id);
+                receivers[id](state, 0, reader);
+            }
+        });
+
+        auto table_ns = nanoseconds_per_packet(ids, [&] (pong::packet::id_t id) {
+            auto reader = reader_of(id);
+            state.invoke_receiver(id, 0, reader);
+        });
+
+        std::cout << "Run #" << run << ": unordered_map " << map_ns << " ns/packet, table " << table_ns << " ns/packet\n";
+    }
+
+    std::cout << state.received << " packets dispatched\n";
+}
@@ -0,0 +1,152 @@
+#include <SFML/Network.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <pong/packet/Server.hpp>
+
+/*
+    Cost and size of the encodings of the control packets
+
+    Serializes a random mix of the packets the server sends outside of a game (lobby and room rosters, names, scores)
+    with sf::Packet, then in place with `Encoding::Sfml` and `Encoding::Compact`, and decodes the frames of both
+    The ids are in the ranges of a busy server: thousands of users and rooms
+    Build with `make SRC_MAIN=bench_encoding.cpp`
+*/
+
+namespace {
+
+namespace server = pong::packet::server;
+namespace details = pong::packet::details;
+using pong::packet::Encoding;
+
+
+std::vector<server::Any> make_packets(std::size_t count) {
+    std::mt19937 engine{ 42 };
+    std::uniform_int_distribution<unsigned> room_id{ 0, 4000 };
+    std::uniform_int_distribution<unsigned> name_id{ 0, 20000 };
+    std::uniform_int_distribution<unsigned> small{ 0, 12 };
+    std::uniform_int_distribution<int> kind{ 0, 8 };
+
+    std::vector<server::Any> packets;
+    packets.reserve(count);
+
+    for(std::size_t i{ 0 }; i < count; ++i) {
+        switch(kind(engine)) {
+            case 0: packets.emplace_back(server::NewRoom{ room_id(engine) }); break;
+            case 1: packets.emplace_back(server::OldRoom{ room_id(engine) }); break;
+            case 2: packets.emplace_back(server::UserCount{ name_id(engine) }); break;
+            case 3: packets.emplace_back(server::RoomUpdate{ { room_id(engine), small(engine), true, false } }); break;
+            case 4: packets.emplace_back(server::NewUser{ name_id(engine) }); break;
+            case 5: packets.emplace_back(server::UserName{ name_id(engine), "player" + std::to_string(name_id(engine)) }); break;
+            case 6: packets.emplace_back(server::Score{ small(engine), small(engine) }); break;
+            case 7: packets.emplace_back(server::RoomInfo{ name_id(engine), name_id(engine), { name_id(engine), name_id(engine), name_id(engine) } }); break;
+            default: packets.emplace_back(server::EnterRoomResponse{ server::EnterRoomResponse::Okay }); break;
+        }
+    }
+
+    return packets;
+}
+
+
+template<typename F>
+double nanoseconds_per_packet(std::size_t count, F&& run) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(count);
+}
+
+
+std::size_t frames_size(std::vector<server::Any> const& packets, Encoding encoding) {
+    std::size_t size{ 0 };
+    for(auto const& packet : packets) {
+        size += std::visit([encoding] (auto const& p) { return details::frame_size(p, encoding); }, packet);
+    }
+    return size;
+}
+
+
+void write_frames(std::vector<server::Any> const& packets, Encoding encoding, std::vector<std::byte>& frames) {
+    details::Writer writer{ frames.data(), encoding };
+    for(auto const& packet : packets) {
+        std::visit([&writer] (auto const& p) {
+            details::write_frame(writer, server::id_of(p), p);
+        }, packet);
+    }
+}
+
+
+bool read_frames(std::vector<std::byte> const& frames, Encoding encoding) {
+    server::Any packet;
+    for(auto const* position = frames.data(); position != frames.data() + frames.size();) {
+        details::Reader header{ position, sizeof(sf::Uint32) };
+        sf::Uint32 size;
+        header >> size;
+
+        if (server::decode(position + sizeof(sf::Uint32), size, packet, encoding) != pong::packet::DecodeError::None) {
+            return false;
+        }
+        position += sizeof(sf::Uint32) + size;
+    }
+    return true;
+}
+
+}
+
+
+int main() {
+    static constexpr std::size_t number_of_packet{ 1 << 20 };
+    static constexpr int number_of_run{ 5 };
+
+    auto packets = make_packets(number_of_packet);
+
+    std::vector<std::byte> sfml_frames(frames_size(packets, Encoding::Sfml));
+    std::vector<std::byte> compact_frames(frames_size(packets, Encoding::Compact));
+
+    std::cout << "Frames of " << number_of_packet << " packets: sf::Packet encoding " << sfml_frames.size()
+        << " bytes, compact " << compact_frames.size() << " bytes ("
+        << 100. * static_cast<double>(compact_frames.size()) / static_cast<double>(sfml_frames.size()) << "%)\n";
+
+
+    sf::Packet sf_packet;
+    for(int run{ 0 }; run < number_of_run; ++run) {
+        auto sf_packet_ns = nanoseconds_per_packet(number_of_packet, [&] {
+            for(auto const& packet : packets) {
+                sf_packet.clear();
+                sf_packet << packet;
+            }
+        });
+
+        auto sfml_ns = nanoseconds_per_packet(number_of_packet, [&] {
+            write_frames(packets, Encoding::Sfml, sfml_frames);
+        });
+
+        auto compact_ns = nanoseconds_per_packet(number_of_packet, [&] {
+            write_frames(packets, Encoding::Compact, compact_frames);
+        });
+
+
+        bool decoded{ true };
+        auto sfml_decode_ns = nanoseconds_per_packet(number_of_packet, [&] {
+            decoded = read_frames(sfml_frames, Encoding::Sfml) && decoded;
+        });
+
+        auto compact_decode_ns = nanoseconds_per_packet(number_of_packet, [&] {
+            decoded = read_frames(compact_frames, Encoding::Compact) && decoded;
+        });
+
+        if (!decoded) {
+            std::cerr << "A frame couldn't be decoded\n";
+            return 1;
+        }
+
+
+        std::cout << "Run #" << run << ": encode sf::Packet " << sf_packet_ns << " ns/packet, in place " << sfml_ns
+            << " ns/packet, compact " << compact_ns << " ns/packet; decode " << sfml_decode_ns
+            << " ns/packet, compact " << compact_decode_ns << " ns/packet\n";
+    }
+}
@@ -0,0 +1,125 @@
+#include <SFML/Network.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pong/server/MainLobby.hpp>
+#include <pong/server/RoomRegistry.hpp>
+#include <pong/server/RoomSnapshot.hpp>
+#include <pong/server/TcpSocket.hpp>
+#include <pong/server/UserRegistry.hpp>
+#include <pong/server/Username.hpp>
+
+/*
+    Cost of the snapshot of a room and of its restore (see RoomSnapshot.hpp)
+
+    Every member knows the names of the others, has a partial frame in its input and a few frames not sent yet,
+    like in a room during a game. The sockets aren't connected: only the state is measured, not the handles
+    Build with `make SRC_MAIN=bench_snapshot.cpp`
+*/
+
+namespace {
+
+namespace server = pong::server;
+
+static constexpr std::size_t pending_output_size{ 200 };
+static constexpr std::size_t number_of_queued_user{ 4 };
+
+
+struct Result {
+    double snapshot_us;
+    double restore_us;
+    std::size_t bytes;
+};
+
+
+bool run(std::size_t number_of_member, int number_of_iteration, Result& result) {
+    server::UsernameTable usernames;
+    server::UserRegistry users;
+    server::RoomRegistry rooms{ users };
+    server::MainLobbyState main_lobby{ users, rooms };
+
+    auto& room = *rooms.get(*rooms.allocate(main_lobby));
+
+    std::vector<server::Username> names;
+    for(std::size_t i{ 0 }; i < number_of_member; ++i) {
+        names.push_back(usernames.intern("player-" + std::to_string(i)));
+    }
+
+    std::byte const partial_frame[3]{};
+    for(auto const& name : names) {
+        auto id = users.create(std::make_unique<server::TcpSocket>());
+        auto& user = *users.get(id);
+        user.username = name;
+        for(auto const& other : names) {
+            user.known_names.learn(other);
+        }
+
+        user.input.append(partial_frame, sizeof(partial_frame));
+        user.output.allocate(pending_output_size);
+
+        room.restore(id);
+    }
+
+    room.left_player = room.get_user_id(0);
+    room.right_player = room.get_user_id(1);
+    for(server::user_handle_t handle{ 2 }; handle < 2 + number_of_queued_user && handle < room.number_of_user(); ++handle) {
+        room.queue.push_back(room.get_user_id(handle));
+    }
+
+
+    std::chrono::steady_clock::duration snapshot_time{ 0 };
+    std::chrono::steady_clock::duration restore_time{ 0 };
+
+    for(int iteration{ 0 }; iteration < number_of_iteration; ++iteration) {
+        auto snapshot_start = std::chrono::steady_clock::now();
+        auto snapshot = server::snapshot_room(room);
+        snapshot_time += std::chrono::steady_clock::now() - snapshot_start;
+
+        result.bytes = snapshot.bytes.size();
+
+
+        auto& restored = *rooms.get(*rooms.allocate(main_lobby));
+
+        auto restore_start = std::chrono::steady_clock::now();
+        auto done = server::restore_room(snapshot, restored, usernames);
+        restore_time += std::chrono::steady_clock::now() - restore_start;
+
+        if (!done || restored.number_of_user() != room.number_of_user()) {
+            std::cerr << "Restore error\n";
+            return false;
+        }
+
+
+        // Not measured: the restored members leave, the room is reclaimed
+        for(server::user_handle_t handle{ 0 }; handle < restored.number_of_user(); ++handle) {
+            restored.get_user(handle).disconnected = true;
+        }
+        restored.receive_packets();
+        rooms.reclaim([] (server::room_id_t) {});
+    }
+
+
+    result.snapshot_us = std::chrono::duration<double, std::micro>(snapshot_time).count() / number_of_iteration;
+    result.restore_us = std::chrono::duration<double, std::micro>(restore_time).count() / number_of_iteration;
+    return true;
+}
+
+}
+
+
+int main() {
+    for(auto [number_of_member, number_of_iteration] : { std::pair{ 8u, 2000 }, std::pair{ 64u, 1000 }, std::pair{ 512u, 100 } }) {
+        Result result;
+        if (!run(number_of_member, number_of_iteration, result)) {
+            return 1;
+        }
+
+        std::cout << number_of_member << " members: " << result.snapshot_us << " us snapshot, "
+            << result.restore_us << " us restore, " << result.bytes << " bytes\n";
+    }
+}
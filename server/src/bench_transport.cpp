@@ -0,0 +1,186 @@
+#include <SFML/Network.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <pong/packet/Client.hpp>
+#include <pong/packet/Server.hpp>
+
+#include <pong/server/IoUringTransport.hpp>
+#include <pong/server/TcpSocket.hpp>
+#include <pong/server/UserRegistry.hpp>
+
+/*
+    Cost of the transports, for 1000 connections on the loopback
+
+    Each tick every client sends an `Input`, the server reads the frames of every user and answers with a `GameState`,
+    like a room during a game. Only the transport (`UserRegistry::receive` and `flush`) is measured:
+    its syscalls, and the CPU time of the process while it runs
+    The clients run in the same thread, between the ticks. With io_uring the kernel copies the received bytes
+    as soon as they arrive, that part runs during the sends of the clients and isn't measured
+    Needs as many file descriptors as twice the connections (`ulimit -n`)
+    Build with `make SRC_MAIN=bench_transport.cpp`
+*/
+
+namespace {
+
+namespace packet = pong::packet;
+
+static constexpr std::size_t number_of_connection{ 1000 };
+static constexpr int number_of_warmup_tick{ 100 };
+static constexpr int number_of_tick{ 2000 };
+
+
+template<typename P>
+std::vector<std::byte> make_frame(packet::id_t id, P const& p) {
+    std::vector<std::byte> frame(packet::details::frame_size(p));
+    packet::details::Writer writer{ frame.data() };
+    packet::details::write_frame(writer, id, p);
+    return frame;
+}
+
+
+struct Result {
+    double syscalls_per_tick;
+    double cpu_us_per_tick;
+    double wall_us_per_tick;
+};
+
+
+bool run(std::unique_ptr<pong::server::Transport> transport, Result& result) {
+    pong::server::UserRegistry users{ std::move(transport) };
+
+    sf::TcpListener listener;
+    if (listener.listen(sf::Socket::AnyPort) != sf::Socket::Done) {
+        std::cerr << "Listening error\n";
+        return false;
+    }
+
+
+    std::vector<std::unique_ptr<sf::TcpSocket>> clients;
+    for(std::size_t i{ 0 }; i < number_of_connection; ++i) {
+        auto client = std::make_unique<sf::TcpSocket>();
+        auto server_side = std::make_unique<pong::server::TcpSocket>();
+
+        if (client->connect(sf::IpAddress::LocalHost, listener.getLocalPort()) != sf::Socket::Done
+            || listener.accept(*server_side) != sf::Socket::Done) {
+            std::cerr << "Connection error after " << i << " connections\n";
+            return false;
+        }
+
+        server_side->configure({});
+        server_side->setBlocking(false);
+        users.create(std::move(server_side));
+        clients.emplace_back(std::move(client));
+    }
+
+
+    auto input = make_frame(packet::client::id_of<packet::client::Input>(), packet::client::Input{});
+    auto state = make_frame(packet::server::id_of<packet::server::GameState>(), packet::server::GameState{});
+    std::vector<std::byte> reply(state.size());
+
+    std::size_t syscalls{ 0 };
+    std::clock_t cpu{ 0 };
+    std::chrono::steady_clock::duration wall{ 0 };
+
+    for(int tick{ 0 }; tick < number_of_warmup_tick + number_of_tick; ++tick) {
+        for(auto& client : clients) {
+            client->send(input.data(), input.size());
+        }
+
+
+        auto syscalls_start = users.traffic.syscalls;
+        auto cpu_start = std::clock();
+        auto wall_start = std::chrono::steady_clock::now();
+
+        users.receive();
+
+        auto syscalls_middle = users.traffic.syscalls;
+        auto cpu_middle = std::clock();
+        auto wall_middle = std::chrono::steady_clock::now();
+
+
+        // Not measured: the work of the states
+        bool lost{ false };
+        users.for_each([&state, &lost] (pong::server::user_id_t, pong::server::User& user) {
+            lost = lost || user.disconnected;
+            while(user.input.next_frame().status == pong::server::InputBuffer::FrameStatus::Complete) {}
+
+            auto* region = user.output.allocate(state.size());
+            std::copy(state.begin(), state.end(), region);
+        });
+
+        if (lost) {
+            std::cerr << "Connection lost\n";
+            return false;
+        }
+
+
+        auto syscalls_flush = users.traffic.syscalls;
+        auto cpu_flush = std::clock();
+        auto wall_flush = std::chrono::steady_clock::now();
+
+        users.flush();
+
+        if (tick >= number_of_warmup_tick) {
+            syscalls += (syscalls_middle - syscalls_start) + (users.traffic.syscalls - syscalls_flush);
+            cpu += (cpu_middle - cpu_start) + (std::clock() - cpu_flush);
+            wall += (wall_middle - wall_start) + (std::chrono::steady_clock::now() - wall_flush);
+        }
+
+
+        for(auto& client : clients) {
+            std::size_t received{ 0 };
+            while(received < reply.size()) {
+                std::size_t count{ 0 };
+                if (client->receive(reply.data() + received, reply.size() - received, count) != sf::Socket::Done) {
+                    std::cerr << "Client receive error\n";
+                    return false;
+                }
+                received += count;
+            }
+        }
+    }
+
+
+    result.syscalls_per_tick = static_cast<double>(syscalls) / number_of_tick;
+    result.cpu_us_per_tick = 1e6 * static_cast<double>(cpu) / CLOCKS_PER_SEC / number_of_tick;
+    result.wall_us_per_tick = std::chrono::duration<double, std::micro>(wall).count() / number_of_tick;
+    return true;
+}
+
+
+void print(char const* name, Result const& result) {
+    auto per_1k = 1000. / number_of_connection;
+    std::cout << name << ": " << result.syscalls_per_tick * per_1k << " syscalls/tick, "
+        << result.cpu_us_per_tick * per_1k << " us CPU/tick, "
+        << result.wall_us_per_tick * per_1k << " us/tick (per 1000 connections)\n";
+}
+
+}
+
+
+int main() {
+    Result classic;
+    if (!run(std::make_unique<pong::server::ClassicTransport>(), classic)) {
+        return 1;
+    }
+    print("classic", classic);
+
+
+    auto io_uring = pong::server::make_io_uring_transport();
+    if (!io_uring) {
+        std::cout << "io_uring isn't supported\n";
+        return 0;
+    }
+
+    Result ring;
+    if (!run(std::move(io_uring), ring)) {
+        return 1;
+    }
+    print("io_uring", ring);
+}
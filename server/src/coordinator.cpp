@@ -0,0 +1,67 @@
+#include <SFML/Network.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <pong/server/Coordinator.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+/*
+    Coordinator of a federation of servers (see Coordinator.hpp)
+
+    The servers join it with `--coordinator`, the clients never connect to it.
+    Build with `make SRC_MAIN=coordinator.cpp`
+*/
+
+
+/*
+    --port <port>: port of the coordinator (48626)
+    --slots-per-node <count>: room slots given to each server (4096)
+*/
+int main(int argc, char** argv) {
+    unsigned short port{ 48626 };
+    unsigned slots_per_node{ 4096 };
+    for(int i{ 1 }; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--slots-per-node") == 0 && i + 1 < argc) {
+            slots_per_node = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::cerr << "[Warning] Unknown argument: " << argv[i] << '\n';
+        }
+    }
+
+    if (slots_per_node == 0 || slots_per_node > pong::server::RoomRegistry::max_number_of_room) {
+        std::cerr << "The slots per node must be in [1, " << pong::server::RoomRegistry::max_number_of_room << "]\n";
+        return 1;
+    }
+
+    sf::TcpListener listener;
+    auto status = listener.listen(port);
+    if (status != sf::Socket::Status::Done) {
+        std::cout << "Listening status error: " << static_cast<int>(status) << '\n';
+        return 1;
+    }
+
+    listener.setBlocking(false);
+    std::cout << "Coordinator on port " << port << ", " << slots_per_node << " slots per node" << std::endl;
+
+    pong::server::Coordinator coordinator{ slots_per_node };
+
+    // The traffic is a few packets per server and per second, no need for a tight loop
+    while(true) {
+        auto socket = std::make_unique<sf::TcpSocket>();
+        while(listener.accept(*socket) == sf::Socket::Done) {
+            std::cout << "New server: " << socket->getRemoteAddress() << ":" << socket->getRemotePort() << std::endl;
+            coordinator.accept(std::move(socket));
+            socket = std::make_unique<sf::TcpSocket>();
+        }
+
+        coordinator.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+    }
+}
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <variant>
 #include <unordered_set>
+#include <chrono>
 
 #include <multipong/Game.hpp>
 #include <multipong/Packets.hpp>
@@ -18,79 +19,482 @@
 #include <pong/server/NewUser.hpp>
 #include <pong/server/MainLobby.hpp>
 #include <pong/server/Room.hpp>
+#include <pong/server/RoomRegistry.hpp>
+#include <pong/server/UserRegistry.hpp>
+#include <pong/server/TcpSocket.hpp>
+#include <pong/server/IoUringTransport.hpp>
+#include <pong/server/MetricsEndpoint.hpp>
+#include <pong/server/TickProfiler.hpp>
+#include <pong/server/SessionCapture.hpp>
+#include <pong/server/MatchRecording.hpp>
+#include <pong/server/FederationLink.hpp>
+#include <pong/server/HotRestart.hpp>
 
-void client_runner(std::mutex& clients_mutex, std::vector<std::unique_ptr<sf::TcpSocket>>& clients, std::atomic_bool& stop) {
-    std::vector<std::unique_ptr<pong::server::RoomState>> rooms;
-    pong::server::MainLobbyState main_lobby{ rooms };
-    pong::server::NewUserState new_users{ main_lobby };
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+std::unique_ptr<pong::server::Transport> make_transport(bool io_uring) {
+    if (io_uring) {
+        if (auto transport = pong::server::make_io_uring_transport()) {
+            return transport;
+        }
+
+        std::cerr << "[Warning] io_uring isn't supported, the classic transport is used\n";
+    }
+
+    return std::make_unique<pong::server::ClassicTransport>();
+}
+
+/*
+    Options of the command line, parsed once by `parse_options` and read by the server thread
+
+    --io-uring: receive and send with io_uring when the kernel supports it (Linux 6.0)
+    --metrics-port <port>: port of the metrics on 127.0.0.1 (see MetricsEndpoint), 0 to disable them
+    --tick-budget-ms <ms>: ticks longer than that are written as Chrome traces (see TickProfiler), 0 to disable them
+    --trace-dir <directory>: where the traces are written, the working directory by default
+    --capture <file>: record the sessions in the file, to be replayed by `replay` (see SessionCapture)
+    --record-dir <directory>: record the matches played in the rooms there (see MatchRecording)
+    --replay <file>: open a room replaying the recorded match to its spectators, can be repeated
+    --port <port>: port of the server (48624)
+    --coordinator <address>: join the federation of this coordinator (see FederationLink), alone by default
+    --coordinator-port <port>: its port (48626)
+    --public-address <address>: address of the server given to the clients redirected to it (127.0.0.1)
+    --handoff <path>: let a new server take over this one through a UNIX socket there (see HotRestart.hpp)
+    --take-over <path>: replace the running server listening for a handoff there, the other arguments must be its own.
+        Both are given to upgrade a server again and again: `--handoff <path> --take-over <path>`
+*/
+struct ServerOptions {
+    bool io_uring{ false };
+    unsigned short metrics_port{ pong::server::MetricsEndpoint::default_port };
+    std::chrono::nanoseconds tick_budget{ 0 };
+    std::string trace_directory{ "." };
+    std::string capture_path;
+    std::string recording_directory;
+    std::vector<std::string> replays;
+    unsigned short port{ 48624 };
+    std::string coordinator_address;
+    unsigned short coordinator_port{ 48626 };
+    std::string public_address{ "127.0.0.1" };
+    std::string handoff_path;
+    std::string take_over_path;
+};
+
+
+ServerOptions parse_options(int argc, char** argv) {
+    ServerOptions options;
+    for(int i{ 1 }; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--io-uring") == 0) {
+            options.io_uring = true;
+        } else if (std::strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            options.metrics_port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--tick-budget-ms") == 0 && i + 1 < argc) {
+            options.tick_budget = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>{ std::strtod(argv[++i], nullptr) });
+        } else if (std::strcmp(argv[i], "--trace-dir") == 0 && i + 1 < argc) {
+            options.trace_directory = argv[++i];
+        } else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            options.capture_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--record-dir") == 0 && i + 1 < argc) {
+            options.recording_directory = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            options.replays.emplace_back(argv[++i]);
+        } else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            options.port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--coordinator") == 0 && i + 1 < argc) {
+            options.coordinator_address = argv[++i];
+        } else if (std::strcmp(argv[i], "--coordinator-port") == 0 && i + 1 < argc) {
+            options.coordinator_port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--public-address") == 0 && i + 1 < argc) {
+            options.public_address = argv[++i];
+        } else if (std::strcmp(argv[i], "--handoff") == 0 && i + 1 < argc) {
+            options.handoff_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--take-over") == 0 && i + 1 < argc) {
+            options.take_over_path = argv[++i];
+        } else {
+            std::cerr << "[Warning] Unknown argument: " << argv[i] << '\n';
+        }
+    }
+
+    return options;
+}
+
+
+/*
+    Update the gauges of the metrics, and the counters kept by the registry since `reported`
+*/
+void publish_metrics(pong::server::UserRegistry& users, pong::server::NewUserState& new_users, pong::server::MainLobbyState& main_lobby, pong::server::RoomRegistry& rooms,
+    pong::server::TrafficCounters& traffic_reported, pong::server::CompressionCounters& compression_reported) {
+
+    auto& metrics = users.metrics;
+
+    metrics.users.set(static_cast<std::int64_t>(users.number_of_user()));
+    metrics.new_users.set(static_cast<std::int64_t>(new_users.number_of_user()));
+    metrics.lobby_users.set(static_cast<std::int64_t>(main_lobby.number_of_user()));
+    metrics.matchmaking_users.set(static_cast<std::int64_t>(main_lobby.matchmaker.number_of_waiting()));
+
+
+    std::vector<std::pair<std::string, std::int64_t>> room_users;
+    rooms.for_each([&room_users] (auto& room) {
+        room_users.emplace_back(std::to_string(room.room_id), static_cast<std::int64_t>(room.number_of_user()));
+    });
+    metrics.rooms.set(static_cast<std::int64_t>(room_users.size()));
+    metrics.room_users.replace(room_users);
+
+
+    std::size_t backlog{ 0 };
+    users.for_each([&backlog] (pong::server::user_id_t, pong::server::User& user) {
+        backlog += user.output.size();
+    });
+    metrics.output_backlog_bytes.set(static_cast<std::int64_t>(backlog));
+
+
+    metrics.write_syscalls.add(users.traffic.sends - traffic_reported.sends);
+    metrics.socket_syscalls.add(users.traffic.syscalls - traffic_reported.syscalls);
+    metrics.compressed_bytes_in.add(users.compression.bytes_in - compression_reported.bytes_in);
+    metrics.compressed_bytes_out.add(users.compression.bytes_out - compression_reported.bytes_out);
+    // From the totals, the fractions of microsecond aren't lost at each report
+    auto as_microseconds = [] (std::chrono::nanoseconds time) { return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(time).count()); };
+    metrics.compression_microseconds.add(as_microseconds(users.compression.time) - as_microseconds(compression_reported.time));
+    traffic_reported = users.traffic;
+    compression_reported = users.compression;
+}
+
+
+void client_runner(std::mutex& clients_mutex, std::vector<std::unique_ptr<pong::server::TcpSocket>>& clients, std::atomic_bool& stop,
+    std::atomic_bool& accept_paused, ServerOptions const& options, sf::SocketHandle listener_handle, pong::server::HandoffReceiver* takeover) {
+    // Outlives the sessions, they hold references to the names
+    pong::server::UsernameTable usernames;
+    pong::server::UserRegistry users{ make_transport(options.io_uring) };
+    pong::server::RoomRegistry rooms{ users };
+    pong::server::MainLobbyState main_lobby{ users, rooms };
+    pong::server::NewUserState new_users{ users, main_lobby, usernames };
+
+    pong::server::ServerState server{ usernames, users, rooms, main_lobby, new_users };
+
+    std::cout << "Transport: " << users.transport_name() << std::endl;
+
+    // The running server waits for the confirmation, the restore is all it waits for
+    auto takeover_start = std::chrono::steady_clock::now();
+    if (takeover && !pong::server::read_server_image(server, takeover->handoff)) {
+        std::cerr << "[Error] Can't restore the state of the running server, it goes on\n";
+        // Closes the connection to the running server at once, and nothing else: the sockets are still its own
+        std::_Exit(1);
+    }
+
+    // Before the first room, the range of slots of the server is given by the coordinator
+    std::unique_ptr<pong::server::FederationLink> federation;
+    if (!options.coordinator_address.empty()) {
+        federation = std::make_unique<pong::server::FederationLink>(users, main_lobby, rooms, sf::IpAddress{ options.coordinator_address }, options.coordinator_port,
+            options.public_address, options.port);
+
+        if (takeover && rooms.number_of_assigned_slot() == pong::server::RoomRegistry::max_number_of_room) {
+            std::cerr << "[Warning] The server taken over wasn't part of a federation, the server runs alone\n";
+            federation.reset();
+        } else if (takeover || federation->join(sf::seconds(10.f))) {
+            // A server taking over joins again with the range of the old one, from its first update
+            main_lobby.federation = &federation->directory;
+        } else {
+            std::cerr << "[Warning] The server runs alone\n";
+            federation.reset();
+        }
+    }
+
+    rooms.recording_directory = options.recording_directory;
+    // The replay rooms of a server taken over are restored with the rest
+    for(auto const& path : takeover ? std::vector<std::string>{} : options.replays) {
+        auto playback = std::make_unique<pong::server::MatchPlayback>();
+        auto room_id = playback->open(path) ? rooms.allocate(main_lobby) : std::nullopt;
+        if (!room_id) {
+            std::cerr << "[Warning] Can't replay " << path << '\n';
+            continue;
+        }
+
+        rooms.get(*room_id)->start_playback(std::move(playback), usernames);
+        std::cout << "Replay of " << path << " in room #" << *room_id << std::endl;
+    }
+
+    if (!options.capture_path.empty() && takeover) {
+        std::cerr << "[Warning] The sessions of a server taken over can't be captured, " << options.capture_path << " isn't created\n";
+    } else if (!options.capture_path.empty()) {
+        users.capture = std::make_unique<pong::server::SessionCapture>();
+        if (users.capture->open(options.capture_path)) {
+            std::cout << "Sessions captured in " << options.capture_path << std::endl;
+        } else {
+            std::cerr << "[Warning] Can't create the capture " << options.capture_path << '\n';
+            users.capture.reset();
+        }
+    }
+
+    pong::server::MetricsEndpoint metrics_endpoint{ users.metrics.registry };
+    if (takeover && takeover->handoff.metrics_listener >= 0) {
+        metrics_endpoint.adopt(takeover->handoff.metrics_listener);
+    } else if (options.metrics_port != 0) {
+        if (metrics_endpoint.start(options.metrics_port)) {
+            std::cout << "Metrics on 127.0.0.1:" << options.metrics_port << std::endl;
+        } else {
+            std::cerr << "[Warning] Can't listen to the metrics port " << options.metrics_port << '\n';
+        }
+    }
+
+    if (takeover) {
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - takeover_start);
+        if (!takeover->confirm()) {
+            std::cerr << "[Warning] The running server left before the confirmation\n";
+        }
+        std::cout << "Took over " << users.number_of_user() << " users and " << rooms.number_of_room() << " rooms in " << duration.count() << " us" << std::endl;
+    }
+
+    // After the takeover, the path is the one of the server taken over
+    pong::server::HandoffListener handoff_listener;
+    if (!options.handoff_path.empty()) {
+        if (handoff_listener.open(options.handoff_path)) {
+            std::cout << "Handoff on " << options.handoff_path << std::endl;
+        } else {
+            std::cerr << "[Warning] Can't listen for a handoff on " << options.handoff_path << '\n';
+        }
+    }
+
+    auto create_clients = [&clients_mutex, &clients, &users, &new_users] {
+        std::lock_guard lk{ clients_mutex };
+
+        for(auto& client : clients) {
+            new_users.create(users.create(std::move(client)));
+            users.metrics.connections.add();
+        }
+
+        clients.clear();
+    };
 
     sf::Clock clock;
 
+    using Phase = pong::server::TickProfiler::Phase;
+    pong::server::TickProfiler profiler{ options.tick_budget, options.trace_directory };
+
+    static constexpr float traffic_report_period{ 10.f /* seconds */ };
+    sf::Clock traffic_clock;
+    pong::server::TrafficCounters traffic_reported;
+    pong::server::CompressionCounters compression_reported;
+    pong::server::MatchmakingCounters matchmaking_reported;
+
+    static constexpr float metrics_period{ 1.f /* seconds */ };
+    sf::Clock metrics_clock;
+    pong::server::TrafficCounters traffic_published;
+    pong::server::CompressionCounters compression_published;
+
     while(!stop) {
+        profiler.begin_tick();
+
         {
-            std::lock_guard lk{ clients_mutex };
+            auto phase = profiler.measure(Phase::Accept);
+            create_clients();
+        }
 
-            for(auto& client : clients) {
-                new_users.create(std::move(client));
-            }
 
-            clients.clear();
+        {
+            auto phase = profiler.measure(Phase::Receive);
+            users.receive();
+        }
+        {
+            auto phase = profiler.measure(Phase::NewUsers);
+            new_users.receive_packets();
         }
+        {
+            auto phase = profiler.measure(Phase::MainLobby);
+            main_lobby.receive_packets();
+            main_lobby.update_matchmaking();
+        }
+        {
+            auto phase = profiler.measure(Phase::Rooms);
+            rooms.for_each([&profiler] (auto& room) {
+                profiler.measure_room(Phase::Rooms, room, [&room] { room.receive_packets(); });
+            });
+        }
+        {
+            auto phase = profiler.measure(Phase::Transitions);
+            users.execute_transitions();
+        }
+
 
+        auto elapsed = clock.restart();
+        float dt = elapsed.asSeconds();
+        if (users.capture) {
+            users.capture->update(elapsed);
+        }
+        main_lobby.matchmaker.advance(std::chrono::microseconds{ elapsed.asMicroseconds() });
 
-        new_users.receive_packets();
-        main_lobby.receive_packets();
-        for(auto& room : rooms) {
-            if(room) {
-                room->receive_packets();
+        {
+            auto phase = profiler.measure(Phase::UpdateLobby);
+            main_lobby.update_rooms();
+            if (federation) {
+                federation->update();
             }
         }
+        {
+            auto phase = profiler.measure(Phase::UpdateGames);
+            rooms.for_each([&profiler, dt] (auto& room) {
+                profiler.measure_room(Phase::UpdateGames, room, [&room, dt] { room.update_game(dt); });
+            });
+        }
+
+
+        {
+            auto phase = profiler.measure(Phase::Flush);
+            users.flush();
+        }
 
 
-        float dt = clock.restart().asSeconds();
-        main_lobby.update_rooms();
-        for(auto& room : rooms) {
-            if(room) {
-                room->update_game(dt);
+        {
+            auto phase = profiler.measure(Phase::Report);
+
+            if (metrics_clock.getElapsedTime().asSeconds() >= metrics_period) {
+                publish_metrics(users, new_users, main_lobby, rooms, traffic_published, compression_published);
+                metrics_clock.restart();
+            }
+
+
+            if (traffic_clock.getElapsedTime().asSeconds() >= traffic_report_period) {
+                auto const& traffic = users.traffic;
+                if (traffic.messages != traffic_reported.messages) {
+                    std::cout << "Sent " << traffic.messages - traffic_reported.messages << " messages in " 
+                        << traffic.sends - traffic_reported.sends << " writes (" 
+                        << traffic.bytes_sent - traffic_reported.bytes_sent << " bytes) to " << users.number_of_user() << " users, "
+                        << traffic.syscalls - traffic_reported.syscalls << " syscalls\n";
+                }
+
+                auto const& compression = users.compression;
+                if (compression.frames != compression_reported.frames) {
+                    auto bytes_in = compression.bytes_in - compression_reported.bytes_in;
+                    auto bytes_out = compression.bytes_out - compression_reported.bytes_out;
+                    std::cout << "Compressed " << compression.frames - compression_reported.frames << " frames: "
+                        << bytes_in << " -> " << bytes_out << " bytes (" << bytes_in - bytes_out << " saved) in "
+                        << std::chrono::duration_cast<std::chrono::microseconds>(compression.time - compression_reported.time).count() << " us\n";
+                }
+
+                auto const& matchmaking = main_lobby.matchmaker.counters;
+                if (matchmaking.matches != matchmaking_reported.matches) {
+                    auto waited = matchmaking.waited - matchmaking_reported.waited;
+                    auto users_paired = matchmaking.users - matchmaking_reported.users;
+                    std::cout << "Matched " << matchmaking.matches - matchmaking_reported.matches << " pairs, "
+                        << std::chrono::duration_cast<std::chrono::milliseconds>(waited).count() / static_cast<long long>(users_paired)
+                        << " ms waited on average, " << main_lobby.matchmaker.number_of_waiting() << " users waiting\n";
+                }
+
+                profiler.report(std::cout);
+
+                traffic_reported = traffic;
+                compression_reported = compression;
+                matchmaking_reported = matchmaking;
+                traffic_clock.restart();
             }
         }
 
+        // Between two ticks, every output buffer was flushed
+        if (handoff_listener.poll()) {
+            auto start = std::chrono::steady_clock::now();
+
+            // Set under the lock of the accepts: no client is accepted once the last ones are created,
+            // the new ones wait in the backlog of the listener for the new server
+            {
+                std::lock_guard lk{ clients_mutex };
+                accept_paused = true;
+            }
+            create_clients();
+            users.release_transport();
+
+            pong::server::Handoff handoff;
+            handoff.listener = listener_handle;
+            handoff.metrics_listener = metrics_endpoint.is_started() ? metrics_endpoint.handle() : -1;
 
-        new_users.send_packets();
-        main_lobby.send_packets();
-        for(auto& room : rooms) {
-            if(room) {
-                room->send_packets();
+            pong::server::StateWriter writer;
+            pong::server::write_server_image(server, writer, handoff);
+            handoff.image = std::move(writer.bytes);
+
+            if (handoff_listener.hand_over(handoff)) {
+                auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+                std::cout << "Handed over " << users.number_of_user() << " users and " << rooms.number_of_room() << " rooms ("
+                    << handoff.image.size() << " bytes) in " << duration.count() << " us" << std::endl;
+
+                // Without closing anything, the sockets belong to the new server
+                std::_Exit(0);
             }
+
+            std::cerr << "[Warning] The new server didn't take over, the server goes on\n";
+            users.resume_transport();
+            accept_paused = false;
         }
+
+        profiler.end_tick();
     }
 }
 
-int main() {
-    sf::TcpListener listener;
-    auto status = listener.listen(48624);
-    if (status != sf::Socket::Status::Done) {
-        std::cout << "Listening status error: " << static_cast<int>(status) << '\n';
-        return 1;
+int main(int argc, char** argv) {
+    auto options = parse_options(argc, argv);
+
+    // A server taking over listens with the listener of the running one
+    pong::server::TcpListener listener;
+    pong::server::HandoffReceiver takeover;
+    if (!options.take_over_path.empty()) {
+        if (!takeover.receive(options.take_over_path)) {
+            std::cerr << "Can't take over the server of " << options.take_over_path << '\n';
+            return 1;
+        }
+
+        listener.adopt(takeover.handoff.listener);
+    } else {
+        auto status = listener.listen(options.port);
+        if (status != sf::Socket::Status::Done) {
+            std::cout << "Listening status error: " << static_cast<int>(status) << '\n';
+            return 1;
+        }
     }
 
     std::mutex clients_mutex;
-    std::vector<std::unique_ptr<sf::TcpSocket>> clients;
+    std::vector<std::unique_ptr<pong::server::TcpSocket>> clients;
     std::atomic_bool stop_thread{ false };
+    // Set by the client thread during a handoff, see HotRestart.hpp
+    std::atomic_bool accept_paused{ false };
 
-    std::thread client_thread(client_runner, std::ref(clients_mutex), std::ref(clients), std::ref(stop_thread));
+    pong::server::SocketOptions socket_options;
+
+    std::thread client_thread(client_runner, std::ref(clients_mutex), std::ref(clients), std::ref(stop_thread), std::ref(accept_paused),
+        std::cref(options), listener.handle(), options.take_over_path.empty() ? nullptr : &takeover);
+
+    // The accepts don't block, so the loop can be paused
+    listener.setBlocking(false);
+    sf::SocketSelector selector;
+    selector.add(listener);
 
     while(true) {
-        auto client = std::make_unique<sf::TcpSocket>();
-        if (listener.accept(*client) != sf::Socket::Done) {
-            std::cerr << "Error\n";
+        if (accept_paused) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
             continue;
         }
 
+        if (!selector.wait(sf::milliseconds(100))) {
+            continue;
+        }
+
+        // Accepted under the lock, a client is never accepted after the handoff created the last ones
+        std::lock_guard lk{ clients_mutex };
+        if (accept_paused) {
+            continue;
+        }
+
+        auto client = std::make_unique<pong::server::TcpSocket>();
+        if (auto status = listener.accept(*client); status != sf::Socket::Done) {
+            if (status != sf::Socket::NotReady) {
+                std::cerr << "Error\n";
+            }
+            continue;
+        }
+
+        if (!client->configure(socket_options)) {
+            std::cerr << "[Warning] Couldn't set the TCP options of the client\n";
+        }
+
         std::cout << "New client: " << client->getRemoteAddress() << ":" << client->getRemotePort() << std::endl;
         client->setBlocking(false);
-        
-        std::lock_guard lk{ clients_mutex };
+
         clients.emplace_back(std::move(client));
     }
 
@@ -0,0 +1,159 @@
+#include <SFML/Network.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pong/server/State.hpp>
+#include <pong/server/NewUser.hpp>
+#include <pong/server/Relay.hpp>
+#include <pong/server/UserRegistry.hpp>
+#include <pong/server/TcpSocket.hpp>
+#include <pong/server/IoUringTransport.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/*
+    Relay of the spectators of an origin server (see Relay.hpp)
+
+    The clients connect to the relay as to a server: they log in, browse the lobby of the origin and enter its rooms
+    as spectators. A room watched by many spectators of the relay costs the origin a single connection.
+    The loop is the one of main2, the origin is read and written once per tick, after the transitions.
+    Build with `make SRC_MAIN=relay.cpp`
+*/
+
+namespace {
+
+std::unique_ptr<pong::server::Transport> make_transport(bool io_uring) {
+    if (io_uring) {
+        if (auto transport = pong::server::make_io_uring_transport()) {
+            return transport;
+        }
+
+        std::cerr << "[Warning] io_uring isn't supported, the classic transport is used\n";
+    }
+
+    return std::make_unique<pong::server::ClassicTransport>();
+}
+
+
+void client_runner(std::mutex& clients_mutex, std::vector<std::unique_ptr<pong::server::TcpSocket>>& clients, std::atomic_bool& stop, bool io_uring,
+    pong::server::Origin const& origin) {
+    // Outlives the sessions, they hold references to the names
+    pong::server::UsernameTable usernames;
+    pong::server::UserRegistry users{ make_transport(io_uring) };
+    pong::server::RelayLobbyState lobby{ users, usernames, origin };
+    pong::server::BasicNewUserState<pong::server::RelayLobbyState> new_users{ users, lobby, usernames };
+
+    std::cout << "Transport: " << users.transport_name() << std::endl;
+
+    while(!stop) {
+        {
+            std::lock_guard lk{ clients_mutex };
+
+            for(auto& client : clients) {
+                new_users.create(users.create(std::move(client)));
+                users.metrics.connections.add();
+            }
+
+            clients.clear();
+        }
+
+        users.receive();
+        new_users.receive_packets();
+        lobby.receive_packets();
+        lobby.for_each_room([] (auto& room) { room.receive_packets(); });
+        users.execute_transitions();
+
+        lobby.update();
+
+        users.flush();
+    }
+}
+
+}
+
+
+/*
+    --origin <address>: the server relayed (127.0.0.1)
+    --origin-port <port>: its port (48624)
+    --port <port>: port of the relay (48625)
+    --name <username>: name of the relay on the origin (relay)
+    --io-uring: receive and send with io_uring when the kernel supports it (Linux 6.0)
+*/
+int main(int argc, char** argv) {
+    bool io_uring{ false };
+    std::string origin_address{ "127.0.0.1" };
+    unsigned short origin_port{ 48624 };
+    unsigned short port{ 48625 };
+    std::string name{ "relay" };
+    for(int i{ 1 }; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--io-uring") == 0) {
+            io_uring = true;
+        } else if (std::strcmp(argv[i], "--origin") == 0 && i + 1 < argc) {
+            origin_address = argv[++i];
+        } else if (std::strcmp(argv[i], "--origin-port") == 0 && i + 1 < argc) {
+            origin_port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else {
+            std::cerr << "[Warning] Unknown argument: " << argv[i] << '\n';
+        }
+    }
+
+    if (!pong::server::is_username_valid(name)) {
+        return 1;
+    }
+
+    pong::server::Origin origin{ sf::IpAddress{ origin_address }, origin_port, name };
+    if (origin.address == sf::IpAddress::None) {
+        std::cerr << "Unknown origin " << origin_address << '\n';
+        return 1;
+    }
+
+    sf::TcpListener listener;
+    auto status = listener.listen(port);
+    if (status != sf::Socket::Status::Done) {
+        std::cout << "Listening status error: " << static_cast<int>(status) << '\n';
+        return 1;
+    }
+
+    std::cout << "Relay of " << origin.address << ':' << origin.port << " on port " << port << std::endl;
+
+    std::mutex clients_mutex;
+    std::vector<std::unique_ptr<pong::server::TcpSocket>> clients;
+    std::atomic_bool stop_thread{ false };
+
+    pong::server::SocketOptions socket_options;
+
+    std::thread client_thread(client_runner, std::ref(clients_mutex), std::ref(clients), std::ref(stop_thread), io_uring, std::cref(origin));
+
+    while(true) {
+        auto client = std::make_unique<pong::server::TcpSocket>();
+        if (listener.accept(*client) != sf::Socket::Done) {
+            std::cerr << "Error\n";
+            continue;
+        }
+
+        if (!client->configure(socket_options)) {
+            std::cerr << "[Warning] Couldn't set the TCP options of the client\n";
+        }
+
+        std::cout << "New client: " << client->getRemoteAddress() << ":" << client->getRemotePort() << std::endl;
+        client->setBlocking(false);
+
+        std::lock_guard lk{ clients_mutex };
+        clients.emplace_back(std::move(client));
+    }
+
+    stop_thread = true;
+}
@@ -0,0 +1,226 @@
+#include <SFML/Network.hpp>
+
+#include <iostream>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <pong/server/State.hpp>
+#include <pong/server/NewUser.hpp>
+#include <pong/server/MainLobby.hpp>
+#include <pong/server/Room.hpp>
+#include <pong/server/RoomRegistry.hpp>
+#include <pong/server/UserRegistry.hpp>
+#include <pong/server/ReplayTransport.hpp>
+#include <pong/server/SessionCapture.hpp>
+
+#include <cstring>
+#include <string>
+
+/*
+    Replay a capture of `main2 --capture` through the states of the server, without sockets
+
+    The ticks are run like in main2, with the frames each tick handled and the `dt` it gave to the games,
+    and the frames sent are compared with the ones recorded: the server is deterministic, a mismatch is a regression
+    (or a frame the capture dropped because the OutputBuffer of its user was full, the replay never drops any).
+    The ids of the users are mapped from the capture to the replay, the registry may number them differently.
+    As fast as possible by default, to profile the states under a real load: `perf record ./replay capture.bin`
+    Build with `make SRC_MAIN=replay.cpp`
+*/
+
+namespace {
+
+static constexpr std::size_t max_reported_mismatch{ 10 };
+
+
+struct Totals {
+    std::uint64_t ticks{ 0 };
+    std::uint64_t sessions{ 0 };
+    std::uint64_t inbound_frames{ 0 };
+    std::uint64_t outbound_frames{ 0 };
+    std::uint64_t mismatches{ 0 };
+    std::chrono::microseconds recorded{ 0 };
+};
+
+
+void report_mismatch(Totals& totals, char const* what, pong::server::user_id_t user, std::vector<std::byte> const& frame) {
+    if (++totals.mismatches > max_reported_mismatch) {
+        return;
+    }
+
+    std::cout << "Tick " << totals.ticks << ": " << what << " frame to user " << user << ", " << frame.size() << " bytes";
+    if (!frame.empty()) {
+        std::cout << ", first byte " << std::to_integer<int>(frame.front());
+    }
+    std::cout << '\n';
+}
+
+
+/*
+    Compare the frames sent by the replay in a tick with the ones recorded
+    Both are in the order of the slots of the users, then of the frames
+*/
+void compare(Totals& totals, std::vector<pong::server::ReplayTransport::Frame> const& sent, std::vector<pong::server::ReplayTransport::Frame> const& recorded) {
+    std::size_t i{ 0 };
+    for(; i < sent.size() && i < recorded.size(); ++i) {
+        if (sent[i].user != recorded[i].user || sent[i].bytes != recorded[i].bytes) {
+            report_mismatch(totals, "Different", recorded[i].user, recorded[i].bytes);
+        }
+    }
+
+    for(std::size_t j{ i }; j < sent.size(); ++j) {
+        report_mismatch(totals, "Extra", sent[j].user, sent[j].bytes);
+    }
+    for(std::size_t j{ i }; j < recorded.size(); ++j) {
+        report_mismatch(totals, "Missing", recorded[j].user, recorded[j].bytes);
+    }
+}
+
+}
+
+
+/*
+    replay <capture> [--realtime]
+    --realtime: wait for the time of each tick, as recorded, instead of running them back to back
+*/
+int main(int argc, char** argv) {
+    std::string path;
+    bool realtime{ false };
+    for(int i{ 1 }; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else if (path.empty() && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            std::cerr << "[Warning] Unknown argument: " << argv[i] << '\n';
+        }
+    }
+
+    pong::server::CaptureReader reader;
+    if (path.empty() || !reader.open(path)) {
+        std::cerr << "Usage: replay <capture> [--realtime], the capture must be written by `main2 --capture`\n";
+        return 1;
+    }
+
+
+    auto transport_owner = std::make_unique<pong::server::ReplayTransport>();
+    auto& transport = *transport_owner;
+
+    pong::server::UsernameTable usernames;
+    pong::server::UserRegistry users{ std::move(transport_owner) };
+    pong::server::RoomRegistry rooms{ users };
+    pong::server::MainLobbyState main_lobby{ users, rooms };
+    pong::server::NewUserState new_users{ users, main_lobby, usernames };
+
+    // Of the capture to the replay
+    std::unordered_map<pong::server::user_id_t, pong::server::user_id_t> ids;
+    auto replay_id = [&ids] (pong::server::user_id_t recorded) {
+        auto it = ids.find(recorded);
+        return it != std::end(ids) ? it->second : pong::server::invalid_user_id;
+    };
+
+    Totals totals;
+    pong::server::CaptureEvent event;
+    bool has_event{ reader.next(event) };
+    std::vector<pong::server::ReplayTransport::Frame> recorded;
+
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds tick_time{ 0 };
+
+    while(has_event) {
+
+        // The sessions and frames of the tick, until its Update
+        for(; has_event && event.record != pong::server::CaptureRecord::Update; has_event = reader.next(event)) {
+            switch(event.record) {
+                case pong::server::CaptureRecord::Connect: {
+                    auto id = users.create(std::make_unique<pong::server::TcpSocket>());
+                    new_users.create(id);
+                    ids[event.user] = id;
+                    ++totals.sessions;
+                    break;
+                }
+
+                case pong::server::CaptureRecord::Inbound:
+                    transport.queue_frame(replay_id(event.user), std::move(event.bytes));
+                    ++totals.inbound_frames;
+                    break;
+
+                case pong::server::CaptureRecord::OversizedFrame:
+                    transport.queue_oversized_frame(replay_id(event.user), event.size);
+                    break;
+
+                case pong::server::CaptureRecord::Disconnect:
+                    transport.queue_disconnect(replay_id(event.user));
+                    break;
+
+                case pong::server::CaptureRecord::Outbound:
+                case pong::server::CaptureRecord::Update:
+                    break;
+            }
+        }
+
+        // The server stopped during the tick
+        if (!has_event) {
+            break;
+        }
+
+
+        if (realtime) {
+            std::this_thread::sleep_until(start + event.time);
+        }
+
+        float dt = event.dt.asSeconds();
+        totals.recorded = event.time;
+        auto tick_start = std::chrono::steady_clock::now();
+
+        users.receive();
+        new_users.receive_packets();
+        main_lobby.receive_packets();
+        main_lobby.update_matchmaking();
+        rooms.for_each([] (auto& room) { room.receive_packets(); });
+        users.execute_transitions();
+
+        // Like the server, with the duration of the tick it recorded
+        main_lobby.matchmaker.advance(std::chrono::microseconds{ event.dt.asMicroseconds() });
+        main_lobby.update_rooms();
+        rooms.for_each([dt] (auto& room) { room.update_game(dt); });
+
+        users.flush();
+
+        tick_time += std::chrono::steady_clock::now() - tick_start;
+        ++totals.ticks;
+
+
+        // The frames sent by the tick follow its Update
+        recorded.clear();
+        for(has_event = reader.next(event); has_event && event.record == pong::server::CaptureRecord::Outbound; has_event = reader.next(event)) {
+            recorded.push_back({ replay_id(event.user), std::move(event.bytes) });
+        }
+
+        auto sent = transport.take_sent();
+        totals.outbound_frames += sent.size();
+
+        // The capture may end in the middle of the frames of its last tick
+        if (has_event) {
+            compare(totals, sent, recorded);
+        }
+    }
+
+
+    if (reader.failed()) {
+        std::cerr << "[Warning] The capture ends with a truncated or malformed record\n";
+    }
+
+    auto seconds = [] (auto duration) { return std::chrono::duration<double>(duration).count(); };
+    auto ticks = static_cast<double>(std::max<std::uint64_t>(totals.ticks, 1));
+
+    std::cout << "Replayed " << totals.ticks << " ticks (" << seconds(totals.recorded) << " s recorded) of " << totals.sessions << " sessions: "
+        << totals.inbound_frames << " frames received, " << totals.outbound_frames << " frames sent\n";
+    std::cout << "Ticks: " << ticks / seconds(tick_time) << "/s, " << seconds(tick_time) * 1e6 / ticks << " us per tick, "
+        << static_cast<double>(totals.inbound_frames + totals.outbound_frames) / seconds(tick_time) << " frames/s\n";
+    std::cout << "Mismatches: " << totals.mismatches << '\n';
+
+    return totals.mismatches == 0 && !reader.failed() ? 0 : 2;
+}
@@ -0,0 +1,150 @@
+#include <SFML/Network.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <pong/packet/Client.hpp>
+#include <pong/packet/Reader.hpp>
+#include <pong/packet/Server.hpp>
+#include <pong/packet/Writer.hpp>
+
+/*
+    Malformed frames are refused by the decoders with the error of the first field that can't be read,
+    before anything is allocated for the lengths they announce
+    The frames are crafted field by field, without the size that prefixes them on the connection
+    Build with `make SRC_MAIN=test_decoder.cpp`, returns 1 if a check failed
+*/
+
+namespace {
+
+namespace packet = pong::packet;
+
+
+/*
+    A frame of the id and the given values, each written as its type in `encoding`
+*/
+template<typename...T>
+std::vector<std::byte> frame(packet::Encoding encoding, packet::id_t id, T const&...values) {
+    std::vector<std::byte> bytes(256);
+    packet::details::Writer writer{ bytes.data(), encoding };
+    writer << id;
+    ((writer << values), ...);
+
+    bytes.resize(static_cast<std::size_t>(writer.position - bytes.data()));
+    return bytes;
+}
+
+
+template<typename P>
+std::vector<std::byte> valid_frame(P const& server_packet) {
+    std::vector<std::byte> bytes(packet::details::frame_size(server_packet));
+    packet::details::Writer writer{ bytes.data() };
+    packet::details::write_frame(writer, packet::server::id_of<P>(), server_packet);
+
+    // Without the size of the frame
+    bytes.erase(std::begin(bytes), std::begin(bytes) + static_cast<std::ptrdiff_t>(sizeof(sf::Uint32)));
+    return bytes;
+}
+
+
+packet::DecodeError decode_server(std::vector<std::byte> const& bytes, packet::server::Any& decoded, packet::Encoding encoding = packet::Encoding::Sfml) {
+    return packet::server::decode(bytes.data(), bytes.size(), decoded, encoding);
+}
+
+
+packet::DecodeError decode_client(std::vector<std::byte> const& bytes, packet::Encoding encoding = packet::Encoding::Sfml) {
+    packet::client::Any decoded;
+    return packet::client::decode(bytes.data(), bytes.size(), decoded, encoding);
+}
+
+
+bool check(bool condition, char const* name) {
+    std::cout << (condition ? "[Ok] " : "[Failed] ") << name << '\n';
+    return condition;
+}
+
+
+bool vector_count_over_its_maximum() {
+    auto bytes = frame(packet::Encoding::Sfml, packet::server::id_of<packet::server::RoomInfo>(),
+        sf::Uint32{ 0 }, sf::Uint32{ 0 }, sf::Uint64{ 1 } << 40);
+
+    packet::server::Any decoded;
+    auto error = decode_server(bytes, decoded);
+    auto const* room_info = std::get_if<packet::server::RoomInfo>(&decoded);
+
+    return check(error == packet::DecodeError::TooLong && room_info && room_info->spectators.capacity() == 0,
+        "A RoomInfo of 2^40 spectators is too long");
+}
+
+
+bool vector_count_over_the_frame() {
+    // Under `max_room_summaries`, but the frame holds no summary
+    auto bytes = frame(packet::Encoding::Sfml, packet::server::id_of<packet::server::LobbyInfo>(),
+        sf::Uint32{ 1 }, sf::Uint64{ packet::server::max_room_summaries });
+
+    packet::server::Any decoded;
+    auto error = decode_server(bytes, decoded);
+    auto const* lobby_info = std::get_if<packet::server::LobbyInfo>(&decoded);
+
+    return check(error == packet::DecodeError::Truncated && lobby_info && lobby_info->rooms.capacity() == 0,
+        "A LobbyInfo announcing more rooms than its frame holds is truncated");
+}
+
+
+bool string_length_over_its_maximum() {
+    auto bytes = frame(packet::Encoding::Sfml, packet::client::id_of<packet::client::ChangeUsername>(),
+        sf::Uint32{ 0xFFFFFFFF });
+
+    return check(decode_client(bytes) == packet::DecodeError::TooLong, "A ChangeUsername of 2^32 - 1 characters is too long");
+}
+
+
+bool string_length_over_the_frame() {
+    auto bytes = frame(packet::Encoding::Sfml, packet::client::id_of<packet::client::ChangeUsername>(),
+        sf::Uint32{ 8 }, sf::Uint8{ 'p' }, sf::Uint8{ 'o' });
+
+    return check(decode_client(bytes) == packet::DecodeError::Truncated,
+        "A ChangeUsername announcing more characters than its frame holds is truncated");
+}
+
+
+bool truncated_frame() {
+    auto bytes = valid_frame(packet::server::RoomInfo{ 1, 2, { 3, 4, 5 } });
+
+    packet::server::Any decoded;
+    bool whole = decode_server(bytes, decoded) == packet::DecodeError::None;
+
+    bytes.pop_back();
+    return check(whole && decode_server(bytes, decoded) == packet::DecodeError::Truncated, "A RoomInfo missing its last byte is truncated");
+}
+
+
+bool unknown_id() {
+    auto sfml = frame(packet::Encoding::Sfml, 200);
+    auto compact = frame(packet::Encoding::Compact, 200);
+
+    packet::server::Any decoded;
+    return check(decode_server(sfml, decoded) == packet::DecodeError::BadId
+        && decode_server(compact, decoded, packet::Encoding::Compact) == packet::DecodeError::BadId
+        && decode_client(sfml) == packet::DecodeError::BadId
+        && decode_client(compact, packet::Encoding::Compact) == packet::DecodeError::BadId,
+        "An unknown id is refused");
+}
+
+}
+
+
+int main() {
+    bool ok{ true };
+    ok &= vector_count_over_its_maximum();
+    ok &= vector_count_over_the_frame();
+    ok &= string_length_over_its_maximum();
+    ok &= string_length_over_the_frame();
+    ok &= truncated_frame();
+    ok &= unknown_id();
+
+    return ok ? 0 : 1;
+}
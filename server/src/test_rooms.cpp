@@ -0,0 +1,151 @@
+#include <SFML/Network.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pong/packet/Client.hpp>
+#include <pong/packet/Writer.hpp>
+
+#include <pong/server/MainLobby.hpp>
+#include <pong/server/RoomRegistry.hpp>
+#include <pong/server/TcpSocket.hpp>
+#include <pong/server/UserRegistry.hpp>
+#include <pong/server/Username.hpp>
+
+/*
+    Rooms left by all their users are reclaimed and retracted from the lobby,
+    also when the last users leave during the same tick
+    The sockets aren't connected, the users are members of the room without the packets of `on_user_enter`
+    Build with `make SRC_MAIN=test_rooms.cpp`, returns 1 if a check failed
+*/
+
+namespace {
+
+namespace server = pong::server;
+
+
+struct Server {
+    server::UsernameTable usernames;
+    server::UserRegistry users;
+    server::RoomRegistry rooms{ users };
+    server::MainLobbyState main_lobby{ users, rooms };
+
+
+    server::RoomState& room_with(std::size_t number_of_member) {
+        auto& room = *rooms.get(*rooms.allocate(main_lobby));
+
+        for(std::size_t i{ 0 }; i < number_of_member; ++i) {
+            auto id = users.create(std::make_unique<server::TcpSocket>());
+            users.get(id)->username = usernames.intern("user-" + std::to_string(id));
+            room.restore(id);
+        }
+
+        // Listed in the lobby, like a room someone entered
+        room.notify_lobby();
+        main_lobby.update_rooms();
+        return room;
+    }
+
+
+    // One tick of the server, without the sockets
+    void tick() {
+        main_lobby.receive_packets();
+        rooms.for_each([] (auto& room) { room.receive_packets(); });
+        users.execute_transitions();
+        main_lobby.update_rooms();
+    }
+
+
+    bool is_listed(server::room_id_t room_id) const {
+        for(auto const& summary : main_lobby.snapshot.rooms) {
+            if (summary.id == room_id) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+
+template<typename P>
+void receive(server::User& user, P const& packet) {
+    std::vector<std::byte> frame(pong::packet::details::frame_size(packet, user.encoding));
+    pong::packet::details::Writer writer{ frame.data(), user.encoding };
+    pong::packet::details::write_frame(writer, pong::packet::client::id_of<P>(), packet);
+    user.input.append(frame.data(), frame.size());
+}
+
+
+bool check(bool condition, char const* name) {
+    std::cout << (condition ? "[Ok] " : "[Failed] ") << name << '\n';
+    return condition;
+}
+
+
+bool last_user_disconnects() {
+    Server s;
+    auto& room = s.room_with(1);
+    auto room_id = room.room_id;
+
+    room.get_user(0).disconnected = true;
+    s.tick();
+
+    return check(s.rooms.get(room_id) == nullptr && !s.is_listed(room_id), "The last user disconnects");
+}
+
+
+bool last_users_disconnect_in_the_same_tick() {
+    Server s;
+    auto& room = s.room_with(2);
+    auto room_id = room.room_id;
+
+    room.get_user(0).disconnected = true;
+    room.get_user(1).disconnected = true;
+    s.tick();
+
+    return check(s.rooms.get(room_id) == nullptr && !s.is_listed(room_id), "The last two users disconnect in the same tick");
+}
+
+
+bool last_users_leave_and_disconnect_in_the_same_tick() {
+    Server s;
+    auto& room = s.room_with(2);
+    auto room_id = room.room_id;
+
+    receive(room.get_user(0), pong::packet::client::LeaveRoom{});
+    room.get_user(1).disconnected = true;
+    s.tick();
+
+    return check(s.rooms.get(room_id) == nullptr && !s.is_listed(room_id) && s.main_lobby.number_of_user() == 1,
+        "The last two users leave the room and disconnect in the same tick");
+}
+
+
+bool room_with_a_user_left_is_kept() {
+    Server s;
+    auto& room = s.room_with(3);
+    auto room_id = room.room_id;
+
+    room.get_user(0).disconnected = true;
+    room.get_user(1).disconnected = true;
+    s.tick();
+
+    return check(s.rooms.get(room_id) != nullptr && s.is_listed(room_id), "A room with a user left is kept");
+}
+
+}
+
+
+int main() {
+    bool ok{ true };
+    ok &= last_user_disconnects();
+    ok &= last_users_disconnect_in_the_same_tick();
+    ok &= last_users_leave_and_disconnect_in_the_same_tick();
+    ok &= room_with_a_user_left_is_kept();
+
+    return ok ? 0 : 1;
+}